@@ -0,0 +1,141 @@
+#include <nano/graphics.h>
+
+#include <chrono>
+#include <cstdio>
+
+// Time to decode a 4000x3000 jpeg at every decode_scale, against the full size decode followed
+// by image::resize_pixels with the box filter, which gives the same size as the reduced decode.
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/graphics_codec.h>
+
+  #include <cstdlib>
+  #include <sstream>
+
+  #include <jpeglib.h>
+
+namespace {
+constexpr std::size_t width = 4000;
+constexpr std::size_t height = 3000;
+constexpr double min_seconds = 0.5;
+
+using scale = nano::image::decode_scale;
+
+const std::pair<scale, const char*> scales[] = {
+  { scale::full, "1/1" },
+  { scale::half, "1/2" },
+  { scale::quarter, "1/4" },
+  { scale::eighth, "1/8" },
+};
+
+// Smooth gradients with some noise, compressed at quality 90 in 4:2:0.
+std::string make_jpeg() {
+  jpeg_compress_struct info;
+  jpeg_error_mgr error;
+  info.err = jpeg_std_error(&error);
+  jpeg_create_compress(&info);
+
+  unsigned char* buffer = nullptr;
+  unsigned long size = 0;
+  jpeg_mem_dest(&info, &buffer, &size);
+
+  info.image_width = width;
+  info.image_height = height;
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, 90, TRUE);
+  jpeg_start_compress(&info, TRUE);
+
+  std::vector<std::uint8_t> row(width * 3);
+  std::uint32_t seed = 7;
+
+  while (info.next_scanline < height) {
+    const std::size_t y = info.next_scanline;
+
+    for (std::size_t x = 0; x < width; x++) {
+      seed = seed * 1664525u + 1013904223u;
+      const std::uint32_t noise = seed >> 28;
+      row[x * 3] = static_cast<std::uint8_t>(x * 255 / width + noise);
+      row[x * 3 + 1] = static_cast<std::uint8_t>(y * 255 / height / 2 + noise);
+      row[x * 3 + 2] = static_cast<std::uint8_t>((x + y) % 256);
+    }
+
+    JSAMPROW r = row.data();
+    jpeg_write_scanlines(&info, &r, 1);
+  }
+
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+
+  std::string file(reinterpret_cast<const char*>(buffer), size);
+  std::free(buffer);
+  return file;
+}
+
+template <typename Fct>
+double milliseconds(Fct&& fct) {
+  std::size_t iterations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+
+  do {
+    fct();
+    iterations++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_seconds);
+
+  return seconds * 1e3 / static_cast<double>(iterations);
+}
+
+/// The whole image in rgb, rows are read one at a time.
+std::vector<std::uint8_t> decode(const std::string& file, scale s, nano::size<std::size_t>& size) {
+  std::istringstream input(file);
+  nano::jpeg_decoder decoder(input, s);
+  size = decoder.get_size();
+
+  std::vector<std::uint8_t> pixels(size.width * size.height * 3);
+  for (std::size_t y = 0; y < size.height; y++) {
+    decoder.read_row(pixels.data() + y * size.width * 3);
+  }
+
+  return pixels;
+}
+} // namespace.
+
+int main() {
+  const std::string file = make_jpeg();
+  std::printf("%zux%zu jpeg, %zu bytes\n", width, height, file.size());
+
+  nano::size<std::size_t> full_size;
+  const double full_ms = milliseconds([&] { decode(file, scale::full, full_size); });
+  const std::vector<std::uint8_t> full = decode(file, scale::full, full_size);
+  const nano::image_view full_view(full.data(), full_size, full_size.width * 3, nano::image::format::rgb);
+
+  for (const auto& [s, name] : scales) {
+    nano::size<std::size_t> size;
+    const double idct_ms = milliseconds([&] { decode(file, s, size); });
+    double baseline_ms = full_ms;
+
+    if (s != scale::full) {
+      std::vector<std::uint8_t> resized(size.width * size.height * 3);
+      const nano::mutable_image_view resized_view(resized.data(), size, size.width * 3, nano::image::format::rgb);
+      baseline_ms = milliseconds([&] {
+        decode(file, scale::full, full_size);
+        nano::image::resize_pixels(full_view, resized_view, nano::image::filter::box);
+      });
+    }
+
+    std::printf("%s %4zux%-4zu  idct %8.2f ms  full + resize %8.2f ms  speedup %5.2fx\n", name, size.width,
+        size.height, idct_ms, baseline_ms, baseline_ms / idct_ms);
+  }
+
+  return 0;
+}
+
+#else
+int main() {
+  std::printf("The jpeg decoder is only available with the software renderer.\n");
+  return 0;
+}
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
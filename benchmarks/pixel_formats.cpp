@@ -0,0 +1,151 @@
+#include <nano/graphics.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Pixels per second of the format conversions for every instruction set, the output of
+// each level is checked against the scalar one. The last column converts the whole image
+// with image::convert_pixels, which splits it in bands on the thread pool.
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/graphics_raster.h>
+
+namespace {
+constexpr std::size_t width = 1920;
+constexpr std::size_t height = 1080;
+constexpr double min_seconds = 0.2;
+
+using fmt = nano::image::format;
+using op = nano::image::alpha_conversion;
+
+struct conversion {
+  const char* name;
+  fmt src;
+  fmt dst;
+  op alpha;
+};
+
+const conversion conversions[] = {
+  { "rgba -> bgra", fmt::rgba, fmt::bgra, op::none },
+  { "rgba -> xrgb", fmt::rgba, fmt::xrgb, op::none },
+  { "rgba -> rgba premultiply", fmt::rgba, fmt::rgba, op::premultiply },
+  { "bgra -> rgba unpremultiply", fmt::bgra, fmt::rgba, op::unpremultiply },
+  { "rgb -> abgr", fmt::rgb, fmt::abgr, op::none },
+  { "argb -> rgb", fmt::argb, fmt::rgb, op::none },
+  { "rgba -> alpha", fmt::rgba, fmt::alpha, op::none },
+  { "alpha -> bgra", fmt::alpha, fmt::bgra, op::none },
+  { "rgba -> float_rgba", fmt::rgba, fmt::float_rgba, op::none },
+  { "float_rgba -> bgra", fmt::float_rgba, fmt::bgra, op::none },
+  { "float_argb -> rgba premul", fmt::float_argb, fmt::rgba, op::premultiply },
+};
+
+const std::pair<nano::detail::simd_level, const char*> levels[] = {
+  { nano::detail::simd_level::scalar, "scalar" },
+  { nano::detail::simd_level::sse2, "sse2" },
+  { nano::detail::simd_level::avx2, "avx2" },
+};
+
+inline std::size_t row_size(fmt f) { return width * nano::detail::get_bits_per_pixel(f) / 8; }
+
+// Deterministic noise, the float formats get values in [0, 1].
+std::vector<std::uint8_t> make_source(fmt f) {
+  std::vector<std::uint8_t> data(row_size(f) * height);
+  std::uint32_t seed = 7;
+
+  if (nano::detail::get_bits_per_component(f) == 32) {
+    std::vector<float> values(data.size() / sizeof(float));
+    for (float& v : values) {
+      seed = seed * 1664525u + 1013904223u;
+      v = static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    }
+
+    std::memcpy(data.data(), values.data(), data.size());
+    return data;
+  }
+
+  for (std::uint8_t& b : data) {
+    seed = seed * 1664525u + 1013904223u;
+    b = static_cast<std::uint8_t>(seed >> 24);
+  }
+
+  return data;
+}
+
+double rows_mpx(const conversion& c, const std::vector<std::uint8_t>& src, std::vector<std::uint8_t>& dst) {
+  std::size_t iterations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+
+  do {
+    for (std::size_t y = 0; y < height; y++) {
+      nano::detail::convert_row(
+          src.data() + y * row_size(c.src), c.src, dst.data() + y * row_size(c.dst), c.dst, width, c.alpha);
+    }
+
+    iterations++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_seconds);
+
+  return static_cast<double>(iterations * width * height) / seconds * 1e-6;
+}
+
+double image_mpx(const conversion& c, const std::vector<std::uint8_t>& src, std::vector<std::uint8_t>& dst) {
+  std::size_t iterations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+
+  do {
+    nano::image::convert_pixels(
+        { width, height }, src.data(), row_size(c.src), c.src, dst.data(), row_size(c.dst), c.dst, c.alpha);
+    iterations++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_seconds);
+
+  return static_cast<double>(iterations * width * height) / seconds * 1e-6;
+}
+} // namespace.
+
+int main() {
+  bool ok = true;
+
+  for (const conversion& c : conversions) {
+    const std::vector<std::uint8_t> src = make_source(c.src);
+    std::vector<std::uint8_t> reference;
+
+    for (const auto& [level, level_name] : levels) {
+      if (level > nano::detail::get_max_simd_level()) {
+        continue;
+      }
+
+      nano::detail::set_simd_level(level);
+      std::vector<std::uint8_t> dst(row_size(c.dst) * height);
+      const double mpx = rows_mpx(c, src, dst);
+
+      if (reference.empty()) {
+        reference = dst;
+      }
+
+      const bool same = reference == dst;
+      ok = ok && same;
+
+      std::printf("%-28s %-7s %9.1f Mpx/s%s\n", c.name, level_name, mpx, same ? "" : " (mismatch)");
+    }
+
+    std::vector<std::uint8_t> dst(row_size(c.dst) * height);
+    const double mpx = image_mpx(c, src, dst);
+    const bool same = reference == dst;
+    ok = ok && same;
+    std::printf("%-28s %-7s %9.1f Mpx/s%s\n", c.name, "threads", mpx, same ? "" : " (mismatch)");
+  }
+
+  nano::detail::set_simd_level(nano::detail::get_max_simd_level());
+  return ok ? 0 : 1;
+}
+
+#else
+int main() {
+  std::printf("The simd levels can only be selected with the software renderer.\n");
+  return 0;
+}
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
@@ -0,0 +1,114 @@
+#include <nano/graphics.h>
+#include <nano/graphics_codec.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+// Time to encode an 8K rgba frame to png on the calling thread and with png_options::parallel,
+// the output of the parallel encoder is decoded and checked against the source pixels.
+
+namespace {
+constexpr std::size_t width = 7680;
+constexpr std::size_t height = 4320;
+constexpr double min_seconds = 0.5;
+
+const std::pair<nano::png_filter, const char*> filters[] = {
+  { nano::png_filter::sub, "sub" },
+  { nano::png_filter::adaptive, "adaptive" },
+};
+
+const int levels[] = { 1, 6 };
+
+// Gradients with a band of noise, something between a render and a photo.
+std::vector<std::uint8_t> make_source() {
+  std::vector<std::uint8_t> data(width * height * 4);
+  std::uint32_t seed = 7;
+
+  for (std::size_t y = 0; y < height; y++) {
+    for (std::size_t x = 0; x < width; x++) {
+      std::uint8_t* px = data.data() + (y * width + x) * 4;
+      seed = seed * 1664525u + 1013904223u;
+      const std::uint32_t noise = y % 512 < 128 ? seed >> 26 : 0;
+      px[0] = static_cast<std::uint8_t>(x * 255 / width + noise);
+      px[1] = static_cast<std::uint8_t>(y * 255 / height);
+      px[2] = static_cast<std::uint8_t>((x ^ y) >> 5);
+      px[3] = 255;
+    }
+  }
+
+  return data;
+}
+
+std::string encode(const std::vector<std::uint8_t>& src, const nano::png_options& options) {
+  std::ostringstream stream;
+  nano::png_encoder encoder(stream, { width, height }, nano::image::format::abgr, options);
+
+  for (std::size_t y = 0; y < height; y++) {
+    encoder.write_row(src.data() + y * width * 4);
+  }
+
+  return stream.str();
+}
+
+double encode_ms(const std::vector<std::uint8_t>& src, const nano::png_options& options, std::size_t& bytes) {
+  std::size_t iterations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+
+  do {
+    bytes = encode(src, options).size();
+    iterations++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_seconds);
+
+  return seconds * 1e3 / static_cast<double>(iterations);
+}
+
+bool decodes_to(const std::string& file, const std::vector<std::uint8_t>& src) {
+  std::istringstream stream(file);
+  nano::png_decoder decoder(stream);
+  std::vector<std::uint8_t> row(width * 4);
+
+  for (std::size_t y = 0; y < height; y++) {
+    if (!decoder.read_row(row.data()) || !std::equal(row.begin(), row.end(), src.begin() + y * width * 4)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+} // namespace.
+
+int main() {
+  const std::vector<std::uint8_t> src = make_source();
+  bool ok = true;
+
+  std::printf("%zux%zu rgba, %u threads\n", width, height, std::max(std::thread::hardware_concurrency(), 1u));
+
+  for (int level : levels) {
+    for (const auto& [f, filter_name] : filters) {
+      nano::png_options options;
+      options.compression_level = level;
+      options.filter = f;
+
+      std::size_t serial_bytes = 0;
+      const double serial_ms = encode_ms(src, options, serial_bytes);
+
+      options.parallel = true;
+      std::size_t parallel_bytes = 0;
+      const double parallel_ms = encode_ms(src, options, parallel_bytes);
+
+      const bool same = decodes_to(encode(src, options), src);
+      ok = ok && same;
+
+      std::printf("level %d %-8s  serial %8.1f ms %9zu bytes  parallel %8.1f ms %9zu bytes  speedup %5.2fx%s\n", level,
+          filter_name, serial_ms, serial_bytes, parallel_ms, parallel_bytes, serial_ms / parallel_ms,
+          same ? "" : " (mismatch)");
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <nano/graphics.h>
+#include <nano/graphics_codec.h>
+
+#include <chrono>
+#include <cstdio>
+
+// Time to load a 4000x3000 rgba image from a png file and from the raw file converted from it.
+// Loading the raw file only maps it, every row is summed to also count the time to read the pages.
+
+namespace {
+constexpr std::size_t width = 4000;
+constexpr std::size_t height = 3000;
+constexpr double min_seconds = 0.5;
+
+template <typename Fct>
+double milliseconds(Fct&& fct) {
+  std::size_t iterations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+
+  do {
+    fct();
+    iterations++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_seconds);
+
+  return seconds * 1e3 / static_cast<double>(iterations);
+}
+
+std::uint32_t load_and_sum(const std::filesystem::path& path, nano::image::type t) {
+  const nano::image img(path.string(), t);
+  const nano::image_view v = img.view();
+  std::uint32_t sum = 0;
+
+  for (std::size_t y = 0; y < v.size.height; y++) {
+    for (std::size_t x = 0; x < v.size.width * 4; x += 64) {
+      sum += v.row(y)[x];
+    }
+  }
+
+  return sum;
+}
+} // namespace.
+
+int main() {
+  const std::filesystem::path dir = std::filesystem::temp_directory_path();
+  const std::filesystem::path png_path = dir / "nano_graphics_raw_load.png";
+  const std::filesystem::path raw_path = dir / "nano_graphics_raw_load.nanoimg";
+
+  {
+    nano::png_encoder encoder(png_path, { width, height }, nano::image::format::abgr);
+    encoder.write_rows([](std::size_t y, const nano::mutable_image_view& row) {
+      for (std::size_t x = 0; x < width; x++) {
+        std::uint8_t* px = row.data + x * 4;
+        px[0] = static_cast<std::uint8_t>(x * 255 / width);
+        px[1] = static_cast<std::uint8_t>(y * 255 / height);
+        px[2] = static_cast<std::uint8_t>((x ^ y) >> 4);
+        px[3] = 255;
+      }
+    });
+  }
+
+  if (!nano::convert_to_raw_image(png_path, nano::image::type::png, raw_path)) {
+    std::printf("The conversion failed.\n");
+    return 1;
+  }
+
+  std::uint32_t png_sum = 0;
+  std::uint32_t raw_sum = 0;
+  const double png_ms = milliseconds([&] { png_sum = load_and_sum(png_path, nano::image::type::png); });
+  const double raw_ms = milliseconds([&] { raw_sum = load_and_sum(raw_path, nano::image::type::raw); });
+
+  std::printf("%zux%zu rgba  png %8.2f ms %9ju bytes  raw %8.2f ms %9ju bytes  speedup %7.1fx%s\n", width, height,
+      png_ms, static_cast<std::uintmax_t>(std::filesystem::file_size(png_path)), raw_ms,
+      static_cast<std::uintmax_t>(std::filesystem::file_size(raw_path)), png_ms / raw_ms,
+      png_sum == raw_sum ? "" : " (mismatch)");
+
+  std::filesystem::remove(png_path);
+  std::filesystem::remove(raw_path);
+  return png_sum == raw_sum ? 0 : 1;
+}
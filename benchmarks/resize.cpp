@@ -0,0 +1,110 @@
+#include <nano/graphics.h>
+
+#include <chrono>
+#include <cstdio>
+
+// Destination pixels per second of image::resize_pixels for every filter and instruction set,
+// the output of each level is checked against the scalar one. The thumbnail column shrinks a
+// 1920x1080 frame to 320x180, the enlarge one doubles a 480x270 one.
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/graphics_raster.h>
+
+namespace {
+constexpr double min_seconds = 0.2;
+
+using filter = nano::image::filter;
+
+const std::pair<filter, const char*> filters[] = {
+  { filter::box, "box" },
+  { filter::bilinear, "bilinear" },
+  { filter::bicubic, "bicubic" },
+  { filter::lanczos3, "lanczos3" },
+};
+
+struct scaling {
+  const char* name;
+  nano::size<std::size_t> src;
+  nano::size<std::size_t> dst;
+};
+
+const scaling scalings[] = {
+  { "thumbnail", { 1920, 1080 }, { 320, 180 } },
+  { "enlarge", { 480, 270 }, { 960, 540 } },
+};
+
+const std::pair<nano::detail::simd_level, const char*> levels[] = {
+  { nano::detail::simd_level::scalar, "scalar" },
+  { nano::detail::simd_level::sse2, "sse2" },
+  { nano::detail::simd_level::avx2, "avx2" },
+};
+
+// Deterministic rgba noise.
+std::vector<std::uint8_t> make_source(const nano::size<std::size_t>& size) {
+  std::vector<std::uint8_t> data(size.width * size.height * 4);
+  std::uint32_t seed = 7;
+
+  for (std::uint8_t& b : data) {
+    seed = seed * 1664525u + 1013904223u;
+    b = static_cast<std::uint8_t>(seed >> 24);
+  }
+
+  return data;
+}
+
+double resize_mpx(filter f, const nano::image_view& src, const nano::mutable_image_view& dst) {
+  std::size_t iterations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+
+  do {
+    nano::image::resize_pixels(src, dst, f);
+    iterations++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_seconds);
+
+  return static_cast<double>(iterations * dst.size.width * dst.size.height) / seconds * 1e-6;
+}
+} // namespace.
+
+int main() {
+  bool ok = true;
+
+  for (const scaling& s : scalings) {
+    const std::vector<std::uint8_t> src = make_source(s.src);
+    const nano::image_view src_view(src.data(), s.src, s.src.width * 4);
+
+    for (const auto& [f, filter_name] : filters) {
+      std::vector<std::uint8_t> reference;
+
+      for (const auto& [level, level_name] : levels) {
+        if (level > nano::detail::get_max_simd_level()) {
+          continue;
+        }
+
+        nano::detail::set_simd_level(level);
+        std::vector<std::uint8_t> dst(s.dst.width * s.dst.height * 4);
+        const double mpx = resize_mpx(f, src_view, nano::mutable_image_view(dst.data(), s.dst, s.dst.width * 4));
+
+        if (reference.empty()) {
+          reference = dst;
+        }
+
+        const bool same = reference == dst;
+        ok = ok && same;
+
+        std::printf("%-10s %-9s %-7s %9.1f Mpx/s%s\n", s.name, filter_name, level_name, mpx, same ? "" : " (mismatch)");
+      }
+    }
+  }
+
+  nano::detail::set_simd_level(nano::detail::get_max_simd_level());
+  return ok ? 0 : 1;
+}
+
+#else
+int main() {
+  std::printf("The simd levels can only be selected with the software renderer.\n");
+  return 0;
+}
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
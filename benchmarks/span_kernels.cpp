@@ -0,0 +1,196 @@
+#include <nano/graphics.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Pixels per second of the software span kernels for every instruction set
+// and pixel format, the output of each level is checked against the scalar one.
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/graphics_raster.h>
+
+namespace {
+constexpr std::size_t width = 1920;
+constexpr std::size_t height = 1080;
+constexpr double min_seconds = 0.2;
+
+struct kernel {
+  const char* name;
+  void (*run)(nano::detail::surface& s, const std::vector<std::uint8_t>& mask, const std::vector<std::uint32_t>& src);
+};
+
+std::uint32_t opaque_pixel(const nano::detail::surface& s) {
+  return nano::detail::premultiplied_pixel(s.layout, nano::color(40, 120, 200, 255));
+}
+
+std::uint32_t translucent_pixel(const nano::detail::surface& s) {
+  return nano::detail::premultiplied_pixel(s.layout, nano::color(200, 60, 20, 140));
+}
+
+const kernel kernels[] = {
+  { "fill_rect opaque", //
+      [](nano::detail::surface& s, const auto&, const auto&) {
+        nano::detail::fill_rect(s, s.bounds(), 0, 0, width, height, opaque_pixel(s));
+      } },
+
+  { "fill_rect blend", //
+      [](nano::detail::surface& s, const auto&, const auto&) {
+        nano::detail::fill_rect(s, s.bounds(), 0, 0, width, height, translucent_pixel(s));
+      } },
+
+  { "fill_rect unaligned", //
+      [](nano::detail::surface& s, const auto&, const auto&) {
+        nano::detail::fill_rect(s, s.bounds(), 0.5f, 0.25f, width - 0.5f, height - 0.75f, translucent_pixel(s));
+      } },
+
+  { "blend_span_mask", //
+      [](nano::detail::surface& s, const auto& mask, const auto&) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_mask(
+              s.row(static_cast<int>(y)), mask.data() + y * width, width, translucent_pixel(s), s.layout.a);
+        }
+      } },
+
+  { "blend_span_pixels", //
+      [](nano::detail::surface& s, const auto&, const auto& src) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_pixels(s.row(static_cast<int>(y)), src.data() + y * width, width, 256, s.layout.a);
+        }
+      } },
+
+  { "blend_span_pixels alpha", //
+      [](nano::detail::surface& s, const auto&, const auto& src) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_pixels(s.row(static_cast<int>(y)), src.data() + y * width, width, 180, s.layout.a);
+        }
+      } },
+
+  { "blend_span_mode multiply", //
+      [](nano::detail::surface& s, const auto& mask, const auto& src) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_mode(nano::blend_mode::multiply, s.row(static_cast<int>(y)), src.data() + y * width,
+              mask.data() + y * width, width, s.layout.a);
+        }
+      } },
+
+  { "blend_span_mode overlay", //
+      [](nano::detail::surface& s, const auto&, const auto& src) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_mode(nano::blend_mode::overlay, s.row(static_cast<int>(y)), src.data() + y * width,
+              nullptr, width, s.layout.a);
+        }
+      } },
+
+  { "blend_span_mode plus", //
+      [](nano::detail::surface& s, const auto& mask, const auto& src) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_mode(nano::blend_mode::plus_lighter, s.row(static_cast<int>(y)),
+              src.data() + y * width, mask.data() + y * width, width, s.layout.a);
+        }
+      } },
+
+  { "blend_span_mode src_atop", //
+      [](nano::detail::surface& s, const auto&, const auto& src) {
+        for (std::size_t y = 0; y < height; y++) {
+          nano::detail::blend_span_mode(nano::blend_mode::source_atop, s.row(static_cast<int>(y)),
+              src.data() + y * width, nullptr, width, s.layout.a);
+        }
+      } },
+
+  { "downsample_row", //
+      [](nano::detail::surface& s, const auto&, const auto& src) {
+        for (std::size_t y = 0; y < height / 2; y++) {
+          nano::detail::downsample_row(
+              src.data() + y * 2 * width, src.data() + (y * 2 + 1) * width, s.row(static_cast<int>(y)), width - 1);
+        }
+      } },
+};
+
+const std::pair<nano::image::format, const char*> formats[] = {
+  { nano::image::format::rgba, "rgba" },
+  { nano::image::format::argb, "argb" },
+  { nano::image::format::bgra, "bgra" },
+  { nano::image::format::abgr, "abgr" },
+};
+
+const std::pair<nano::detail::simd_level, const char*> levels[] = {
+  { nano::detail::simd_level::scalar, "scalar" },
+  { nano::detail::simd_level::sse2, "sse2" },
+  { nano::detail::simd_level::avx2, "avx2" },
+};
+
+// Deterministic premultiplied noise.
+void fill_noise(nano::detail::surface& s, std::uint32_t seed) {
+  for (std::size_t i = 0; i < width * height; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    const std::uint32_t a = seed >> 24;
+    s.pixels[i] = nano::detail::pack_pixel(s.layout, ((seed >> 16) & 0xFF) * a / 255, ((seed >> 8) & 0xFF) * a / 255,
+        (seed & 0xFF) * a / 255, a);
+  }
+}
+} // namespace.
+
+int main() {
+  std::vector<std::uint8_t> mask(width * height);
+  for (std::size_t i = 0; i < mask.size(); i++) {
+    // Runs of empty, partial and full coverage.
+    const std::size_t x = i % 64;
+    mask[i] = x < 16 ? 0 : x < 48 ? static_cast<std::uint8_t>(i * 7) : 255;
+  }
+
+  bool ok = true;
+
+  for (const auto& [fmt, fmt_name] : formats) {
+    nano::detail::surface src_surface({ width, height }, fmt);
+    fill_noise(src_surface, 7);
+    const std::vector<std::uint32_t> src(src_surface.pixels, src_surface.pixels + width * height);
+
+    for (const kernel& k : kernels) {
+      std::vector<std::uint32_t> reference;
+
+      for (const auto& [level, level_name] : levels) {
+        if (level > nano::detail::get_max_simd_level()) {
+          continue;
+        }
+
+        nano::detail::set_simd_level(level);
+        nano::detail::surface s({ width, height }, fmt);
+
+        // Correctness against the scalar result.
+        fill_noise(s, 3);
+        k.run(s, mask, src);
+
+        if (reference.empty()) {
+          reference.assign(s.pixels, s.pixels + width * height);
+        }
+
+        const bool same = std::memcmp(reference.data(), s.pixels, width * height * sizeof(std::uint32_t)) == 0;
+        ok = ok && same;
+
+        std::size_t iterations = 0;
+        const auto start = std::chrono::steady_clock::now();
+        double seconds = 0;
+
+        do {
+          k.run(s, mask, src);
+          iterations++;
+          seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < min_seconds);
+
+        const double mpx = static_cast<double>(iterations * width * height) / seconds * 1e-6;
+        std::printf("%-5s %-24s %-7s %9.1f Mpx/s%s\n", fmt_name, k.name, level_name, mpx, same ? "" : " (mismatch)");
+      }
+    }
+  }
+
+  nano::detail::set_simd_level(nano::detail::get_max_simd_level());
+  return ok ? 0 : 1;
+}
+
+#else
+int main() {
+  std::printf("The span kernels are only used by the software renderer.\n");
+  return 0;
+}
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
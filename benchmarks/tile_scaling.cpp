@@ -0,0 +1,115 @@
+#include <nano/graphics.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// Renders the same 4K scene with tiled rendering on 1 to N threads and
+// reports the speedup against immediate rendering.
+
+namespace {
+constexpr std::size_t width = 3840;
+constexpr std::size_t height = 2160;
+constexpr int iterations = 5;
+
+void draw_scene(nano::graphic_context& gc, const nano::image& img) {
+  gc.set_fill_color(0x202020FF);
+  gc.fill_rect({ 0, 0, static_cast<float>(width), static_cast<float>(height) });
+
+  for (int i = 0; i < 400; i++) {
+    const float x = static_cast<float>((i * 97) % width);
+    const float y = static_cast<float>((i * 53) % height);
+    const nano::color c(static_cast<std::uint8_t>(i * 31), static_cast<std::uint8_t>(i * 17),
+        static_cast<std::uint8_t>(i * 7), static_cast<std::uint8_t>(96 + i % 160));
+
+    gc.set_fill_color(c);
+    gc.set_stroke_color(c);
+    gc.set_line_width(3.5f);
+
+    switch (i % 4) {
+    case 0:
+      gc.fill_ellipse({ x, y, 240.5f, 180.25f });
+      break;
+    case 1:
+      gc.fill_rounded_rect({ x + 0.5f, y + 0.25f, 300, 200 }, 24);
+      break;
+    case 2:
+      gc.stroke_line({ x, y }, { x + 400, y + 260 });
+      break;
+    case 3:
+      gc.draw_image(img, nano::rect<float>{ x + 0.3f, y + 0.6f, 220, 150 });
+      break;
+    }
+  }
+
+  gc.begin_transparent_layer(0.5f);
+  gc.set_fill_color(0xFFFFFFFF);
+  gc.fill_ellipse({ 800, 400, 2200, 1300 });
+  gc.end_transparent_layer();
+}
+
+nano::image make_source_image() {
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 128, 128 }, nano::image::format::rgba);
+  gc.set_fill_color(0x3060C0FF);
+  gc.fill_rect({ 0, 0, 128, 128 });
+  gc.set_fill_color(0xF0A020C0);
+  gc.fill_ellipse({ 16, 16, 96, 96 });
+  return gc.create_image();
+}
+
+nano::image render(const nano::image& img, std::size_t threads, double& ms) {
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ width, height }, nano::image::format::rgba);
+  nano::image out;
+  ms = 1e12;
+
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (threads) {
+      gc.set_tiled_rendering(true, threads);
+    }
+
+    draw_scene(gc, img);
+    gc.flush();
+
+    auto end = std::chrono::steady_clock::now();
+    ms = std::min(ms, std::chrono::duration<double, std::milli>(end - start).count());
+    gc.set_tiled_rendering(false);
+  }
+
+  return gc.create_image();
+}
+
+bool is_same(const nano::image& a, const nano::image& b) {
+  return a.get_size() == b.get_size()
+      && std::memcmp(a.data(), b.data(), a.get_bytes_per_row() * a.get_size().height) == 0;
+}
+} // namespace.
+
+int main() {
+  const nano::image img = make_source_image();
+  const std::size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  double serial_ms = 0;
+  const nano::image reference = render(img, 0, serial_ms);
+  std::cout << "immediate: " << serial_ms << " ms" << std::endl;
+
+  bool ok = true;
+  for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+    double ms = 0;
+    const nano::image result = render(img, threads, ms);
+    const bool same = is_same(reference, result);
+    ok = ok && same;
+
+    std::cout << "tiled " << threads << " thread(s): " << ms << " ms, speedup " << serial_ms / ms << "x"
+              << (same ? "" : " (output differs)") << std::endl;
+
+    if (threads < max_threads && threads * 2 > max_threads) {
+      threads = max_threads / 2;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
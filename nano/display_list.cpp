@@ -0,0 +1,699 @@
+#include <nano/graphics.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+namespace nano {
+
+//
+// MARK: display_list
+//
+
+namespace {
+  enum class op : std::uint8_t {
+    save_state,
+    restore_state,
+    begin_transparent_layer,
+    end_transparent_layer,
+    translate,
+    clip,
+    clip_even_odd,
+    reset_clip,
+    clip_to_rect,
+    clip_to_path,
+    clip_to_path_even_odd,
+    clip_to_mask,
+    begin_path,
+    close_path,
+    add_rect,
+    add_path,
+    set_line_width,
+    set_line_join,
+    set_line_cap,
+    set_line_style,
+    set_miter_limit,
+    set_blend_mode,
+    set_fill_color,
+    set_stroke_color,
+    fill_rect,
+    stroke_rect,
+    stroke_rect_width,
+    stroke_line,
+    fill_ellipse,
+    stroke_ellipse,
+    fill_rounded_rect,
+    stroke_rounded_rect,
+    fill_path,
+    fill_path_in_rect,
+    stroke_path,
+    draw_image_at,
+    draw_image,
+    draw_image_clipped,
+    draw_sub_image,
+    draw_text_at,
+    draw_text
+  };
+
+  class command_reader {
+  public:
+    command_reader(const std::uint8_t* data) noexcept
+        : m_data(data) {}
+
+    template <typename T>
+    inline T read() noexcept {
+      static_assert(std::is_trivially_copyable_v<T>, "display_list commands must be trivially copyable");
+      T value;
+      std::memcpy(&value, m_data, sizeof(T));
+      m_data += sizeof(T);
+      return value;
+    }
+
+    inline nano::rect<float> read_rect() noexcept {
+      const float x = read<float>();
+      const float y = read<float>();
+      const float w = read<float>();
+      const float h = read<float>();
+      return { x, y, w, h };
+    }
+
+    inline nano::point<float> read_point() noexcept {
+      const float x = read<float>();
+      const float y = read<float>();
+      return { x, y };
+    }
+
+    inline const std::uint8_t* position() const noexcept { return m_data; }
+
+  private:
+    const std::uint8_t* m_data;
+  };
+
+  // Translation and line width followed during a culled replay.
+  struct cull_state {
+    nano::point<float> offset;
+
+    // Negative while unknown, strokes are never culled in that case.
+    float line_width;
+
+    float miter_limit;
+  };
+
+  // Save/restore nesting of a culled replay, on the stack of replay() unless it goes deeper than k_inline_depth.
+  class cull_stack {
+  public:
+    static constexpr std::size_t k_inline_depth = 16;
+
+    inline std::size_t size() const noexcept { return m_size; }
+
+    inline cull_state& back() noexcept {
+      return m_size <= k_inline_depth ? m_inline[m_size - 1] : m_spill[m_size - k_inline_depth - 1];
+    }
+
+    // By value, s can be the back of the spilled states.
+    inline void push(cull_state s) {
+      if (m_size < k_inline_depth) {
+        m_inline[m_size] = s;
+      }
+      else {
+        m_spill.push_back(s);
+      }
+
+      m_size++;
+    }
+
+    inline void pop() noexcept {
+      if (m_size > k_inline_depth) {
+        m_spill.pop_back();
+      }
+
+      m_size--;
+    }
+
+  private:
+    std::array<cull_state, k_inline_depth> m_inline;
+    std::vector<cull_state> m_spill;
+    std::size_t m_size = 0;
+  };
+
+  static inline bool is_outside(
+      const nano::rect<float>& visible, const cull_state& st, const nano::rect<float>& r, float margin) noexcept {
+    // One extra pixel for anti-aliasing.
+    margin += 1.0f;
+
+    const float x0 = r.x + st.offset.x - margin;
+    const float y0 = r.y + st.offset.y - margin;
+    const float x1 = r.x + st.offset.x + r.width + margin;
+    const float y1 = r.y + st.offset.y + r.height + margin;
+    return x1 <= visible.x || y1 <= visible.y || x0 >= visible.x + visible.width || y0 >= visible.y + visible.height;
+  }
+
+  static inline nano::rect<float> line_bounds(const nano::point<float>& p0, const nano::point<float>& p1) noexcept {
+    const float x = std::min(p0.x, p1.x);
+    const float y = std::min(p0.y, p1.y);
+    return { x, y, std::max(p0.x, p1.x) - x, std::max(p0.y, p1.y) - y };
+  }
+
+  // Bounds of a path drawn with fill_path(p, rect).
+  static inline nano::rect<float> path_bounds(const nano::path& p, const nano::rect<float>& r) noexcept {
+    const nano::rect<float> b = p.get_bounding_box();
+    return line_bounds({ r.x + b.x * r.width, r.y + b.y * r.height },
+        { r.x + (b.x + b.width) * r.width, r.y + (b.y + b.height) * r.height });
+  }
+} // namespace.
+
+struct display_list::pimpl {
+  template <typename... Args>
+  inline void push(op o, const Args&... args) {
+    data.push_back(static_cast<std::uint8_t>(o));
+    (write(args), ...);
+    count++;
+  }
+
+  template <typename T>
+  inline void write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>, "display_list commands must be trivially copyable");
+    const std::size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+  }
+
+  // The geometry types are written component by component.
+  inline void write(const nano::rect<float>& r) {
+    write(r.x);
+    write(r.y);
+    write(r.width);
+    write(r.height);
+  }
+
+  inline void write(const nano::point<float>& p) {
+    write(p.x);
+    write(p.y);
+  }
+
+  // Consecutive uses of the same image or font share their slot.
+  inline std::uint32_t add_image(const nano::image& img) {
+    if (images.empty() || images.back().get_native_image() != img.get_native_image()) {
+      images.push_back(img);
+    }
+
+    return static_cast<std::uint32_t>(images.size() - 1);
+  }
+
+  inline std::uint32_t add_font(const nano::font& f) {
+    if (fonts.empty() || !f.get_native_font() || fonts.back().get_native_font() != f.get_native_font()) {
+      fonts.push_back(f);
+    }
+
+    return static_cast<std::uint32_t>(fonts.size() - 1);
+  }
+
+  inline std::uint32_t add_text(const std::string& text) {
+    texts.push_back(text);
+    return static_cast<std::uint32_t>(texts.size() - 1);
+  }
+
+  // Paths share their geometry, keeping a copy is cheap.
+  inline std::uint32_t add_path(const nano::path& p) {
+    paths.push_back(p);
+    return static_cast<std::uint32_t>(paths.size() - 1);
+  }
+
+  void replay(graphic_context& gc, const nano::rect<float>* visible) const;
+
+  std::vector<std::uint8_t> data;
+  std::vector<nano::image> images;
+  std::vector<nano::font> fonts;
+  std::vector<std::string> texts;
+  std::vector<nano::path> paths;
+  std::size_t count = 0;
+};
+
+void display_list::pimpl::replay(graphic_context& gc, const nano::rect<float>* visible) const {
+  using rectf = nano::rect<float>;
+  using pointf = nano::point<float>;
+
+  cull_stack states;
+  if (visible) {
+    states.push({ { 0, 0 }, -1.0f, 10.0f });
+  }
+
+  // Draw commands still have to be decoded when they are culled.
+  // Strokes reach at most their line width past the geometry, miter joins of paths go further.
+  auto culled = [&](const rectf& r, bool stroke, bool joins = false) {
+    if (!visible) {
+      return false;
+    }
+
+    const cull_state& st = states.back();
+    if (stroke && st.line_width < 0) {
+      return false;
+    }
+
+    const float margin = joins ? st.line_width * std::max(st.miter_limit * 0.5f, 1.0f) : st.line_width;
+    return is_outside(*visible, st, r, stroke ? margin : 0.0f);
+  };
+
+  auto set_width = [&](float width) {
+    if (visible) {
+      states.back().line_width = width;
+    }
+  };
+
+  auto save = [&]() {
+    if (visible) {
+      states.push(states.back());
+    }
+  };
+
+  auto restore = [&]() {
+    if (visible && states.size() > 1) {
+      states.pop();
+    }
+  };
+
+  command_reader reader(data.data());
+  const std::uint8_t* end = data.data() + data.size();
+
+  while (reader.position() < end) {
+    switch (static_cast<op>(reader.read<std::uint8_t>())) {
+    case op::save_state:
+      save();
+      gc.save_state();
+      break;
+
+    case op::restore_state:
+      restore();
+      gc.restore_state();
+      break;
+
+    case op::begin_transparent_layer:
+      save();
+      gc.begin_transparent_layer(reader.read<float>());
+      break;
+
+    case op::end_transparent_layer:
+      restore();
+      gc.end_transparent_layer();
+      break;
+
+    case op::translate: {
+      const pointf pos = reader.read_point();
+      if (visible) {
+        states.back().offset = states.back().offset + pos;
+      }
+
+      gc.translate(pos);
+    } break;
+
+    case op::clip:
+      gc.clip();
+      break;
+
+    case op::clip_even_odd:
+      gc.clip_even_odd();
+      break;
+
+    case op::reset_clip:
+      gc.reset_clip();
+      break;
+
+    case op::clip_to_rect:
+      gc.clip_to_rect(reader.read_rect());
+      break;
+
+    case op::clip_to_path:
+      gc.clip_to_path(paths[reader.read<std::uint32_t>()]);
+      break;
+
+    case op::clip_to_path_even_odd:
+      gc.clip_to_path_even_odd(paths[reader.read<std::uint32_t>()]);
+      break;
+
+    case op::clip_to_mask: {
+      const nano::image& img = images[reader.read<std::uint32_t>()];
+      gc.clip_to_mask(img, reader.read_rect());
+    } break;
+
+    case op::begin_path:
+      gc.begin_path();
+      break;
+
+    case op::close_path:
+      gc.close_path();
+      break;
+
+    case op::add_rect:
+      gc.add_rect(reader.read_rect());
+      break;
+
+    case op::add_path:
+      gc.add_path(paths[reader.read<std::uint32_t>()]);
+      break;
+
+    case op::set_line_width: {
+      const float width = reader.read<float>();
+      set_width(width);
+      gc.set_line_width(width);
+    } break;
+
+    case op::set_line_join:
+      gc.set_line_join(reader.read<line_join>());
+      break;
+
+    case op::set_line_cap:
+      gc.set_line_cap(reader.read<line_cap>());
+      break;
+
+    case op::set_line_style: {
+      const float width = reader.read<float>();
+      const line_join lj = reader.read<line_join>();
+      const line_cap lc = reader.read<line_cap>();
+      set_width(width);
+      gc.set_line_style(width, lj, lc);
+    } break;
+
+    case op::set_miter_limit: {
+      const float limit = reader.read<float>();
+      if (visible) {
+        states.back().miter_limit = limit;
+      }
+
+      gc.set_miter_limit(limit);
+    } break;
+
+    case op::set_blend_mode:
+      gc.set_blend_mode(reader.read<blend_mode>());
+      break;
+
+    case op::set_fill_color:
+      gc.set_fill_color(reader.read<nano::color>());
+      break;
+
+    case op::set_stroke_color:
+      gc.set_stroke_color(reader.read<nano::color>());
+      break;
+
+    case op::fill_rect: {
+      const rectf r = reader.read_rect();
+      if (!culled(r, false)) {
+        gc.fill_rect(r);
+      }
+    } break;
+
+    case op::stroke_rect: {
+      const rectf r = reader.read_rect();
+      if (!culled(r, true)) {
+        gc.stroke_rect(r);
+      }
+    } break;
+
+    case op::stroke_rect_width: {
+      const rectf r = reader.read_rect();
+      const float width = reader.read<float>();
+
+      // The line width is set even when the stroke itself is culled.
+      set_width(width);
+      if (culled(r, true)) {
+        gc.set_line_width(width);
+      }
+      else {
+        gc.stroke_rect(r, width);
+      }
+    } break;
+
+    case op::stroke_line: {
+      const pointf p0 = reader.read_point();
+      const pointf p1 = reader.read_point();
+      if (!culled(line_bounds(p0, p1), true)) {
+        gc.stroke_line(p0, p1);
+      }
+    } break;
+
+    case op::fill_ellipse: {
+      const rectf r = reader.read_rect();
+      if (!culled(r, false)) {
+        gc.fill_ellipse(r);
+      }
+    } break;
+
+    case op::stroke_ellipse: {
+      const rectf r = reader.read_rect();
+      if (!culled(r, true)) {
+        gc.stroke_ellipse(r);
+      }
+    } break;
+
+    case op::fill_rounded_rect: {
+      const rectf r = reader.read_rect();
+      const float radius = reader.read<float>();
+      if (!culled(r, false)) {
+        gc.fill_rounded_rect(r, radius);
+      }
+    } break;
+
+    case op::stroke_rounded_rect: {
+      const rectf r = reader.read_rect();
+      const float radius = reader.read<float>();
+      if (!culled(r, true)) {
+        gc.stroke_rounded_rect(r, radius);
+      }
+    } break;
+
+    case op::fill_path: {
+      const nano::path& p = paths[reader.read<std::uint32_t>()];
+      if (!culled(p.get_bounding_box(), false)) {
+        gc.fill_path(p);
+      }
+    } break;
+
+    case op::fill_path_in_rect: {
+      const nano::path& p = paths[reader.read<std::uint32_t>()];
+      const rectf r = reader.read_rect();
+      if (!culled(path_bounds(p, r), false)) {
+        gc.fill_path(p, r);
+      }
+    } break;
+
+    case op::stroke_path: {
+      const nano::path& p = paths[reader.read<std::uint32_t>()];
+      if (!culled(p.get_bounding_box(), true, true)) {
+        gc.stroke_path(p);
+      }
+    } break;
+
+    case op::draw_image_at: {
+      const nano::image& img = images[reader.read<std::uint32_t>()];
+      const pointf pos = reader.read_point();
+      if (!culled(rectf(pos, img.get_size()), false)) {
+        gc.draw_image(img, pos);
+      }
+    } break;
+
+    case op::draw_image: {
+      const nano::image& img = images[reader.read<std::uint32_t>()];
+      const rectf r = reader.read_rect();
+      if (!culled(r, false)) {
+        gc.draw_image(img, r);
+      }
+    } break;
+
+    case op::draw_image_clipped: {
+      const nano::image& img = images[reader.read<std::uint32_t>()];
+      const rectf r = reader.read_rect();
+      const rectf clip_rect = reader.read_rect();
+      if (!culled(r, false)) {
+        gc.draw_image(img, r, clip_rect);
+      }
+    } break;
+
+    case op::draw_sub_image: {
+      const nano::image& img = images[reader.read<std::uint32_t>()];
+      const rectf r = reader.read_rect();
+      const rectf img_rect = reader.read_rect();
+      if (!culled(r, false)) {
+        gc.draw_sub_image(img, r, img_rect);
+      }
+    } break;
+
+    // Text is never culled, the extent of the glyphs isn't known.
+    case op::draw_text_at: {
+      const nano::font& f = fonts[reader.read<std::uint32_t>()];
+      const std::string& text = texts[reader.read<std::uint32_t>()];
+      gc.draw_text(f, text, reader.read_point());
+    } break;
+
+    case op::draw_text: {
+      const nano::font& f = fonts[reader.read<std::uint32_t>()];
+      const std::string& text = texts[reader.read<std::uint32_t>()];
+      const rectf r = reader.read_rect();
+      gc.draw_text(f, text, r, reader.read<text_alignment>());
+    } break;
+    }
+  }
+}
+
+display_list::display_list() { m_pimpl = new pimpl; }
+
+display_list::display_list(const display_list& dl) { m_pimpl = new pimpl(*dl.m_pimpl); }
+
+display_list::display_list(display_list&& dl) { m_pimpl = new pimpl(std::move(*dl.m_pimpl)); }
+
+display_list::~display_list() { delete m_pimpl; }
+
+display_list& display_list::operator=(const display_list& dl) {
+  *m_pimpl = *dl.m_pimpl;
+  return *this;
+}
+
+display_list& display_list::operator=(display_list&& dl) {
+  *m_pimpl = std::move(*dl.m_pimpl);
+  return *this;
+}
+
+void display_list::clear() {
+  m_pimpl->data.clear();
+  m_pimpl->images.clear();
+  m_pimpl->fonts.clear();
+  m_pimpl->texts.clear();
+  m_pimpl->paths.clear();
+  m_pimpl->count = 0;
+}
+
+bool display_list::empty() const noexcept { return m_pimpl->count == 0; }
+
+std::size_t display_list::size() const noexcept { return m_pimpl->count; }
+
+void display_list::replay(graphic_context& gc) const { m_pimpl->replay(gc, nullptr); }
+
+void display_list::replay(graphic_context& gc, const nano::rect<float>& visible_rect) const {
+  m_pimpl->replay(gc, &visible_rect);
+}
+
+void display_list::save_state() { m_pimpl->push(op::save_state); }
+
+void display_list::restore_state() { m_pimpl->push(op::restore_state); }
+
+void display_list::begin_transparent_layer(float alpha) { m_pimpl->push(op::begin_transparent_layer, alpha); }
+
+void display_list::end_transparent_layer() { m_pimpl->push(op::end_transparent_layer); }
+
+void display_list::translate(const nano::point<float>& pos) { m_pimpl->push(op::translate, pos); }
+
+void display_list::clip() { m_pimpl->push(op::clip); }
+
+void display_list::clip_even_odd() { m_pimpl->push(op::clip_even_odd); }
+
+void display_list::reset_clip() { m_pimpl->push(op::reset_clip); }
+
+void display_list::clip_to_rect(const nano::rect<float>& rect) { m_pimpl->push(op::clip_to_rect, rect); }
+
+void display_list::clip_to_path(const nano::path& p) { m_pimpl->push(op::clip_to_path, m_pimpl->add_path(p)); }
+
+void display_list::clip_to_path_even_odd(const nano::path& p) {
+  m_pimpl->push(op::clip_to_path_even_odd, m_pimpl->add_path(p));
+}
+
+void display_list::clip_to_mask(const nano::image& img, const nano::rect<float>& rect) {
+  m_pimpl->push(op::clip_to_mask, m_pimpl->add_image(img), rect);
+}
+
+void display_list::clip_to_mask(const nano::image_view& img, const nano::rect<float>& rect) {
+  clip_to_mask(nano::image(img), rect);
+}
+
+void display_list::begin_path() { m_pimpl->push(op::begin_path); }
+
+void display_list::close_path() { m_pimpl->push(op::close_path); }
+
+void display_list::add_rect(const nano::rect<float>& rect) { m_pimpl->push(op::add_rect, rect); }
+
+void display_list::add_path(const nano::path& p) { m_pimpl->push(op::add_path, m_pimpl->add_path(p)); }
+
+void display_list::set_line_width(float width) { m_pimpl->push(op::set_line_width, width); }
+
+void display_list::set_line_join(line_join lj) { m_pimpl->push(op::set_line_join, lj); }
+
+void display_list::set_line_cap(line_cap lc) { m_pimpl->push(op::set_line_cap, lc); }
+
+void display_list::set_line_style(float width, line_join lj, line_cap lc) {
+  m_pimpl->push(op::set_line_style, width, lj, lc);
+}
+
+void display_list::set_miter_limit(float limit) { m_pimpl->push(op::set_miter_limit, limit); }
+
+void display_list::set_blend_mode(blend_mode mode) { m_pimpl->push(op::set_blend_mode, mode); }
+
+void display_list::set_fill_color(const nano::color& c) { m_pimpl->push(op::set_fill_color, c); }
+
+void display_list::set_stroke_color(const nano::color& c) { m_pimpl->push(op::set_stroke_color, c); }
+
+void display_list::fill_rect(const nano::rect<float>& r) { m_pimpl->push(op::fill_rect, r); }
+
+void display_list::stroke_rect(const nano::rect<float>& r) { m_pimpl->push(op::stroke_rect, r); }
+
+void display_list::stroke_rect(const nano::rect<float>& r, float line_width) {
+  m_pimpl->push(op::stroke_rect_width, r, line_width);
+}
+
+void display_list::stroke_line(const nano::point<float>& p0, const nano::point<float>& p1) {
+  m_pimpl->push(op::stroke_line, p0, p1);
+}
+
+void display_list::fill_ellipse(const nano::rect<float>& r) { m_pimpl->push(op::fill_ellipse, r); }
+
+void display_list::stroke_ellipse(const nano::rect<float>& r) { m_pimpl->push(op::stroke_ellipse, r); }
+
+void display_list::fill_rounded_rect(const nano::rect<float>& r, float radius) {
+  m_pimpl->push(op::fill_rounded_rect, r, radius);
+}
+
+void display_list::stroke_rounded_rect(const nano::rect<float>& r, float radius) {
+  m_pimpl->push(op::stroke_rounded_rect, r, radius);
+}
+
+void display_list::fill_path(const nano::path& p) { m_pimpl->push(op::fill_path, m_pimpl->add_path(p)); }
+
+void display_list::fill_path(const nano::path& p, const nano::rect<float>& rect) {
+  m_pimpl->push(op::fill_path_in_rect, m_pimpl->add_path(p), rect);
+}
+
+void display_list::stroke_path(const nano::path& p) { m_pimpl->push(op::stroke_path, m_pimpl->add_path(p)); }
+
+void display_list::draw_image(const nano::image& img, const nano::point<float>& pos) {
+  m_pimpl->push(op::draw_image_at, m_pimpl->add_image(img), pos);
+}
+
+void display_list::draw_image(const nano::image& img, const nano::rect<float>& r) {
+  m_pimpl->push(op::draw_image, m_pimpl->add_image(img), r);
+}
+
+void display_list::draw_image(const nano::image& img, const nano::rect<float>& r, const nano::rect<float>& clip_rect) {
+  m_pimpl->push(op::draw_image_clipped, m_pimpl->add_image(img), r, clip_rect);
+}
+
+void display_list::draw_sub_image(
+    const nano::image& img, const nano::rect<float>& r, const nano::rect<float>& img_rect) {
+  m_pimpl->push(op::draw_sub_image, m_pimpl->add_image(img), r, img_rect);
+}
+
+void display_list::draw_image(const nano::image_view& img, const nano::rect<float>& r) {
+  draw_image(nano::image(img), r);
+}
+
+void display_list::draw_sub_image(
+    const nano::image_view& img, const nano::rect<float>& r, const nano::rect<float>& img_rect) {
+  draw_sub_image(nano::image(img), r, img_rect);
+}
+
+void display_list::draw_text(const nano::font& f, const std::string& text, const nano::point<float>& pos) {
+  m_pimpl->push(op::draw_text_at, m_pimpl->add_font(f), m_pimpl->add_text(text), pos);
+}
+
+void display_list::draw_text(
+    const nano::font& f, const std::string& text, const nano::rect<float>& rect, nano::text_alignment alignment) {
+  m_pimpl->push(op::draw_text, m_pimpl->add_font(f), m_pimpl->add_text(text), rect, alignment);
+}
+
+} // namespace nano.
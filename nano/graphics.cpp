@@ -1,24 +1,32 @@
 #include <nano/graphics.h>
-#include <nano/objc.h>
-#include <CoreFoundation/CoreFoundation.h>
-#include <CoreGraphics/CoreGraphics.h>
-#include <ImageIO/ImageIO.h>
-#include <CoreText/CoreText.h>
-#include <CoreServices/CoreServices.h>
-
-#include <fstream>
-#include <errno.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/sysctl.h>
-#include <sys/types.h>
-#include <sys/proc_info.h>
-#include <sys/param.h>
-#include <libproc.h>
-
-#define NANO_UTTypePNG CFSTR("public.png")
-#define NANO_UTTypeJPEG CFSTR("public.jpeg")
+
+// CoreGraphics backend, see graphics_software.cpp for the portable one.
+#if !NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/objc.h>
+  #include <CoreFoundation/CoreFoundation.h>
+  #include <CoreGraphics/CoreGraphics.h>
+  #include <ImageIO/ImageIO.h>
+  #include <nano/graphics_path.h>
+  #include <nano/graphics_raster.h>
+  #include <CoreText/CoreText.h>
+  #include <CoreServices/CoreServices.h>
+
+  #include <algorithm>
+  #include <cstring>
+  #include <fstream>
+  #include <mutex>
+  #include <errno.h>
+  #include <stdio.h>
+  #include <stdlib.h>
+  #include <string.h>
+  #include <sys/sysctl.h>
+  #include <sys/types.h>
+  #include <sys/proc_info.h>
+  #include <sys/param.h>
+  #include <libproc.h>
+
+  #define NANO_UTTypePNG CFSTR("public.png")
+  #define NANO_UTTypeJPEG CFSTR("public.jpeg")
 
 namespace nano {
 
@@ -54,53 +62,69 @@ double display::get_scale_factor() {
 
 struct image::pimpl {
   CGImageRef img = nullptr;
-};
 
-image::image() { m_pimpl = new pimpl; }
+  /// Pixels read from img the first time they were needed, shared with the copies of the image.
+  /// Images created from pixels draw from them, their data provider holds a second reference.
+  detail::bitmap* bmp = nullptr;
+  bool drawn_from_bmp = false;
 
-nano::size<double> image::get_dpi(const std::string& filepath) {
-  cf::unique_ptr<CGDataProviderRef> dataProvider = CGDataProviderCreateWithFilename(filepath.c_str());
+  /// CoreGraphics filters the draws itself, the setting is only kept.
+  bool mipmapped = false;
 
-  if (!dataProvider) {
-    return { 0.0, 0.0 };
-  }
-
-  cf::unique_ptr<CGImageSourceRef> imageRef = CGImageSourceCreateWithDataProvider(dataProvider, nullptr);
+  std::mutex mutex;
+};
 
-  if (!imageRef) {
-    return { 0.0, 0.0 };
+namespace {
+  static void release_bitmap(void* info, const void*, std::size_t) {
+    detail::bitmap::release(static_cast<detail::bitmap*>(info));
   }
 
-  cf::unique_ptr<CFDictionaryRef> imagePropertiesDict = CGImageSourceCopyPropertiesAtIndex(imageRef, 0, nullptr);
+  /// Image drawing from the pixels of bmp, which its data provider keeps alive.
+  static inline CGImageRef create_image(const detail::bitmap& bmp, CGColorSpaceRef color_space, CGBitmapInfo info) {
+    detail::bitmap* owner = detail::bitmap::retain(const_cast<detail::bitmap*>(&bmp));
+    cf::unique_ptr<CGDataProviderRef> provider = CGDataProviderCreateWithData(
+        owner, bmp.data, bmp.bytes_per_row * bmp.size.height, &release_bitmap);
 
-  if (!imagePropertiesDict) {
-    return { 0.0, 0.0 };
+    return CGImageCreate(bmp.size.width, bmp.size.height, bmp.bits_per_component, bmp.bits_per_pixel,
+        bmp.bytes_per_row, color_space, info, provider, nullptr, false, kCGRenderingIntentDefault);
   }
 
-  CFNumberRef dpiWidth = nullptr;
-  if (!CFDictionaryGetValueIfPresent(
-          imagePropertiesDict, kCGImagePropertyDPIWidth, reinterpret_cast<const void**>(&dpiWidth))) {
-    return { 0.0, 0.0 };
+  /// Takes the reference of bmp.
+  static inline void set_bitmap(image::pimpl& p, detail::bitmap* bmp, CGColorSpaceRef color_space, CGBitmapInfo info) {
+    p.img = create_image(*bmp, color_space, info);
+    p.bmp = bmp;
+    p.drawn_from_bmp = true;
   }
 
-  CFNumberRef dpiHeight = nullptr;
-  if (!CFDictionaryGetValueIfPresent(
-          imagePropertiesDict, kCGImagePropertyDPIHeight, reinterpret_cast<const void**>(&dpiHeight))) {
-    return { 0.0, 0.0 };
-  }
+  /// Reads the pixels of an image that CoreGraphics created, decoding them if needed.
+  /// This is done once, the image keeps drawing from its own provider.
+  static inline void read_bitmap(image::pimpl& p, image::format fmt) {
+    if (p.bmp) {
+      return;
+    }
+
+    const nano::size<std::size_t> size(CGImageGetWidth(p.img), CGImageGetHeight(p.img));
+    detail::bitmap* bmp = detail::bitmap::create(size, fmt, CGImageGetBytesPerRow(p.img));
+    bmp->bits_per_component = CGImageGetBitsPerComponent(p.img);
+    bmp->bits_per_pixel = CGImageGetBitsPerPixel(p.img);
 
-  CFNumberType ftype = kCFNumberFloat32Type;
-  if (CFNumberGetType(dpiWidth) != ftype || CFNumberGetType(dpiHeight) != ftype) {
-    return { 0.0, 0.0 };
+    const CGImageAlphaInfo alpha_info = CGImageGetAlphaInfo(p.img);
+    bmp->premultiplied = alpha_info == kCGImageAlphaPremultipliedFirst || alpha_info == kCGImageAlphaPremultipliedLast;
+
+    cf::unique_ptr<CFDataRef> data = CGDataProviderCopyData(CGImageGetDataProvider(p.img));
+    if (data) {
+      const std::size_t length = static_cast<std::size_t>(CFDataGetLength(data));
+      std::memcpy(bmp->data, CFDataGetBytePtr(data), std::min(length, bmp->bytes_per_row * size.height));
+    }
+
+    p.bmp = bmp;
   }
 
-  float w_dpi = 0;
-  float h_dpi = 0;
-  CFNumberGetValue(dpiWidth, ftype, (void*)&w_dpi);
-  CFNumberGetValue(dpiHeight, ftype, (void*)&h_dpi);
+  /// Defined with the bitmap infos below.
+  static void map_raw_image(image::pimpl& p, const std::string& filepath);
+} // namespace.
 
-  return { w_dpi, h_dpi };
-}
+image::image() { m_pimpl = new pimpl; }
 
 inline void nameee() {
   struct kinfo_proc* process = NULL;
@@ -141,6 +165,11 @@ inline void nameee(pid_t pid) {
 image::image(const std::string& filepath, type img_type) {
   m_pimpl = new pimpl;
 
+  if (img_type == type::raw) {
+    map_raw_image(*m_pimpl, filepath);
+    return;
+  }
+
   cf::unique_ptr<CGDataProviderRef> dataProvider = CGDataProviderCreateWithFilename(filepath.c_str());
   assert(dataProvider != nullptr);
 
@@ -156,78 +185,165 @@ image::image(const std::string& filepath, type img_type) {
   case type::jpeg:
     m_pimpl->img = CGImageCreateWithJPEGDataProvider(dataProvider, nullptr, false, kCGRenderingIntentDefault);
     break;
+
+  case type::raw:
+    break;
   }
 }
 
-image::image(const nano::size<std::size_t>& size, std::size_t bitsPerComponent, std::size_t bitsPerPixel,
-    std::size_t bytesPerRow, format fmt, const std::uint8_t* buffer) {
-  m_pimpl = new pimpl;
-  CGBitmapInfo bmp_info = 0;
+image::image(const std::string& filepath, type img_type, decode_scale scale)
+    : image(filepath, img_type) {
+  if (!m_pimpl->img || scale == decode_scale::full) {
+    return;
+  }
 
-  switch (fmt) {
-  case format::alpha:
-    bmp_info = kCGImageAlphaOnly;
-    break;
+  const std::size_t d = static_cast<std::size_t>(scale);
 
-  case format::argb:
-    bmp_info = kCGImageAlphaFirst | kCGImageByteOrder32Little;
-    break;
+  // ImageIO can't read raw files, the mapped pixels are box filtered.
+  if (img_type == type::raw) {
+    const nano::size<std::size_t> size = get_size();
+    *this = resize({ (size.width + d - 1) / d, (size.height + d - 1) / d }, filter::box);
+    return;
+  }
 
-  case format::bgra:
-    bmp_info = kCGImageAlphaFirst | kCGImageByteOrder32Big;
-    break;
+  // ImageIO makes the thumbnails of jpeg files with a scaled inverse DCT, png ones are resampled.
+  cf::unique_ptr<CGDataProviderRef> dataProvider = CGDataProviderCreateWithFilename(filepath.c_str());
+  cf::unique_ptr<CGImageSourceRef> source
+      = dataProvider ? CGImageSourceCreateWithDataProvider(dataProvider, nullptr) : nullptr;
 
-  case format::rgb:
-    bmp_info = kCGImageAlphaNone;
-    break;
+  if (!source) {
+    return;
+  }
 
-  case format::rgba:
-    bmp_info = kCGImageAlphaLast | kCGImageByteOrder32Little;
-    break;
+  const long max_size
+      = static_cast<long>((std::max(CGImageGetWidth(m_pimpl->img), CGImageGetHeight(m_pimpl->img)) + d - 1) / d);
+  cf::unique_ptr<CFNumberRef> max_size_ref = CFNumberCreate(kCFAllocatorDefault, kCFNumberLongType, &max_size);
 
-  case format::abgr:
-    bmp_info = kCGImageAlphaLast | kCGImageByteOrder32Big;
-    break;
+  cf::unique_ptr<CFDictionaryRef> options(
+      cf::create_dictionary({ kCGImageSourceCreateThumbnailFromImageAlways, kCGImageSourceThumbnailMaxPixelSize },
+          { kCFBooleanTrue, max_size_ref.get() }));
 
-  case format::rgbx:
-    bmp_info = kCGImageAlphaNoneSkipLast | kCGImageByteOrder32Little;
-    break;
+  if (CGImageRef thumbnail = CGImageSourceCreateThumbnailAtIndex(source, 0, options)) {
+    CGImageRelease(m_pimpl->img);
+    m_pimpl->img = thumbnail;
+  }
+}
 
-  case format::xbgr:
-    bmp_info = kCGImageAlphaNoneSkipLast | kCGImageByteOrder32Big;
-    break;
+namespace {
+  static inline CGBitmapInfo get_bitmap_info(image::format fmt) {
+    switch (fmt) {
+    case image::format::alpha:
+      return kCGImageAlphaOnly;
 
-  case format::xrgb:
-    bmp_info = kCGImageAlphaNoneSkipFirst | kCGImageByteOrder32Little;
-    break;
+    case image::format::argb:
+      return kCGImageAlphaFirst | kCGImageByteOrder32Little;
 
-  case format::bgrx:
-    bmp_info = kCGImageAlphaNoneSkipFirst | kCGImageByteOrder32Big;
-    break;
+    case image::format::bgra:
+      return kCGImageAlphaFirst | kCGImageByteOrder32Big;
 
-  case format::float_alpha:
-    bmp_info = kCGImageAlphaOnly | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
-    break;
+    case image::format::rgb:
+      return kCGImageAlphaNone;
 
-  case format::float_argb:
-    bmp_info = kCGImageAlphaFirst | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
-    break;
+    case image::format::rgba:
+      return kCGImageAlphaLast | kCGImageByteOrder32Little;
 
-  case format::float_rgb:
-    bmp_info = kCGImageAlphaNone | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
-    break;
+    case image::format::abgr:
+      return kCGImageAlphaLast | kCGImageByteOrder32Big;
 
-  case format::float_rgba:
-    bmp_info = kCGImageAlphaLast | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
-    break;
+    case image::format::rgbx:
+      return kCGImageAlphaNoneSkipLast | kCGImageByteOrder32Little;
+
+    case image::format::xbgr:
+      return kCGImageAlphaNoneSkipLast | kCGImageByteOrder32Big;
+
+    case image::format::xrgb:
+      return kCGImageAlphaNoneSkipFirst | kCGImageByteOrder32Little;
+
+    case image::format::bgrx:
+      return kCGImageAlphaNoneSkipFirst | kCGImageByteOrder32Big;
+
+    case image::format::float_alpha:
+      return kCGImageAlphaOnly | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
+
+    case image::format::float_argb:
+      return kCGImageAlphaFirst | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
+
+    case image::format::float_rgb:
+      return kCGImageAlphaNone | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
+
+    case image::format::float_rgba:
+      return kCGImageAlphaLast | kCGBitmapFloatComponents | kCGImageByteOrder32Little;
+    }
+
+    return kCGImageAlphaLast | kCGImageByteOrder32Little;
+  }
+
+  static inline CGBitmapInfo get_bitmap_info(image::format fmt, bool premultiplied) {
+    CGBitmapInfo info = get_bitmap_info(fmt);
+
+    if (premultiplied && (info & kCGBitmapAlphaInfoMask) == kCGImageAlphaFirst) {
+      return (info & ~kCGBitmapAlphaInfoMask) | kCGImageAlphaPremultipliedFirst;
+    }
+
+    if (premultiplied && (info & kCGBitmapAlphaInfoMask) == kCGImageAlphaLast) {
+      return (info & ~kCGBitmapAlphaInfoMask) | kCGImageAlphaPremultipliedLast;
+    }
+
+    return info;
+  }
+
+  /// Image drawing straight from the pixels of the view, for immediate use while the view is alive.
+  static inline CGImageRef create_view_image(const image_view& v) {
+    cf::unique_ptr<CGDataProviderRef> provider
+        = CGDataProviderCreateWithData(nullptr, v.data, v.bytes_per_row * v.size.height, nullptr);
+    cf::unique_ptr<CGColorSpaceRef> colorSpace(CGColorSpaceCreateWithName(kCGColorSpaceGenericRGB));
+
+    return CGImageCreate(v.size.width, v.size.height, detail::get_bits_per_component(v.fmt),
+        detail::get_bits_per_pixel(v.fmt), v.bytes_per_row, colorSpace, get_bitmap_info(v.fmt), provider, nullptr,
+        false, kCGRenderingIntentDefault);
+  }
+
+  static void map_raw_image(image::pimpl& p, const std::string& filepath) {
+    if (detail::bitmap* bmp = detail::map_raw_image(filepath)) {
+      cf::unique_ptr<CGColorSpaceRef> colorSpace(CGColorSpaceCreateWithName(kCGColorSpaceGenericRGB));
+      set_bitmap(p, bmp, colorSpace, get_bitmap_info(bmp->fmt, bmp->premultiplied));
+    }
+  }
+} // namespace.
+
+image::image(const nano::size<std::size_t>& size, std::size_t bitsPerComponent, std::size_t bitsPerPixel,
+    std::size_t bytesPerRow, format fmt, const std::uint8_t* buffer) {
+  m_pimpl = new pimpl;
+
+  // The pixels are copied, the buffer can be released as soon as the image is created.
+  detail::bitmap* bmp = detail::bitmap::create(size, fmt, bytesPerRow);
+
+  if (!bmp) {
+    return;
+  }
+
+  bmp->bits_per_component = bitsPerComponent;
+  bmp->bits_per_pixel = bitsPerPixel;
+
+  if (buffer) {
+    std::memcpy(bmp->data, buffer, bmp->bytes_per_row * size.height);
   }
 
-  cf::unique_ptr<CGDataProviderRef> dataProvider(
-      CGDataProviderCreateWithData(nullptr, buffer, bytesPerRow * size.height, nullptr));
   cf::unique_ptr<CGColorSpaceRef> colorSpace(CGColorSpaceCreateWithName(kCGColorSpaceGenericRGB));
+  set_bitmap(*m_pimpl, bmp, colorSpace, get_bitmap_info(fmt));
+}
+
+image::image(const image_view& v) {
+  m_pimpl = new pimpl;
+  detail::bitmap* bmp = v ? detail::bitmap::create(v.size, v.fmt) : nullptr;
 
-  m_pimpl->img = CGImageCreate(size.width, size.height, bitsPerComponent, bitsPerPixel, bytesPerRow, colorSpace,
-      bmp_info, dataProvider, nullptr, false, kCGRenderingIntentDefault);
+  if (!bmp) {
+    return;
+  }
+
+  convert_pixels(v, mutable_image_view(bmp->data, v.size, bmp->bytes_per_row, v.fmt));
+  cf::unique_ptr<CGColorSpaceRef> colorSpace(CGColorSpaceCreateWithName(kCGColorSpaceGenericRGB));
+  set_bitmap(*m_pimpl, bmp, colorSpace, get_bitmap_info(v.fmt));
 }
 
 // CGImageRef __nullable CGImageCreate(size_t width, size_t height,
@@ -239,23 +355,19 @@ image::image(const nano::size<std::size_t>& size, std::size_t bitsPerComponent,
 //     CG_AVAILABLE_STARTING(10.0, 2.0);
 
 image::image(const image& img) {
-
   m_pimpl = new pimpl;
-  m_pimpl->img = img.m_pimpl->img;
-
-  if (m_pimpl->img) {
-    CGImageRetain(m_pimpl->img);
-  }
+  *this = img;
 }
 
 image::image(image&& img) {
   m_pimpl = new pimpl;
-  m_pimpl->img = img.m_pimpl->img;
-  img.m_pimpl->img = nullptr;
+  std::swap(m_pimpl->img, img.m_pimpl->img);
+  std::swap(m_pimpl->bmp, img.m_pimpl->bmp);
+  std::swap(m_pimpl->drawn_from_bmp, img.m_pimpl->drawn_from_bmp);
+  std::swap(m_pimpl->mipmapped, img.m_pimpl->mipmapped);
 }
 
 image::image(image::handle nativeImg) {
-
   m_pimpl = new pimpl;
   m_pimpl->img = reinterpret_cast<CGImageRef>(nativeImg);
 
@@ -269,15 +381,17 @@ image::~image() {
     CGImageRelease(m_pimpl->img);
   }
 
+  detail::bitmap::release(m_pimpl->bmp);
   delete m_pimpl;
 }
 
 image& image::operator=(const image& img) {
-
-  if (m_pimpl->img == img.m_pimpl->img) {
+  if (this == &img) {
     return *this;
   }
 
+  std::scoped_lock lock(img.m_pimpl->mutex);
+
   if (m_pimpl->img) {
     CGImageRelease(m_pimpl->img);
   }
@@ -288,16 +402,18 @@ image& image::operator=(const image& img) {
     CGImageRetain(m_pimpl->img);
   }
 
+  detail::bitmap::release(m_pimpl->bmp);
+  m_pimpl->bmp = detail::bitmap::retain(img.m_pimpl->bmp);
+  m_pimpl->drawn_from_bmp = img.m_pimpl->drawn_from_bmp;
+  m_pimpl->mipmapped = img.m_pimpl->mipmapped;
   return *this;
 }
 
 image& image::operator=(image&& img) {
-  if (m_pimpl->img) {
-    CGImageRelease(m_pimpl->img);
-  }
-
-  m_pimpl->img = img.m_pimpl->img;
-  img.m_pimpl->img = nullptr;
+  std::swap(m_pimpl->img, img.m_pimpl->img);
+  std::swap(m_pimpl->bmp, img.m_pimpl->bmp);
+  std::swap(m_pimpl->drawn_from_bmp, img.m_pimpl->drawn_from_bmp);
+  std::swap(m_pimpl->mipmapped, img.m_pimpl->mipmapped);
   return *this;
 }
 
@@ -335,26 +451,58 @@ std::size_t image::get_bits_per_pixel() const { return CGImageGetBitsPerPixel(m_
 
 std::size_t image::get_bytes_per_row() const { return CGImageGetBytesPerRow(m_pimpl->img); }
 
-const std::uint8_t* image::data() const {
+const std::uint8_t* image::data() const { return view().data; }
+
+image_view image::view() const {
   if (!is_valid()) {
-    return nullptr;
+    return image_view();
   }
 
-  CGDataProviderRef dataProvider = CGImageGetDataProvider(m_pimpl->img);
-  return CFDataGetBytePtr(cf::unique_ptr<CFDataRef>(CGDataProviderCopyData(dataProvider)));
+  const format fmt = get_format();
+  std::scoped_lock lock(m_pimpl->mutex);
+  read_bitmap(*m_pimpl, fmt);
+
+  const detail::bitmap& bmp = *m_pimpl->bmp;
+  return image_view(bmp.data, bmp.size, bmp.bytes_per_row, fmt);
 }
 
-void image::copy_data(std::vector<std::uint8_t>& buffer) const {
+mutable_image_view image::mutable_view() {
   if (!is_valid()) {
-    return;
+    return mutable_image_view();
   }
 
-  CGDataProviderRef dataProvider = CGImageGetDataProvider(m_pimpl->img);
-  cf::unique_ptr<CFDataRef> cfData = CGDataProviderCopyData(dataProvider);
+  const format fmt = get_format();
+  std::scoped_lock lock(m_pimpl->mutex);
+  read_bitmap(*m_pimpl, fmt);
+
+  // Copies of the image share the CGImageRef and the bitmap, CoreGraphics can retain the image too.
+  detail::bitmap* bmp = m_pimpl->bmp;
+  const std::size_t owners = m_pimpl->drawn_from_bmp ? 2 : 1;
+
+  if (CFGetRetainCount(m_pimpl->img) != 1 || bmp->ref_count.load(std::memory_order_acquire) != owners) {
+    // Copy on write, the others keep the pixels they share.
+    detail::bitmap* copy = detail::bitmap::create(bmp->size, bmp->fmt, bmp->bytes_per_row);
+    copy->bits_per_component = bmp->bits_per_component;
+    copy->bits_per_pixel = bmp->bits_per_pixel;
+    copy->premultiplied = bmp->premultiplied;
+    std::memcpy(copy->data, bmp->data, bmp->bytes_per_row * bmp->size.height);
+
+    detail::bitmap::release(bmp);
+    m_pimpl->bmp = bmp = copy;
+  }
 
-  std::size_t data_size = CFDataGetLength(cfData);
-  buffer.resize(data_size);
-  CFDataGetBytes(cfData, CFRangeMake(0, data_size), buffer.data());
+  // CoreGraphics can cache what it decoded from an image, the new one draws from the pixels about to change.
+  CGImageRef img = create_image(*bmp, CGImageGetColorSpace(m_pimpl->img), CGImageGetBitmapInfo(m_pimpl->img));
+  CGImageRelease(m_pimpl->img);
+  m_pimpl->img = img;
+  m_pimpl->drawn_from_bmp = true;
+
+  return mutable_image_view(bmp->data, bmp->size, bmp->bytes_per_row, fmt);
+}
+
+void image::copy_data(std::vector<std::uint8_t>& buffer) const {
+  const image_view v = view();
+  buffer.assign(v.data, v.data + v.bytes_per_row * v.size.height);
 }
 
 std::vector<std::uint8_t> image::get_data() const {
@@ -371,9 +519,8 @@ std::vector<std::uint8_t> image::get_data() const {
 //   return bytes;
 // }
 
-image image::make_copy() {
-  return is_valid() ? image(cf::unique_ptr<CGImageRef>(CGImageCreateCopy(m_pimpl->img)).as<handle>()) : image();
-}
+// The pixels are copied by the first mutable_view() of either image.
+image image::make_copy() { return *this; }
 
 image image::get_sub_image(const nano::rect<std::size_t>& r) const {
   return is_valid()
@@ -405,6 +552,79 @@ namespace {
 
 image image::create_colored_image(const nano::color& color) const { return create_colored_image_impl(*this, color); }
 
+image::format image::get_format() const {
+  if (!is_valid()) {
+    return format::rgba;
+  }
+
+  const CGBitmapInfo info = CGImageGetBitmapInfo(m_pimpl->img);
+  const bool is_float = info & kCGBitmapFloatComponents;
+  const bool little = (info & kCGBitmapByteOrderMask) == kCGImageByteOrder32Little;
+
+  switch (info & kCGBitmapAlphaInfoMask) {
+  case kCGImageAlphaOnly:
+    return is_float ? format::float_alpha : format::alpha;
+
+  case kCGImageAlphaNone:
+    return is_float ? format::float_rgb : format::rgb;
+
+  case kCGImageAlphaFirst:
+  case kCGImageAlphaPremultipliedFirst:
+    return is_float ? format::float_argb : little ? format::argb : format::bgra;
+
+  case kCGImageAlphaNoneSkipLast:
+    return little ? format::rgbx : format::xbgr;
+
+  case kCGImageAlphaNoneSkipFirst:
+    return little ? format::xrgb : format::bgrx;
+
+  default:
+    return is_float ? format::float_rgba : little ? format::rgba : format::abgr;
+  }
+}
+
+image image::convert(format fmt) const {
+  const format src_fmt = get_format();
+
+  if (!is_valid() || src_fmt == fmt) {
+    return *this;
+  }
+
+  const image_view src = view();
+  detail::bitmap* bmp = detail::bitmap::create(src.size, fmt);
+  bmp->premultiplied = m_pimpl->bmp->premultiplied;
+  convert_pixels(src.size, src.data, src.bytes_per_row, src_fmt, bmp->data, bmp->bytes_per_row, fmt);
+
+  // Keeps the premultiplication of the source.
+  image result;
+  set_bitmap(*result.m_pimpl, bmp, CGImageGetColorSpace(m_pimpl->img), get_bitmap_info(fmt, bmp->premultiplied));
+  return result;
+}
+
+void image::set_mipmapped(bool enabled) { m_pimpl->mipmapped = enabled; }
+
+bool image::is_mipmapped() const { return m_pimpl->mipmapped; }
+
+image image::resize(const nano::size<std::size_t>& size, filter f) const {
+  if (!is_valid()) {
+    return image();
+  }
+
+  const image_view src = view();
+  detail::bitmap* bmp = detail::bitmap::create(size, src.fmt);
+
+  if (!bmp) {
+    return image();
+  }
+
+  bmp->premultiplied = m_pimpl->bmp->premultiplied;
+  detail::resize_pixels(src, mutable_image_view(bmp->data, size, bmp->bytes_per_row, src.fmt), f, bmp->premultiplied);
+
+  image result;
+  set_bitmap(*result.m_pimpl, bmp, CGImageGetColorSpace(m_pimpl->img), get_bitmap_info(src.fmt, bmp->premultiplied));
+  return result;
+}
+
 namespace {
   static inline CFStringRef get_image_type_string(image::type img_type) {
     switch (img_type) {
@@ -415,6 +635,9 @@ namespace {
     case image::type::jpeg:
       return NANO_UTTypeJPEG;
       break;
+
+    case image::type::raw:
+      break;
     }
 
     return NANO_UTTypePNG;
@@ -426,6 +649,11 @@ bool image::save(const std::filesystem::path& filepath, type img_type) {
     return false;
   }
 
+  if (img_type == type::raw) {
+    const image_view v = view();
+    return detail::save_raw_image(filepath, v, m_pimpl->bmp->premultiplied);
+  }
+
   cf::unique_ptr<CFURLRef> url = CFURLCreateFromFileSystemRepresentation(
       kCFAllocatorDefault, (const UInt8*)filepath.c_str(), std::string_view(filepath.c_str()).size(), false);
 
@@ -755,6 +983,50 @@ float font::get_string_width(std::string_view text) const {
 
 font::handle font::get_native_font() const noexcept { return reinterpret_cast<font::handle>(m_pimpl->font); }
 
+//
+// MARK: path
+//
+
+// The CGPathRef is built on first use and shared by the copies of the path.
+path::handle path::get_native_path() const {
+  const detail::path_data& d = *m_pimpl->data;
+  std::lock_guard<std::mutex> lock(d.mutex);
+
+  if (d.native) {
+    return d.native.get();
+  }
+
+  CGMutablePathRef p = CGPathCreateMutable();
+  const nano::point<float>* pts = d.points.data();
+
+  for (detail::path_verb v : d.verbs) {
+    switch (v) {
+    case detail::path_verb::move:
+      CGPathMoveToPoint(p, nullptr, pts[0].x, pts[0].y);
+      pts += 1;
+      break;
+    case detail::path_verb::line:
+      CGPathAddLineToPoint(p, nullptr, pts[0].x, pts[0].y);
+      pts += 1;
+      break;
+    case detail::path_verb::quad:
+      CGPathAddQuadCurveToPoint(p, nullptr, pts[0].x, pts[0].y, pts[1].x, pts[1].y);
+      pts += 2;
+      break;
+    case detail::path_verb::cubic:
+      CGPathAddCurveToPoint(p, nullptr, pts[0].x, pts[0].y, pts[1].x, pts[1].y, pts[2].x, pts[2].y);
+      pts += 3;
+      break;
+    case detail::path_verb::close:
+      CGPathCloseSubpath(p);
+      break;
+    }
+  }
+
+  d.native = std::shared_ptr<const void>(p, [](const void* ptr) { CGPathRelease(reinterpret_cast<CGPathRef>(ptr)); });
+  return d.native.get();
+}
+
 //
 // MARK: graphic_context
 //
@@ -770,6 +1042,35 @@ public:
     CGContextConcatCTM(c, CGAffineTransformMake(1.0f, 0.0f, 0.0f, -1.0f, 0.0f, flipHeight));
   }
 
+  static inline void clip_to_mask(CGContextRef g, CGImageRef img, const nano::rect<float>& rect) {
+    CGContextTranslateCTM(g, static_cast<CGFloat>(rect.x), static_cast<CGFloat>(rect.y));
+    flip(g, rect.height);
+    CGContextClipToMask(g, static_cast<CGRect>(rect.with_position({ 0, 0 })), img);
+    flip(g, rect.height);
+    CGContextTranslateCTM(g, static_cast<CGFloat>(-rect.x), static_cast<CGFloat>(-rect.y));
+  }
+
+  // Draws the whole image scaled and moved so that src lands on dst, clipped to dst.
+  // No sub-image is created per draw.
+  static inline void draw_sub_image(
+      CGContextRef g, CGImageRef img, const nano::rect<float>& dst, const nano::rect<float>& src) {
+    if (src.width <= 0 || src.height <= 0) {
+      return;
+    }
+
+    const float sx = dst.width / src.width;
+    const float sy = dst.height / src.height;
+    const nano::rect<float> full = { dst.x - src.x * sx, dst.y - src.y * sy,
+      static_cast<float>(CGImageGetWidth(img)) * sx, static_cast<float>(CGImageGetHeight(img)) * sy };
+
+    CGContextSaveGState(g);
+    CGContextClipToRect(g, static_cast<CGRect>(dst));
+    CGContextTranslateCTM(g, static_cast<CGFloat>(full.x), static_cast<CGFloat>(full.y));
+    flip(g, full.height);
+    CGContextDrawImage(g, full.with_position({ 0.0f, 0.0f }).convert<CGRect>(), img);
+    CGContextRestoreGState(g);
+  }
+
   template <typename Fct, typename... Args>
   inline void draw(Fct&& fct, Args&&... args) {
 
@@ -811,7 +1112,9 @@ void graphic_context::restore_state() { CGContextRestoreGState(m_pimpl->gc); }
 void graphic_context::begin_transparent_layer(float alpha) {
   save_state();
   CGContextSetAlpha(m_pimpl->gc, static_cast<CGFloat>(alpha));
-  CGContextBeginTransparencyLayer(m_pimpl->gc, nullptr);
+
+  // Bounded by the clip so that the offscreen buffer isn't the size of the whole context.
+  CGContextBeginTransparencyLayerWithRect(m_pimpl->gc, CGContextGetClipBoundingBox(m_pimpl->gc), nullptr);
 }
 
 void graphic_context::end_transparent_layer() {
@@ -833,40 +1136,41 @@ void graphic_context::clip_to_rect(const nano::rect<float>& rect) {
   CGContextClipToRect(m_pimpl->gc, static_cast<CGRect>(rect));
 }
 
-// void graphic_context::clip_to_path(const nano::Path& p)
-// {
-//     CGContextRef g = m_pimpl->gc;
-//     CGContextBeginPath(g);
-//     CGContextAddPath(g, (CGPathRef)p.GetnativePath());
-//     CGContextClip(g);
-// }
+void graphic_context::clip_to_path(const nano::path& p) {
+  CGContextRef g = m_pimpl->gc;
+  CGContextBeginPath(g);
+  CGContextAddPath(g, reinterpret_cast<CGPathRef>(p.get_native_path()));
+  CGContextClip(g);
+}
 
-// void graphic_context::clip_to_path_even_odd(const nano::Path& p)
-// {
-//     CGContextRef g = m_pimpl->gc;
-//     CGContextBeginPath(g);
-//     CGContextAddPath(g, (CGPathRef)p.get_native_path());
-//     CGContextEOClip(g);
-// }
+void graphic_context::clip_to_path_even_odd(const nano::path& p) {
+  CGContextRef g = m_pimpl->gc;
+  CGContextBeginPath(g);
+  CGContextAddPath(g, reinterpret_cast<CGPathRef>(p.get_native_path()));
+  CGContextEOClip(g);
+}
 
 void graphic_context::clip_to_mask(const nano::image& img, const nano::rect<float>& rect) {
-  CGContextRef g = m_pimpl->gc;
-  CGContextTranslateCTM(g, static_cast<CGFloat>(rect.x), static_cast<CGFloat>(rect.y));
-  pimpl::flip(g, rect.height);
-  CGContextClipToMask(
-      g, static_cast<CGRect>(rect.with_position({ 0, 0 })), reinterpret_cast<CGImageRef>(img.get_native_image()));
-  pimpl::flip(g, rect.height);
-  CGContextTranslateCTM(g, static_cast<CGFloat>(-rect.x), static_cast<CGFloat>(-rect.y));
+  pimpl::clip_to_mask(m_pimpl->gc, reinterpret_cast<CGImageRef>(img.get_native_image()), rect);
+}
+
+void graphic_context::clip_to_mask(const nano::image_view& img, const nano::rect<float>& rect) {
+  if (!img) {
+    clip_to_rect(rect);
+    return;
+  }
+
+  cf::unique_ptr<CGImageRef> mask = create_view_image(img);
+  pimpl::clip_to_mask(m_pimpl->gc, mask, rect);
 }
 
 void graphic_context::add_rect(const nano::rect<float>& rect) {
   CGContextAddRect(m_pimpl->gc, static_cast<CGRect>(rect));
 }
 
-// void graphic_context::add_path(const nano::Path& p)
-// {
-//     CGContextAddPath(m_pimpl->gc, (CGPathRef)p.GetNativePath());
-// }
+void graphic_context::add_path(const nano::path& p) {
+  CGContextAddPath(m_pimpl->gc, reinterpret_cast<CGPathRef>(p.get_native_path()));
+}
 
 void graphic_context::begin_path() { CGContextBeginPath(m_pimpl->gc); }
 void graphic_context::close_path() { CGContextClosePath(m_pimpl->gc); }
@@ -913,6 +1217,51 @@ void graphic_context::set_line_style(float width, line_join lj, line_cap lc) {
   set_line_cap(lc);
 }
 
+void graphic_context::set_miter_limit(float limit) {
+  CGContextSetMiterLimit(m_pimpl->gc, static_cast<CGFloat>(limit));
+}
+
+namespace {
+  static inline CGBlendMode to_cg_blend_mode(blend_mode mode) noexcept {
+    switch (mode) {
+    case blend_mode::normal:
+      return kCGBlendModeNormal;
+    case blend_mode::multiply:
+      return kCGBlendModeMultiply;
+    case blend_mode::screen:
+      return kCGBlendModeScreen;
+    case blend_mode::overlay:
+      return kCGBlendModeOverlay;
+    case blend_mode::clear:
+      return kCGBlendModeClear;
+    case blend_mode::copy:
+      return kCGBlendModeCopy;
+    case blend_mode::source_in:
+      return kCGBlendModeSourceIn;
+    case blend_mode::source_out:
+      return kCGBlendModeSourceOut;
+    case blend_mode::source_atop:
+      return kCGBlendModeSourceAtop;
+    case blend_mode::destination_over:
+      return kCGBlendModeDestinationOver;
+    case blend_mode::destination_in:
+      return kCGBlendModeDestinationIn;
+    case blend_mode::destination_out:
+      return kCGBlendModeDestinationOut;
+    case blend_mode::destination_atop:
+      return kCGBlendModeDestinationAtop;
+    case blend_mode::exclusive_or:
+      return kCGBlendModeXOR;
+    case blend_mode::plus_lighter:
+      return kCGBlendModePlusLighter;
+    }
+
+    return kCGBlendModeNormal;
+  }
+} // namespace.
+
+void graphic_context::set_blend_mode(blend_mode mode) { CGContextSetBlendMode(m_pimpl->gc, to_cg_blend_mode(mode)); }
+
 void graphic_context::set_fill_color(const nano::color& c) {
   CGContextRef cg = m_pimpl->gc;
   CGColorRef color
@@ -1012,26 +1361,29 @@ void graphic_context::stroke_rounded_rect(const nano::rect<float>& r, float radi
   CGPathRelease(path);
 }
 
-// void graphic_context::fill_path(const nano::Path& p)
-// {
-//     CGContextRef g = m_pimpl->gc;
-//     CGContextAddPath(g, (CGPathRef)p.GetNativePath());
-//     CGContextFillPath(g);
-// }
-
-// void graphic_context::fill_path(const nano::Path& p, const nano::rect<float>& rect)
-// {
-//     SaveState();
-//     Translate(rect.position);
-
-//     CGContextRef g = m_pimpl->gc;
-
-//     CGContextScaleCTM(g, rect.width, rect.height);
-//     CGContextAddPath(g, (CGPathRef)p.GetNativePath());
-//     CGContextFillPath(g);
+void graphic_context::fill_path(const nano::path& p) {
+  m_pimpl->draw(
+      [](CGContextRef g, CGPathRef path) {
+        CGContextBeginPath(g);
+        CGContextAddPath(g, path);
+        CGContextFillPath(g);
+      },
+      reinterpret_cast<CGPathRef>(p.get_native_path()));
+}
 
-//     RestoreState();
-// }
+void graphic_context::fill_path(const nano::path& p, const nano::rect<float>& rect) {
+  m_pimpl->draw(
+      [](CGContextRef g, CGPathRef path, const nano::rect<float>& r) {
+        CGContextSaveGState(g);
+        CGContextTranslateCTM(g, static_cast<CGFloat>(r.x), static_cast<CGFloat>(r.y));
+        CGContextScaleCTM(g, static_cast<CGFloat>(r.width), static_cast<CGFloat>(r.height));
+        CGContextBeginPath(g);
+        CGContextAddPath(g, path);
+        CGContextFillPath(g);
+        CGContextRestoreGState(g);
+      },
+      reinterpret_cast<CGPathRef>(p.get_native_path()), rect);
+}
 
 // void graphic_context::fill_path_with_shadow(
 //     const nano::Path& p, float blur, const nano::color& shadow_color, const nano::size<float>& offset)
@@ -1049,12 +1401,15 @@ void graphic_context::stroke_rounded_rect(const nano::rect<float>& r, float radi
 //     RestoreState();
 // }
 
-// void graphic_context::stroke_path(const nano::Path& p)
-// {
-//     CGContextRef g = m_pimpl->gc;
-//     CGContextAddPath(g, (CGPathRef)p.get_native_path());
-//     CGContextStrokePath(g);
-// }
+void graphic_context::stroke_path(const nano::path& p) {
+  m_pimpl->draw(
+      [](CGContextRef g, CGPathRef path) {
+        CGContextBeginPath(g);
+        CGContextAddPath(g, path);
+        CGContextStrokePath(g);
+      },
+      reinterpret_cast<CGPathRef>(p.get_native_path()));
+}
 
 void graphic_context::draw_image(const nano::image& img, const nano::point<float>& pos) {
   CGContextRef g = m_pimpl->gc;
@@ -1098,16 +1453,24 @@ void graphic_context::draw_image(
 
 void graphic_context::draw_sub_image(
     const nano::image& img, const nano::rect<float>& rect, const nano::rect<float>& imgRect) {
-  CGContextRef g = m_pimpl->gc;
+  if (img.is_valid()) {
+    pimpl::draw_sub_image(m_pimpl->gc, reinterpret_cast<CGImageRef>(img.get_native_image()), rect, imgRect);
+  }
+}
 
-  nano::image sImg = img.get_sub_image(imgRect);
+void graphic_context::draw_image(const nano::image_view& img, const nano::rect<float>& rect) {
+  draw_sub_image(img, rect, nano::rect<float>(img.get_rect()));
+}
 
-  CGContextTranslateCTM(g, static_cast<CGFloat>(rect.x), static_cast<CGFloat>(rect.y));
-  pimpl::flip(g, rect.height);
-  CGContextDrawImage(
-      g, rect.with_position({ 0.0f, 0.0f }).convert<CGRect>(), reinterpret_cast<CGImageRef>(sImg.get_native_image()));
-  pimpl::flip(g, rect.height);
-  CGContextTranslateCTM(g, static_cast<CGFloat>(-rect.x), static_cast<CGFloat>(-rect.y));
+void graphic_context::draw_sub_image(
+    const nano::image_view& img, const nano::rect<float>& rect, const nano::rect<float>& imgRect) {
+  if (!img) {
+    return;
+  }
+
+  // CoreGraphics draws synchronously, the image doesn't outlive the view.
+  cf::unique_ptr<CGImageRef> cg_img = create_view_image(img);
+  pimpl::draw_sub_image(m_pimpl->gc, cg_img, rect, imgRect);
 }
 
 //
@@ -1190,6 +1553,33 @@ graphic_context::handle graphic_context::get_handle() const noexcept { return re
 
 bool graphic_context::is_bitmap() const noexcept { return m_pimpl->is_bitmap; }
 
+// CoreGraphics schedules its own rendering.
+void graphic_context::set_tiled_rendering(bool enabled, std::size_t thread_count) {
+  (void)enabled;
+  (void)thread_count;
+}
+
+bool graphic_context::is_tiled_rendering() const noexcept { return false; }
+
+void graphic_context::flush() { CGContextFlush(m_pimpl->gc); }
+
+// Draw calls aren't tracked, the whole context is always damaged.
+std::vector<nano::rect<std::size_t>> graphic_context::get_damage() const { return { get_damage_bounds() }; }
+
+nano::rect<std::size_t> graphic_context::get_damage_bounds() const {
+  if (!m_pimpl->is_bitmap) {
+    return { 0, 0, 0, 0 };
+  }
+
+  return { 0, 0, CGBitmapContextGetWidth(m_pimpl->gc), CGBitmapContextGetHeight(m_pimpl->gc) };
+}
+
+void graphic_context::add_damage(const nano::rect<float>& rect) { (void)rect; }
+
+void graphic_context::clip_to_damage() {}
+
+void graphic_context::reset_damage() {}
+
 nano::image graphic_context::create_image() {
   if (!is_bitmap()) {
     return image();
@@ -1351,3 +1741,4 @@ graphic_context graphic_context::create_bitmap_context(const nano::size<std::siz
 //}
 
 } // namespace nano.
+#endif // !NANO_GRAPHICS_SOFTWARE_RENDERER
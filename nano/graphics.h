@@ -24,12 +24,21 @@
 #include <nano/common.h>
 #include <nano/geometry.h>
 
+#include <chrono>
 #include <filesystem>
+#include <functional>
 #include <iomanip>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
 
+/// Set to 1 (see NANO_GRAPHICS_SOFTWARE_RENDERER in CMakeLists.txt) to use the
+/// portable CPU rasterizer instead of CoreGraphics.
+#ifndef NANO_GRAPHICS_SOFTWARE_RENDERER
+  #define NANO_GRAPHICS_SOFTWARE_RENDERER 0
+#endif
+
 NANO_CLANG_DIAGNOSTIC_PUSH()
 NANO_CLANG_DIAGNOSTIC(warning, "-Weverything")
 NANO_CLANG_DIAGNOSTIC(ignored, "-Wc++98-compat")
@@ -204,12 +213,25 @@ private:
 
 static_assert(std::is_trivial<color>::value, "nano::color must remain a trivial type");
 
+template <typename T>
+struct basic_image_view;
+
+/// Read-only pixels of an image.
+using image_view = basic_image_view<const std::uint8_t>;
+
+/// Writable pixels of an image.
+using mutable_image_view = basic_image_view<std::uint8_t>;
+
+class async_image;
+
 ///
 ///
 ///
 class image {
 public:
-  enum class type { png, jpeg };
+  /// raw is the nano image container: a small header followed by the pixel rows as they are in memory.
+  /// Loading one maps the file instead of decoding it, see save() and convert_to_raw_image().
+  enum class type { png, jpeg, raw };
 
   enum class format {
     alpha,
@@ -234,15 +256,52 @@ public:
     float_rgba
   };
 
+  /// Change of premultiplication applied by convert_pixels on top of the format conversion.
+  enum class alpha_conversion { none, premultiply, unpremultiply };
+
+  /// Resampling filters of resize(), from the fastest to the sharpest.
+  enum class filter { box, bilinear, bicubic, lanczos3 };
+
+  /// Reduction applied while loading a file, the value is the denominator of the scale.
+  enum class decode_scale { full = 1, half = 2, quarter = 4, eighth = 8 };
+
+  /// Header of an image file read by probe(), without decoding the pixels.
+  struct file_info {
+    type file_type = type::png;
+    nano::size<std::size_t> size = { 0, 0 };
+
+    /// Channels of the decoded pixels: 1 gray, 2 gray and alpha, 3 colors, 4 colors and alpha.
+    /// The transparent colors of png files count as alpha, the cmyk jpeg files as colors.
+    std::size_t channels = 0;
+
+    /// Bits of each sample in the file, 8 for the palette of indexed png files.
+    std::size_t bits_per_component = 0;
+
+    /// Pixels per inch, 0 when the file doesn't tell.
+    nano::size<double> dpi = { 0.0, 0.0 };
+
+    bool valid = false;
+    inline explicit operator bool() const noexcept { return valid; }
+  };
+
   using handle = void*;
 
   image();
   image(const std::string& filepath, type fmt);
+
+  /// Loads the file divided by scale, each dimension rounded up. jpeg files are reduced by the inverse DCT,
+  /// which only computes the smaller pixels: the time and memory needed are proportional to the loaded size.
+  /// png and raw files are loaded at full size and box filtered.
+  image(const std::string& filepath, type fmt, decode_scale scale);
+
   image(handle native_img);
 
   image(const nano::size<std::size_t>& size, std::size_t bitsPerComponent, std::size_t bitsPerPixel,
       std::size_t bytesPerRow, format fmt, const std::uint8_t* buffer = nullptr);
 
+  /// Copies the pixels of the view, which are straight alpha like the buffer of the constructor above.
+  explicit image(const image_view& v);
+
   image(const image& img);
   image(image&& img);
 
@@ -260,8 +319,11 @@ public:
 
   inline nano::rect<std::size_t> get_rect() const { return { { 0, 0 }, get_size() }; }
 
+  /// The rect is intersected with the image bounds. The sub-image shares the pixels of the image
+  /// instead of copying them, use view().sub_view(r) when an image object isn't needed.
   image get_sub_image(const nano::rect<std::size_t>& r) const;
 
+  /// Shares the pixels like a copy of the image, they are only duplicated when one of the images writes to them.
   image make_copy();
 
   handle get_native_image() const;
@@ -270,24 +332,173 @@ public:
   std::size_t get_bits_per_pixel() const;
   std::size_t get_bytes_per_row() const;
 
+  /// Same as view().data, the pointer stays valid as long as the image is alive and mutable_view() isn't called.
   const std::uint8_t* data() const;
 
+  /// The pixels of the image, without copying them. The view stays valid as long as the image is alive and
+  /// mutable_view() isn't called, reading the pixels of an image that wasn't created from pixels decodes them
+  /// the first time.
+  image_view view() const;
+
+  /// Writable pixels, copied on write: when other images, sub-images or pending draws share the pixels,
+  /// this image gets its own copy first and the others keep the current ones.
+  mutable_image_view mutable_view();
+
+  /// Copies the pixels, prefer view() when they are only read.
   void copy_data(std::vector<std::uint8_t>& buffer) const;
 
   std::vector<std::uint8_t> get_data() const;
 
   image create_colored_image(const nano::color& color) const;
 
+  format get_format() const;
+
+  /// Copy of the image with its pixels in another format, the premultiplication is left as is.
+  /// Formats without alpha are opaque, the alpha one has black colors.
+  image convert(format fmt) const;
+
+  /// Converts size.width x size.height pixels between two buffers that don't overlap.
+  /// Large images are converted in bands of rows on several threads.
+  static void convert_pixels(const nano::size<std::size_t>& size, const std::uint8_t* src,
+      std::size_t src_bytes_per_row, format src_fmt, std::uint8_t* dst, std::size_t dst_bytes_per_row, format dst_fmt,
+      alpha_conversion op = alpha_conversion::none);
+
+  /// Same as above for the pixels common to both views.
+  static void convert_pixels(const image_view& src, const mutable_image_view& dst,
+      alpha_conversion op = alpha_conversion::none);
+
+  /// Draws that shrink a mipmapped image sample the smallest of its halved copies that is still
+  /// larger than the destination, instead of the full resolution pixels. The copies are built on
+  /// first use and dropped by mutable_view(), images sharing pixels share the setting.
+  /// CoreGraphics filters the draws itself, this does nothing on that backend.
+  void set_mipmapped(bool enabled);
+  bool is_mipmapped() const;
+
+  /// Bytes that the mipmaps of every image can use together, 64 MB by default.
+  /// Levels past the limit aren't built, draws then use the smallest level available.
+  static void set_mipmap_memory_limit(std::size_t bytes);
+  static std::size_t get_mipmap_memory_limit();
+
+  /// Copy of the image resampled to size, in the same format and premultiplication.
+  image resize(const nano::size<std::size_t>& size, filter f = filter::bicubic) const;
+
+  /// Resamples src to fill dst with two separable passes, split in bands of rows on several threads.
+  /// The pixels of both views are straight alpha, they are filtered premultiplied and clamped to [0, 1].
+  static void resize_pixels(const image_view& src, const mutable_image_view& dst, filter f = filter::bicubic);
+
+  static std::size_t get_bytes_per_pixel(format fmt) noexcept;
+
+  /// raw files keep the format and premultiplication of the pixels, rows are padded to 64 bytes.
   bool save(const std::filesystem::path& filepath, type fmt);
 
+  /// Same as probe(filepath).dpi.
   static nano::size<double> get_dpi(const std::string& filepath);
 
+  /// Reads the header of a png, jpeg or raw file, whose type is found from its first bytes. Only what comes
+  /// before the pixels is read: the png chunks before IDAT, the jpeg segments before the frame header.
+  static file_info probe(const std::filesystem::path& filepath);
+
+  /// probe() of every file on the thread pool, for directory scans. The infos are in the order of filepaths.
+  static std::vector<file_info> probe(const std::vector<std::filesystem::path>& filepaths);
+
+  /// Order in which the pending loads of load_async() start, a running load is never interrupted.
+  enum class load_priority { low, normal, high };
+
+  /// Loads the file on the decode threads, a small pool separate from the one used for rendering,
+  /// and returns at once. Unless the load is cancelled before it starts, on_loaded is called on a decode
+  /// thread with the image, invalid if the load failed, and returns before the load is done.
+  static async_image load_async(const std::string& filepath, type fmt, load_priority priority = load_priority::normal,
+      std::function<void(const image&)> on_loaded = nullptr);
+
+  /// load_async() of the next assets with load_priority::low, which only take the decode threads
+  /// that nothing else needs. Keep the requests and get() the images when they are needed.
+  static std::vector<async_image> prefetch(const std::vector<std::string>& filepaths, type fmt);
+
   struct pimpl;
 
 private:
   pimpl* m_pimpl;
 };
 
+/// Image being loaded by image::load_async(), the copies refer to the same load.
+class async_image {
+public:
+  enum class status { pending, running, done, cancelled };
+
+  /// Refers to no load, is_valid() is false.
+  async_image() noexcept = default;
+
+  inline bool is_valid() const noexcept { return m_state != nullptr; }
+  inline explicit operator bool() const noexcept { return is_valid(); }
+
+  status get_status() const;
+
+  /// True when the load is done or cancelled, get() won't wait.
+  bool is_ready() const;
+
+  /// Waits for the load, up to timeout, and tells if it is ready.
+  bool wait_for(std::chrono::milliseconds timeout) const;
+
+  /// Waits for the load. The image is invalid when the load failed or was cancelled.
+  image get() const;
+
+  /// The load won't start if it hasn't yet. Returns false when it is already running or done.
+  bool cancel();
+
+  /// Moves a pending load to another priority, nothing happens once it started.
+  void set_priority(image::load_priority priority);
+
+  struct state;
+
+private:
+  friend class image;
+  std::shared_ptr<state> m_state;
+};
+
+/// Strided pixels that belong to something else, rows are bytes_per_row apart.
+template <typename T>
+struct basic_image_view {
+  basic_image_view() noexcept = default;
+
+  inline basic_image_view(
+      T* d, const nano::size<std::size_t>& s, std::size_t bpr, image::format f = image::format::rgba) noexcept
+      : data(d)
+      , size(s)
+      , bytes_per_row(bpr)
+      , fmt(f) {}
+
+  /// A mutable view converts to a read-only one.
+  template <typename U, std::enable_if_t<std::is_convertible<U*, T*>::value, int> = 0>
+  inline basic_image_view(const basic_image_view<U>& v) noexcept
+      : data(v.data)
+      , size(v.size)
+      , bytes_per_row(v.bytes_per_row)
+      , fmt(v.fmt) {}
+
+  inline explicit operator bool() const noexcept { return data != nullptr; }
+
+  inline T* row(std::size_t y) const noexcept { return data + y * bytes_per_row; }
+
+  inline std::size_t bytes_per_pixel() const noexcept { return image::get_bytes_per_pixel(fmt); }
+
+  inline nano::rect<std::size_t> get_rect() const noexcept { return { { 0, 0 }, size }; }
+
+  /// The pixels of r in the same buffer, r is intersected with the bounds of the view.
+  inline basic_image_view sub_view(const nano::rect<std::size_t>& r) const noexcept {
+    if (!data || r.x >= size.width || r.y >= size.height) {
+      return basic_image_view();
+    }
+
+    return basic_image_view(row(r.y) + r.x * bytes_per_pixel(),
+        { std::min(r.width, size.width - r.x), std::min(r.height, size.height - r.y) }, bytes_per_row, fmt);
+  }
+
+  T* data = nullptr;
+  nano::size<std::size_t> size = { 0, 0 };
+  std::size_t bytes_per_row = 0;
+  image::format fmt = image::format::rgba;
+};
+
 enum class text_alignment { left, center, right };
 
 /// https://developer.apple.com/documentation/quartzcore/cashapelayer/1521905-linecap?language=objc
@@ -324,6 +535,57 @@ enum class line_cap {
 
 };
 
+/// https://developer.apple.com/documentation/coregraphics/cgblendmode?language=objc
+/// In the formulas R is the result, S the source, D the destination, Sa and Da their alpha,
+/// all the colors are premultiplied.
+enum class blend_mode {
+  /// R = S + D * (1 - Sa), source-over. This is the default.
+  normal,
+
+  /// R = S * D + S * (1 - Da) + D * (1 - Sa)
+  multiply,
+
+  /// R = S + D - S * D
+  screen,
+
+  /// Multiplies or screens depending on the destination color.
+  overlay,
+
+  /// R = 0
+  clear,
+
+  /// R = S
+  copy,
+
+  /// R = S * Da
+  source_in,
+
+  /// R = S * (1 - Da)
+  source_out,
+
+  /// R = S * Da + D * (1 - Sa)
+  source_atop,
+
+  /// R = S * (1 - Da) + D
+  destination_over,
+
+  /// R = D * Sa
+  destination_in,
+
+  /// R = D * (1 - Sa)
+  destination_out,
+
+  /// R = S * (1 - Da) + D * Sa
+  destination_atop,
+
+  /// R = S * (1 - Da) + D * (1 - Sa)
+  exclusive_or,
+
+  /// R = min(1, S + D), additive blending.
+  plus_lighter
+
+};
+
 ///
 ///
 ///
@@ -375,6 +637,62 @@ private:
   pimpl* m_pimpl;
 };
 
+///
+/// Vector path made of lines, quadratic and cubic bezier curves.
+/// Copies share the geometry until one of them is modified, the flattened
+/// segments used by the software renderer are cached with it.
+///
+class path {
+public:
+  using handle = const void*;
+
+  path();
+  path(const path& p);
+  path(path&& p);
+
+  ~path();
+
+  path& operator=(const path& p);
+  path& operator=(path&& p);
+
+  /// Starts a new contour.
+  void move_to(const nano::point<float>& p);
+
+  void line_to(const nano::point<float>& p);
+
+  void quad_to(const nano::point<float>& ctrl, const nano::point<float>& end);
+
+  void cubic_to(const nano::point<float>& ctrl0, const nano::point<float>& ctrl1, const nano::point<float>& end);
+
+  /// Angles are in radians, clockwise goes from the positive x axis toward the positive y axis.
+  /// A line joins the current contour to the start of the arc.
+  void add_arc(const nano::point<float>& center, float radius, float start_angle, float end_angle, bool clockwise);
+
+  void add_rect(const nano::rect<float>& r);
+
+  void add_ellipse(const nano::rect<float>& r);
+
+  void add_rounded_rect(const nano::rect<float>& r, float radius);
+
+  void add_path(const path& p);
+
+  void close_path();
+
+  void clear();
+
+  bool empty() const noexcept;
+
+  /// Bounds of every point of the path, curve control points included.
+  nano::rect<float> get_bounding_box() const noexcept;
+
+  handle get_native_path() const;
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+
 ///
 ///
 ///
@@ -434,14 +752,15 @@ public:
   void clip_even_odd();
   void reset_clip();
   void clip_to_rect(const nano::rect<float>& rect);
-  // void clip_to_path(const nano::path& p);
-  // void clip_to_path_even_odd(const nano::path& p);
+  void clip_to_path(const nano::path& p);
+  void clip_to_path_even_odd(const nano::path& p);
   void clip_to_mask(const nano::image& img, const nano::rect<float>& rect);
+  void clip_to_mask(const nano::image_view& img, const nano::rect<float>& rect);
 
   void begin_path();
   void close_path();
   void add_rect(const nano::rect<float>& rect);
-  // void add_path(const nano::path& p);
+  void add_path(const nano::path& p);
 
   nano::rect<float> get_clipping_rect() const;
 
@@ -450,6 +769,14 @@ public:
   void set_line_cap(line_cap lc);
   void set_line_style(float width, line_join lj, line_cap lc);
 
+  /// Miter joins longer than limit times the line width are beveled, 10 by default.
+  void set_miter_limit(float limit);
+
+  /// How the following draw calls are composited, part of the saved state.
+  /// Transparency layers start with blend_mode::normal and are composited with the mode in effect
+  /// when they end.
+  void set_blend_mode(blend_mode mode);
+
   void set_fill_color(const nano::color& c);
   void set_stroke_color(const nano::color& c);
 
@@ -468,12 +795,14 @@ public:
   // void fill_quad(const nano::quad& q);
   // void stroke_quad(const nano::quad& q);
 
-  // void fill_path(const nano::path& p);
-  // void fill_path(const nano::path& p, const nano::rect<float>& rect);
+  void fill_path(const nano::path& p);
+
+  /// Fills p scaled by the size of rect and moved to its position.
+  void fill_path(const nano::path& p, const nano::rect<float>& rect);
   // void fill_path_with_shadow(
   // const nano::path& p, float blur, const nano::color& shadow_color, const nano::size<float>& offset);
 
-  // void stroke_path(const nano::path& p);
+  void stroke_path(const nano::path& p);
 
   void draw_image(const nano::image& img, const nano::point<float>& pos);
   void draw_image(const nano::image& img, const nano::rect<float>& r);
@@ -481,6 +810,11 @@ public:
 
   void draw_sub_image(const nano::image& img, const nano::rect<float>& r, const nano::rect<float>& img_rect);
 
+  /// Draws pixels that belong to the caller without creating an image, sub_view() selects a sprite
+  /// in O(1). Tiled rendering defers the draw so the view is copied, draw an image to avoid it.
+  void draw_image(const nano::image_view& img, const nano::rect<float>& r);
+  void draw_sub_image(const nano::image_view& img, const nano::rect<float>& r, const nano::rect<float>& img_rect);
+
   void draw_text(const nano::font& f, const std::string& text, const nano::point<float>& pos);
 
   void draw_text(
@@ -490,6 +824,33 @@ public:
 
   bool is_bitmap() const noexcept;
 
+  /// Opt-in parallel rendering for bitmap contexts.
+  /// Draw calls are deferred, binned into 256x64 tiles and rasterized on a pool of
+  /// thread_count threads (0 for every core) when flush() is called. The output is
+  /// identical to immediate rendering. Does nothing on the CoreGraphics backend.
+  void set_tiled_rendering(bool enabled, std::size_t thread_count = 0);
+
+  bool is_tiled_rendering() const noexcept;
+
+  /// Renders the deferred draw calls. create_image() and disabling tiled rendering flush implicitly.
+  void flush();
+
+  /// Damage tracking for partial redraws of bitmap contexts.
+  /// Every draw call adds its clipped device bounds to the damage, which is cleared by
+  /// create_image(), flush() and reset_damage(). Read it before calling create_image() to
+  /// know which pixels changed. The CoreGraphics backend always reports the whole context.
+  std::vector<nano::rect<std::size_t>> get_damage() const;
+
+  nano::rect<std::size_t> get_damage_bounds() const;
+
+  /// Marks a rect as changed, typically before redrawing it with clip_to_damage().
+  void add_damage(const nano::rect<float>& rect);
+
+  /// Intersects the clip with the damage bounds, draw calls outside of them are skipped.
+  void clip_to_damage();
+
+  void reset_damage();
+
   nano::image create_image();
 
   handle get_handle() const noexcept;
@@ -500,6 +861,106 @@ private:
   pimpl* m_pimpl;
 };
 
+///
+/// Records graphic_context calls into a compact command buffer that can be
+/// replayed into any context, any number of times.
+/// The images and fonts are retained by the list.
+///
+class display_list {
+public:
+  display_list();
+  display_list(const display_list& dl);
+  display_list(display_list&& dl);
+
+  ~display_list();
+
+  display_list& operator=(const display_list& dl);
+  display_list& operator=(display_list&& dl);
+
+  /// Removes every command, the memory is kept for the next recording.
+  void clear();
+
+  bool empty() const noexcept;
+
+  /// Number of recorded commands.
+  std::size_t size() const noexcept;
+
+  /// Replays every command into gc.
+  void replay(graphic_context& gc) const;
+
+  /// Same as replay(gc) but the fills, strokes and images entirely outside of
+  /// visible_rect (in the coordinates of the list) are skipped.
+  void replay(graphic_context& gc, const nano::rect<float>& visible_rect) const;
+
+  void save_state();
+  void restore_state();
+
+  void begin_transparent_layer(float alpha);
+  void end_transparent_layer();
+
+  void translate(const nano::point<float>& pos);
+
+  void clip();
+  void clip_even_odd();
+  void reset_clip();
+  void clip_to_rect(const nano::rect<float>& rect);
+  void clip_to_path(const nano::path& p);
+  void clip_to_path_even_odd(const nano::path& p);
+  void clip_to_mask(const nano::image& img, const nano::rect<float>& rect);
+  void clip_to_mask(const nano::image_view& img, const nano::rect<float>& rect);
+
+  void begin_path();
+  void close_path();
+  void add_rect(const nano::rect<float>& rect);
+  void add_path(const nano::path& p);
+
+  void set_line_width(float width);
+  void set_line_join(line_join lj);
+  void set_line_cap(line_cap lc);
+  void set_line_style(float width, line_join lj, line_cap lc);
+  void set_miter_limit(float limit);
+  void set_blend_mode(blend_mode mode);
+
+  void set_fill_color(const nano::color& c);
+  void set_stroke_color(const nano::color& c);
+
+  void fill_rect(const nano::rect<float>& r);
+  void stroke_rect(const nano::rect<float>& r);
+  void stroke_rect(const nano::rect<float>& r, float line_width);
+
+  void stroke_line(const nano::point<float>& p0, const nano::point<float>& p1);
+
+  void fill_ellipse(const nano::rect<float>& r);
+  void stroke_ellipse(const nano::rect<float>& r);
+
+  void fill_rounded_rect(const nano::rect<float>& r, float radius);
+  void stroke_rounded_rect(const nano::rect<float>& r, float radius);
+
+  void fill_path(const nano::path& p);
+  void fill_path(const nano::path& p, const nano::rect<float>& rect);
+  void stroke_path(const nano::path& p);
+
+  void draw_image(const nano::image& img, const nano::point<float>& pos);
+  void draw_image(const nano::image& img, const nano::rect<float>& r);
+  void draw_image(const nano::image& img, const nano::rect<float>& r, const nano::rect<float>& clip_rect);
+
+  void draw_sub_image(const nano::image& img, const nano::rect<float>& r, const nano::rect<float>& img_rect);
+
+  /// The list outlives the view, its pixels are copied into an image.
+  void draw_image(const nano::image_view& img, const nano::rect<float>& r);
+  void draw_sub_image(const nano::image_view& img, const nano::rect<float>& r, const nano::rect<float>& img_rect);
+
+  void draw_text(const nano::font& f, const std::string& text, const nano::point<float>& pos);
+
+  void draw_text(
+      const nano::font& f, const std::string& text, const nano::rect<float>& rect, nano::text_alignment alignment);
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+
 class display {
 public:
   static double get_scale_factor();
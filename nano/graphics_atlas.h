@@ -0,0 +1,95 @@
+/*
+ * Nano Library
+ *
+ * Copyright (C) 2022, Meta-Sonic
+ * All rights reserved.
+ *
+ * Proprietary and confidential.
+ * Any unauthorized copying, alteration, distribution, transmission, performance,
+ * display or other use of this material is strictly prohibited.
+ *
+ * Written by Alexandre Arsenault <alx.arsenault@gmail.com>
+ */
+
+#pragma once
+
+/*!
+ * @file      nano/graphics_atlas.h
+ * @brief     nano graphics texture atlas
+ * @copyright Copyright (C) 2022, Meta-Sonic
+ * @author    Alexandre Arsenault alx.arsenault@gmail.com
+ * @date      Created 16/06/2022
+ */
+
+#include <nano/graphics.h>
+
+#include <cstdint>
+#include <limits>
+
+NANO_CLANG_DIAGNOSTIC_PUSH()
+NANO_CLANG_DIAGNOSTIC(warning, "-Weverything")
+NANO_CLANG_DIAGNOSTIC(ignored, "-Wc++98-compat")
+
+namespace nano {
+
+/// Many small images packed in a few large pages, drawn with graphic_context::draw_sub_image().
+/// Each page is filled by a skyline packer: an image goes at the lowest position where it fits,
+/// which keeps the insertion incremental. Every image is surrounded by padding pixels repeating
+/// its edges, so filtered draws never blend in the neighbours.
+class texture_atlas {
+public:
+  /// Stays the same for the life of the image in the atlas, repack() included.
+  using handle = std::uint32_t;
+  static constexpr handle invalid_handle = std::numeric_limits<handle>::max();
+
+  /// Where an image is in the atlas, rect is in the pixels of get_page(page).
+  struct entry {
+    std::size_t page = 0;
+    nano::rect<float> rect = { 0.0f, 0.0f, 0.0f, 0.0f };
+  };
+
+  /// The pages are page_size pixels in the given format.
+  explicit texture_atlas(const nano::size<std::size_t>& page_size, image::format fmt = image::format::rgba,
+      std::size_t padding = 1);
+
+  texture_atlas(const texture_atlas&) = delete;
+  texture_atlas& operator=(const texture_atlas&) = delete;
+
+  ~texture_atlas();
+
+  /// Copies the straight alpha pixels of v into the first page where they fit, a page is added when none has room.
+  /// Returns invalid_handle when the image with its padding is larger than a page.
+  handle insert(const image_view& v);
+
+  /// The space of the image is only reused after repack(), the handle can be given to a next image.
+  void erase(handle h);
+
+  /// Packs every image again into as few pages as possible, the tallest ones first.
+  /// The handles stay valid, their entries change.
+  void repack();
+
+  bool contains(handle h) const;
+  entry get_entry(handle h) const;
+
+  std::size_t get_page_count() const;
+  nano::size<std::size_t> get_page_size() const;
+
+  /// Drawing a copy of the page keeps its pixels as they were, images inserted later aren't in it.
+  const image& get_page(std::size_t index) const;
+
+  /// Same as g.draw_sub_image(get_page(e.page), r, e.rect) with the entry of h.
+  void draw(graphic_context& g, handle h, const nano::rect<float>& r) const;
+
+  std::size_t get_image_count() const;
+
+  /// Area of the images and their padding over the area of the pages, from 0 to 1.
+  float get_occupancy() const;
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+} // namespace nano.
+
+NANO_CLANG_DIAGNOSTIC_POP()
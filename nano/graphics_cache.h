@@ -0,0 +1,89 @@
+/*
+ * Nano Library
+ *
+ * Copyright (C) 2022, Meta-Sonic
+ * All rights reserved.
+ *
+ * Proprietary and confidential.
+ * Any unauthorized copying, alteration, distribution, transmission, performance,
+ * display or other use of this material is strictly prohibited.
+ *
+ * Written by Alexandre Arsenault <alx.arsenault@gmail.com>
+ */
+
+#pragma once
+
+/*!
+ * @file      nano/graphics_cache.h
+ * @brief     nano graphics image cache
+ * @copyright Copyright (C) 2022, Meta-Sonic
+ * @author    Alexandre Arsenault alx.arsenault@gmail.com
+ * @date      Created 16/06/2022
+ */
+
+#include <nano/graphics.h>
+
+#include <cstdint>
+#include <filesystem>
+
+NANO_CLANG_DIAGNOSTIC_PUSH()
+NANO_CLANG_DIAGNOSTIC(warning, "-Weverything")
+NANO_CLANG_DIAGNOSTIC(ignored, "-Wc++98-compat")
+
+namespace nano {
+
+/// Decoded images by path, the least recently used ones are dropped to stay under a budget of bytes of pixels.
+/// An entry is reloaded when the modification time or the size of its file changed. Every function can be
+/// called from any thread, concurrent requests of the same file share a single load of image::load_async().
+class image_cache {
+public:
+  struct stats {
+    /// Requests served by an entry, loaded or being loaded.
+    std::uint64_t hits = 0;
+
+    /// Requests that started a load.
+    std::uint64_t misses = 0;
+
+    /// Entries dropped to stay under the budget.
+    std::uint64_t evictions = 0;
+
+    std::size_t bytes = 0;
+    std::size_t count = 0;
+  };
+
+  explicit image_cache(std::size_t byte_budget);
+
+  image_cache(const image_cache&) = delete;
+  image_cache& operator=(const image_cache&) = delete;
+
+  /// Cancels the loads that didn't start and waits for the running ones.
+  ~image_cache();
+
+  /// The cached image of the file, loaded first on a miss. The image is invalid when the file can't be loaded,
+  /// failed loads aren't cached. An image larger than the budget is returned but not kept.
+  image get(const std::filesystem::path& filepath, image::type fmt);
+
+  /// Same as get() without waiting, the image is loaded with the given priority on a miss. On a hit the
+  /// request is the one of the first load, which can already be done. A load cancelled before it started
+  /// is a miss for the next request.
+  async_image get_async(const std::filesystem::path& filepath, image::type fmt,
+      image::load_priority priority = image::load_priority::normal);
+
+  /// The least recently used images are dropped right away when the budget shrinks.
+  void set_byte_budget(std::size_t byte_budget);
+  std::size_t get_byte_budget() const;
+
+  /// Drops the entry of the file, a pending load is cancelled if it didn't start.
+  void erase(const std::filesystem::path& filepath);
+  void clear();
+
+  stats get_stats() const;
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+} // namespace nano.
+
+NANO_CLANG_DIAGNOSTIC_POP()
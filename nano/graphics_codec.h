@@ -0,0 +1,209 @@
+/*
+ * Nano Library
+ *
+ * Copyright (C) 2022, Meta-Sonic
+ * All rights reserved.
+ *
+ * Proprietary and confidential.
+ * Any unauthorized copying, alteration, distribution, transmission, performance,
+ * display or other use of this material is strictly prohibited.
+ *
+ * Written by Alexandre Arsenault <alx.arsenault@gmail.com>
+ */
+
+#pragma once
+
+/*!
+ * @file      nano/graphics_codec.h
+ * @brief     nano graphics image codecs
+ * @copyright Copyright (C) 2022, Meta-Sonic
+ * @author    Alexandre Arsenault alx.arsenault@gmail.com
+ * @date      Created 16/06/2022
+ */
+
+#include <nano/graphics.h>
+
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+
+NANO_CLANG_DIAGNOSTIC_PUSH()
+NANO_CLANG_DIAGNOSTIC(warning, "-Weverything")
+NANO_CLANG_DIAGNOSTIC(ignored, "-Wc++98-compat")
+
+namespace nano {
+
+//
+// MARK: png
+//
+
+/// Filter applied to each row before it is compressed. The fixed ones are faster to encode,
+/// adaptive picks the filter giving the smallest sum of absolute differences on every row,
+/// which usually compresses best.
+enum class png_filter { none, sub, up, average, paeth, adaptive };
+
+struct png_options {
+  /// zlib level, from 0 (stored, fastest) to 9 (smallest).
+  int compression_level = 6;
+
+  png_filter filter = png_filter::adaptive;
+
+  /// Pixels per inch written in a pHYs chunk, none when either is 0.
+  nano::size<double> dpi = { 0.0, 0.0 };
+
+  /// Filters and compresses bands of rows on the thread pool, the rows are buffered by batches of bands.
+  /// Like pigz, every band restarts the compression on a byte boundary with the end of the previous
+  /// one as dictionary, which makes the files slightly larger. The bands have a fixed size, the file
+  /// is the same whatever the number of threads.
+  bool parallel = false;
+};
+
+/// Decodes a png one row at a time, the memory used only depends on the width of the image.
+/// Interlaced files are the exception, all their passes are decoded on the first read_row().
+/// Every color type and bit depth is supported, 16 bits samples are rounded to 8 bits.
+class png_decoder {
+public:
+  /// Reads the header, is_valid() is false when the file can't be opened or isn't a png.
+  explicit png_decoder(const std::filesystem::path& filepath);
+
+  /// Same as above, the stream must outlive the decoder.
+  explicit png_decoder(std::istream& stream);
+
+  png_decoder(const png_decoder&) = delete;
+  png_decoder& operator=(const png_decoder&) = delete;
+
+  ~png_decoder();
+
+  /// False when the header is invalid or when the data of a row was corrupted.
+  bool is_valid() const;
+  inline explicit operator bool() const { return is_valid(); }
+
+  nano::size<std::size_t> get_size() const;
+
+  /// image::format::abgr (r, g, b, a bytes) when the file has alpha or a transparent color,
+  /// image::format::rgb otherwise. Colors are never premultiplied.
+  image::format get_format() const;
+
+  /// Number of rows read so far, which is also the index of the next one.
+  std::size_t get_row_index() const;
+
+  /// Decodes the next row into get_size().width pixels of row in the given format.
+  /// Returns false once every row was read or when the data is corrupted.
+  bool read_row(std::uint8_t* row, image::format fmt);
+  inline bool read_row(std::uint8_t* row) { return read_row(row, get_format()); }
+
+  /// Calls fct(y, row) with each remaining row in get_format(), the view is only valid during the call.
+  /// Stops when fct returns false, returns true when the last row was read.
+  bool read_rows(const std::function<bool(std::size_t, const image_view&)>& fct);
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+
+/// Encodes a png one row at a time, the memory used only depends on the width of the image and,
+/// with png_options::parallel, on the number of threads. Pixels with alpha are written as 8 bits
+/// rgba, the others as 8 bits rgb.
+class png_encoder {
+public:
+  /// Writes the header, is_valid() is false when the file can't be created.
+  png_encoder(const std::filesystem::path& filepath, const nano::size<std::size_t>& size, image::format fmt,
+      const png_options& options = {});
+
+  /// Same as above, the stream must outlive the encoder.
+  png_encoder(
+      std::ostream& stream, const nano::size<std::size_t>& size, image::format fmt, const png_options& options = {});
+
+  png_encoder(const png_encoder&) = delete;
+  png_encoder& operator=(const png_encoder&) = delete;
+
+  /// Calls finish().
+  ~png_encoder();
+
+  bool is_valid() const;
+  inline explicit operator bool() const { return is_valid(); }
+
+  nano::size<std::size_t> get_size() const;
+
+  /// Number of rows written so far, which is also the index of the next one.
+  std::size_t get_row_index() const;
+
+  /// Compresses get_size().width straight alpha pixels in the format given to the constructor.
+  /// The end of the file is written with the last row.
+  bool write_row(const std::uint8_t* row);
+
+  /// Calls fct(y, row) to fill each remaining row before writing it, the view is only valid during the call.
+  bool write_rows(const std::function<void(std::size_t, const mutable_image_view&)>& fct);
+
+  /// True when every row was written and the file is complete, the file is left truncated otherwise.
+  bool finish();
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+
+//
+// MARK: jpeg
+//
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+/// Decodes a jpeg one row at a time with libjpeg, baseline files only keep a band of rows in memory.
+/// The scale is applied by the inverse DCT, which directly computes the reduced pixels instead of
+/// resampling full size ones. CoreGraphics loads jpeg files with ImageIO, this is only available
+/// with the software renderer.
+class jpeg_decoder {
+public:
+  /// Reads the header, is_valid() is false when the file can't be opened or isn't a jpeg.
+  explicit jpeg_decoder(const std::filesystem::path& filepath, image::decode_scale scale = image::decode_scale::full);
+
+  /// Same as above, the stream must outlive the decoder.
+  explicit jpeg_decoder(std::istream& stream, image::decode_scale scale = image::decode_scale::full);
+
+  jpeg_decoder(const jpeg_decoder&) = delete;
+  jpeg_decoder& operator=(const jpeg_decoder&) = delete;
+
+  ~jpeg_decoder();
+
+  /// False when the header is invalid or when the data of a row was corrupted or truncated.
+  bool is_valid() const;
+  inline explicit operator bool() const { return is_valid(); }
+
+  /// The size of the file divided by the scale, rounded up.
+  nano::size<std::size_t> get_size() const;
+
+  /// Always image::format::rgb, gray and cmyk files are converted.
+  image::format get_format() const;
+
+  /// Number of rows read so far, which is also the index of the next one.
+  std::size_t get_row_index() const;
+
+  /// Decodes the next row into get_size().width pixels of row in the given format.
+  /// Returns false once every row was read or when the data is corrupted.
+  bool read_row(std::uint8_t* row, image::format fmt);
+  inline bool read_row(std::uint8_t* row) { return read_row(row, get_format()); }
+
+  /// Calls fct(y, row) with each remaining row in get_format(), the view is only valid during the call.
+  /// Stops when fct returns false, returns true when the last row was read.
+  bool read_rows(const std::function<bool(std::size_t, const image_view&)>& fct);
+
+  struct pimpl;
+
+private:
+  pimpl* m_pimpl;
+};
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
+
+//
+// MARK: raw
+//
+
+/// Writes a png or jpeg file as an image::type::raw file, which then loads without decoding.
+/// png files, and jpeg files with the software renderer, are converted one row at a time in the format
+/// given by their decoder. Other files are loaded as an image first.
+bool convert_to_raw_image(const std::filesystem::path& src, image::type src_type, const std::filesystem::path& dst);
+} // namespace nano.
+
+NANO_CLANG_DIAGNOSTIC_POP()
@@ -0,0 +1,105 @@
+/*
+ * Nano Library
+ *
+ * Copyright (C) 2022, Meta-Sonic
+ * All rights reserved.
+ *
+ * Proprietary and confidential.
+ * Any unauthorized copying, alteration, distribution, transmission, performance,
+ * display or other use of this material is strictly prohibited.
+ *
+ * Written by Alexandre Arsenault <alx.arsenault@gmail.com>
+ */
+
+#pragma once
+
+/*!
+ * @file      nano/graphics_path.h
+ * @brief     nano graphics path internals
+ * @copyright Copyright (C) 2022, Meta-Sonic
+ * @author    Alexandre Arsenault alx.arsenault@gmail.com
+ * @date      Created 16/06/2022
+ */
+
+#include <nano/graphics.h>
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace nano::detail {
+
+enum class path_verb : std::uint8_t { move, line, quad, cubic, close };
+
+/// Contours of a path flattened into line segments.
+struct polyline {
+  /// Scale the curves were flattened for.
+  float scale;
+
+  std::vector<nano::point<float>> points;
+
+  /// End index (exclusive) in points of each contour.
+  std::vector<std::uint32_t> contours;
+
+  /// Whether each contour was ended with close_path.
+  std::vector<std::uint8_t> closed;
+
+  nano::rect<float> bounds;
+};
+
+struct stroke_style {
+  float width;
+  nano::line_join join;
+  nano::line_cap cap;
+  float miter_limit;
+
+  inline bool operator==(const stroke_style& s) const noexcept {
+    return width == s.width && join == s.join && cap == s.cap && miter_limit == s.miter_limit;
+  }
+};
+
+/// Outline of the stroke of every contour of src, appended to dst.
+/// Segments, joins and caps are emitted as separate closed contours that all wind
+/// the same way, filling the outline with the non-zero rule gives their union.
+void stroke_polyline(const polyline& src, const stroke_style& style, polyline& dst);
+
+/// Geometry shared by the copies of a nano::path.
+/// It is never modified once shared, which is what makes the caches safe.
+struct path_data {
+  path_data() = default;
+
+  /// Copies the geometry, not the caches.
+  path_data(const path_data& d);
+
+  path_data& operator=(const path_data&) = delete;
+
+  /// Flattened with a tolerance of a tenth of a pixel once multiplied by scale.
+  /// The last few scales are cached.
+  std::shared_ptr<const polyline> flatten(float scale) const;
+
+  /// Stroke outline of the path flattened at scale 1, the last few styles are cached.
+  std::shared_ptr<const polyline> stroke(const stroke_style& style) const;
+
+  std::vector<path_verb> verbs;
+  std::vector<nano::point<float>> points;
+
+  /// Bounds of every point, control points included.
+  nano::point<float> min = { 0, 0 };
+  nano::point<float> max = { 0, 0 };
+
+  mutable std::mutex mutex;
+  mutable std::vector<std::shared_ptr<const polyline>> cache;
+  mutable std::vector<std::pair<stroke_style, std::shared_ptr<const polyline>>> strokes;
+
+  /// Backend object built from the geometry, a CGPathRef with CoreGraphics.
+  mutable std::shared_ptr<const void> native;
+};
+
+} // namespace nano::detail.
+
+namespace nano {
+struct path::pimpl {
+  std::shared_ptr<detail::path_data> data;
+};
+} // namespace nano.
@@ -0,0 +1,2117 @@
+#include <nano/graphics_raster.h>
+
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace nano::detail {
+
+//
+// MARK: - pixel layout -
+//
+
+bool is_word_format(image::format fmt) noexcept {
+  switch (fmt) {
+  case image::format::argb:
+  case image::format::bgra:
+  case image::format::rgba:
+  case image::format::abgr:
+  case image::format::rgbx:
+  case image::format::xbgr:
+  case image::format::xrgb:
+  case image::format::bgrx:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+pixel_layout get_pixel_layout(image::format fmt) noexcept {
+  switch (fmt) {
+  case image::format::argb:
+  case image::format::xrgb:
+    return { 16, 8, 0, 24 };
+
+  case image::format::bgra:
+  case image::format::bgrx:
+    return { 8, 16, 24, 0 };
+
+  case image::format::abgr:
+  case image::format::xbgr:
+    return { 0, 8, 16, 24 };
+
+  default:
+    return { 24, 16, 8, 0 };
+  }
+}
+
+image::format get_word_format(const pixel_layout& layout) noexcept {
+  if (layout.a == 0) {
+    return layout.r == 24 ? image::format::rgba : image::format::bgra;
+  }
+
+  return layout.r == 16 ? image::format::argb : image::format::abgr;
+}
+
+std::size_t get_bits_per_component(image::format fmt) noexcept {
+  switch (fmt) {
+  case image::format::float_alpha:
+  case image::format::float_argb:
+  case image::format::float_rgb:
+  case image::format::float_rgba:
+    return 32;
+
+  default:
+    return 8;
+  }
+}
+
+std::size_t get_bits_per_pixel(image::format fmt) noexcept {
+  switch (fmt) {
+  case image::format::alpha:
+    return 8;
+
+  case image::format::rgb:
+    return 24;
+
+  case image::format::float_alpha:
+    return 32;
+
+  case image::format::float_rgb:
+    return 96;
+
+  case image::format::float_argb:
+  case image::format::float_rgba:
+    return 128;
+
+  default:
+    return 32;
+  }
+}
+
+//
+// MARK: - bitmap -
+//
+
+bitmap::bitmap(const image_view& v) noexcept
+    : size(v.size)
+    , bits_per_component(get_bits_per_component(v.fmt))
+    , bits_per_pixel(get_bits_per_pixel(v.fmt))
+    , bytes_per_row(v.bytes_per_row)
+    , fmt(v.fmt)
+    , data(const_cast<std::uint8_t*>(v.data)) {}
+
+bitmap* bitmap::create(const nano::size<std::size_t>& size, image::format fmt, std::size_t bytes_per_row) {
+  if (!size.width || !size.height) {
+    return nullptr;
+  }
+
+  bitmap* bmp = new bitmap;
+  bmp->size = size;
+  bmp->fmt = fmt;
+  bmp->bits_per_component = get_bits_per_component(fmt);
+  bmp->bits_per_pixel = get_bits_per_pixel(fmt);
+  bmp->bytes_per_row = std::max(bytes_per_row, (size.width * bmp->bits_per_pixel + 7) / 8);
+  bmp->storage = std::make_unique<std::uint8_t[]>(bmp->bytes_per_row * size.height);
+  bmp->data = bmp->storage.get();
+  return bmp;
+}
+
+bitmap* bitmap::create_sub_bitmap(bitmap& parent, const nano::rect<std::size_t>& r) {
+  if (!r.width || !r.height) {
+    return nullptr;
+  }
+
+  bitmap* bmp = new bitmap;
+  bmp->size = r.size;
+  bmp->fmt = parent.fmt;
+  bmp->bits_per_component = parent.bits_per_component;
+  bmp->bits_per_pixel = parent.bits_per_pixel;
+  bmp->bytes_per_row = parent.bytes_per_row;
+  bmp->premultiplied = parent.premultiplied;
+  bmp->data = parent.row(r.y) + r.x * (parent.bits_per_pixel / 8);
+  bmp->owner = retain(parent.owner ? parent.owner : &parent);
+  return bmp;
+}
+
+bitmap* bitmap::retain(bitmap* bmp) noexcept {
+  if (bmp) {
+    bmp->ref_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return bmp;
+}
+
+void bitmap::release(bitmap* bmp) noexcept {
+  if (bmp && bmp->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    bitmap* owner = bmp->owner;
+    delete bmp;
+    release(owner);
+  }
+}
+
+bool bitmap::is_unique() const noexcept {
+  if (ref_count.load(std::memory_order_acquire) != 1) {
+    return false;
+  }
+
+  // Each sub-bitmap holds a reference to the owner, so does every image of the owner itself.
+  return !owner || owner->ref_count.load(std::memory_order_acquire) == 1;
+}
+
+void load_row(const bitmap& bmp, std::size_t x, std::size_t y, std::size_t count, std::uint32_t* dst,
+    const pixel_layout& layout) noexcept {
+  const std::uint8_t* src = bmp.row(y) + x * (bmp.bits_per_pixel / 8);
+  convert_row(src, bmp.fmt, reinterpret_cast<std::uint8_t*>(dst), get_word_format(layout), count,
+      bmp.premultiplied ? image::alpha_conversion::none : image::alpha_conversion::premultiply);
+}
+
+//
+// MARK: - surface -
+//
+
+surface::surface(const nano::size<std::size_t>& size, image::format f)
+    : width(size.width)
+    , height(size.height)
+    , stride(size.width)
+    , capacity(size.width * size.height)
+    , fmt(is_word_format(f) ? f : image::format::rgba)
+    , layout(get_pixel_layout(fmt))
+    , buffer(std::make_unique<std::uint32_t[]>(size.width * size.height))
+    , pixels(buffer.get()) {}
+
+bool surface::reshape(const irect& area) noexcept {
+  const std::size_t w = static_cast<std::size_t>(std::max(area.x1 - area.x0, 0));
+  const std::size_t h = static_cast<std::size_t>(std::max(area.y1 - area.y0, 0));
+
+  if (w * h > capacity) {
+    return false;
+  }
+
+  width = w;
+  height = h;
+  stride = w;
+  origin_x = area.x0;
+  origin_y = area.y0;
+  return true;
+}
+
+void surface::clear() noexcept { std::fill_n(pixels, stride * height, 0u); }
+
+//
+// MARK: - clip mask -
+//
+
+clip_mask::clip_mask(const irect& r, const clip_mask* parent)
+    : bounds(r)
+    , width(static_cast<std::size_t>(std::max(r.x1 - r.x0, 0))) {
+  const std::size_t height = static_cast<std::size_t>(std::max(r.y1 - r.y0, 0));
+
+  if (!parent) {
+    coverage.assign(width * height, 255);
+    return;
+  }
+
+  coverage.resize(width * height);
+  for (int y = r.y0; y < r.y1; y++) {
+    std::memcpy(span(r.x0, y), parent->span(r.x0, y), width);
+  }
+}
+
+bool clip_mask::is_opaque() const noexcept {
+  return std::all_of(coverage.begin(), coverage.end(), [](std::uint8_t c) { return c == 255; });
+}
+
+//
+// MARK: - damage -
+//
+
+namespace {
+  static inline irect get_union(const irect& a, const irect& b) noexcept {
+    return { std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
+  }
+
+  static inline std::int64_t get_area(const irect& r) noexcept {
+    return r.empty() ? 0 : static_cast<std::int64_t>(r.x1 - r.x0) * static_cast<std::int64_t>(r.y1 - r.y0);
+  }
+
+  static inline bool contains(const irect& a, const irect& b) noexcept {
+    return b.x0 >= a.x0 && b.y0 >= a.y0 && b.x1 <= a.x1 && b.y1 <= a.y1;
+  }
+} // namespace.
+
+void damage_region::add(const irect& rect) {
+  if (rect.empty()) {
+    return;
+  }
+
+  irect r = rect;
+
+  // Merging can make the result overlap rectangles that were already checked.
+  for (bool merged = true; merged;) {
+    merged = false;
+
+    for (std::size_t i = 0; i < m_rects.size(); i++) {
+      const irect& a = m_rects[i];
+
+      if (contains(a, r)) {
+        return;
+      }
+
+      const irect u = get_union(a, r);
+      if (contains(r, a) || get_area(u) <= get_area(a) + get_area(r)) {
+        r = u;
+        m_rects.erase(m_rects.begin() + static_cast<std::ptrdiff_t>(i));
+        merged = true;
+        break;
+      }
+    }
+  }
+
+  m_rects.push_back(r);
+
+  while (m_rects.size() > max_rects) {
+    std::size_t best_i = 0;
+    std::size_t best_j = 1;
+    std::int64_t best_growth = std::numeric_limits<std::int64_t>::max();
+
+    for (std::size_t i = 0; i < m_rects.size(); i++) {
+      for (std::size_t j = i + 1; j < m_rects.size(); j++) {
+        const std::int64_t growth
+            = get_area(get_union(m_rects[i], m_rects[j])) - get_area(m_rects[i]) - get_area(m_rects[j]);
+
+        if (growth < best_growth) {
+          best_growth = growth;
+          best_i = i;
+          best_j = j;
+        }
+      }
+    }
+
+    m_rects[best_i] = get_union(m_rects[best_i], m_rects[best_j]);
+    m_rects.erase(m_rects.begin() + static_cast<std::ptrdiff_t>(best_j));
+  }
+}
+
+irect damage_region::bounds() const noexcept {
+  if (m_rects.empty()) {
+    return { 0, 0, 0, 0 };
+  }
+
+  irect r = m_rects[0];
+  for (const irect& a : m_rects) {
+    r = get_union(r, a);
+  }
+
+  return r;
+}
+
+//
+// MARK: - span kernels -
+//
+
+namespace {
+  // Scalar kernels, also used for the tails of the vectorized ones.
+  static inline void scalar_blend_span(
+      std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t f) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      dst[i] = px + scale_pixel(dst[i], f);
+    }
+  }
+
+  static inline void scalar_blend_span_mask(std::uint32_t* dst, const std::uint8_t* mask, std::size_t count,
+      std::uint32_t px, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      if (const std::uint32_t m = mask[i]) {
+        const std::uint32_t s = m == 255 ? px : scale_pixel(px, alpha_to_scale(m));
+        dst[i] = blend_pixel(dst[i], s, (s >> alpha_shift) & 0xFF);
+      }
+    }
+  }
+
+  static inline void scalar_blend_span_pixels(std::uint32_t* dst, const std::uint32_t* src, std::size_t count,
+      std::uint32_t f, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      const std::uint32_t s = f == 256 ? src[i] : scale_pixel(src[i], f);
+      if (s) {
+        dst[i] = blend_pixel(dst[i], s, (s >> alpha_shift) & 0xFF);
+      }
+    }
+  }
+
+  static inline std::uint32_t sub_sat(std::uint32_t a, std::uint32_t b) noexcept { return a > b ? a - b : 0; }
+
+  // Blend mode formulas on premultiplied channels in [0, 255], the alpha channel uses the same one.
+  // The vector kernels reproduce every rounding and clamping step.
+  template <blend_mode M>
+  static inline std::uint32_t blend_channel(
+      std::uint32_t s, std::uint32_t d, std::uint32_t sa, std::uint32_t da) noexcept {
+    const std::uint32_t isa = 255 - sa;
+    const std::uint32_t ida = 255 - da;
+
+    if constexpr (M == blend_mode::normal) {
+      return std::min(s + mul_div255(d, isa), 255u);
+    }
+    else if constexpr (M == blend_mode::multiply) {
+      return std::min(mul_div255(s, d) + mul_div255(s, ida) + mul_div255(d, isa), 255u);
+    }
+    else if constexpr (M == blend_mode::screen) {
+      return std::min(s + d - mul_div255(s, d), 255u);
+    }
+    else if constexpr (M == blend_mode::overlay) {
+      const std::uint32_t x = 2 * d <= da ? 2 * mul_div255(s, d)
+                                          : sub_sat(mul_div255(sa, da), 2 * mul_div255(sub_sat(da, d), sub_sat(sa, s)));
+      return std::min(x + mul_div255(s, ida) + mul_div255(d, isa), 255u);
+    }
+    else if constexpr (M == blend_mode::clear) {
+      return 0;
+    }
+    else if constexpr (M == blend_mode::copy) {
+      return s;
+    }
+    else if constexpr (M == blend_mode::source_in) {
+      return mul_div255(s, da);
+    }
+    else if constexpr (M == blend_mode::source_out) {
+      return mul_div255(s, ida);
+    }
+    else if constexpr (M == blend_mode::source_atop) {
+      return std::min(mul_div255(s, da) + mul_div255(d, isa), 255u);
+    }
+    else if constexpr (M == blend_mode::destination_over) {
+      return std::min(mul_div255(s, ida) + d, 255u);
+    }
+    else if constexpr (M == blend_mode::destination_in) {
+      return mul_div255(d, sa);
+    }
+    else if constexpr (M == blend_mode::destination_out) {
+      return mul_div255(d, isa);
+    }
+    else if constexpr (M == blend_mode::destination_atop) {
+      return std::min(mul_div255(d, sa) + mul_div255(s, ida), 255u);
+    }
+    else if constexpr (M == blend_mode::exclusive_or) {
+      return std::min(mul_div255(s, ida) + mul_div255(d, isa), 255u);
+    }
+    else {
+      return std::min(s + d, 255u);
+    }
+  }
+
+  // The blended result is interpolated with the destination by the coverage c.
+  template <blend_mode M>
+  static inline std::uint32_t blend_pixel_mode(
+      std::uint32_t dst, std::uint32_t src, std::uint32_t c, std::uint32_t alpha_shift) noexcept {
+    const std::uint32_t sa = (src >> alpha_shift) & 0xFF;
+    const std::uint32_t da = (dst >> alpha_shift) & 0xFF;
+    std::uint32_t r = 0;
+
+    for (std::uint32_t shift = 0; shift < 32; shift += 8) {
+      const std::uint32_t d = (dst >> shift) & 0xFF;
+      const std::uint32_t x = blend_channel<M>((src >> shift) & 0xFF, d, sa, da);
+      r |= std::min(mul_div255(x, c) + mul_div255(d, 255 - c), 255u) << shift;
+    }
+
+    return r;
+  }
+
+  template <blend_mode M>
+  static inline void scalar_blend_span_mode(std::uint32_t* dst, const std::uint32_t* src, const std::uint8_t* coverage,
+      std::size_t count, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      if (const std::uint32_t c = coverage ? coverage[i] : 255) {
+        dst[i] = blend_pixel_mode<M>(dst[i], src[i], c, alpha_shift);
+      }
+    }
+  }
+
+  static inline simd_level detect_simd_level() noexcept {
+#if NANO_GRAPHICS_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+      return simd_level::avx2;
+    }
+#endif
+
+#if NANO_GRAPHICS_SSE2
+    return simd_level::sse2;
+#else
+    return simd_level::scalar;
+#endif
+  }
+
+  static const simd_level k_max_simd_level = detect_simd_level();
+  static std::atomic<simd_level> s_simd_level = k_max_simd_level;
+
+  // The vector kernels work on 16 bits per channel so that scale_pixel's (c * f) >> 8
+  // is reproduced exactly. For premultiplied pixels s + scale(d, 256 - sa) never
+  // exceeds 255 per channel, so adding bytes matches the scalar word addition.
+#if NANO_GRAPHICS_SSE2
+  namespace sse2 {
+    static inline __m128i scale(__m128i x16, __m128i f16) noexcept {
+      return _mm_srli_epi16(_mm_mullo_epi16(x16, f16), 8);
+    }
+
+    /// Broadcasts the alpha channel (16-bit lane A) of each pixel.
+    template <int A>
+    static inline __m128i splat_alpha(__m128i x16) noexcept {
+      return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x16, _MM_SHUFFLE(A, A, A, A)), _MM_SHUFFLE(A, A, A, A));
+    }
+
+    template <int A>
+    static inline __m128i over(__m128i d, __m128i s) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i k256 = _mm_set1_epi16(256);
+      const __m128i flo = _mm_sub_epi16(k256, splat_alpha<A>(_mm_unpacklo_epi8(s, zero)));
+      const __m128i fhi = _mm_sub_epi16(k256, splat_alpha<A>(_mm_unpackhi_epi8(s, zero)));
+      const __m128i dlo = scale(_mm_unpacklo_epi8(d, zero), flo);
+      const __m128i dhi = scale(_mm_unpackhi_epi8(d, zero), fhi);
+      return _mm_add_epi8(s, _mm_packus_epi16(dlo, dhi));
+    }
+
+    static inline std::size_t fill_span(std::uint32_t* dst, std::size_t count, std::uint32_t px) noexcept {
+      const __m128i v = _mm_set1_epi32(static_cast<int>(px));
+      std::size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+      }
+      return i;
+    }
+
+    static inline std::size_t blend_span(
+        std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t f) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i s = _mm_set1_epi32(static_cast<int>(px));
+      const __m128i f16 = _mm_set1_epi16(static_cast<short>(f));
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i dlo = scale(_mm_unpacklo_epi8(d, zero), f16);
+        const __m128i dhi = scale(_mm_unpackhi_epi8(d, zero), f16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi8(s, _mm_packus_epi16(dlo, dhi)));
+      }
+      return i;
+    }
+
+    template <int A>
+    static inline std::size_t blend_span_mask(
+        std::uint32_t* dst, const std::uint8_t* mask, std::size_t count, std::uint32_t px) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i pxv = _mm_set1_epi32(static_cast<int>(px));
+      const __m128i plo = _mm_unpacklo_epi8(pxv, zero);
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        std::int32_t m4;
+        std::memcpy(&m4, mask + i, sizeof(m4));
+        if (!m4) {
+          continue;
+        }
+
+        // Each coverage byte repeated over the 4 channels of its pixel.
+        __m128i m = _mm_cvtsi32_si128(m4);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m);
+
+        __m128i mlo = _mm_unpacklo_epi8(m, zero);
+        __m128i mhi = _mm_unpackhi_epi8(m, zero);
+        mlo = _mm_add_epi16(mlo, _mm_srli_epi16(mlo, 7));
+        mhi = _mm_add_epi16(mhi, _mm_srli_epi16(mhi, 7));
+
+        const __m128i s = _mm_packus_epi16(scale(plo, mlo), scale(plo, mhi));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), over<A>(d, s));
+      }
+      return i;
+    }
+
+    template <int A>
+    static inline std::size_t blend_span_pixels(
+        std::uint32_t* dst, const std::uint32_t* src, std::size_t count, std::uint32_t f) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i f16 = _mm_set1_epi16(static_cast<short>(f));
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if (f != 256) {
+          s = _mm_packus_epi16(scale(_mm_unpacklo_epi8(s, zero), f16), scale(_mm_unpackhi_epi8(s, zero), f16));
+        }
+
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), over<A>(d, s));
+      }
+      return i;
+    }
+
+    /// Rounded a * b / 255 of 16-bit lanes holding values in [0, 255].
+    static inline __m128i mul255(__m128i a, __m128i b) noexcept {
+      const __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+      return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    template <blend_mode M>
+    static inline __m128i blend_lanes(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+      const __m128i k255 = _mm_set1_epi16(255);
+      const __m128i isa = _mm_sub_epi16(k255, sa);
+      const __m128i ida = _mm_sub_epi16(k255, da);
+
+      if constexpr (M == blend_mode::normal) {
+        return _mm_min_epi16(_mm_add_epi16(s, mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::multiply) {
+        return _mm_min_epi16(_mm_add_epi16(_mm_add_epi16(mul255(s, d), mul255(s, ida)), mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::screen) {
+        return _mm_min_epi16(_mm_sub_epi16(_mm_add_epi16(s, d), mul255(s, d)), k255);
+      }
+      else if constexpr (M == blend_mode::overlay) {
+        const __m128i lo = _mm_slli_epi16(mul255(s, d), 1);
+        const __m128i hi = _mm_subs_epu16(
+            mul255(sa, da), _mm_slli_epi16(mul255(_mm_subs_epu16(da, d), _mm_subs_epu16(sa, s)), 1));
+        const __m128i use_hi = _mm_cmpgt_epi16(_mm_slli_epi16(d, 1), da);
+        const __m128i x = _mm_or_si128(_mm_and_si128(use_hi, hi), _mm_andnot_si128(use_hi, lo));
+        return _mm_min_epi16(_mm_add_epi16(_mm_add_epi16(x, mul255(s, ida)), mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::clear) {
+        return _mm_setzero_si128();
+      }
+      else if constexpr (M == blend_mode::copy) {
+        return s;
+      }
+      else if constexpr (M == blend_mode::source_in) {
+        return mul255(s, da);
+      }
+      else if constexpr (M == blend_mode::source_out) {
+        return mul255(s, ida);
+      }
+      else if constexpr (M == blend_mode::source_atop) {
+        return _mm_min_epi16(_mm_add_epi16(mul255(s, da), mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::destination_over) {
+        return _mm_min_epi16(_mm_add_epi16(mul255(s, ida), d), k255);
+      }
+      else if constexpr (M == blend_mode::destination_in) {
+        return mul255(d, sa);
+      }
+      else if constexpr (M == blend_mode::destination_out) {
+        return mul255(d, isa);
+      }
+      else if constexpr (M == blend_mode::destination_atop) {
+        return _mm_min_epi16(_mm_add_epi16(mul255(d, sa), mul255(s, ida)), k255);
+      }
+      else if constexpr (M == blend_mode::exclusive_or) {
+        return _mm_min_epi16(_mm_add_epi16(mul255(s, ida), mul255(d, isa)), k255);
+      }
+      else {
+        return _mm_min_epi16(_mm_add_epi16(s, d), k255);
+      }
+    }
+
+    /// Two pixels of 16-bit lanes blended and interpolated with the destination by the coverage c.
+    template <blend_mode M, int A>
+    static inline __m128i blend_mode_lanes(__m128i s, __m128i d, __m128i c) noexcept {
+      const __m128i k255 = _mm_set1_epi16(255);
+      const __m128i x = blend_lanes<M>(s, d, splat_alpha<A>(s), splat_alpha<A>(d));
+      return _mm_min_epi16(_mm_add_epi16(mul255(x, c), mul255(d, _mm_sub_epi16(k255, c))), k255);
+    }
+
+    template <blend_mode M, int A>
+    static inline std::size_t blend_span_mode(
+        std::uint32_t* dst, const std::uint32_t* src, const std::uint8_t* coverage, std::size_t count) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i k255 = _mm_set1_epi16(255);
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        __m128i clo = k255;
+        __m128i chi = k255;
+
+        if (coverage) {
+          std::int32_t m4;
+          std::memcpy(&m4, coverage + i, sizeof(m4));
+          if (!m4) {
+            continue;
+          }
+
+          __m128i m = _mm_cvtsi32_si128(m4);
+          m = _mm_unpacklo_epi8(m, m);
+          m = _mm_unpacklo_epi16(m, m);
+          clo = _mm_unpacklo_epi8(m, zero);
+          chi = _mm_unpackhi_epi8(m, zero);
+        }
+
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i lo = blend_mode_lanes<M, A>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), clo);
+        const __m128i hi = blend_mode_lanes<M, A>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), chi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+      }
+      return i;
+    }
+  } // namespace sse2.
+#endif // NANO_GRAPHICS_SSE2
+
+#if NANO_GRAPHICS_AVX2
+  namespace avx2 {
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i scale(__m256i x16, __m256i f16) noexcept {
+      return _mm256_srli_epi16(_mm256_mullo_epi16(x16, f16), 8);
+    }
+
+    template <int A>
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i splat_alpha(__m256i x16) noexcept {
+      return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x16, _MM_SHUFFLE(A, A, A, A)), _MM_SHUFFLE(A, A, A, A));
+    }
+
+    template <int A>
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i over(__m256i d, __m256i s) noexcept {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i k256 = _mm256_set1_epi16(256);
+      const __m256i flo = _mm256_sub_epi16(k256, splat_alpha<A>(_mm256_unpacklo_epi8(s, zero)));
+      const __m256i fhi = _mm256_sub_epi16(k256, splat_alpha<A>(_mm256_unpackhi_epi8(s, zero)));
+      const __m256i dlo = scale(_mm256_unpacklo_epi8(d, zero), flo);
+      const __m256i dhi = scale(_mm256_unpackhi_epi8(d, zero), fhi);
+      return _mm256_add_epi8(s, _mm256_packus_epi16(dlo, dhi));
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t fill_span(
+        std::uint32_t* dst, std::size_t count, std::uint32_t px) noexcept {
+      const __m256i v = _mm256_set1_epi32(static_cast<int>(px));
+      std::size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+      }
+      return i;
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t blend_span(
+        std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t f) noexcept {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i s = _mm256_set1_epi32(static_cast<int>(px));
+      const __m256i f16 = _mm256_set1_epi16(static_cast<short>(f));
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        const __m256i dlo = scale(_mm256_unpacklo_epi8(d, zero), f16);
+        const __m256i dhi = scale(_mm256_unpackhi_epi8(d, zero), f16);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi8(s, _mm256_packus_epi16(dlo, dhi)));
+      }
+      return i;
+    }
+
+    template <int A>
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t blend_span_mask(
+        std::uint32_t* dst, const std::uint8_t* mask, std::size_t count, std::uint32_t px) noexcept {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i pxv = _mm256_set1_epi32(static_cast<int>(px));
+      const __m256i plo = _mm256_unpacklo_epi8(pxv, zero);
+      const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12, //
+          0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        std::int64_t m8;
+        std::memcpy(&m8, mask + i, sizeof(m8));
+        if (!m8) {
+          continue;
+        }
+
+        // Each coverage byte repeated over the 4 channels of its pixel.
+        const __m128i m8v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask + i));
+        const __m256i m = _mm256_shuffle_epi8(_mm256_cvtepu8_epi32(m8v), spread);
+        __m256i mlo = _mm256_unpacklo_epi8(m, zero);
+        __m256i mhi = _mm256_unpackhi_epi8(m, zero);
+        mlo = _mm256_add_epi16(mlo, _mm256_srli_epi16(mlo, 7));
+        mhi = _mm256_add_epi16(mhi, _mm256_srli_epi16(mhi, 7));
+
+        const __m256i s = _mm256_packus_epi16(scale(plo, mlo), scale(plo, mhi));
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), over<A>(d, s));
+      }
+      return i;
+    }
+
+    template <int A>
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t blend_span_pixels(
+        std::uint32_t* dst, const std::uint32_t* src, std::size_t count, std::uint32_t f) noexcept {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i f16 = _mm256_set1_epi16(static_cast<short>(f));
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        if (f != 256) {
+          s = _mm256_packus_epi16(
+              scale(_mm256_unpacklo_epi8(s, zero), f16), scale(_mm256_unpackhi_epi8(s, zero), f16));
+        }
+
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), over<A>(d, s));
+      }
+      return i;
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i mul255(__m256i a, __m256i b) noexcept {
+      const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+      return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    template <blend_mode M>
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i blend_lanes(
+        __m256i s, __m256i d, __m256i sa, __m256i da) noexcept {
+      const __m256i k255 = _mm256_set1_epi16(255);
+      const __m256i isa = _mm256_sub_epi16(k255, sa);
+      const __m256i ida = _mm256_sub_epi16(k255, da);
+
+      if constexpr (M == blend_mode::normal) {
+        return _mm256_min_epi16(_mm256_add_epi16(s, mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::multiply) {
+        return _mm256_min_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(mul255(s, d), mul255(s, ida)), mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::screen) {
+        return _mm256_min_epi16(_mm256_sub_epi16(_mm256_add_epi16(s, d), mul255(s, d)), k255);
+      }
+      else if constexpr (M == blend_mode::overlay) {
+        const __m256i lo = _mm256_slli_epi16(mul255(s, d), 1);
+        const __m256i hi = _mm256_subs_epu16(
+            mul255(sa, da), _mm256_slli_epi16(mul255(_mm256_subs_epu16(da, d), _mm256_subs_epu16(sa, s)), 1));
+        const __m256i use_hi = _mm256_cmpgt_epi16(_mm256_slli_epi16(d, 1), da);
+        const __m256i x = _mm256_blendv_epi8(lo, hi, use_hi);
+        return _mm256_min_epi16(_mm256_add_epi16(_mm256_add_epi16(x, mul255(s, ida)), mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::clear) {
+        return _mm256_setzero_si256();
+      }
+      else if constexpr (M == blend_mode::copy) {
+        return s;
+      }
+      else if constexpr (M == blend_mode::source_in) {
+        return mul255(s, da);
+      }
+      else if constexpr (M == blend_mode::source_out) {
+        return mul255(s, ida);
+      }
+      else if constexpr (M == blend_mode::source_atop) {
+        return _mm256_min_epi16(_mm256_add_epi16(mul255(s, da), mul255(d, isa)), k255);
+      }
+      else if constexpr (M == blend_mode::destination_over) {
+        return _mm256_min_epi16(_mm256_add_epi16(mul255(s, ida), d), k255);
+      }
+      else if constexpr (M == blend_mode::destination_in) {
+        return mul255(d, sa);
+      }
+      else if constexpr (M == blend_mode::destination_out) {
+        return mul255(d, isa);
+      }
+      else if constexpr (M == blend_mode::destination_atop) {
+        return _mm256_min_epi16(_mm256_add_epi16(mul255(d, sa), mul255(s, ida)), k255);
+      }
+      else if constexpr (M == blend_mode::exclusive_or) {
+        return _mm256_min_epi16(_mm256_add_epi16(mul255(s, ida), mul255(d, isa)), k255);
+      }
+      else {
+        return _mm256_min_epi16(_mm256_add_epi16(s, d), k255);
+      }
+    }
+
+    template <blend_mode M, int A>
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i blend_mode_lanes(__m256i s, __m256i d, __m256i c) noexcept {
+      const __m256i k255 = _mm256_set1_epi16(255);
+      const __m256i x = blend_lanes<M>(s, d, splat_alpha<A>(s), splat_alpha<A>(d));
+      return _mm256_min_epi16(_mm256_add_epi16(mul255(x, c), mul255(d, _mm256_sub_epi16(k255, c))), k255);
+    }
+
+    template <blend_mode M, int A>
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t blend_span_mode(
+        std::uint32_t* dst, const std::uint32_t* src, const std::uint8_t* coverage, std::size_t count) noexcept {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i k255 = _mm256_set1_epi16(255);
+      const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12, //
+          0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        __m256i clo = k255;
+        __m256i chi = k255;
+
+        if (coverage) {
+          std::int64_t m8;
+          std::memcpy(&m8, coverage + i, sizeof(m8));
+          if (!m8) {
+            continue;
+          }
+
+          const __m128i m8v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i));
+          const __m256i m = _mm256_shuffle_epi8(_mm256_cvtepu8_epi32(m8v), spread);
+          clo = _mm256_unpacklo_epi8(m, zero);
+          chi = _mm256_unpackhi_epi8(m, zero);
+        }
+
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        const __m256i lo = blend_mode_lanes<M, A>(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), clo);
+        const __m256i hi = blend_mode_lanes<M, A>(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), chi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+      }
+      return i;
+    }
+  } // namespace avx2.
+#endif // NANO_GRAPHICS_AVX2
+
+  // Runs the widest kernel available for the alpha position and returns the number of processed pixels.
+  template <typename Kernel>
+  static inline std::size_t dispatch_alpha(std::uint32_t alpha_shift, Kernel&& k) noexcept {
+    switch (alpha_shift) {
+    case 0:
+      return k(std::integral_constant<int, 0>());
+    case 8:
+      return k(std::integral_constant<int, 1>());
+    case 16:
+      return k(std::integral_constant<int, 2>());
+    case 24:
+      return k(std::integral_constant<int, 3>());
+    default:
+      return 0;
+    }
+  }
+
+  // Calls k with the blend mode as a compile time constant.
+  template <typename Kernel>
+  static inline void dispatch_blend_mode(blend_mode mode, Kernel&& k) noexcept {
+    using bm = blend_mode;
+
+    switch (mode) {
+    case bm::normal:
+      return k(std::integral_constant<bm, bm::normal>());
+    case bm::multiply:
+      return k(std::integral_constant<bm, bm::multiply>());
+    case bm::screen:
+      return k(std::integral_constant<bm, bm::screen>());
+    case bm::overlay:
+      return k(std::integral_constant<bm, bm::overlay>());
+    case bm::clear:
+      return k(std::integral_constant<bm, bm::clear>());
+    case bm::copy:
+      return k(std::integral_constant<bm, bm::copy>());
+    case bm::source_in:
+      return k(std::integral_constant<bm, bm::source_in>());
+    case bm::source_out:
+      return k(std::integral_constant<bm, bm::source_out>());
+    case bm::source_atop:
+      return k(std::integral_constant<bm, bm::source_atop>());
+    case bm::destination_over:
+      return k(std::integral_constant<bm, bm::destination_over>());
+    case bm::destination_in:
+      return k(std::integral_constant<bm, bm::destination_in>());
+    case bm::destination_out:
+      return k(std::integral_constant<bm, bm::destination_out>());
+    case bm::destination_atop:
+      return k(std::integral_constant<bm, bm::destination_atop>());
+    case bm::exclusive_or:
+      return k(std::integral_constant<bm, bm::exclusive_or>());
+    case bm::plus_lighter:
+      return k(std::integral_constant<bm, bm::plus_lighter>());
+    }
+  }
+} // namespace.
+
+simd_level get_max_simd_level() noexcept { return k_max_simd_level; }
+
+simd_level get_simd_level() noexcept { return s_simd_level.load(std::memory_order_relaxed); }
+
+void set_simd_level(simd_level level) noexcept {
+  s_simd_level.store(std::min(level, k_max_simd_level), std::memory_order_relaxed);
+}
+
+void fill_span(std::uint32_t* dst, std::size_t count, std::uint32_t px) noexcept {
+  std::size_t done = 0;
+
+  switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+  case simd_level::avx2:
+    done = avx2::fill_span(dst, count, px);
+    break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+  case simd_level::sse2:
+    done = sse2::fill_span(dst, count, px);
+    break;
+#endif
+
+  default:
+    break;
+  }
+
+  std::fill_n(dst + done, count - done, px);
+}
+
+void blend_span(std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t alpha) noexcept {
+  const std::uint32_t f = 256 - alpha;
+  std::size_t done = 0;
+
+  switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+  case simd_level::avx2:
+    done = avx2::blend_span(dst, count, px, f);
+    break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+  case simd_level::sse2:
+    done = sse2::blend_span(dst, count, px, f);
+    break;
+#endif
+
+  default:
+    break;
+  }
+
+  scalar_blend_span(dst + done, count - done, px, f);
+}
+
+void blend_span_mask(std::uint32_t* dst, const std::uint8_t* mask, std::size_t count, std::uint32_t px,
+    std::uint32_t alpha_shift) noexcept {
+  std::size_t done = 0;
+
+  switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+  case simd_level::avx2:
+    done = dispatch_alpha(alpha_shift, [&](auto a) { //
+      return avx2::blend_span_mask<decltype(a)::value>(dst, mask, count, px);
+    });
+    break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+  case simd_level::sse2:
+    done = dispatch_alpha(alpha_shift, [&](auto a) { //
+      return sse2::blend_span_mask<decltype(a)::value>(dst, mask, count, px);
+    });
+    break;
+#endif
+
+  default:
+    break;
+  }
+
+  scalar_blend_span_mask(dst + done, mask + done, count - done, px, alpha_shift);
+}
+
+void blend_span_pixels(std::uint32_t* dst, const std::uint32_t* src, std::size_t count, std::uint32_t f,
+    std::uint32_t alpha_shift) noexcept {
+  std::size_t done = 0;
+
+  switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+  case simd_level::avx2:
+    done = dispatch_alpha(alpha_shift, [&](auto a) { //
+      return avx2::blend_span_pixels<decltype(a)::value>(dst, src, count, f);
+    });
+    break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+  case simd_level::sse2:
+    done = dispatch_alpha(alpha_shift, [&](auto a) { //
+      return sse2::blend_span_pixels<decltype(a)::value>(dst, src, count, f);
+    });
+    break;
+#endif
+
+  default:
+    break;
+  }
+
+  scalar_blend_span_pixels(dst + done, src + done, count - done, f, alpha_shift);
+}
+
+void paint_span(std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t coverage,
+    std::uint32_t alpha_shift) noexcept {
+  if (!coverage || !count) {
+    return;
+  }
+
+  if (coverage != 255) {
+    px = scale_pixel(px, alpha_to_scale(coverage));
+  }
+
+  const std::uint32_t alpha = (px >> alpha_shift) & 0xFF;
+  if (alpha == 255) {
+    fill_span(dst, count, px);
+  }
+  else if (alpha) {
+    blend_span(dst, count, px, alpha);
+  }
+}
+
+void blend_span_mode(blend_mode mode, std::uint32_t* dst, const std::uint32_t* src, const std::uint8_t* coverage,
+    std::size_t count, std::uint32_t alpha_shift) noexcept {
+  dispatch_blend_mode(mode, [&](auto m) {
+    constexpr blend_mode M = decltype(m)::value;
+    std::size_t done = 0;
+
+    switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+    case simd_level::avx2:
+      done = dispatch_alpha(alpha_shift, [&](auto a) { //
+        return avx2::blend_span_mode<M, decltype(a)::value>(dst, src, coverage, count);
+      });
+      break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+    case simd_level::sse2:
+      done = dispatch_alpha(alpha_shift, [&](auto a) { //
+        return sse2::blend_span_mode<M, decltype(a)::value>(dst, src, coverage, count);
+      });
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+    scalar_blend_span_mode<M>(dst + done, src + done, coverage ? coverage + done : nullptr, count - done, alpha_shift);
+  });
+}
+
+//
+// MARK: - rect -
+//
+
+namespace {
+  static inline std::uint32_t to_coverage(float c) noexcept {
+    return static_cast<std::uint32_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+  }
+
+  /// Pixels gathered on the stack by the masked paths.
+  constexpr std::size_t k_mask_chunk = 256;
+
+  static inline void apply_mask(std::uint8_t* coverage, const std::uint8_t* mask, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      coverage[i] = static_cast<std::uint8_t>(mul_div255(coverage[i], mask[i]));
+    }
+  }
+
+  static inline void apply_mask(std::uint32_t* px, const std::uint8_t* mask, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      px[i] = scale_pixel(px[i], alpha_to_scale(mask[i]));
+    }
+  }
+
+  // A constant pixel through blend_span_mode, coverage can't be null.
+  static inline void paint_span_mode(blend_mode mode, std::uint32_t* dst, std::uint32_t px,
+      const std::uint8_t* coverage, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    std::uint32_t src[k_mask_chunk];
+    std::fill_n(src, std::min(count, k_mask_chunk), px);
+
+    for (std::size_t i = 0; i < count; i += k_mask_chunk) {
+      blend_span_mode(mode, dst + i, src, coverage + i, std::min(k_mask_chunk, count - i), alpha_shift);
+    }
+  }
+} // namespace.
+
+void fill_rect(surface& s, const irect& clip, float x0, float y0, float x1, float y1, std::uint32_t px,
+    const clip_mask* mask, blend_mode mode) noexcept {
+  x0 = std::max(x0, static_cast<float>(clip.x0));
+  y0 = std::max(y0, static_cast<float>(clip.y0));
+  x1 = std::min(x1, static_cast<float>(clip.x1));
+  y1 = std::min(y1, static_cast<float>(clip.y1));
+
+  if (!(x0 < x1 && y0 < y1)) {
+    return;
+  }
+
+  const int ix0 = static_cast<int>(std::floor(x0));
+  const int iy0 = static_cast<int>(std::floor(y0));
+  const int ix1 = static_cast<int>(std::ceil(x1));
+  const int iy1 = static_cast<int>(std::ceil(y1));
+  const std::uint32_t shift = s.layout.a;
+
+  // Masked or blended: the coverage of every pixel is gathered and modulated by the mask.
+  if (mask || mode != blend_mode::normal) {
+    std::uint8_t coverage[k_mask_chunk];
+
+    for (int y = iy0; y < iy1; y++) {
+      const float cy = std::min(static_cast<float>(y + 1), y1) - std::max(static_cast<float>(y), y0);
+
+      for (int x = ix0; x < ix1; x += static_cast<int>(k_mask_chunk)) {
+        const std::size_t count = std::min(k_mask_chunk, static_cast<std::size_t>(ix1 - x));
+
+        for (std::size_t i = 0; i < count; i++) {
+          const float fx = static_cast<float>(x) + static_cast<float>(i);
+          coverage[i] = static_cast<std::uint8_t>(to_coverage((std::min(fx + 1.0f, x1) - std::max(fx, x0)) * cy));
+        }
+
+        if (mask) {
+          apply_mask(coverage, mask->span(x, y), count);
+        }
+
+        if (mode == blend_mode::normal) {
+          blend_span_mask(s.at(x, y), coverage, count, px, shift);
+        }
+        else {
+          paint_span_mode(mode, s.at(x, y), px, coverage, count, shift);
+        }
+      }
+    }
+    return;
+  }
+
+  // Pixel aligned: every pixel is fully covered, the rows go straight to the span kernels.
+  if (x0 == static_cast<float>(ix0) && y0 == static_cast<float>(iy0) && x1 == static_cast<float>(ix1)
+      && y1 == static_cast<float>(iy1)) {
+    const std::uint32_t alpha = (px >> shift) & 0xFF;
+    const std::size_t count = static_cast<std::size_t>(ix1 - ix0);
+
+    for (int y = iy0; alpha && y < iy1; y++) {
+      if (alpha == 255) {
+        fill_span(s.at(ix0, y), count, px);
+      }
+      else {
+        blend_span(s.at(ix0, y), count, px, alpha);
+      }
+    }
+    return;
+  }
+
+  // Single column: the whole row is one partially covered pixel.
+  if (ix1 - ix0 == 1) {
+    for (int y = iy0; y < iy1; y++) {
+      const float cy = std::min(static_cast<float>(y + 1), y1) - std::max(static_cast<float>(y), y0);
+      paint_span(s.at(ix0, y), 1, px, to_coverage((x1 - x0) * cy), shift);
+    }
+    return;
+  }
+
+  const float cl = static_cast<float>(ix0 + 1) - x0;
+  const float cr = x1 - static_cast<float>(ix1 - 1);
+  const std::size_t inner = static_cast<std::size_t>(ix1 - ix0 - 2);
+
+  for (int y = iy0; y < iy1; y++) {
+    const float cy = std::min(static_cast<float>(y + 1), y1) - std::max(static_cast<float>(y), y0);
+    std::uint32_t* row = s.at(ix0, y);
+    paint_span(row, 1, px, to_coverage(cl * cy), shift);
+    paint_span(row + 1, inner, px, to_coverage(cy), shift);
+    paint_span(row + 1 + inner, 1, px, to_coverage(cr * cy), shift);
+  }
+}
+
+//
+// MARK: - rasterizer -
+//
+
+namespace {
+  constexpr float k_pi = 3.14159265358979323846f;
+
+  /// Maximum distance in pixels between a flattened arc and the real curve.
+  constexpr float k_flatten_tolerance = 0.1f;
+
+  static inline int get_arc_segments(float radius, float sweep) noexcept {
+    if (radius <= k_flatten_tolerance) {
+      return 2;
+    }
+
+    const float step = 2.0f * std::acos(1.0f - k_flatten_tolerance / radius);
+    return std::clamp(static_cast<int>(std::ceil(std::abs(sweep) / step)), 2, 1024);
+  }
+} // namespace.
+
+void rasterizer::reset() noexcept {
+  m_edges.clear();
+  m_min_x = m_min_y = std::numeric_limits<float>::max();
+  m_max_x = m_max_y = std::numeric_limits<float>::lowest();
+  m_start_x = m_start_y = m_last_x = m_last_y = 0;
+}
+
+void rasterizer::move_to(float x, float y) {
+  close();
+  m_start_x = m_last_x = x;
+  m_start_y = m_last_y = y;
+}
+
+void rasterizer::line_to(float x, float y) {
+  if (y != m_last_y) {
+    edge e = m_last_y < y ? edge{ m_last_x, m_last_y, x, y, 1 } : edge{ x, y, m_last_x, m_last_y, -1 };
+    m_edges.push_back(e);
+
+    m_min_x = std::min({ m_min_x, x, m_last_x });
+    m_max_x = std::max({ m_max_x, x, m_last_x });
+    m_min_y = std::min(m_min_y, e.y0);
+    m_max_y = std::max(m_max_y, e.y1);
+  }
+
+  m_last_x = x;
+  m_last_y = y;
+}
+
+void rasterizer::close() {
+  if (m_last_x != m_start_x || m_last_y != m_start_y) {
+    line_to(m_start_x, m_start_y);
+  }
+}
+
+void rasterizer::prepare() {
+  close();
+  std::sort(m_edges.begin(), m_edges.end(), [](const edge& a, const edge& b) { return a.y0 < b.y0; });
+}
+
+irect rasterizer::get_bounds() const noexcept {
+  if (m_edges.empty()) {
+    return { 0, 0, 0, 0 };
+  }
+
+  return { static_cast<int>(std::floor(m_min_x)), static_cast<int>(std::floor(m_min_y)),
+    static_cast<int>(std::ceil(m_max_x)), static_cast<int>(std::ceil(m_max_y)) };
+}
+
+void rasterizer::fill(
+    surface& s, const irect& clip, fill_rule rule, std::uint32_t px, const clip_mask* mask, blend_mode mode) {
+  prepare();
+  sweep(s, clip, rule, px, m_edges.data(), m_edges.size(), get_bounds(), mask, mode);
+}
+
+template <class Fct>
+void rasterizer::sweep_rows(const edge* edges, std::size_t edge_count, const irect& bounds, Fct&& fct) {
+  m_active.clear();
+  std::size_t next_edge = 0;
+
+  for (int y = bounds.y0; y < bounds.y1; y++) {
+    const float y0 = static_cast<float>(y);
+    const float y1 = static_cast<float>(y + 1);
+
+    while (next_edge < edge_count && edges[next_edge].y0 < y1) {
+      m_active.push_back(next_edge++);
+    }
+
+    // Drop the finished edges while keeping the order, the cells are generated from the rest.
+    m_cells.clear();
+    std::size_t kept = 0;
+    for (std::size_t index : m_active) {
+      const edge& e = edges[index];
+      if (e.y1 <= y0) {
+        continue;
+      }
+
+      m_active[kept++] = index;
+      add_cells(e, y0, y1);
+    }
+    m_active.resize(kept);
+
+    if (m_cells.empty()) {
+      continue;
+    }
+
+    std::sort(m_cells.begin(), m_cells.end(),
+        [](const cell& a, const cell& b) { return a.x < b.x || (a.x == b.x && a.order < b.order); });
+
+    fct(y);
+  }
+}
+
+void rasterizer::sweep(surface& s, const irect& clip, fill_rule rule, std::uint32_t px, const edge* edges,
+    std::size_t edge_count, const irect& shape_bounds, const clip_mask* mask, blend_mode mode) {
+  const irect bounds = shape_bounds.intersect(clip);
+
+  if (!edge_count || bounds.empty()) {
+    return;
+  }
+
+  const std::uint32_t shift = s.layout.a;
+  sweep_rows(edges, edge_count, bounds, [&](int y) {
+    emit_row(
+        s.at(bounds.x0, y), bounds.x0, bounds.x1, rule, px, shift, mask ? mask->span(bounds.x0, y) : nullptr, mode);
+  });
+}
+
+void rasterizer::intersect_mask(clip_mask& mask, fill_rule rule) {
+  prepare();
+  const irect bounds = get_bounds().intersect(mask.bounds);
+
+  if (m_edges.empty() || bounds.empty()) {
+    std::fill(mask.coverage.begin(), mask.coverage.end(), std::uint8_t(0));
+    return;
+  }
+
+  // The coverage of the shape over the mask, zero wherever no span is emitted.
+  std::vector<std::uint8_t> shape(mask.coverage.size(), 0);
+  sweep_rows(m_edges.data(), m_edges.size(), bounds, [&](int y) {
+    std::uint8_t* row = shape.data() + static_cast<std::size_t>(y - mask.bounds.y0) * mask.width;
+    for_each_span(bounds.x0, bounds.x1, rule, [&](int a, int b, std::uint32_t coverage) {
+      std::fill(row + (a - mask.bounds.x0), row + (b - mask.bounds.x0), static_cast<std::uint8_t>(coverage));
+    });
+  });
+
+  apply_mask(mask.coverage.data(), shape.data(), shape.size());
+}
+
+void rasterizer::add_cells(const edge& e, float y0, float y1) {
+  const float ya = std::max(y0, e.y0);
+  const float yb = std::min(y1, e.y1);
+
+  if (!(ya < yb)) {
+    return;
+  }
+
+  const float slope = (e.x1 - e.x0) / (e.y1 - e.y0);
+  const float xa = e.x0 + (ya - e.y0) * slope;
+  const float xb = e.x0 + (yb - e.y0) * slope;
+  const float d = (yb - ya) * static_cast<float>(e.dir);
+
+  auto push = [this](int x, float cover) {
+    if (cover != 0.0f) {
+      m_cells.push_back({ x, static_cast<std::uint32_t>(m_cells.size()), cover });
+    }
+  };
+
+  const float x0 = std::min(xa, xb);
+  const float x1 = std::max(xa, xb);
+  const float x0_floor = std::floor(x0);
+  const float x1_ceil = std::ceil(x1);
+  const int ix0 = static_cast<int>(x0_floor);
+  const int ix1 = static_cast<int>(x1_ceil);
+
+  // Within a single column the covered area is a trapezoid split by its mid point.
+  if (ix1 <= ix0 + 1) {
+    const float mid = 0.5f * (xa + xb) - x0_floor;
+    push(ix0, d - d * mid);
+    push(ix0 + 1, d * mid);
+    return;
+  }
+
+  // Across several columns: a triangle in the first one, a constant slope in the
+  // middle ones and the remaining area in the last one.
+  const float inv = 1.0f / (x1 - x0);
+  const float f0 = x0 - x0_floor;
+  const float a0 = 0.5f * inv * (1.0f - f0) * (1.0f - f0);
+  const float f1 = x1 - x1_ceil + 1.0f;
+  const float am = 0.5f * inv * f1 * f1;
+
+  push(ix0, d * a0);
+
+  if (ix1 == ix0 + 2) {
+    push(ix0 + 1, d * (1.0f - a0 - am));
+  }
+  else {
+    const float a1 = inv * (1.5f - f0);
+    push(ix0 + 1, d * (a1 - a0));
+
+    for (int x = ix0 + 2; x < ix1 - 1; x++) {
+      push(x, d * inv);
+    }
+
+    const float a2 = a1 + static_cast<float>(ix1 - ix0 - 3) * inv;
+    push(ix1 - 1, d * (1.0f - a2 - am));
+  }
+
+  push(ix1, d * am);
+}
+
+template <class Fct>
+void rasterizer::for_each_span(int x0, int x1, fill_rule rule, Fct&& fct) {
+  float acc = 0;
+  const std::size_t count = m_cells.size();
+
+  // Every cell has been accumulated from the left edge of the shape, even outside of
+  // [x0, x1), so the coverage of a pixel doesn't depend on the clip.
+  for (std::size_t i = 0; i < count;) {
+    const int x = m_cells[i].x;
+    while (i < count && m_cells[i].x == x) {
+      acc += m_cells[i++].cover;
+    }
+
+    const int a = std::max(x, x0);
+    const int b = std::min(i < count ? m_cells[i].x : x + 1, x1);
+    if (a >= b) {
+      continue;
+    }
+
+    float c = std::abs(acc);
+    if (rule == fill_rule::even_odd) {
+      c -= 2.0f * std::floor(c * 0.5f);
+      c = c > 1.0f ? 2.0f - c : c;
+    }
+
+    fct(a, b, to_coverage(c));
+  }
+}
+
+void rasterizer::emit_row(std::uint32_t* row, int x0, int x1, fill_rule rule, std::uint32_t px,
+    std::uint32_t alpha_shift, const std::uint8_t* mask, blend_mode mode) {
+  // Short runs are gathered in a coverage mask, long ones are painted as constant spans.
+  // With a clip mask or a blend mode every run is gathered so that it goes through the same kernel.
+  constexpr int k_min_span = 8;
+
+  int mask_x = 0;
+  m_coverage.clear();
+
+  auto flush_mask = [&]() {
+    if (!m_coverage.empty()) {
+      if (mask) {
+        apply_mask(m_coverage.data(), mask + (mask_x - x0), m_coverage.size());
+      }
+
+      if (mode == blend_mode::normal) {
+        blend_span_mask(row + (mask_x - x0), m_coverage.data(), m_coverage.size(), px, alpha_shift);
+      }
+      else {
+        paint_span_mode(mode, row + (mask_x - x0), px, m_coverage.data(), m_coverage.size(), alpha_shift);
+      }
+
+      m_coverage.clear();
+    }
+  };
+
+  const bool gather = mask || mode != blend_mode::normal;
+
+  for_each_span(x0, x1, rule, [&](int a, int b, std::uint32_t coverage) {
+    if (!gather && b - a >= k_min_span) {
+      flush_mask();
+      paint_span(row + (a - x0), static_cast<std::size_t>(b - a), px, coverage, alpha_shift);
+      return;
+    }
+
+    if (!m_coverage.empty() && mask_x + static_cast<int>(m_coverage.size()) != a) {
+      flush_mask();
+    }
+
+    if (m_coverage.empty()) {
+      mask_x = a;
+    }
+
+    m_coverage.insert(m_coverage.end(), static_cast<std::size_t>(b - a), static_cast<std::uint8_t>(coverage));
+  });
+
+  flush_mask();
+}
+
+void rasterizer::add_rect(float x0, float y0, float x1, float y1, bool reversed) {
+  move_to(x0, y0);
+
+  if (reversed) {
+    line_to(x0, y1);
+    line_to(x1, y1);
+    line_to(x1, y0);
+  }
+  else {
+    line_to(x1, y0);
+    line_to(x1, y1);
+    line_to(x0, y1);
+  }
+
+  close();
+}
+
+void rasterizer::add_ellipse(float cx, float cy, float rx, float ry, bool reversed) {
+  if (rx <= 0 || ry <= 0) {
+    return;
+  }
+
+  const int n = std::max(get_arc_segments(std::max(rx, ry), 2.0f * k_pi), 8);
+  const float step = (reversed ? -2.0f : 2.0f) * k_pi / static_cast<float>(n);
+  const float c = std::cos(step);
+  const float s = std::sin(step);
+
+  // Rotate a unit vector instead of calling cos and sin for every vertex.
+  float ux = 1.0f;
+  float uy = 0.0f;
+  move_to(cx + rx, cy);
+
+  for (int i = 1; i < n; i++) {
+    const float nx = ux * c - uy * s;
+    uy = ux * s + uy * c;
+    ux = nx;
+    line_to(cx + rx * ux, cy + ry * uy);
+  }
+
+  close();
+}
+
+namespace {
+  template <typename LineTo>
+  static inline void add_arc(LineTo&& line_to, float cx, float cy, float r, float a0, float sweep) {
+    const int n = get_arc_segments(r, sweep);
+    for (int i = 0; i <= n; i++) {
+      const float a = a0 + sweep * static_cast<float>(i) / static_cast<float>(n);
+      line_to(cx + r * std::cos(a), cy + r * std::sin(a));
+    }
+  }
+} // namespace.
+
+void rasterizer::add_rounded_rect(float x0, float y0, float x1, float y1, float radius, bool reversed) {
+  const float r = std::min({ radius, (x1 - x0) * 0.5f, (y1 - y0) * 0.5f });
+
+  if (r <= 0) {
+    add_rect(x0, y0, x1, y1, reversed);
+    return;
+  }
+
+  auto lt = [this](float x, float y) { line_to(x, y); };
+  const float h = 0.5f * k_pi;
+  move_to(x1 - r, y0);
+
+  if (reversed) {
+    add_arc(lt, x0 + r, y0 + r, r, -h, -h);
+    add_arc(lt, x0 + r, y1 - r, r, -2 * h, -h);
+    add_arc(lt, x1 - r, y1 - r, r, h, -h);
+    add_arc(lt, x1 - r, y0 + r, r, 0, -h);
+  }
+  else {
+    add_arc(lt, x1 - r, y0 + r, r, -h, h);
+    add_arc(lt, x1 - r, y1 - r, r, 0, h);
+    add_arc(lt, x0 + r, y1 - r, r, h, h);
+    add_arc(lt, x0 + r, y0 + r, r, 2 * h, h);
+  }
+
+  close();
+}
+
+void rasterizer::add_line(float x0, float y0, float x1, float y1, float width, line_cap cap) {
+  const float hw = width * 0.5f;
+  const float dx = x1 - x0;
+  const float dy = y1 - y0;
+  const float len = std::sqrt(dx * dx + dy * dy);
+
+  if (len <= 0 || hw <= 0) {
+    if (hw > 0 && cap == line_cap::round) {
+      add_ellipse(x0, y0, hw, hw);
+    }
+    else if (hw > 0 && cap == line_cap::square) {
+      add_rect(x0 - hw, y0 - hw, x0 + hw, y0 + hw);
+    }
+    return;
+  }
+
+  const float ux = dx / len;
+  const float uy = dy / len;
+  const float nx = -uy * hw;
+  const float ny = ux * hw;
+
+  if (cap == line_cap::square) {
+    x0 -= ux * hw;
+    y0 -= uy * hw;
+    x1 += ux * hw;
+    y1 += uy * hw;
+  }
+
+  move_to(x0 + nx, y0 + ny);
+
+  if (cap == line_cap::round) {
+    auto lt = [this](float x, float y) { line_to(x, y); };
+    const float a = std::atan2(ny, nx);
+    line_to(x1 + nx, y1 + ny);
+    add_arc(lt, x1, y1, hw, a, -k_pi);
+    line_to(x0 - nx, y0 - ny);
+    add_arc(lt, x0, y0, hw, a - k_pi, -k_pi);
+  }
+  else {
+    line_to(x1 + nx, y1 + ny);
+    line_to(x1 - nx, y1 - ny);
+    line_to(x0 - nx, y0 - ny);
+  }
+
+  close();
+}
+
+//
+// MARK: - images -
+//
+
+namespace {
+  static inline std::uint32_t lerp_pixel(std::uint32_t a, std::uint32_t b, std::uint32_t t) noexcept {
+    return scale_pixel(a, 256 - t) + scale_pixel(b, t);
+  }
+} // namespace.
+
+void draw_bitmap(surface& s, const irect& clip, const bitmap& bmp, const nano::rect<float>& src,
+    const nano::rect<float>& dst, std::vector<std::uint32_t>& scratch, const clip_mask* mask, blend_mode mode) {
+
+  // Restrict the source to the bitmap.
+  const float sx0 = std::max(src.x, 0.0f);
+  const float sy0 = std::max(src.y, 0.0f);
+  const float sx1 = std::min(src.x + src.width, static_cast<float>(bmp.size.width));
+  const float sy1 = std::min(src.y + src.height, static_cast<float>(bmp.size.height));
+
+  if (!(sx0 < sx1 && sy0 < sy1) || !(dst.width > 0 && dst.height > 0)) {
+    return;
+  }
+
+  // Pixels whose center is inside the destination.
+  const irect area = irect{ static_cast<int>(std::ceil(dst.x - 0.5f)), static_cast<int>(std::ceil(dst.y - 0.5f)),
+    static_cast<int>(std::ceil(dst.x + dst.width - 0.5f)), static_cast<int>(std::ceil(dst.y + dst.height - 0.5f)) }
+                         .intersect(clip);
+
+  if (area.empty()) {
+    return;
+  }
+
+  const float scale_x = src.width / dst.width;
+  const float scale_y = src.height / dst.height;
+  const std::uint32_t shift = s.layout.a;
+
+  const bool is_unscaled = scale_x == 1.0f && scale_y == 1.0f && std::floor(src.x) == src.x
+      && std::floor(src.y) == src.y && std::floor(dst.x) == dst.x && std::floor(dst.y) == dst.y;
+
+  if (is_unscaled) {
+    // Keep the source coordinates inside [sx0, sx1) x [sy0, sy1).
+    const int ox = static_cast<int>(src.x - dst.x);
+    const int oy = static_cast<int>(src.y - dst.y);
+    const irect r = area.intersect({ static_cast<int>(sx0) - ox, static_cast<int>(sy0) - oy, static_cast<int>(sx1) - ox,
+        static_cast<int>(sy1) - oy });
+
+    if (r.empty()) {
+      return;
+    }
+
+    const std::size_t count = static_cast<std::size_t>(r.x1 - r.x0);
+    scratch.resize(count);
+
+    for (int y = r.y0; y < r.y1; y++) {
+      load_row(bmp, static_cast<std::size_t>(r.x0 + ox), static_cast<std::size_t>(y + oy), count, scratch.data(),
+          s.layout);
+
+      if (mode != blend_mode::normal) {
+        blend_span_mode(mode, s.at(r.x0, y), scratch.data(), mask ? mask->span(r.x0, y) : nullptr, count, shift);
+        continue;
+      }
+
+      if (mask) {
+        apply_mask(scratch.data(), mask->span(r.x0, y), count);
+      }
+
+      blend_span_pixels(s.at(r.x0, y), scratch.data(), count, 256, shift);
+    }
+    return;
+  }
+
+  // Bilinear sampling from two cached rows of converted pixels.
+  const int lo_x = static_cast<int>(sx0);
+  const int hi_x = static_cast<int>(std::ceil(sx1)) - 1;
+  const int lo_y = static_cast<int>(sy0);
+  const int hi_y = static_cast<int>(std::ceil(sy1)) - 1;
+  const std::size_t columns = static_cast<std::size_t>(hi_x - lo_x + 1);
+
+  // Blend modes go through a row of samples.
+  const bool blended = mode != blend_mode::normal;
+  const std::size_t width = static_cast<std::size_t>(area.x1 - area.x0);
+  scratch.resize(columns * 2 + (blended ? width : 0));
+  std::uint32_t* rows[2] = { scratch.data(), scratch.data() + columns };
+  std::uint32_t* samples = scratch.data() + columns * 2;
+  int cached[2] = { -1, -1 };
+
+  auto slot_of = [&](int y) { return cached[0] == y ? 0 : (cached[1] == y ? 1 : -1); };
+
+  // Makes sure both rows are converted without evicting one another.
+  auto fetch = [&](int ya, int yb, const std::uint32_t*& ra, const std::uint32_t*& rb) {
+    int sa = slot_of(ya);
+    if (sa < 0) {
+      sa = slot_of(yb) == 0 ? 1 : 0;
+      cached[sa] = ya;
+      load_row(bmp, static_cast<std::size_t>(lo_x), static_cast<std::size_t>(ya), columns, rows[sa], s.layout);
+    }
+
+    int sb = slot_of(yb);
+    if (sb < 0) {
+      sb = 1 - sa;
+      cached[sb] = yb;
+      load_row(bmp, static_cast<std::size_t>(lo_x), static_cast<std::size_t>(yb), columns, rows[sb], s.layout);
+    }
+
+    ra = rows[sa];
+    rb = rows[sb];
+  };
+
+  for (int y = area.y0; y < area.y1; y++) {
+    const float v = src.y + (static_cast<float>(y) + 0.5f - dst.y) * scale_y - 0.5f;
+    const float fv = std::floor(v);
+    const int ty = static_cast<int>(fv);
+    const std::uint32_t wy = static_cast<std::uint32_t>((v - fv) * 256.0f);
+    const std::uint32_t* top = nullptr;
+    const std::uint32_t* bottom = nullptr;
+    fetch(std::clamp(ty, lo_y, hi_y), std::clamp(ty + 1, lo_y, hi_y), top, bottom);
+
+    std::uint32_t* row = s.at(area.x0, y);
+    const std::uint8_t* coverage = mask ? mask->span(area.x0, y) : nullptr;
+
+    for (int x = area.x0; x < area.x1; x++) {
+      const float u = src.x + (static_cast<float>(x) + 0.5f - dst.x) * scale_x - 0.5f;
+      const float fu = std::floor(u);
+      const int tx = static_cast<int>(fu);
+      const std::uint32_t wx = static_cast<std::uint32_t>((u - fu) * 256.0f);
+      const int x0 = std::clamp(tx, lo_x, hi_x) - lo_x;
+      const int x1 = std::clamp(tx + 1, lo_x, hi_x) - lo_x;
+
+      std::uint32_t px = lerp_pixel(lerp_pixel(top[x0], top[x1], wx), lerp_pixel(bottom[x0], bottom[x1], wx), wy);
+      if (blended) {
+        samples[x - area.x0] = px;
+        continue;
+      }
+
+      if (coverage) {
+        px = scale_pixel(px, alpha_to_scale(coverage[x - area.x0]));
+      }
+
+      if (px) {
+        std::uint32_t& d = row[x - area.x0];
+        d = blend_pixel(d, px, (px >> shift) & 0xFF);
+      }
+    }
+
+    if (blended) {
+      blend_span_mode(mode, row, samples, coverage, width, shift);
+    }
+  }
+}
+
+void composite_surface(surface& dst, const irect& clip, const surface& src, float alpha, const clip_mask* mask,
+    blend_mode mode) noexcept {
+  const irect r = clip.intersect(dst.bounds()).intersect(src.bounds());
+  const std::uint32_t f = alpha_to_scale(to_coverage(alpha));
+
+  if (r.empty() || !f) {
+    return;
+  }
+
+  if (mask || mode != blend_mode::normal) {
+    std::uint32_t pixels[k_mask_chunk];
+
+    for (int y = r.y0; y < r.y1; y++) {
+      for (int x = r.x0; x < r.x1; x += static_cast<int>(k_mask_chunk)) {
+        const std::size_t count = std::min(k_mask_chunk, static_cast<std::size_t>(r.x1 - x));
+        std::memcpy(pixels, src.at(x, y), count * sizeof(std::uint32_t));
+
+        if (mode == blend_mode::normal) {
+          apply_mask(pixels, mask->span(x, y), count);
+          blend_span_pixels(dst.at(x, y), pixels, count, f, dst.layout.a);
+          continue;
+        }
+
+        for (std::size_t i = 0; f != 256 && i < count; i++) {
+          pixels[i] = scale_pixel(pixels[i], f);
+        }
+
+        blend_span_mode(mode, dst.at(x, y), pixels, mask ? mask->span(x, y) : nullptr, count, dst.layout.a);
+      }
+    }
+    return;
+  }
+
+  for (int y = r.y0; y < r.y1; y++) {
+    blend_span_pixels(dst.at(r.x0, y), src.at(r.x0, y), static_cast<std::size_t>(r.x1 - r.x0), f, dst.layout.a);
+  }
+}
+
+//
+// MARK: - thread pool -
+//
+
+thread_pool& thread_pool::shared() {
+  static thread_pool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+  return pool;
+}
+
+thread_pool::thread_pool(std::size_t worker_count) {
+  m_workers.reserve(worker_count);
+
+  for (std::size_t i = 0; i < worker_count; i++) {
+    m_workers.emplace_back([this]() { run(); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+
+  m_condition.notify_all();
+
+  for (std::thread& t : m_workers) {
+    t.join();
+  }
+}
+
+void thread_pool::push(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+
+  m_condition.notify_one();
+}
+
+void thread_pool::run() {
+  for (;;) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+      if (m_tasks.empty()) {
+        return;
+      }
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+namespace {
+  struct parallel_job {
+    std::atomic<std::size_t> next{ 0 };
+    std::atomic<std::size_t> done{ 0 };
+    std::size_t count = 0;
+    const std::function<void(std::size_t)>* fct = nullptr;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // Helpers that start once every index is taken leave without touching fct,
+    // which is why the caller only has to wait for the indices to be done.
+    void work() {
+      std::size_t finished = 0;
+      for (std::size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+        (*fct)(i);
+        finished++;
+      }
+
+      if (finished && done.fetch_add(finished) + finished == count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notify_all();
+      }
+    }
+  };
+} // namespace.
+
+void thread_pool::parallel_for(
+    std::size_t count, std::size_t max_threads, const std::function<void(std::size_t)>& fct) {
+  const std::size_t max_helpers = max_threads ? max_threads - 1 : m_workers.size();
+  const std::size_t helpers = count ? std::min({ max_helpers, m_workers.size(), count - 1 }) : 0;
+
+  if (!helpers) {
+    for (std::size_t i = 0; i < count; i++) {
+      fct(i);
+    }
+    return;
+  }
+
+  auto job = std::make_shared<parallel_job>();
+  job->count = count;
+  job->fct = &fct;
+
+  for (std::size_t i = 0; i < helpers; i++) {
+    push([job]() { job->work(); });
+  }
+
+  job->work();
+
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->condition.wait(lock, [&]() { return job->done.load() == count; });
+}
+
+//
+// MARK: - tile renderer -
+//
+
+tile_renderer::~tile_renderer() {
+  for (command& cmd : m_commands) {
+    bitmap::release(cmd.bmp);
+  }
+}
+
+void tile_renderer::push(command& cmd, const mask_ptr& mask) {
+  if (cmd.bounds.empty()) {
+    bitmap::release(cmd.bmp);
+    return;
+  }
+
+  // Consecutive commands usually share the same clip.
+  if (mask && (m_masks.empty() || m_masks.back() != mask)) {
+    m_masks.push_back(mask);
+  }
+
+  cmd.mask = mask.get();
+  m_commands.push_back(cmd);
+}
+
+void tile_renderer::fill_rect(surface& s, const irect& clip, const mask_ptr& mask, blend_mode mode, float x0, float y0,
+    float x1, float y1, std::uint32_t px) {
+  command cmd = {};
+  cmd.type = kind::fill_rect;
+  cmd.mode = mode;
+  cmd.target = &s;
+  cmd.clip = clip;
+  cmd.bounds = irect{ static_cast<int>(std::floor(x0)), static_cast<int>(std::floor(y0)),
+    static_cast<int>(std::ceil(x1)), static_cast<int>(std::ceil(y1)) }
+                   .intersect(clip);
+  cmd.px = px;
+  cmd.dst = { x0, y0, x1 - x0, y1 - y0 };
+  push(cmd, mask);
+}
+
+void tile_renderer::fill_path(surface& s, const irect& clip, const mask_ptr& mask, blend_mode mode, rasterizer& rast,
+    fill_rule rule, std::uint32_t px) {
+  rast.prepare();
+
+  command cmd = {};
+  cmd.type = kind::fill_path;
+  cmd.mode = mode;
+  cmd.rule = rule;
+  cmd.target = &s;
+  cmd.clip = clip;
+  cmd.bounds = rast.get_bounds().intersect(clip);
+  cmd.px = px;
+  cmd.first_edge = m_edges.size();
+  cmd.edge_count = rast.get_edges().size();
+
+  if (!cmd.bounds.empty()) {
+    m_edges.insert(m_edges.end(), rast.get_edges().begin(), rast.get_edges().end());
+    cmd.dst = { static_cast<float>(cmd.bounds.x0), static_cast<float>(cmd.bounds.y0), 0, 0 };
+
+    // The shape bounds are needed to sweep the edges, the clipped ones only for binning.
+    const irect shape = rast.get_bounds();
+    cmd.src = { static_cast<float>(shape.x0), static_cast<float>(shape.y0), static_cast<float>(shape.x1 - shape.x0),
+      static_cast<float>(shape.y1 - shape.y0) };
+  }
+
+  push(cmd, mask);
+}
+
+void tile_renderer::draw_bitmap(surface& s, const irect& clip, const mask_ptr& mask, blend_mode mode, const bitmap& bmp,
+    const nano::rect<float>& src, const nano::rect<float>& dst) {
+  command cmd = {};
+  cmd.type = kind::draw_bitmap;
+  cmd.mode = mode;
+  cmd.target = &s;
+  cmd.clip = clip;
+  cmd.bounds = irect{ static_cast<int>(std::floor(dst.x)), static_cast<int>(std::floor(dst.y)),
+    static_cast<int>(std::ceil(dst.x + dst.width)), static_cast<int>(std::ceil(dst.y + dst.height)) }
+                   .intersect(clip);
+  cmd.bmp = bitmap::retain(const_cast<bitmap*>(&bmp));
+  cmd.src = src;
+  cmd.dst = dst;
+  push(cmd, mask);
+}
+
+void tile_renderer::composite(
+    surface& dst, const irect& clip, const mask_ptr& mask, blend_mode mode, const surface& src, float alpha) {
+  command cmd = {};
+  cmd.type = kind::composite;
+  cmd.mode = mode;
+  cmd.target = &dst;
+  cmd.source = &src;
+  cmd.clip = clip;
+  cmd.bounds = clip.intersect(dst.bounds());
+  cmd.alpha = alpha;
+  push(cmd, mask);
+}
+
+void tile_renderer::retire(std::unique_ptr<surface> s) { m_retired.push_back(std::move(s)); }
+
+void tile_renderer::release_retired(std::vector<std::unique_ptr<surface>>& dst) {
+  for (std::unique_ptr<surface>& s : m_released) {
+    dst.push_back(std::move(s));
+  }
+
+  m_released.clear();
+}
+
+void tile_renderer::release_flushed() {
+  for (std::unique_ptr<surface>& s : m_retired) {
+    m_released.push_back(std::move(s));
+  }
+
+  m_retired.clear();
+}
+
+void tile_renderer::flush(const irect& area, std::size_t max_threads) {
+  if (m_commands.empty() || area.empty()) {
+    release_flushed();
+    m_masks.clear();
+    return;
+  }
+
+  const int tiles_x = (area.x1 - area.x0 + tile_width - 1) / tile_width;
+  const int tiles_y = (area.y1 - area.y0 + tile_height - 1) / tile_height;
+  m_bins.resize(static_cast<std::size_t>(tiles_x * tiles_y));
+
+  for (std::vector<std::uint32_t>& bin : m_bins) {
+    bin.clear();
+  }
+
+  for (std::size_t i = 0; i < m_commands.size(); i++) {
+    const irect b = m_commands[i].bounds.intersect(area);
+    if (b.empty()) {
+      continue;
+    }
+
+    for (int ty = (b.y0 - area.y0) / tile_height; ty <= (b.y1 - 1 - area.y0) / tile_height; ty++) {
+      for (int tx = (b.x0 - area.x0) / tile_width; tx <= (b.x1 - 1 - area.x0) / tile_width; tx++) {
+        m_bins[static_cast<std::size_t>(ty * tiles_x + tx)].push_back(static_cast<std::uint32_t>(i));
+      }
+    }
+  }
+
+  m_active_bins.clear();
+  for (std::size_t i = 0; i < m_bins.size(); i++) {
+    if (!m_bins[i].empty()) {
+      m_active_bins.push_back(i);
+    }
+  }
+
+  thread_pool::shared().parallel_for(m_active_bins.size(), max_threads, [&](std::size_t index) {
+    thread_local rasterizer rast;
+    thread_local std::vector<std::uint32_t> scratch;
+
+    const int t = static_cast<int>(m_active_bins[index]);
+    const int x0 = area.x0 + (t % tiles_x) * tile_width;
+    const int y0 = area.y0 + (t / tiles_x) * tile_height;
+    const irect tile = irect{ x0, y0, x0 + tile_width, y0 + tile_height }.intersect(area);
+
+    for (std::uint32_t c : m_bins[static_cast<std::size_t>(t)]) {
+      const command& cmd = m_commands[c];
+      const irect clip = cmd.clip.intersect(tile);
+
+      switch (cmd.type) {
+      case kind::fill_rect:
+        detail::fill_rect(*cmd.target, clip, cmd.dst.x, cmd.dst.y, cmd.dst.x + cmd.dst.width,
+            cmd.dst.y + cmd.dst.height, cmd.px, cmd.mask, cmd.mode);
+        break;
+
+      case kind::fill_path: {
+        const irect shape = { static_cast<int>(cmd.src.x), static_cast<int>(cmd.src.y),
+          static_cast<int>(cmd.src.x + cmd.src.width), static_cast<int>(cmd.src.y + cmd.src.height) };
+        rast.sweep(*cmd.target, clip, cmd.rule, cmd.px, m_edges.data() + cmd.first_edge, cmd.edge_count, shape,
+            cmd.mask, cmd.mode);
+      } break;
+
+      case kind::draw_bitmap:
+        detail::draw_bitmap(*cmd.target, clip, *cmd.bmp, cmd.src, cmd.dst, scratch, cmd.mask, cmd.mode);
+        break;
+
+      case kind::composite:
+        composite_surface(*cmd.target, clip, *cmd.source, cmd.alpha, cmd.mask, cmd.mode);
+        break;
+      }
+    }
+  });
+
+  for (command& cmd : m_commands) {
+    bitmap::release(cmd.bmp);
+  }
+
+  m_commands.clear();
+  m_edges.clear();
+  release_flushed();
+  m_masks.clear();
+}
+
+} // namespace nano::detail.
@@ -0,0 +1,640 @@
+/*
+ * Nano Library
+ *
+ * Copyright (C) 2022, Meta-Sonic
+ * All rights reserved.
+ *
+ * Proprietary and confidential.
+ * Any unauthorized copying, alteration, distribution, transmission, performance,
+ * display or other use of this material is strictly prohibited.
+ *
+ * Written by Alexandre Arsenault <alx.arsenault@gmail.com>
+ */
+
+#pragma once
+
+/*!
+ * @file      nano/graphics_raster.h
+ * @brief     nano graphics software rasterizer internals
+ * @copyright Copyright (C) 2022, Meta-Sonic
+ * @author    Alexandre Arsenault alx.arsenault@gmail.com
+ * @date      Created 16/06/2022
+ */
+
+#include <nano/graphics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Instruction sets of the vector kernels, the level picked at runtime is the one returned by get_simd_level().
+// SSE2 is part of every x86-64 target.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define NANO_GRAPHICS_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define NANO_GRAPHICS_SSE2 0
+#endif
+
+// AVX2 kernels are compiled with a target attribute, which also enables SSSE3.
+#if NANO_GRAPHICS_SSE2 && (defined(__GNUC__) || defined(__clang__))
+  #define NANO_GRAPHICS_AVX2 1
+  #define NANO_GRAPHICS_AVX2_TARGET __attribute__((target("avx2")))
+  #include <immintrin.h>
+#else
+  #define NANO_GRAPHICS_AVX2 0
+#endif
+
+namespace nano::detail {
+
+//
+// MARK: - pixel layout -
+//
+
+/// Bit position of each channel in a 32-bit pixel word.
+/// Pixels are read and written as native words, which makes image::format::rgba
+/// the same 0xRRGGBBAA value as nano::color::rgba().
+struct pixel_layout {
+  std::uint32_t r, g, b, a;
+};
+
+/// True for the 8 bits per component, 32 bits per pixel formats.
+bool is_word_format(image::format fmt) noexcept;
+
+/// Only meaningful when is_word_format(fmt) is true.
+pixel_layout get_pixel_layout(image::format fmt) noexcept;
+
+/// Format with alpha whose pixels have the given layout.
+image::format get_word_format(const pixel_layout& layout) noexcept;
+
+std::size_t get_bits_per_component(image::format fmt) noexcept;
+std::size_t get_bits_per_pixel(image::format fmt) noexcept;
+
+/// Rounded a * b / 255.
+inline std::uint32_t mul_div255(std::uint32_t a, std::uint32_t b) noexcept {
+  const std::uint32_t t = a * b + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+inline std::uint32_t pack_pixel(
+    const pixel_layout& l, std::uint32_t r, std::uint32_t g, std::uint32_t b, std::uint32_t a) noexcept {
+  return (r << l.r) | (g << l.g) | (b << l.b) | (a << l.a);
+}
+
+inline std::uint32_t premultiplied_pixel(const pixel_layout& l, const nano::color& c) noexcept {
+  const std::uint32_t a = c.alpha();
+  return pack_pixel(l, mul_div255(c.red(), a), mul_div255(c.green(), a), mul_div255(c.blue(), a), a);
+}
+
+/// Scales the four channels of a pixel by f / 256, with f in [0, 256].
+inline std::uint32_t scale_pixel(std::uint32_t px, std::uint32_t f) noexcept {
+  const std::uint32_t rb = (((px & 0x00FF00FF) * f) >> 8) & 0x00FF00FF;
+  const std::uint32_t ag = (((px >> 8) & 0x00FF00FF) * f) & 0xFF00FF00;
+  return rb | ag;
+}
+
+/// Maps a [0, 255] alpha or coverage to a [0, 256] scale factor.
+inline std::uint32_t alpha_to_scale(std::uint32_t a) noexcept { return a + (a >> 7); }
+
+/// Premultiplied source-over of a single pixel.
+inline std::uint32_t blend_pixel(std::uint32_t dst, std::uint32_t src, std::uint32_t src_alpha) noexcept {
+  return src + scale_pixel(dst, 256 - src_alpha);
+}
+
+//
+// MARK: - bitmap -
+//
+
+struct bitmap;
+
+/// Halved copies of a bitmap for the draws that shrink it, built on first use.
+/// Levels are premultiplied image::format::rgba bitmaps, each one half the previous one rounded up.
+/// Every chain shares the budget of image::set_mipmap_memory_limit().
+class mipmap_chain {
+public:
+  mipmap_chain() = default;
+  ~mipmap_chain();
+
+  mipmap_chain(const mipmap_chain&) = delete;
+  mipmap_chain& operator=(const mipmap_chain&) = delete;
+
+  /// The smallest level that is at least size pixels, retained, or nullptr when base itself is.
+  bitmap* get_level(const bitmap& base, const nano::size<float>& size);
+
+  /// Drops the levels, the pixels of the base changed.
+  void clear() noexcept;
+
+private:
+  std::mutex m_mutex;
+  std::vector<bitmap*> m_levels;
+};
+
+/// Averages 2x2 blocks of premultiplied words, dst has (width + 1) / 2 pixels.
+/// The last column is repeated when width is odd, r0 and r1 can be the same row.
+void downsample_row(const std::uint32_t* r0, const std::uint32_t* r1, std::uint32_t* dst, std::size_t width) noexcept;
+
+/// Private mapping of a whole file, the pages are only read from the disk when they are first touched.
+/// The pages are writable but copied on write, the file itself never changes.
+class mapped_file {
+public:
+  /// nullptr when the file can't be opened or is empty.
+  static std::unique_ptr<mapped_file> map(const std::filesystem::path& filepath);
+
+  ~mapped_file();
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  inline std::uint8_t* data() const noexcept { return m_data; }
+  inline std::size_t size() const noexcept { return m_size; }
+
+private:
+  mapped_file(std::uint8_t* data, std::size_t size) noexcept
+      : m_data(data)
+      , m_size(size) {}
+
+  std::uint8_t* m_data;
+  std::size_t m_size;
+};
+
+/// Reference counted pixel storage behind a nano::image.
+/// This plays the role of the CGImageRef in the CoreGraphics backend.
+struct bitmap {
+  bitmap() noexcept = default;
+
+  /// Pixels owned by the caller, for immediate use only: the bitmap can't be retained.
+  explicit bitmap(const image_view& v) noexcept;
+
+  static bitmap* create(const nano::size<std::size_t>& size, image::format fmt, std::size_t bytes_per_row = 0);
+
+  /// The pixels of r inside the ones of parent, which stay alive as long as the sub-bitmap.
+  /// r must be inside the bounds of parent.
+  static bitmap* create_sub_bitmap(bitmap& parent, const nano::rect<std::size_t>& r);
+
+  static bitmap* retain(bitmap* bmp) noexcept;
+  static void release(bitmap* bmp) noexcept;
+
+  /// True when nothing else shares the pixels, neither a reference nor another sub-bitmap.
+  bool is_unique() const noexcept;
+
+  inline std::uint8_t* row(std::size_t y) noexcept { return data + y * bytes_per_row; }
+  inline const std::uint8_t* row(std::size_t y) const noexcept { return data + y * bytes_per_row; }
+
+  std::atomic<std::size_t> ref_count{ 1 };
+  nano::size<std::size_t> size;
+  std::size_t bits_per_component = 0;
+  std::size_t bits_per_pixel = 0;
+  std::size_t bytes_per_row = 0;
+  image::format fmt = image::format::rgba;
+
+  /// Images created from a graphic_context are premultiplied, loaded or user provided ones are not.
+  bool premultiplied = false;
+
+  std::uint8_t* data = nullptr;
+  std::unique_ptr<std::uint8_t[]> storage;
+
+  /// Holds the pixels instead of storage for the bitmaps of map_raw_image().
+  std::unique_ptr<mapped_file> mapping;
+
+  /// The bitmap holding the storage of a sub-bitmap, retained by it.
+  bitmap* owner = nullptr;
+
+  /// Set by image::set_mipmapped().
+  std::unique_ptr<mipmap_chain> mipmaps;
+};
+
+/// Converts count pixels of row y starting at x into premultiplied words of the given layout.
+void load_row(const bitmap& bmp, std::size_t x, std::size_t y, std::size_t count, std::uint32_t* dst,
+    const pixel_layout& layout) noexcept;
+
+//
+// MARK: - pixel conversion -
+//
+
+/// Converts count pixels between two formats, src and dst may not overlap.
+/// See image::convert_pixels, the op is ignored for formats without both colors and alpha.
+void convert_row(const std::uint8_t* src, image::format src_fmt, std::uint8_t* dst, image::format dst_fmt,
+    std::size_t count, image::alpha_conversion op = image::alpha_conversion::none) noexcept;
+
+//
+// MARK: - raw images -
+//
+
+/// The pixels of a file written by save_raw_image(), data points inside the mapped file: nothing is decoded
+/// nor copied. nullptr when the file isn't a valid raw image.
+bitmap* map_raw_image(const std::filesystem::path& filepath);
+
+/// Writes the header and the rows of v, padded to 64 bytes, premultiplied is stored with them.
+bool save_raw_image(const std::filesystem::path& filepath, const image_view& v, bool premultiplied);
+
+//
+// MARK: - resampling -
+//
+
+/// See image::resize_pixels, premultiplied tells if both views already are.
+void resize_pixels(const image_view& src, const mutable_image_view& dst, image::filter f, bool premultiplied);
+
+//
+// MARK: - surface -
+//
+
+/// Integer device rectangle, [x0, x1) x [y0, y1).
+struct irect {
+  int x0, y0, x1, y1;
+
+  inline bool empty() const noexcept { return x0 >= x1 || y0 >= y1; }
+
+  inline irect intersect(const irect& r) const noexcept {
+    return { std::max(x0, r.x0), std::max(y0, r.y0), std::min(x1, r.x1), std::min(y1, r.y1) };
+  }
+};
+
+/// Premultiplied 32-bit render target of a software graphic_context.
+/// Only the word formats are rendered natively, every other format falls back to rgba.
+/// A surface can cover only part of the device, the draw functions address it in device
+/// coordinates through at(), row() is relative to the first row.
+struct surface {
+  surface(const nano::size<std::size_t>& size, image::format fmt);
+
+  inline std::uint32_t* row(int y) noexcept { return pixels + static_cast<std::size_t>(y) * stride; }
+  inline const std::uint32_t* row(int y) const noexcept { return pixels + static_cast<std::size_t>(y) * stride; }
+
+  /// Pixel at the device position (x, y), which must be inside bounds().
+  inline std::uint32_t* at(int x, int y) noexcept {
+    return pixels + static_cast<std::size_t>(y - origin_y) * stride + static_cast<std::size_t>(x - origin_x);
+  }
+
+  inline const std::uint32_t* at(int x, int y) const noexcept {
+    return pixels + static_cast<std::size_t>(y - origin_y) * stride + static_cast<std::size_t>(x - origin_x);
+  }
+
+  inline irect bounds() const noexcept {
+    return { origin_x, origin_y, origin_x + static_cast<int>(width), origin_y + static_cast<int>(height) };
+  }
+
+  /// Reuses the buffer for the device rectangle area, false when it holds fewer pixels than needed.
+  /// The pixels are left as they are.
+  bool reshape(const irect& area) noexcept;
+
+  void clear() noexcept;
+
+  std::size_t width;
+  std::size_t height;
+
+  /// In pixels.
+  std::size_t stride;
+
+  /// Size of the buffer in pixels.
+  std::size_t capacity;
+
+  /// Device position of the first pixel.
+  int origin_x = 0;
+  int origin_y = 0;
+
+  image::format fmt;
+  pixel_layout layout;
+  std::unique_ptr<std::uint32_t[]> buffer;
+  std::uint32_t* pixels;
+};
+
+//
+// MARK: - clip mask -
+//
+
+/// A8 coverage of a non-rectangular clip over the scissor rectangle that was current when it was built.
+/// Masks are only created for path and image clips, rectangles stay a scissor. A mask is never modified
+/// once it is installed in a state, so saved states share it and restoring one only drops a reference.
+struct clip_mask {
+  /// Starts from the coverage of parent when there is one, fully opaque otherwise.
+  /// The parent must cover r, which holds since a scissor can only shrink.
+  clip_mask(const irect& r, const clip_mask* parent);
+
+  /// Coverage of the pixels starting at (x, y), which must be inside bounds.
+  inline const std::uint8_t* span(int x, int y) const noexcept {
+    return coverage.data() + static_cast<std::size_t>(y - bounds.y0) * width + static_cast<std::size_t>(x - bounds.x0);
+  }
+
+  inline std::uint8_t* span(int x, int y) noexcept {
+    return coverage.data() + static_cast<std::size_t>(y - bounds.y0) * width + static_cast<std::size_t>(x - bounds.x0);
+  }
+
+  /// True when every pixel is fully covered, the scissor alone is then enough.
+  bool is_opaque() const noexcept;
+
+  irect bounds;
+  std::size_t width;
+  std::vector<std::uint8_t> coverage;
+};
+
+//
+// MARK: - damage -
+//
+
+/// Union of the device rectangles touched since the last clear, kept as a short list.
+/// Rectangles that overlap are merged when their union isn't larger than the two of them,
+/// past max_rects the pair whose union grows the least is merged.
+class damage_region {
+public:
+  static constexpr std::size_t max_rects = 8;
+
+  void add(const irect& r);
+
+  inline void clear() noexcept { m_rects.clear(); }
+
+  inline bool empty() const noexcept { return m_rects.empty(); }
+
+  inline const std::vector<irect>& rects() const noexcept { return m_rects; }
+
+  irect bounds() const noexcept;
+
+private:
+  std::vector<irect> m_rects;
+};
+
+//
+// MARK: - span kernels -
+//
+
+/// Instruction set used by the span kernels.
+/// Every level produces bit-identical results.
+enum class simd_level { scalar, sse2, avx2 };
+
+/// Best level supported by the compiler and the CPU.
+simd_level get_max_simd_level() noexcept;
+
+simd_level get_simd_level() noexcept;
+
+/// Clamped to get_max_simd_level(), this is meant for testing and benchmarking.
+void set_simd_level(simd_level level) noexcept;
+
+void fill_span(std::uint32_t* dst, std::size_t count, std::uint32_t px) noexcept;
+
+/// Source-over of a constant premultiplied pixel.
+void blend_span(std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t alpha) noexcept;
+
+/// Source-over of a constant premultiplied pixel modulated by a coverage mask.
+void blend_span_mask(std::uint32_t* dst, const std::uint8_t* mask, std::size_t count, std::uint32_t px,
+    std::uint32_t alpha_shift) noexcept;
+
+/// Source-over of premultiplied source pixels scaled by f / 256.
+void blend_span_pixels(std::uint32_t* dst, const std::uint32_t* src, std::size_t count, std::uint32_t f,
+    std::uint32_t alpha_shift) noexcept;
+
+/// Paints a constant pixel with a uniform coverage in [0, 255].
+void paint_span(std::uint32_t* dst, std::size_t count, std::uint32_t px, std::uint32_t coverage,
+    std::uint32_t alpha_shift) noexcept;
+
+/// Composites premultiplied source pixels with a blend mode. The result is interpolated with the
+/// destination by the coverage of each pixel, a null coverage is full. The other kernels only do
+/// blend_mode::normal, this one is used for every other mode.
+void blend_span_mode(blend_mode mode, std::uint32_t* dst, const std::uint32_t* src, const std::uint8_t* coverage,
+    std::size_t count, std::uint32_t alpha_shift) noexcept;
+
+//
+// MARK: - rasterizer -
+//
+
+enum class fill_rule { non_zero, even_odd };
+
+/// Exact area fill of an axis aligned rectangle in device space.
+/// Every draw function takes the scissor as clip, an optional mask covering it and a blend mode.
+void fill_rect(surface& s, const irect& clip, float x0, float y0, float x1, float y1, std::uint32_t px,
+    const clip_mask* mask = nullptr, blend_mode mode = blend_mode::normal) noexcept;
+
+/// Exact area coverage scanline rasterizer.
+/// Edges are accumulated with move_to / line_to and then swept into a surface one row at a time.
+/// Each edge deposits the signed area it covers into sparse per-row cells, and a running sum over
+/// the sorted cells gives the coverage of every pixel without supersampling. The cost is
+/// proportional to the length of the edges plus the number of filled spans.
+/// All the buffers are kept between calls so that steady state drawing doesn't allocate.
+class rasterizer {
+public:
+  struct edge {
+    float x0, y0, x1, y1;
+    int dir;
+  };
+
+  void reset() noexcept;
+
+  void move_to(float x, float y);
+  void line_to(float x, float y);
+  void close();
+
+  inline bool empty() const noexcept { return m_edges.empty(); }
+
+  void fill(surface& s, const irect& clip, fill_rule rule, std::uint32_t px, const clip_mask* mask = nullptr,
+      blend_mode mode = blend_mode::normal);
+
+  /// Closes the last contour and sorts the edges, get_bounds() is only valid afterwards.
+  void prepare();
+
+  irect get_bounds() const noexcept;
+
+  inline const std::vector<edge>& get_edges() const noexcept { return m_edges; }
+
+  /// Sweeps prepared edges, possibly recorded from another rasterizer.
+  /// The coverage of a pixel doesn't depend on the clip, which keeps tiled rendering exact.
+  void sweep(surface& s, const irect& clip, fill_rule rule, std::uint32_t px, const edge* edges, std::size_t count,
+      const irect& bounds, const clip_mask* mask = nullptr, blend_mode mode = blend_mode::normal);
+
+  /// Multiplies mask by the coverage of the edges, the pixels outside of the shape are cleared.
+  void intersect_mask(clip_mask& mask, fill_rule rule);
+
+  /// Contour helpers, reversed contours can be used to punch holes with the non-zero rule.
+  void add_rect(float x0, float y0, float x1, float y1, bool reversed = false);
+  void add_ellipse(float cx, float cy, float rx, float ry, bool reversed = false);
+  void add_rounded_rect(float x0, float y0, float x1, float y1, float radius, bool reversed = false);
+  void add_line(float x0, float y0, float x1, float y1, float width, line_cap cap);
+
+private:
+  /// Signed area added to the running coverage from x onwards.
+  /// The insertion order breaks the ties so the summation order is always the same.
+  struct cell {
+    int x;
+    std::uint32_t order;
+    float cover;
+  };
+
+  void add_cells(const edge& e, float y0, float y1);
+
+  /// Calls fct(y) for every row of bounds with the sorted cells of that row, rows without cells are skipped.
+  template <class Fct>
+  void sweep_rows(const edge* edges, std::size_t count, const irect& bounds, Fct&& fct);
+
+  /// Calls fct(x0, x1, coverage) for every run of pixels of the current row with the same coverage.
+  template <class Fct>
+  void for_each_span(int x0, int x1, fill_rule rule, Fct&& fct);
+
+  /// row points at the pixel x0.
+  void emit_row(std::uint32_t* row, int x0, int x1, fill_rule rule, std::uint32_t px, std::uint32_t alpha_shift,
+      const std::uint8_t* mask, blend_mode mode);
+
+  std::vector<edge> m_edges;
+  std::vector<std::size_t> m_active;
+  std::vector<cell> m_cells;
+  std::vector<std::uint8_t> m_coverage;
+  float m_start_x = 0;
+  float m_start_y = 0;
+  float m_last_x = 0;
+  float m_last_y = 0;
+  float m_min_y = 0;
+  float m_max_y = 0;
+  float m_min_x = 0;
+  float m_max_x = 0;
+};
+
+/// Draws the src region of a bitmap into the dst device rectangle.
+/// Unscaled draws are converted and blended one row at a time, scaled ones are sampled bilinearly.
+void draw_bitmap(surface& s, const irect& clip, const bitmap& bmp, const nano::rect<float>& src,
+    const nano::rect<float>& dst, std::vector<std::uint32_t>& scratch, const clip_mask* mask = nullptr,
+    blend_mode mode = blend_mode::normal);
+
+/// Composites a whole surface with a global alpha in [0, 1].
+void composite_surface(surface& dst, const irect& clip, const surface& src, float alpha,
+    const clip_mask* mask = nullptr, blend_mode mode = blend_mode::normal) noexcept;
+
+//
+// MARK: - thread pool -
+//
+
+/// Worker pool shared by the parallel code paths.
+class thread_pool {
+public:
+  /// One worker less than the number of cores, since the calling thread always takes part.
+  static thread_pool& shared();
+
+  explicit thread_pool(std::size_t worker_count);
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  inline std::size_t get_worker_count() const noexcept { return m_workers.size(); }
+
+  /// Calls fct(index) for every index in [0, count) on at most max_threads threads,
+  /// the calling one included, and returns once they are all done. 0 uses every thread.
+  void parallel_for(std::size_t count, std::size_t max_threads, const std::function<void(std::size_t)>& fct);
+
+  void push(std::function<void()> task);
+
+private:
+  void run();
+
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop = false;
+};
+
+/// Smaller images are processed on the calling thread.
+constexpr std::size_t k_parallel_pixels = 1 << 18;
+
+/// Pixels in each band of rows given to the thread pool.
+constexpr std::size_t k_band_pixels = 1 << 16;
+
+/// Calls fct(y0, y1) on bands of rows covering [0, height), each band on a single thread.
+/// row_pixels is the work of a row, the bands are only spread over the shared pool for large images.
+template <typename Fct>
+inline void parallel_rows(std::size_t height, std::size_t row_pixels, Fct&& fct) {
+  thread_pool& pool = thread_pool::shared();
+
+  if (row_pixels * height < k_parallel_pixels || !pool.get_worker_count()) {
+    fct(std::size_t(0), height);
+    return;
+  }
+
+  const std::size_t band = std::max<std::size_t>(1, k_band_pixels / row_pixels);
+  const std::size_t band_count = (height + band - 1) / band;
+  pool.parallel_for(band_count, 0, [&](std::size_t i) { //
+    fct(i * band, std::min(height, (i + 1) * band));
+  });
+}
+
+//
+// MARK: - tile renderer -
+//
+
+/// Deferred draw calls of a tiled graphic_context.
+/// Calls are binned into fixed size screen tiles on flush() and the tiles are rasterized in
+/// parallel, each one replaying its calls in order with the clip restricted to the tile.
+/// Every kernel computes a pixel independently of the clip so the result is identical to
+/// immediate rendering.
+class tile_renderer {
+public:
+  // Wide tiles keep the rows long enough for the prefetcher.
+  static constexpr int tile_width = 256;
+  static constexpr int tile_height = 64;
+
+  tile_renderer() = default;
+  tile_renderer(const tile_renderer&) = delete;
+  tile_renderer& operator=(const tile_renderer&) = delete;
+  ~tile_renderer();
+
+  inline bool empty() const noexcept { return m_commands.empty(); }
+
+  /// The clip masks are kept alive until the commands referencing them are flushed.
+  using mask_ptr = std::shared_ptr<const clip_mask>;
+
+  void fill_rect(surface& s, const irect& clip, const mask_ptr& mask, blend_mode mode, float x0, float y0, float x1,
+      float y1, std::uint32_t px);
+
+  /// Takes the prepared edges of the rasterizer.
+  void fill_path(surface& s, const irect& clip, const mask_ptr& mask, blend_mode mode, rasterizer& rast, fill_rule rule,
+      std::uint32_t px);
+
+  void draw_bitmap(surface& s, const irect& clip, const mask_ptr& mask, blend_mode mode, const bitmap& bmp,
+      const nano::rect<float>& src, const nano::rect<float>& dst);
+
+  void composite(
+      surface& dst, const irect& clip, const mask_ptr& mask, blend_mode mode, const surface& src, float alpha);
+
+  /// Keeps a layer surface alive until the commands referencing it are flushed.
+  void retire(std::unique_ptr<surface> s);
+
+  /// Moves the surfaces retired before the last flush into dst so that they can be reused.
+  void release_retired(std::vector<std::unique_ptr<surface>>& dst);
+
+  /// Renders every command inside area, which should cover the surfaces.
+  void flush(const irect& area, std::size_t max_threads);
+
+private:
+  enum class kind : std::uint8_t { fill_rect, fill_path, draw_bitmap, composite };
+
+  struct command {
+    kind type;
+    fill_rule rule;
+    blend_mode mode;
+    surface* target;
+    const surface* source;
+    bitmap* bmp;
+    const clip_mask* mask;
+    irect clip;
+    irect bounds;
+    std::uint32_t px;
+    float alpha;
+    nano::rect<float> src;
+    nano::rect<float> dst;
+    std::size_t first_edge;
+    std::size_t edge_count;
+  };
+
+  void push(command& cmd, const mask_ptr& mask);
+  void release_flushed();
+
+  std::vector<command> m_commands;
+  std::vector<rasterizer::edge> m_edges;
+  std::vector<std::unique_ptr<surface>> m_retired;
+  std::vector<std::unique_ptr<surface>> m_released;
+  std::vector<mask_ptr> m_masks;
+  std::vector<std::vector<std::uint32_t>> m_bins;
+  std::vector<std::size_t> m_active_bins;
+};
+
+} // namespace nano::detail.
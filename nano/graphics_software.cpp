@@ -0,0 +1,1255 @@
+#include <nano/graphics.h>
+
+// Portable CPU backend, see graphics.cpp for the CoreGraphics one.
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/graphics_codec.h>
+  #include <nano/graphics_path.h>
+  #include <nano/graphics_raster.h>
+
+  #include <cstring>
+  #include <limits>
+
+namespace nano {
+
+//
+// MARK: display
+//
+
+// There is no window system behind the software renderer.
+double display::get_scale_factor() { return 1; }
+
+double display::get_refresh_rate() { return 0; }
+
+//
+// MARK: image
+//
+
+struct image::pimpl {
+  detail::bitmap* img = nullptr;
+};
+
+image::image() { m_pimpl = new pimpl; }
+
+namespace {
+  /// Reads every row of a png_decoder or jpeg_decoder into a bitmap in the format of the decoder.
+  template <class Decoder>
+  static inline detail::bitmap* decode_bitmap(Decoder& decoder) {
+    detail::bitmap* bmp = decoder ? detail::bitmap::create(decoder.get_size(), decoder.get_format()) : nullptr;
+
+    for (std::size_t y = 0; bmp && y < bmp->size.height; y++) {
+      if (!decoder.read_row(bmp->row(y))) {
+        detail::bitmap::release(bmp);
+        return nullptr;
+      }
+    }
+
+    return bmp;
+  }
+} // namespace.
+
+image::image(const std::string& filepath, type img_type)
+    : image(filepath, img_type, decode_scale::full) {}
+
+image::image(const std::string& filepath, type img_type, decode_scale scale) {
+  m_pimpl = new pimpl;
+
+  if (img_type == type::jpeg) {
+    jpeg_decoder decoder(filepath, scale);
+    m_pimpl->img = decode_bitmap(decoder);
+    return;
+  }
+
+  if (img_type == type::raw) {
+    m_pimpl->img = detail::map_raw_image(filepath);
+  }
+  else {
+    png_decoder decoder(filepath);
+    m_pimpl->img = decode_bitmap(decoder);
+  }
+
+  if (m_pimpl->img && scale != decode_scale::full) {
+    const std::size_t d = static_cast<std::size_t>(scale);
+    const nano::size<std::size_t> size = get_size();
+    *this = resize({ (size.width + d - 1) / d, (size.height + d - 1) / d }, filter::box);
+  }
+}
+
+image::image(const nano::size<std::size_t>& size, std::size_t bitsPerComponent, std::size_t bitsPerPixel,
+    std::size_t bytesPerRow, format fmt, const std::uint8_t* buffer) {
+  m_pimpl = new pimpl;
+
+  // The layout is entirely defined by the format.
+  (void)bitsPerComponent;
+  (void)bitsPerPixel;
+
+  m_pimpl->img = detail::bitmap::create(size, fmt, bytesPerRow);
+
+  if (m_pimpl->img && buffer) {
+    std::memcpy(m_pimpl->img->data, buffer, m_pimpl->img->bytes_per_row * size.height);
+  }
+}
+
+image::image(const image_view& v) {
+  m_pimpl = new pimpl;
+  m_pimpl->img = v ? detail::bitmap::create(v.size, v.fmt) : nullptr;
+
+  if (m_pimpl->img) {
+    convert_pixels(v, mutable_image_view(m_pimpl->img->data, v.size, m_pimpl->img->bytes_per_row, v.fmt));
+  }
+}
+
+image::image(const image& img) {
+  m_pimpl = new pimpl;
+  m_pimpl->img = detail::bitmap::retain(img.m_pimpl->img);
+}
+
+image::image(image&& img) {
+  m_pimpl = new pimpl;
+  m_pimpl->img = img.m_pimpl->img;
+  img.m_pimpl->img = nullptr;
+}
+
+image::image(image::handle nativeImg) {
+  m_pimpl = new pimpl;
+  m_pimpl->img = detail::bitmap::retain(reinterpret_cast<detail::bitmap*>(nativeImg));
+}
+
+image::~image() {
+  detail::bitmap::release(m_pimpl->img);
+  delete m_pimpl;
+}
+
+image& image::operator=(const image& img) {
+  if (m_pimpl->img == img.m_pimpl->img) {
+    return *this;
+  }
+
+  detail::bitmap::release(m_pimpl->img);
+  m_pimpl->img = detail::bitmap::retain(img.m_pimpl->img);
+  return *this;
+}
+
+image& image::operator=(image&& img) {
+  detail::bitmap::release(m_pimpl->img);
+  m_pimpl->img = img.m_pimpl->img;
+  img.m_pimpl->img = nullptr;
+  return *this;
+}
+
+image::handle image::get_native_image() const { return reinterpret_cast<handle>(m_pimpl->img); }
+
+bool image::is_valid() const { return m_pimpl->img != nullptr; }
+
+nano::size<std::size_t> image::get_size() const { return is_valid() ? m_pimpl->img->size : nano::size<std::size_t>(0, 0); }
+
+std::size_t image::width() const { return is_valid() ? m_pimpl->img->size.width : 0; }
+
+std::size_t image::height() const { return is_valid() ? m_pimpl->img->size.height : 0; }
+
+std::size_t image::get_bits_per_component() const { return is_valid() ? m_pimpl->img->bits_per_component : 0; }
+
+std::size_t image::get_bits_per_pixel() const { return is_valid() ? m_pimpl->img->bits_per_pixel : 0; }
+
+std::size_t image::get_bytes_per_row() const { return is_valid() ? m_pimpl->img->bytes_per_row : 0; }
+
+const std::uint8_t* image::data() const { return is_valid() ? m_pimpl->img->data : nullptr; }
+
+namespace {
+  static inline detail::bitmap* copy_bitmap(const detail::bitmap& src, const nano::rect<std::size_t>& r) {
+    detail::bitmap* bmp = detail::bitmap::create(r.size, src.fmt);
+
+    if (!bmp) {
+      return nullptr;
+    }
+
+    bmp->premultiplied = src.premultiplied;
+    const std::size_t offset = r.x * (src.bits_per_pixel / 8);
+    const std::size_t row_size = r.width * (src.bits_per_pixel / 8);
+
+    for (std::size_t y = 0; y < r.height; y++) {
+      std::memcpy(bmp->row(y), src.row(r.y + y) + offset, row_size);
+    }
+
+    return bmp;
+  }
+
+  static inline image make_image(detail::bitmap* bmp) {
+    image img(reinterpret_cast<image::handle>(bmp));
+    detail::bitmap::release(bmp);
+    return img;
+  }
+} // namespace.
+
+image_view image::view() const {
+  if (!is_valid()) {
+    return image_view();
+  }
+
+  const detail::bitmap& bmp = *m_pimpl->img;
+  return image_view(bmp.data, bmp.size, bmp.bytes_per_row, bmp.fmt);
+}
+
+mutable_image_view image::mutable_view() {
+  if (!is_valid()) {
+    return mutable_image_view();
+  }
+
+  // Copy on write, copies of the image, its sub-images and the draws waiting in a tiled context
+  // keep the pixels they share.
+  if (!m_pimpl->img->is_unique()) {
+    detail::bitmap* bmp = copy_bitmap(*m_pimpl->img, get_rect());
+
+    if (m_pimpl->img->mipmaps) {
+      bmp->mipmaps = std::make_unique<detail::mipmap_chain>();
+    }
+
+    detail::bitmap::release(m_pimpl->img);
+    m_pimpl->img = bmp;
+  }
+  else if (m_pimpl->img->mipmaps) {
+    m_pimpl->img->mipmaps->clear();
+  }
+
+  detail::bitmap& bmp = *m_pimpl->img;
+  return mutable_image_view(bmp.data, bmp.size, bmp.bytes_per_row, bmp.fmt);
+}
+
+void image::copy_data(std::vector<std::uint8_t>& buffer) const {
+  if (!is_valid()) {
+    return;
+  }
+
+  const detail::bitmap& bmp = *m_pimpl->img;
+  buffer.resize(bmp.bytes_per_row * bmp.size.height);
+  std::memcpy(buffer.data(), bmp.data, buffer.size());
+}
+
+std::vector<std::uint8_t> image::get_data() const {
+  std::vector<std::uint8_t> buffer;
+  copy_data(buffer);
+  return buffer;
+}
+
+// The pixels are copied by the first mutable_view() of either image.
+image image::make_copy() { return *this; }
+
+image image::get_sub_image(const nano::rect<std::size_t>& r) const {
+  if (!is_valid() || r.x >= width() || r.y >= height()) {
+    return image();
+  }
+
+  // Like CGImageCreateWithImageInRect, the rect is intersected with the image bounds.
+  const nano::rect<std::size_t> area
+      = { r.x, r.y, std::min(r.width, width() - r.x), std::min(r.height, height() - r.y) };
+  return make_image(detail::bitmap::create_sub_bitmap(*m_pimpl->img, area));
+}
+
+image::format image::get_format() const { return is_valid() ? m_pimpl->img->fmt : format::rgba; }
+
+image image::convert(format fmt) const {
+  if (!is_valid() || m_pimpl->img->fmt == fmt) {
+    return *this;
+  }
+
+  const detail::bitmap& src = *m_pimpl->img;
+  detail::bitmap* bmp = detail::bitmap::create(src.size, fmt);
+  bmp->premultiplied = src.premultiplied;
+  convert_pixels(src.size, src.data, src.bytes_per_row, src.fmt, bmp->data, bmp->bytes_per_row, fmt);
+  return make_image(bmp);
+}
+
+void image::set_mipmapped(bool enabled) {
+  if (!is_valid() || enabled == is_mipmapped()) {
+    return;
+  }
+
+  m_pimpl->img->mipmaps = enabled ? std::make_unique<detail::mipmap_chain>() : nullptr;
+}
+
+bool image::is_mipmapped() const { return is_valid() && m_pimpl->img->mipmaps; }
+
+image image::resize(const nano::size<std::size_t>& size, filter f) const {
+  if (!is_valid()) {
+    return image();
+  }
+
+  const detail::bitmap& src = *m_pimpl->img;
+  detail::bitmap* bmp = detail::bitmap::create(size, src.fmt);
+
+  if (!bmp) {
+    return image();
+  }
+
+  bmp->premultiplied = src.premultiplied;
+  const mutable_image_view dst(bmp->data, size, bmp->bytes_per_row, bmp->fmt);
+  detail::resize_pixels(view(), dst, f, src.premultiplied);
+  return make_image(bmp);
+}
+
+image image::create_colored_image(const nano::color& color) const {
+  if (!is_valid()) {
+    return image();
+  }
+
+  // The alpha of the image is used as a mask, the result is premultiplied like a bitmap context.
+  const detail::bitmap& src = *m_pimpl->img;
+  detail::bitmap* bmp = detail::bitmap::create(src.size, format::rgba);
+  bmp->premultiplied = true;
+
+  const detail::pixel_layout layout = detail::get_pixel_layout(format::rgba);
+  const std::uint32_t px = detail::premultiplied_pixel(layout, color);
+  std::vector<std::uint32_t> row(src.size.width);
+
+  for (std::size_t y = 0; y < src.size.height; y++) {
+    detail::load_row(src, 0, y, src.size.width, row.data(), layout);
+    std::uint32_t* dst = reinterpret_cast<std::uint32_t*>(bmp->row(y));
+
+    for (std::size_t x = 0; x < src.size.width; x++) {
+      dst[x] = detail::scale_pixel(px, detail::alpha_to_scale(row[x] & 0xFF));
+    }
+  }
+
+  return make_image(bmp);
+}
+
+bool image::save(const std::filesystem::path& filepath, type img_type) {
+  // There is no built-in jpeg encoder yet.
+  if (!is_valid() || img_type == type::jpeg) {
+    return false;
+  }
+
+  const detail::bitmap& bmp = *m_pimpl->img;
+
+  if (img_type == type::raw) {
+    return detail::save_raw_image(filepath, view(), bmp.premultiplied);
+  }
+
+  png_options options;
+  options.parallel = true;
+  png_encoder encoder(filepath, bmp.size, bmp.fmt, options);
+
+  if (!bmp.premultiplied) {
+    for (std::size_t y = 0; y < bmp.size.height; y++) {
+      if (!encoder.write_row(bmp.row(y))) {
+        return false;
+      }
+    }
+
+    return encoder.finish();
+  }
+
+  // png colors are straight alpha.
+  return encoder.write_rows([&](std::size_t y, const mutable_image_view& row) {
+    detail::convert_row(bmp.row(y), bmp.fmt, row.data, bmp.fmt, bmp.size.width, alpha_conversion::unpremultiply);
+  });
+}
+
+//
+// MARK: font
+//
+
+// There is no font engine in the software renderer, fonts are never valid and text isn't drawn.
+struct font::pimpl {
+  pimpl(double ft)
+      : font_size(ft) {}
+
+  double font_size;
+};
+
+font::font() { m_pimpl = new pimpl(0); }
+
+font::font(const char* fontName, double fontSize) {
+  (void)fontName;
+  m_pimpl = new pimpl(fontSize);
+}
+
+font::font(const char* filepath, double fontSize, filepath_tag) {
+  (void)filepath;
+  m_pimpl = new pimpl(fontSize);
+}
+
+font::font(const std::uint8_t* data, std::size_t data_size, double font_size) {
+  (void)data;
+  (void)data_size;
+  m_pimpl = new pimpl(font_size);
+}
+
+font::font(const font& f) { m_pimpl = new pimpl(f.get_font_size()); }
+
+font::font(font&& f) { m_pimpl = new pimpl(f.get_font_size()); }
+
+font::~font() { delete m_pimpl; }
+
+font& font::operator=(const font& f) {
+  m_pimpl->font_size = f.m_pimpl->font_size;
+  return *this;
+}
+
+font& font::operator=(font&& f) {
+  m_pimpl->font_size = f.m_pimpl->font_size;
+  return *this;
+}
+
+bool font::is_valid() const noexcept { return false; }
+
+double font::get_font_size() const noexcept { return m_pimpl->font_size; }
+
+double font::get_height() const noexcept { return 0; }
+
+float font::get_string_width(std::string_view text) const {
+  (void)text;
+  return 0;
+}
+
+font::handle font::get_native_font() const noexcept { return nullptr; }
+
+//
+// MARK: path
+//
+
+// The native handle of a software path is its detail::path_data.
+path::handle path::get_native_path() const { return m_pimpl->data.get(); }
+
+//
+// MARK: graphic_context
+//
+
+namespace {
+  static inline detail::irect to_irect(float x0, float y0, float x1, float y1) noexcept {
+    return { static_cast<int>(std::floor(x0)), static_cast<int>(std::floor(y0)), static_cast<int>(std::ceil(x1)),
+      static_cast<int>(std::ceil(y1)) };
+  }
+
+  /// A scissor only clips exactly at the edges of the pixels.
+  static inline bool is_pixel_aligned(const nano::rect<float>& r) noexcept {
+    return std::floor(r.x) == r.x && std::floor(r.y) == r.y && std::floor(r.x + r.width) == r.x + r.width
+        && std::floor(r.y + r.height) == r.y + r.height;
+  }
+} // namespace.
+
+// The native handle of a software context is a detail::surface.
+class graphic_context::pimpl {
+public:
+  // The clip is a scissor rectangle, plus a shared coverage mask once a path or an image is clipped to.
+  // Saving copies a pointer and restoring pops it, no pixels are involved.
+  struct state {
+    nano::point<float> offset;
+    detail::irect clip;
+    std::shared_ptr<const detail::clip_mask> mask;
+    nano::color fill_color;
+    nano::color stroke_color;
+    float line_width;
+    nano::line_join line_join;
+    nano::line_cap line_cap;
+    float miter_limit;
+    nano::blend_mode blend_mode;
+  };
+
+  // A layer only covers the clip it was begun with and only the part that was drawn is composited.
+  struct layer {
+    std::unique_ptr<detail::surface> target;
+    float alpha;
+    detail::irect drawn;
+
+    /// Number of states once the layer began, restore_state() never goes below it.
+    std::size_t depth;
+  };
+
+  // Recycled layer buffers, the largest ones are kept.
+  static constexpr std::size_t max_pooled_layers = 8;
+
+  pimpl(detail::surface* s, bool bitmap)
+      : root(s)
+      , is_bitmap(bitmap) {
+    states.reserve(16);
+    states.push_back({ { 0, 0 }, root->bounds(), nullptr, nano::colors::black, nano::colors::black, 1.0f,
+        line_join::miter, line_cap::butt, 10.0f, blend_mode::normal });
+    rast.reset();
+  }
+
+  ~pimpl() = default;
+
+  inline state& current() noexcept { return states.back(); }
+
+  inline detail::surface& target() noexcept { return layers.empty() ? *root : *layers.back().target; }
+
+  // Layer buffers only cover the clip they began with, draws never go past the target.
+  inline detail::irect target_clip() noexcept { return current().clip.intersect(target().bounds()); }
+
+  inline std::uint32_t pixel(const nano::color& c) noexcept {
+    return detail::premultiplied_pixel(target().layout, c);
+  }
+
+  // Returns false when r is entirely clipped out, the draw call can be skipped.
+  inline bool add_damage(const detail::irect& r) {
+    const detail::irect visible = r.intersect(current().clip);
+    if (visible.empty()) {
+      return false;
+    }
+
+    damage.add(visible);
+    add_drawn(visible);
+    return true;
+  }
+
+  // Grows the drawn bounds of the current layer.
+  inline void add_drawn(const detail::irect& r) noexcept {
+    if (layers.empty() || r.empty()) {
+      return;
+    }
+
+    detail::irect& d = layers.back().drawn;
+    if (d.empty()) {
+      d = r;
+      return;
+    }
+
+    d = { std::min(d.x0, r.x0), std::min(d.y0, r.y0), std::max(d.x1, r.x1), std::max(d.y1, r.y1) };
+  }
+
+  // Smallest pooled buffer holding area, cleared, or a new one.
+  inline std::unique_ptr<detail::surface> acquire_layer(const detail::irect& area) {
+    const std::size_t count = area.empty() ? 0 : static_cast<std::size_t>(area.x1 - area.x0) * (area.y1 - area.y0);
+    auto best = layer_pool.end();
+
+    for (auto it = layer_pool.begin(); it != layer_pool.end(); ++it) {
+      if ((*it)->capacity >= count && (best == layer_pool.end() || (*it)->capacity < (*best)->capacity)) {
+        best = it;
+      }
+    }
+
+    if (best == layer_pool.end()) {
+      auto s = std::make_unique<detail::surface>(nano::size<std::size_t>(count, 1), root->fmt);
+      s->reshape(area);
+      return s;
+    }
+
+    std::unique_ptr<detail::surface> s = std::move(*best);
+    layer_pool.erase(best);
+    s->reshape(area);
+    s->clear();
+    return s;
+  }
+
+  inline void trim_layer_pool() {
+    if (layer_pool.size() > max_pooled_layers) {
+      std::sort(layer_pool.begin(), layer_pool.end(),
+          [](const auto& a, const auto& b) { return a->capacity > b->capacity; });
+      layer_pool.resize(max_pooled_layers);
+    }
+  }
+
+  // In tiled mode the draw calls are recorded and rendered on flush.
+  inline void fill(detail::fill_rule rule, const nano::color& c) {
+    if (!add_damage(rast.get_bounds())) {
+      rast.reset();
+      return;
+    }
+
+    const state& st = current();
+    if (tiles) {
+      tiles->fill_path(target(), st.clip, st.mask, st.blend_mode, rast, rule, pixel(c));
+    }
+    else {
+      rast.fill(target(), target_clip(), rule, pixel(c), st.mask.get(), st.blend_mode);
+    }
+
+    rast.reset();
+  }
+
+  inline void fill_rect(float x0, float y0, float x1, float y1, const nano::color& c) {
+    if (!add_damage(to_irect(x0, y0, x1, y1))) {
+      return;
+    }
+
+    const state& st = current();
+    if (tiles) {
+      tiles->fill_rect(target(), st.clip, st.mask, st.blend_mode, x0, y0, x1, y1, pixel(c));
+    }
+    else {
+      detail::fill_rect(target(), target_clip(), x0, y0, x1, y1, pixel(c), st.mask.get(), st.blend_mode);
+    }
+  }
+
+  inline void draw_bitmap(const detail::bitmap& bmp, const nano::rect<float>& src, const nano::rect<float>& dst) {
+    if (!add_damage(to_irect(dst.x, dst.y, dst.x + dst.width, dst.y + dst.height))) {
+      return;
+    }
+
+    const state& st = current();
+    if (tiles) {
+      tiles->draw_bitmap(target(), st.clip, st.mask, st.blend_mode, bmp, src, dst);
+    }
+    else {
+      detail::draw_bitmap(target(), target_clip(), bmp, src, dst, scratch, st.mask.get(), st.blend_mode);
+    }
+  }
+
+  inline void set_clip(const detail::irect& r, std::shared_ptr<const detail::clip_mask> mask) noexcept {
+    state& st = current();
+    st.clip = r.empty() ? detail::irect{ 0, 0, 0, 0 } : r;
+    st.mask = r.empty() ? nullptr : std::move(mask);
+  }
+
+  // Intersects the clip with the coverage of the rasterizer edges.
+  // A mask that ends up fully opaque is dropped, the scissor is then exact.
+  inline void clip_to_coverage(detail::fill_rule rule) {
+    rast.prepare();
+    const detail::irect r = current().clip.intersect(rast.get_bounds());
+
+    if (rast.empty() || r.empty()) {
+      set_clip({ 0, 0, 0, 0 }, nullptr);
+      rast.reset();
+      return;
+    }
+
+    auto mask = std::make_shared<detail::clip_mask>(r, current().mask.get());
+    rast.intersect_mask(*mask, rule);
+    rast.reset();
+
+    if (mask->is_opaque()) {
+      mask.reset();
+    }
+
+    set_clip(r, std::move(mask));
+  }
+
+  inline detail::stroke_style stroke_style() noexcept {
+    const state& st = current();
+    return { st.line_width, st.line_join, st.line_cap, st.miter_limit };
+  }
+
+  inline void clear_outline() noexcept {
+    outline.points.clear();
+    outline.contours.clear();
+    outline.closed.clear();
+  }
+
+  inline void flush() {
+    if (tiles) {
+      tiles->flush(root->bounds(), tile_threads);
+      tiles->release_retired(layer_pool);
+      trim_layer_pool();
+    }
+  }
+
+  detail::surface* root;
+  bool is_bitmap;
+  std::unique_ptr<detail::tile_renderer> tiles;
+  std::size_t tile_threads = 0;
+  std::vector<state> states;
+  std::vector<layer> layers;
+  std::vector<std::unique_ptr<detail::surface>> layer_pool;
+  std::vector<nano::rect<float>> path;
+  std::vector<std::pair<nano::path, nano::point<float>>> shapes;
+  std::vector<std::uint32_t> scratch;
+  detail::polyline contour;
+  detail::polyline outline;
+  detail::rasterizer rast;
+  detail::damage_region damage;
+};
+
+graphic_context::graphic_context(handle nc, bool is_bitmap) {
+  m_pimpl = new pimpl(reinterpret_cast<detail::surface*>(nc), is_bitmap);
+}
+
+graphic_context::~graphic_context() {
+  if (m_pimpl->is_bitmap) {
+    delete m_pimpl->root;
+  }
+
+  delete m_pimpl;
+}
+
+void graphic_context::save_state() { m_pimpl->states.push_back(m_pimpl->current()); }
+
+// The state pushed by begin_transparent_layer() is only popped by end_transparent_layer().
+void graphic_context::restore_state() {
+  if (m_pimpl->states.size() > (m_pimpl->layers.empty() ? 1 : m_pimpl->layers.back().depth)) {
+    m_pimpl->states.pop_back();
+  }
+}
+
+void graphic_context::begin_transparent_layer(float alpha) {
+  save_state();
+
+  // The clip mask and the blend mode are applied when the layer is composited.
+  m_pimpl->current().mask.reset();
+  m_pimpl->current().blend_mode = blend_mode::normal;
+  m_pimpl->layers.push_back(
+      { m_pimpl->acquire_layer(m_pimpl->current().clip), alpha, { 0, 0, 0, 0 }, m_pimpl->states.size() });
+}
+
+void graphic_context::end_transparent_layer() {
+  if (m_pimpl->layers.empty()) {
+    return;
+  }
+
+  // States saved in the layer and never restored are dropped with it.
+  pimpl::layer layer = std::move(m_pimpl->layers.back());
+  m_pimpl->layers.pop_back();
+  m_pimpl->states.erase(m_pimpl->states.begin() + static_cast<std::ptrdiff_t>(layer.depth - 1), m_pimpl->states.end());
+
+  const pimpl::state& st = m_pimpl->current();
+  const detail::irect area = m_pimpl->target_clip().intersect(layer.drawn);
+  m_pimpl->add_drawn(area);
+
+  if (m_pimpl->tiles) {
+    if (!area.empty()) {
+      m_pimpl->tiles->composite(m_pimpl->target(), area, st.mask, st.blend_mode, *layer.target, layer.alpha);
+    }
+
+    m_pimpl->tiles->retire(std::move(layer.target));
+    return;
+  }
+
+  if (!area.empty()) {
+    detail::composite_surface(m_pimpl->target(), area, *layer.target, layer.alpha, st.mask.get(), st.blend_mode);
+  }
+
+  m_pimpl->layer_pool.push_back(std::move(layer.target));
+  m_pimpl->trim_layer_pool();
+}
+
+void graphic_context::translate(const nano::point<float>& pos) {
+  m_pimpl->current().offset = m_pimpl->current().offset + pos;
+}
+
+namespace {
+  static inline const detail::path_data& get_path_data(const nano::path& p) noexcept {
+    return *reinterpret_cast<const detail::path_data*>(p.get_native_path());
+  }
+
+  // Contours of pl mapped by scale then offset.
+  static inline void add_polyline(detail::rasterizer& rast, const detail::polyline& pl, const nano::point<float>& scale,
+      const nano::point<float>& offset) {
+    std::size_t begin = 0;
+
+    for (std::uint32_t end : pl.contours) {
+      const nano::point<float>& p0 = pl.points[begin];
+      rast.move_to(p0.x * scale.x + offset.x, p0.y * scale.y + offset.y);
+
+      for (std::size_t i = begin + 1; i < end; i++) {
+        rast.line_to(pl.points[i].x * scale.x + offset.x, pl.points[i].y * scale.y + offset.y);
+      }
+
+      rast.close();
+      begin = end;
+    }
+  }
+
+  /// Lines of a pixel or less go straight to the rasterizer, one quad per segment of pl without joins.
+  /// Only the ends of the open contours are capped, round caps are drawn square: the difference is below a pixel.
+  static inline void add_hairline(detail::rasterizer& rast, const detail::polyline& pl,
+      const detail::stroke_style& style, const nano::point<float>& offset) {
+    const float ext = style.cap == line_cap::butt ? 0.0f : style.width * 0.5f;
+    std::size_t begin = 0;
+
+    for (std::size_t c = 0; c < pl.contours.size(); c++) {
+      const std::size_t end = pl.contours[c];
+      const bool closed = pl.closed[c] && end - begin > 2;
+      const std::size_t segments = closed ? end - begin : end - begin - 1;
+      bool empty = true;
+
+      for (std::size_t k = 0; k < segments; k++) {
+        const std::size_t i = begin + k;
+        nano::point<float> p0 = pl.points[i] + offset;
+        nano::point<float> p1 = pl.points[i + 1 == end ? begin : i + 1] + offset;
+        const float dx = p1.x - p0.x;
+        const float dy = p1.y - p0.y;
+        const float len = std::sqrt(dx * dx + dy * dy);
+
+        if (len <= 0) {
+          continue;
+        }
+
+        if (!closed) {
+          const nano::point<float> e = { dx * (ext / len), dy * (ext / len) };
+          p0 = k == 0 ? p0 - e : p0;
+          p1 = k + 1 == segments ? p1 + e : p1;
+        }
+
+        rast.add_line(p0.x, p0.y, p1.x, p1.y, style.width, line_cap::butt);
+        empty = false;
+      }
+
+      // A contour of a single point is only its cap.
+      if (empty) {
+        const nano::point<float> p = pl.points[begin] + offset;
+        rast.add_line(p.x, p.y, p.x, p.y, style.width, style.cap);
+      }
+
+      begin = end;
+    }
+  }
+} // namespace.
+
+namespace {
+  // A single rectangle on pixel edges stays a scissor, any other path is rasterized into the clip mask.
+  static inline void clip_to_current_path(graphic_context::pimpl& p, detail::fill_rule rule) {
+    if (p.path.size() == 1 && p.shapes.empty() && is_pixel_aligned(p.path.front())) {
+      const nano::rect<float>& r = p.path.front();
+      p.set_clip(p.current().clip.intersect(to_irect(r.x, r.y, r.x + r.width, r.y + r.height)), p.current().mask);
+    }
+    else {
+      for (const nano::rect<float>& r : p.path) {
+        p.rast.add_rect(r.x, r.y, r.x + r.width, r.y + r.height);
+      }
+
+      for (const auto& [shape, offset] : p.shapes) {
+        add_polyline(p.rast, *get_path_data(shape).flatten(1), { 1, 1 }, offset);
+      }
+
+      p.clip_to_coverage(rule);
+    }
+
+    p.path.clear();
+    p.shapes.clear();
+  }
+} // namespace.
+
+void graphic_context::clip() { clip_to_current_path(*m_pimpl, detail::fill_rule::non_zero); }
+
+void graphic_context::clip_even_odd() { clip_to_current_path(*m_pimpl, detail::fill_rule::even_odd); }
+
+void graphic_context::clip_to_path(const nano::path& p) {
+  begin_path();
+  add_path(p);
+  clip();
+}
+
+void graphic_context::clip_to_path_even_odd(const nano::path& p) {
+  begin_path();
+  add_path(p);
+  clip_even_odd();
+}
+
+// Inside a layer the clip can't grow past the layer buffer.
+void graphic_context::reset_clip() { m_pimpl->set_clip(m_pimpl->target().bounds(), nullptr); }
+
+// Fractional edges are partially covered, they go through the clip mask like any other shape.
+void graphic_context::clip_to_rect(const nano::rect<float>& rect) {
+  const pimpl::state& st = m_pimpl->current();
+  const nano::rect<float> r = { rect.x + st.offset.x, rect.y + st.offset.y, rect.width, rect.height };
+
+  if (is_pixel_aligned(r)) {
+    m_pimpl->set_clip(st.clip.intersect(to_irect(r.x, r.y, r.x + r.width, r.y + r.height)), st.mask);
+    return;
+  }
+
+  m_pimpl->rast.add_rect(r.x, r.y, r.x + r.width, r.y + r.height);
+  m_pimpl->clip_to_coverage(detail::fill_rule::non_zero);
+}
+
+void graphic_context::clip_to_mask(const nano::image& img, const nano::rect<float>& rect) {
+  // Only the alpha is used, which doesn't depend on the premultiplication.
+  clip_to_mask(img.view(), rect);
+}
+
+void graphic_context::clip_to_mask(const nano::image_view& img, const nano::rect<float>& rect) {
+  if (!img) {
+    clip_to_rect(rect);
+    return;
+  }
+
+  // The alpha of the image drawn in rect becomes the coverage of the clip.
+  const pimpl::state& st = m_pimpl->current();
+  const nano::rect<float> dst = { rect.x + st.offset.x, rect.y + st.offset.y, rect.width, rect.height };
+  const detail::irect r = st.clip.intersect(to_irect(dst.x, dst.y, dst.x + dst.width, dst.y + dst.height));
+
+  if (r.empty()) {
+    m_pimpl->set_clip(r, nullptr);
+    return;
+  }
+
+  const std::size_t width = static_cast<std::size_t>(r.x1 - r.x0);
+  detail::surface s({ width, static_cast<std::size_t>(r.y1 - r.y0) }, image::format::rgba);
+  const detail::bitmap bmp(img);
+  detail::draw_bitmap(s, s.bounds(), bmp, nano::rect<float>(img.get_rect()),
+      { dst.x - static_cast<float>(r.x0), dst.y - static_cast<float>(r.y0), dst.width, dst.height },
+      m_pimpl->scratch);
+
+  auto mask = std::make_shared<detail::clip_mask>(r, st.mask.get());
+
+  for (int y = r.y0; y < r.y1; y++) {
+    std::uint8_t* coverage = mask->span(r.x0, y);
+    const std::uint32_t* row = s.row(y - r.y0);
+
+    for (std::size_t x = 0; x < width; x++) {
+      coverage[x] = static_cast<std::uint8_t>(detail::mul_div255(coverage[x], (row[x] >> s.layout.a) & 0xFF));
+    }
+  }
+
+  m_pimpl->set_clip(r, std::move(mask));
+}
+
+void graphic_context::add_rect(const nano::rect<float>& rect) {
+  const nano::point<float> o = m_pimpl->current().offset;
+  m_pimpl->path.push_back({ rect.x + o.x, rect.y + o.y, rect.width, rect.height });
+}
+
+void graphic_context::add_path(const nano::path& p) {
+  if (!p.empty()) {
+    m_pimpl->shapes.emplace_back(p, m_pimpl->current().offset);
+  }
+}
+
+void graphic_context::begin_path() {
+  m_pimpl->path.clear();
+  m_pimpl->shapes.clear();
+}
+
+void graphic_context::close_path() {}
+
+// The scissor bounds any clip mask, the pixels are never looked at.
+nano::rect<float> graphic_context::get_clipping_rect() const {
+  const detail::irect& c = m_pimpl->current().clip;
+  const nano::point<float> o = m_pimpl->current().offset;
+
+  if (c.empty()) {
+    return { 0, 0, 0, 0 };
+  }
+
+  return { static_cast<float>(c.x0) - o.x, static_cast<float>(c.y0) - o.y, static_cast<float>(c.x1 - c.x0),
+    static_cast<float>(c.y1 - c.y0) };
+}
+
+void graphic_context::set_line_width(float width) { m_pimpl->current().line_width = width; }
+
+void graphic_context::set_line_join(line_join lj) { m_pimpl->current().line_join = lj; }
+
+void graphic_context::set_line_cap(line_cap lc) { m_pimpl->current().line_cap = lc; }
+
+void graphic_context::set_line_style(float width, line_join lj, line_cap lc) {
+  set_line_width(width);
+  set_line_join(lj);
+  set_line_cap(lc);
+}
+
+void graphic_context::set_miter_limit(float limit) { m_pimpl->current().miter_limit = limit; }
+
+void graphic_context::set_blend_mode(nano::blend_mode mode) { m_pimpl->current().blend_mode = mode; }
+
+void graphic_context::set_fill_color(const nano::color& c) { m_pimpl->current().fill_color = c; }
+
+void graphic_context::set_stroke_color(const nano::color& c) { m_pimpl->current().stroke_color = c; }
+
+void graphic_context::fill_rect(const nano::rect<float>& r) {
+  const pimpl::state& st = m_pimpl->current();
+  const float x = r.x + st.offset.x;
+  const float y = r.y + st.offset.y;
+  m_pimpl->fill_rect(x, y, x + r.width, y + r.height, st.fill_color);
+}
+
+void graphic_context::stroke_rect(const nano::rect<float>& r) {
+  const pimpl::state& st = m_pimpl->current();
+  const float hw = st.line_width * 0.5f;
+  const float x0 = r.x + st.offset.x;
+  const float y0 = r.y + st.offset.y;
+  const float x1 = x0 + r.width;
+  const float y1 = y0 + r.height;
+
+  // The joins of a rect are right angles, a miter length of sqrt(2) times the line width.
+  if (st.line_join != line_join::miter || st.miter_limit < 1.41421356f) {
+    detail::polyline& contour = m_pimpl->contour;
+    contour.points.assign({ { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } });
+    contour.contours.assign(1, 4);
+    contour.closed.assign(1, 1);
+
+    m_pimpl->clear_outline();
+    detail::stroke_polyline(contour, m_pimpl->stroke_style(), m_pimpl->outline);
+    add_polyline(m_pimpl->rast, m_pimpl->outline, { 1, 1 }, { 0, 0 });
+    m_pimpl->fill(detail::fill_rule::non_zero, st.stroke_color);
+    return;
+  }
+
+  // Mitered corners, the hole is punched with a reversed contour.
+  m_pimpl->rast.add_rect(x0 - hw, y0 - hw, x1 + hw, y1 + hw);
+
+  if (r.width > st.line_width && r.height > st.line_width) {
+    m_pimpl->rast.add_rect(x0 + hw, y0 + hw, x1 - hw, y1 - hw, true);
+  }
+
+  m_pimpl->fill(detail::fill_rule::non_zero, st.stroke_color);
+}
+
+void graphic_context::stroke_rect(const nano::rect<float>& r, float lineWidth) {
+  set_line_width(lineWidth);
+  stroke_rect(r);
+}
+
+void graphic_context::stroke_line(const nano::point<float>& p0, const nano::point<float>& p1) {
+  const pimpl::state& st = m_pimpl->current();
+
+  // Horizontal and vertical lines, grid lines most of the time, are rectangles.
+  if ((p0.x == p1.x || p0.y == p1.y) && !(p0 == p1) && st.line_cap != line_cap::round) {
+    const float hw = st.line_width * 0.5f;
+    const float ext = st.line_cap == line_cap::square ? hw : 0.0f;
+    const float ex = p0.y == p1.y ? ext : hw;
+    const float ey = p0.y == p1.y ? hw : ext;
+    m_pimpl->fill_rect(std::min(p0.x, p1.x) + st.offset.x - ex, std::min(p0.y, p1.y) + st.offset.y - ey,
+        std::max(p0.x, p1.x) + st.offset.x + ex, std::max(p0.y, p1.y) + st.offset.y + ey, st.stroke_color);
+    return;
+  }
+
+  m_pimpl->rast.add_line(p0.x + st.offset.x, p0.y + st.offset.y, p1.x + st.offset.x, p1.y + st.offset.y,
+      st.line_width, st.line_cap);
+  m_pimpl->fill(detail::fill_rule::non_zero, st.stroke_color);
+}
+
+void graphic_context::fill_ellipse(const nano::rect<float>& r) {
+  const pimpl::state& st = m_pimpl->current();
+  const float rx = r.width * 0.5f;
+  const float ry = r.height * 0.5f;
+  m_pimpl->rast.add_ellipse(r.x + st.offset.x + rx, r.y + st.offset.y + ry, rx, ry);
+  m_pimpl->fill(detail::fill_rule::non_zero, st.fill_color);
+}
+
+void graphic_context::stroke_ellipse(const nano::rect<float>& r) {
+  const pimpl::state& st = m_pimpl->current();
+  const float hw = st.line_width * 0.5f;
+  const float rx = r.width * 0.5f;
+  const float ry = r.height * 0.5f;
+  const float cx = r.x + st.offset.x + rx;
+  const float cy = r.y + st.offset.y + ry;
+
+  m_pimpl->rast.add_ellipse(cx, cy, rx + hw, ry + hw);
+  m_pimpl->rast.add_ellipse(cx, cy, rx - hw, ry - hw, true);
+  m_pimpl->fill(detail::fill_rule::non_zero, st.stroke_color);
+}
+
+void graphic_context::fill_rounded_rect(const nano::rect<float>& r, float radius) {
+  const pimpl::state& st = m_pimpl->current();
+  const float x = r.x + st.offset.x;
+  const float y = r.y + st.offset.y;
+  m_pimpl->rast.add_rounded_rect(x, y, x + r.width, y + r.height, radius);
+  m_pimpl->fill(detail::fill_rule::non_zero, st.fill_color);
+}
+
+void graphic_context::stroke_rounded_rect(const nano::rect<float>& r, float radius) {
+  const pimpl::state& st = m_pimpl->current();
+  const float hw = st.line_width * 0.5f;
+  const float x0 = r.x + st.offset.x;
+  const float y0 = r.y + st.offset.y;
+  const float x1 = x0 + r.width;
+  const float y1 = y0 + r.height;
+
+  m_pimpl->rast.add_rounded_rect(x0 - hw, y0 - hw, x1 + hw, y1 + hw, radius + hw);
+
+  if (r.width > st.line_width && r.height > st.line_width) {
+    m_pimpl->rast.add_rounded_rect(x0 + hw, y0 + hw, x1 - hw, y1 - hw, std::max(radius - hw, 0.0f), true);
+  }
+
+  m_pimpl->fill(detail::fill_rule::non_zero, st.stroke_color);
+}
+
+void graphic_context::fill_path(const nano::path& p) { fill_path(p, { 0, 0, 1, 1 }); }
+
+void graphic_context::fill_path(const nano::path& p, const nano::rect<float>& rect) {
+  if (p.empty()) {
+    return;
+  }
+
+  const pimpl::state& st = m_pimpl->current();
+  const nano::point<float> scale = { rect.width, rect.height };
+  const std::shared_ptr<const detail::polyline> pl
+      = get_path_data(p).flatten(std::max(std::abs(scale.x), std::abs(scale.y)));
+  add_polyline(m_pimpl->rast, *pl, scale, { rect.x + st.offset.x, rect.y + st.offset.y });
+  m_pimpl->fill(detail::fill_rule::non_zero, st.fill_color);
+}
+
+void graphic_context::stroke_path(const nano::path& p) {
+  if (p.empty()) {
+    return;
+  }
+
+  const pimpl::state& st = m_pimpl->current();
+  const detail::path_data& d = get_path_data(p);
+
+  // Hairlines skip the joins, the outline and its cache.
+  if (st.line_width <= 1.0f) {
+    add_hairline(m_pimpl->rast, *d.flatten(1), m_pimpl->stroke_style(), st.offset);
+  }
+  else {
+    add_polyline(m_pimpl->rast, *d.stroke(m_pimpl->stroke_style()), { 1, 1 }, st.offset);
+  }
+
+  m_pimpl->fill(detail::fill_rule::non_zero, st.stroke_color);
+}
+
+void graphic_context::draw_image(const nano::image& img, const nano::point<float>& pos) {
+  draw_image(img, nano::rect<float>(pos, img.get_size()));
+}
+
+void graphic_context::draw_image(const nano::image& img, const nano::rect<float>& rect) {
+  draw_sub_image(img, rect, nano::rect<float>(img.get_rect()));
+}
+
+void graphic_context::draw_image(
+    const nano::image& img, const nano::rect<float>& rect, const nano::rect<float>& clipRect) {
+  save_state();
+  translate(rect.position);
+  clip_to_rect(clipRect);
+  draw_image(img, rect.with_position({ 0.0f, 0.0f }));
+  restore_state();
+}
+
+void graphic_context::draw_sub_image(
+    const nano::image& img, const nano::rect<float>& rect, const nano::rect<float>& imgRect) {
+  if (!img.is_valid()) {
+    return;
+  }
+
+  const nano::point<float> o = m_pimpl->current().offset;
+  const nano::rect<float> dst = { rect.x + o.x, rect.y + o.y, rect.width, rect.height };
+  const detail::bitmap& bmp = *reinterpret_cast<const detail::bitmap*>(img.get_native_image());
+
+  // Size of the whole image at the scale of the draw.
+  detail::bitmap* level = bmp.mipmaps && imgRect.width > 0 && imgRect.height > 0
+      ? bmp.mipmaps->get_level(bmp,
+            { static_cast<float>(bmp.size.width) * rect.width / imgRect.width,
+                static_cast<float>(bmp.size.height) * rect.height / imgRect.height })
+      : nullptr;
+
+  if (!level) {
+    m_pimpl->draw_bitmap(bmp, imgRect, dst);
+    return;
+  }
+
+  const float sx = static_cast<float>(level->size.width) / static_cast<float>(bmp.size.width);
+  const float sy = static_cast<float>(level->size.height) / static_cast<float>(bmp.size.height);
+  m_pimpl->draw_bitmap(*level, { imgRect.x * sx, imgRect.y * sy, imgRect.width * sx, imgRect.height * sy }, dst);
+  detail::bitmap::release(level);
+}
+
+void graphic_context::draw_image(const nano::image_view& img, const nano::rect<float>& rect) {
+  draw_sub_image(img, rect, nano::rect<float>(img.get_rect()));
+}
+
+void graphic_context::draw_sub_image(
+    const nano::image_view& img, const nano::rect<float>& rect, const nano::rect<float>& imgRect) {
+  if (!img) {
+    return;
+  }
+
+  // The tile renderer keeps the bitmap until flush(), the view might not live that long.
+  // Only the pixels that can be sampled are copied.
+  if (m_pimpl->tiles) {
+    const float x0 = std::floor(std::max(imgRect.x, 0.0f));
+    const float y0 = std::floor(std::max(imgRect.y, 0.0f));
+    const float x1 = std::ceil(std::min(imgRect.x + imgRect.width, static_cast<float>(img.size.width)));
+    const float y1 = std::ceil(std::min(imgRect.y + imgRect.height, static_cast<float>(img.size.height)));
+
+    if (x0 < x1 && y0 < y1) {
+      const nano::image copy(img.sub_view({ static_cast<std::size_t>(x0), static_cast<std::size_t>(y0),
+          static_cast<std::size_t>(x1 - x0), static_cast<std::size_t>(y1 - y0) }));
+      draw_sub_image(copy, rect, { imgRect.x - x0, imgRect.y - y0, imgRect.width, imgRect.height });
+    }
+    return;
+  }
+
+  const nano::point<float> o = m_pimpl->current().offset;
+  const detail::bitmap bmp(img);
+  m_pimpl->draw_bitmap(bmp, imgRect, { rect.x + o.x, rect.y + o.y, rect.width, rect.height });
+}
+
+//
+// MARK: Text.
+//
+
+void graphic_context::draw_text(const nano::font& f, const std::string& text, const nano::point<float>& pos) {
+  (void)f;
+  (void)text;
+  (void)pos;
+}
+
+void graphic_context::draw_text(
+    const nano::font& f, const std::string& text, const nano::rect<float>& rect, nano::text_alignment alignment) {
+  (void)f;
+  (void)text;
+  (void)rect;
+  (void)alignment;
+}
+
+graphic_context::handle graphic_context::get_handle() const noexcept { return reinterpret_cast<handle>(m_pimpl->root); }
+
+bool graphic_context::is_bitmap() const noexcept { return m_pimpl->is_bitmap; }
+
+void graphic_context::set_tiled_rendering(bool enabled, std::size_t thread_count) {
+  if (!enabled) {
+    m_pimpl->flush();
+    m_pimpl->tiles.reset();
+    return;
+  }
+
+  if (!m_pimpl->tiles) {
+    m_pimpl->tiles = std::make_unique<detail::tile_renderer>();
+  }
+
+  m_pimpl->tile_threads = thread_count;
+}
+
+bool graphic_context::is_tiled_rendering() const noexcept { return m_pimpl->tiles != nullptr; }
+
+void graphic_context::flush() {
+  m_pimpl->flush();
+  m_pimpl->damage.clear();
+}
+
+namespace {
+  static inline nano::rect<std::size_t> to_rect(const detail::irect& r) noexcept {
+    return { static_cast<std::size_t>(r.x0), static_cast<std::size_t>(r.y0), static_cast<std::size_t>(r.x1 - r.x0),
+      static_cast<std::size_t>(r.y1 - r.y0) };
+  }
+} // namespace.
+
+std::vector<nano::rect<std::size_t>> graphic_context::get_damage() const {
+  std::vector<nano::rect<std::size_t>> rects;
+  rects.reserve(m_pimpl->damage.rects().size());
+
+  for (const detail::irect& r : m_pimpl->damage.rects()) {
+    rects.push_back(to_rect(r));
+  }
+
+  return rects;
+}
+
+nano::rect<std::size_t> graphic_context::get_damage_bounds() const { return to_rect(m_pimpl->damage.bounds()); }
+
+void graphic_context::add_damage(const nano::rect<float>& rect) {
+  const nano::point<float> o = m_pimpl->current().offset;
+  const detail::irect r = to_irect(rect.x + o.x, rect.y + o.y, rect.x + o.x + rect.width, rect.y + o.y + rect.height);
+  m_pimpl->damage.add(r.intersect(m_pimpl->root->bounds()));
+}
+
+void graphic_context::clip_to_damage() {
+  m_pimpl->set_clip(m_pimpl->current().clip.intersect(m_pimpl->damage.bounds()), m_pimpl->current().mask);
+}
+
+void graphic_context::reset_damage() { m_pimpl->damage.clear(); }
+
+nano::image graphic_context::create_image() {
+  if (!is_bitmap()) {
+    return image();
+  }
+
+  m_pimpl->flush();
+  m_pimpl->damage.clear();
+
+  const detail::surface& s = *m_pimpl->root;
+  detail::bitmap* bmp = detail::bitmap::create({ s.width, s.height }, s.fmt);
+  bmp->premultiplied = true;
+
+  for (std::size_t y = 0; y < s.height; y++) {
+    std::memcpy(bmp->row(y), s.row(static_cast<int>(y)), s.width * sizeof(std::uint32_t));
+  }
+
+  return make_image(bmp);
+}
+
+graphic_context graphic_context::create_bitmap_context(const nano::size<std::size_t>& size, image::format fmt) {
+  return graphic_context(new detail::surface(size, fmt), true);
+}
+
+} // namespace nano.
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
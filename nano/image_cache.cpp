@@ -0,0 +1,221 @@
+#include <nano/graphics_cache.h>
+
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace nano {
+namespace {
+  /// What tells that a file changed since it was loaded.
+  struct file_stamp {
+    std::filesystem::file_time_type time;
+    std::uintmax_t size = 0;
+
+    inline bool operator==(const file_stamp& s) const noexcept { return time == s.time && size == s.size; }
+  };
+
+  static inline file_stamp get_file_stamp(const std::filesystem::path& filepath) {
+    std::error_code ec;
+    file_stamp stamp;
+    stamp.time = std::filesystem::last_write_time(filepath, ec);
+    stamp.size = ec ? 0 : std::filesystem::file_size(filepath, ec);
+    return stamp;
+  }
+
+  static inline std::size_t get_byte_size(const image& img) { return img.get_bytes_per_row() * img.height(); }
+} // namespace.
+
+struct image_cache::pimpl {
+  struct entry {
+    /// Tells the load of the entry from the one of an entry that replaced it.
+    std::uint64_t id;
+    image::type img_type;
+    file_stamp stamp;
+    image::load_priority priority;
+
+    /// Shared with the requests, the image is in it once loaded.
+    async_image load;
+    bool loaded = false;
+    std::size_t bytes = 0;
+
+    std::list<std::string>::iterator lru;
+  };
+
+  using entry_map = std::unordered_map<std::string, entry>;
+
+  explicit pimpl(std::size_t budget)
+      : byte_budget(budget) {}
+
+  async_image request(const std::filesystem::path& filepath, image::type fmt, image::load_priority priority) {
+    const std::string key = filepath.lexically_normal().string();
+    const file_stamp stamp = get_file_stamp(filepath);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    entry_map::iterator it = entries.find(key);
+
+    // A caller can cancel the shared load before it starts, the entry would then never be loaded.
+    if (it != entries.end() && it->second.stamp == stamp && it->second.img_type == fmt
+        && it->second.load.get_status() != async_image::status::cancelled) {
+      entry& e = it->second;
+      lru.splice(lru.begin(), lru, e.lru);
+      counters.hits++;
+
+      // A prefetch becomes urgent when something waits for it, the other way around it stays urgent.
+      if (!e.loaded && priority > e.priority) {
+        e.priority = priority;
+        e.load.set_priority(priority);
+      }
+
+      return e.load;
+    }
+
+    if (it != entries.end()) {
+      drop(it);
+    }
+
+    counters.misses++;
+
+    const std::uint64_t id = next_id++;
+    lru.push_front(key);
+    entry& e = entries.emplace(key, entry{ id, fmt, stamp, priority, {}, false, 0, lru.begin() }).first->second;
+
+    // The entry can't be found before the lock is released, the callback locks it too.
+    e.load = image::load_async(
+        filepath.string(), fmt, priority, [this, key, id](const image& img) { on_loaded(key, id, img); });
+
+    loads.erase(std::remove_if(loads.begin(), loads.end(), [](const async_image& l) { return l.is_ready(); }),
+        loads.end());
+    loads.push_back(e.load);
+    return e.load;
+  }
+
+  void on_loaded(const std::string& key, std::uint64_t id, const image& img) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entry_map::iterator it = entries.find(key);
+
+    // Erased or replaced while loading.
+    if (it == entries.end() || it->second.id != id) {
+      return;
+    }
+
+    if (!img) {
+      drop(it);
+      return;
+    }
+
+    it->second.loaded = true;
+    it->second.bytes = get_byte_size(img);
+    bytes += it->second.bytes;
+    evict();
+  }
+
+  /// Drops the least recently used loaded entries until the budget is met, loading ones have no size yet.
+  void evict() {
+    // it is after the entry to look at, dropping that entry leaves it valid.
+    for (auto it = lru.end(); bytes > byte_budget && it != lru.begin();) {
+      entry_map::iterator e = entries.find(*std::prev(it));
+
+      if (e->second.loaded) {
+        drop(e);
+        counters.evictions++;
+      }
+      else {
+        --it;
+      }
+    }
+  }
+
+  void drop(entry_map::iterator it) {
+    entry& e = it->second;
+
+    if (!e.loaded) {
+      e.load.cancel();
+    }
+
+    bytes -= e.bytes;
+    lru.erase(e.lru);
+    entries.erase(it);
+  }
+
+  mutable std::mutex mutex;
+  entry_map entries;
+
+  /// Keys from the most to the least recently used.
+  std::list<std::string> lru;
+
+  std::size_t byte_budget;
+  std::size_t bytes = 0;
+  std::uint64_t next_id = 0;
+  stats counters;
+
+  /// Every load that may still call back, including the ones of dropped entries.
+  std::vector<async_image> loads;
+};
+
+image_cache::image_cache(std::size_t byte_budget) { m_pimpl = new pimpl(byte_budget); }
+
+image_cache::~image_cache() {
+  std::vector<async_image> loads;
+
+  {
+    std::lock_guard<std::mutex> lock(m_pimpl->mutex);
+    loads.swap(m_pimpl->loads);
+  }
+
+  // The running loads call back into the cache.
+  for (async_image& load : loads) {
+    load.cancel();
+    load.get();
+  }
+
+  delete m_pimpl;
+}
+
+image image_cache::get(const std::filesystem::path& filepath, image::type fmt) {
+  return m_pimpl->request(filepath, fmt, image::load_priority::high).get();
+}
+
+async_image image_cache::get_async(
+    const std::filesystem::path& filepath, image::type fmt, image::load_priority priority) {
+  return m_pimpl->request(filepath, fmt, priority);
+}
+
+void image_cache::set_byte_budget(std::size_t byte_budget) {
+  std::lock_guard<std::mutex> lock(m_pimpl->mutex);
+  m_pimpl->byte_budget = byte_budget;
+  m_pimpl->evict();
+}
+
+std::size_t image_cache::get_byte_budget() const {
+  std::lock_guard<std::mutex> lock(m_pimpl->mutex);
+  return m_pimpl->byte_budget;
+}
+
+void image_cache::erase(const std::filesystem::path& filepath) {
+  std::lock_guard<std::mutex> lock(m_pimpl->mutex);
+  auto it = m_pimpl->entries.find(filepath.lexically_normal().string());
+
+  if (it != m_pimpl->entries.end()) {
+    m_pimpl->drop(it);
+  }
+}
+
+void image_cache::clear() {
+  std::lock_guard<std::mutex> lock(m_pimpl->mutex);
+
+  while (!m_pimpl->entries.empty()) {
+    m_pimpl->drop(m_pimpl->entries.begin());
+  }
+}
+
+image_cache::stats image_cache::get_stats() const {
+  std::lock_guard<std::mutex> lock(m_pimpl->mutex);
+  stats s = m_pimpl->counters;
+  s.bytes = m_pimpl->bytes;
+  s.count = m_pimpl->entries.size();
+  return s;
+}
+} // namespace nano.
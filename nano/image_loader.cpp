@@ -0,0 +1,215 @@
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+#include <array>
+
+namespace nano {
+struct async_image::state {
+  state(const std::string& path, image::type t, image::load_priority p, std::function<void(const image&)> fct)
+      : filepath(path)
+      , img_type(t)
+      , priority(p)
+      , on_loaded(std::move(fct)) {}
+
+  const std::string filepath;
+  const image::type img_type;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  image::load_priority priority;
+  status current = status::pending;
+  image result;
+
+  std::function<void(const image&)> on_loaded;
+};
+
+namespace {
+  /// Decoding is mostly bound by memory and the disk, a few threads are enough to keep them busy
+  /// and leave the cores to rendering.
+  constexpr std::size_t k_max_decode_threads = 4;
+
+  constexpr std::size_t k_priority_count = 3;
+
+  /// Pending loads by priority on a thread_pool of its own. Each push adds one task to the pool, which runs
+  /// the pending load with the highest priority: there are never less tasks than loads to run.
+  /// A load whose priority changed is pushed again, the entry left in the other queue is skipped.
+  class load_queue {
+  public:
+    static load_queue& shared() {
+      static load_queue queue;
+      return queue;
+    }
+
+    load_queue()
+        : m_pool(std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, k_max_decode_threads + 1) - 1) {}
+
+    /// The loads that didn't start are cancelled, the pool then waits for the running ones.
+    ~load_queue() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (auto& pending : m_pending) {
+        for (const std::shared_ptr<async_image::state>& s : pending) {
+          std::lock_guard<std::mutex> state_lock(s->mutex);
+
+          if (s->current == async_image::status::pending) {
+            s->current = async_image::status::cancelled;
+            s->condition.notify_all();
+          }
+        }
+
+        pending.clear();
+      }
+    }
+
+    void push(const std::shared_ptr<async_image::state>& s, image::load_priority priority) {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending[static_cast<std::size_t>(priority)].push_back(s);
+      }
+
+      m_pool.push([this]() { run_next(); });
+    }
+
+  private:
+    /// The next load to run, its status is running.
+    std::shared_ptr<async_image::state> pop() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (std::size_t p = k_priority_count; p-- > 0;) {
+        while (!m_pending[p].empty()) {
+          std::shared_ptr<async_image::state> s = std::move(m_pending[p].front());
+          m_pending[p].pop_front();
+
+          std::lock_guard<std::mutex> state_lock(s->mutex);
+          if (s->current == async_image::status::pending && static_cast<std::size_t>(s->priority) == p) {
+            s->current = async_image::status::running;
+            return s;
+          }
+        }
+      }
+
+      return nullptr;
+    }
+
+    void run_next() {
+      std::shared_ptr<async_image::state> s = pop();
+
+      if (!s) {
+        return;
+      }
+
+      const image img(s->filepath, s->img_type);
+
+      if (s->on_loaded) {
+        s->on_loaded(img);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->result = img;
+        s->current = async_image::status::done;
+      }
+
+      s->condition.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::array<std::deque<std::shared_ptr<async_image::state>>, k_priority_count> m_pending;
+
+    // Last, its threads are joined before the queues are destroyed.
+    detail::thread_pool m_pool;
+  };
+} // namespace.
+
+async_image image::load_async(
+    const std::string& filepath, type fmt, load_priority priority, std::function<void(const image&)> on_loaded) {
+  async_image request;
+  request.m_state = std::make_shared<async_image::state>(filepath, fmt, priority, std::move(on_loaded));
+  load_queue::shared().push(request.m_state, priority);
+  return request;
+}
+
+std::vector<async_image> image::prefetch(const std::vector<std::string>& filepaths, type fmt) {
+  std::vector<async_image> requests;
+  requests.reserve(filepaths.size());
+
+  for (const std::string& filepath : filepaths) {
+    requests.push_back(load_async(filepath, fmt, load_priority::low));
+  }
+
+  return requests;
+}
+
+async_image::status async_image::get_status() const {
+  if (!m_state) {
+    return status::cancelled;
+  }
+
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+  return m_state->current;
+}
+
+bool async_image::is_ready() const {
+  const status s = get_status();
+  return s == status::done || s == status::cancelled;
+}
+
+bool async_image::wait_for(std::chrono::milliseconds timeout) const {
+  if (!m_state) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(m_state->mutex);
+  return m_state->condition.wait_for(lock, timeout, [this]() {
+    return m_state->current == status::done || m_state->current == status::cancelled;
+  });
+}
+
+image async_image::get() const {
+  if (!m_state) {
+    return image();
+  }
+
+  std::unique_lock<std::mutex> lock(m_state->mutex);
+  m_state->condition.wait(
+      lock, [this]() { return m_state->current == status::done || m_state->current == status::cancelled; });
+  return m_state->result;
+}
+
+bool async_image::cancel() {
+  if (!m_state) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+
+    if (m_state->current != status::pending) {
+      return m_state->current == status::cancelled;
+    }
+
+    m_state->current = status::cancelled;
+  }
+
+  m_state->condition.notify_all();
+  return true;
+}
+
+void async_image::set_priority(image::load_priority priority) {
+  if (!m_state) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+
+    if (m_state->current != status::pending || m_state->priority == priority) {
+      return;
+    }
+
+    m_state->priority = priority;
+  }
+
+  load_queue::shared().push(m_state, priority);
+}
+} // namespace nano.
@@ -0,0 +1,313 @@
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace nano {
+namespace {
+  constexpr std::uint8_t k_png_signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+  constexpr char k_raw_magic[8] = { 'N', 'A', 'N', 'O', 'I', 'M', 'G', '\0' };
+
+  /// Chunks skipped before giving up on finding IHDR and IDAT, a valid file has a handful of them.
+  constexpr std::size_t k_max_chunks = 256;
+
+  /// Bytes read from an EXIF segment, IFD0 and its resolution come first and segments can hold a thumbnail.
+  constexpr std::size_t k_exif_bytes = 4096;
+
+  constexpr double k_meters_per_inch = 0.0254;
+  constexpr double k_cm_per_inch = 2.54;
+
+  static inline std::uint32_t read_be32(const std::uint8_t* p) noexcept {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+  }
+
+  static inline std::uint16_t read_be16(const std::uint8_t* p) noexcept {
+    return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+  }
+
+  static inline bool read(std::istream& in, void* data, std::size_t n) {
+    in.read(static_cast<char*>(data), static_cast<std::streamsize>(n));
+    return static_cast<std::size_t>(in.gcount()) == n;
+  }
+
+  static inline bool skip(std::istream& in, std::size_t n) {
+    return static_cast<bool>(in.seekg(static_cast<std::streamoff>(n), std::ios::cur));
+  }
+
+  static inline std::size_t get_channel_count(image::format fmt) noexcept {
+    switch (fmt) {
+    case image::format::alpha:
+    case image::format::float_alpha:
+      return 1;
+
+    case image::format::rgb:
+    case image::format::rgbx:
+    case image::format::xbgr:
+    case image::format::xrgb:
+    case image::format::bgrx:
+    case image::format::float_rgb:
+      return 3;
+
+    default:
+      return 4;
+    }
+  }
+
+  /// The signature was read, stops at the first IDAT chunk.
+  static bool probe_png(std::istream& in, image::file_info& info) {
+    std::uint8_t color_type = 0;
+    bool transparent = false;
+
+    for (std::size_t i = 0; i < k_max_chunks; i++) {
+      std::uint8_t header[8];
+      if (!read(in, header, sizeof(header))) {
+        return false;
+      }
+
+      const std::uint32_t length = read_be32(header);
+      const char* type = reinterpret_cast<const char*>(header + 4);
+
+      if (i == 0) {
+        std::uint8_t ihdr[13];
+        if (std::memcmp(type, "IHDR", 4) != 0 || length != sizeof(ihdr) || !read(in, ihdr, sizeof(ihdr))) {
+          return false;
+        }
+
+        info.size = { read_be32(ihdr), read_be32(ihdr + 4) };
+        info.bits_per_component = ihdr[9] == 3 ? 8 : ihdr[8];
+        color_type = ihdr[9];
+      }
+      else if (std::memcmp(type, "pHYs", 4) == 0 && length == 9) {
+        std::uint8_t phys[9];
+        if (!read(in, phys, sizeof(phys))) {
+          return false;
+        }
+
+        // Otherwise only the aspect ratio is known.
+        if (phys[8] == 1) {
+          info.dpi = { read_be32(phys) * k_meters_per_inch, read_be32(phys + 4) * k_meters_per_inch };
+        }
+      }
+      else if (std::memcmp(type, "IDAT", 4) == 0 || std::memcmp(type, "IEND", 4) == 0) {
+        break;
+      }
+      else {
+        transparent = transparent || std::memcmp(type, "tRNS", 4) == 0;
+
+        if (!skip(in, length)) {
+          return false;
+        }
+      }
+
+      // crc.
+      if (!skip(in, 4)) {
+        return false;
+      }
+    }
+
+    switch (color_type) {
+    case 0:
+      info.channels = transparent ? 2 : 1;
+      break;
+
+    case 2:
+    case 3:
+      info.channels = transparent ? 4 : 3;
+      break;
+
+    case 4:
+      info.channels = 2;
+      break;
+
+    case 6:
+      info.channels = 4;
+      break;
+
+    default:
+      return false;
+    }
+
+    return info.size.width && info.size.height;
+  }
+
+  /// Resolution of the first IFD of an EXIF segment, data starts after "Exif\0\0".
+  static nano::size<double> read_exif_dpi(const std::uint8_t* data, std::size_t size) {
+    if (size < 8 || (std::memcmp(data, "II", 2) != 0 && std::memcmp(data, "MM", 2) != 0)) {
+      return { 0.0, 0.0 };
+    }
+
+    const bool little_endian = data[0] == 'I';
+    const auto u16 = [&](std::size_t i) -> std::uint32_t {
+      return little_endian ? data[i] | (data[i + 1] << 8) : (data[i] << 8) | data[i + 1];
+    };
+
+    const auto u32 = [&](std::size_t i) -> std::uint32_t {
+      return little_endian ? u16(i) | (u16(i + 2) << 16) : (u16(i) << 16) | u16(i + 2);
+    };
+
+    const std::size_t ifd = u32(4);
+    if (u16(2) != 42 || ifd > size - 2) {
+      return { 0.0, 0.0 };
+    }
+
+    // Rationals are stored after the entries, resolution_unit defaults to inches.
+    double resolution[2] = { 0.0, 0.0 };
+    std::uint32_t unit = 2;
+    const std::size_t count = u16(ifd);
+
+    for (std::size_t i = 0; i < count && ifd + 2 + (i + 1) * 12 <= size; i++) {
+      const std::size_t entry = ifd + 2 + i * 12;
+      const std::uint32_t tag = u16(entry);
+
+      if ((tag == 0x011A || tag == 0x011B) && u16(entry + 2) == 5) {
+        const std::size_t offset = u32(entry + 8);
+
+        if (offset <= size - 8 && u32(offset + 4)) {
+          resolution[tag - 0x011A] = static_cast<double>(u32(offset)) / u32(offset + 4);
+        }
+      }
+      else if (tag == 0x0128) {
+        unit = u16(entry + 8);
+      }
+    }
+
+    const double scale = unit == 2 ? 1.0 : unit == 3 ? k_cm_per_inch : 0.0;
+    return { resolution[0] * scale, resolution[1] * scale };
+  }
+
+  static inline bool is_frame_marker(std::uint8_t marker) noexcept {
+    // SOF0 to SOF15, without DHT, JPG and DAC.
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+  }
+
+  /// SOI was read, stops at the frame header. JFIF density comes first when it has a unit, then EXIF.
+  static bool probe_jpeg(std::istream& in, image::file_info& info) {
+    nano::size<double> jfif_dpi = { 0.0, 0.0 };
+    nano::size<double> exif_dpi = { 0.0, 0.0 };
+
+    for (;;) {
+      std::uint8_t marker[2];
+      if (!read(in, marker, 2) || marker[0] != 0xFF) {
+        return false;
+      }
+
+      // Fill bytes.
+      while (marker[1] == 0xFF) {
+        if (!read(in, marker + 1, 1)) {
+          return false;
+        }
+      }
+
+      // Markers without a segment.
+      if (marker[1] == 0x01 || (marker[1] >= 0xD0 && marker[1] <= 0xD8)) {
+        continue;
+      }
+
+      std::uint8_t length_bytes[2];
+      if (marker[1] == 0xD9 || marker[1] == 0xDA || !read(in, length_bytes, 2) || read_be16(length_bytes) < 2) {
+        return false;
+      }
+
+      std::size_t length = read_be16(length_bytes) - 2u;
+
+      if (is_frame_marker(marker[1])) {
+        std::uint8_t frame[6];
+        if (length < sizeof(frame) || !read(in, frame, sizeof(frame))) {
+          return false;
+        }
+
+        info.bits_per_component = frame[0];
+        info.size = { read_be16(frame + 3), read_be16(frame + 1) };
+        info.channels = frame[5] == 1 ? 1 : 3;
+        info.dpi = jfif_dpi.width > 0 ? jfif_dpi : exif_dpi;
+        return info.size.width && info.size.height && (frame[5] == 1 || frame[5] == 3 || frame[5] == 4);
+      }
+
+      if (marker[1] == 0xE0 && length >= 14) {
+        std::uint8_t jfif[14];
+        if (!read(in, jfif, sizeof(jfif))) {
+          return false;
+        }
+
+        length -= sizeof(jfif);
+        const double scale = jfif[7] == 1 ? 1.0 : jfif[7] == 2 ? k_cm_per_inch : 0.0;
+
+        if (std::memcmp(jfif, "JFIF", 5) == 0) {
+          jfif_dpi = { read_be16(jfif + 8) * scale, read_be16(jfif + 10) * scale };
+        }
+      }
+      else if (marker[1] == 0xE1 && length >= 6) {
+        std::uint8_t exif[k_exif_bytes];
+        const std::size_t n = std::min(length, sizeof(exif));
+
+        if (!read(in, exif, n)) {
+          return false;
+        }
+
+        length -= n;
+
+        if (std::memcmp(exif, "Exif\0\0", 6) == 0) {
+          exif_dpi = read_exif_dpi(exif + 6, n - 6);
+        }
+      }
+
+      if (!skip(in, length)) {
+        return false;
+      }
+    }
+  }
+
+  static bool probe_raw(const std::filesystem::path& filepath, image::file_info& info) {
+    // Only the header page is read, the file is mapped to check that every row is there.
+    detail::bitmap* bmp = detail::map_raw_image(filepath);
+
+    if (!bmp) {
+      return false;
+    }
+
+    info.size = bmp->size;
+    info.channels = get_channel_count(bmp->fmt);
+    info.bits_per_component = bmp->bits_per_component;
+    detail::bitmap::release(bmp);
+    return true;
+  }
+} // namespace.
+
+nano::size<double> image::get_dpi(const std::string& filepath) { return probe(filepath).dpi; }
+
+image::file_info image::probe(const std::filesystem::path& filepath) {
+  file_info info;
+  std::ifstream in(filepath, std::ios::binary);
+  std::uint8_t signature[8];
+
+  if (!read(in, signature, sizeof(signature))) {
+    return info;
+  }
+
+  if (std::memcmp(signature, k_png_signature, sizeof(signature)) == 0) {
+    info.file_type = type::png;
+    info.valid = probe_png(in, info);
+  }
+  else if (signature[0] == 0xFF && signature[1] == 0xD8) {
+    info.file_type = type::jpeg;
+    info.valid = in.seekg(2) && probe_jpeg(in, info);
+  }
+  else if (std::memcmp(signature, k_raw_magic, sizeof(signature)) == 0) {
+    in.close();
+    info.file_type = type::raw;
+    info.valid = probe_raw(filepath, info);
+  }
+
+  return info.valid ? info : file_info();
+}
+
+std::vector<image::file_info> image::probe(const std::vector<std::filesystem::path>& filepaths) {
+  std::vector<file_info> infos(filepaths.size());
+
+  // Mostly waiting for the disk, every file is a task.
+  detail::thread_pool::shared().parallel_for(
+      filepaths.size(), 0, [&](std::size_t i) { infos[i] = probe(filepaths[i]); });
+  return infos;
+}
+} // namespace nano.
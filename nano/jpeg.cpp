@@ -0,0 +1,242 @@
+#include <nano/graphics_codec.h>
+
+// CoreGraphics loads jpeg files with ImageIO.
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  #include <nano/graphics_raster.h>
+
+  #include <csetjmp>
+  #include <cstdio>
+  #include <cstring>
+  #include <fstream>
+  #include <vector>
+
+  #include <jpeglib.h>
+  #include <jerror.h>
+
+namespace nano {
+namespace {
+  /// Bytes read from the stream at once.
+  constexpr std::size_t k_buffer_size = 1 << 16;
+
+  /// libjpeg reports errors through error_exit, which jumps back to the last setjmp instead of exiting.
+  /// Only the functions calling setjmp are between the jump and libjpeg, they have no objects to destroy.
+  struct error_manager {
+    jpeg_error_mgr mgr;
+    std::jmp_buf jump;
+  };
+
+  static void error_exit(j_common_ptr info) { std::longjmp(reinterpret_cast<error_manager*>(info->err)->jump, 1); }
+
+  /// Warnings are ignored, libjpeg recovers from them.
+  static void output_message(j_common_ptr) {}
+
+  struct stream_source {
+    jpeg_source_mgr mgr;
+    std::istream* in;
+    JOCTET buffer[k_buffer_size];
+  };
+
+  static void init_source(j_decompress_ptr) {}
+
+  static void term_source(j_decompress_ptr) {}
+
+  static boolean fill_input_buffer(j_decompress_ptr info) {
+    stream_source& src = *reinterpret_cast<stream_source*>(info->src);
+    src.in->read(reinterpret_cast<char*>(src.buffer), sizeof(src.buffer));
+
+    // A truncated file is an error, libjpeg would otherwise fill the missing rows with gray.
+    if (src.in->gcount() <= 0) {
+      ERREXIT(info, JERR_INPUT_EOF);
+    }
+
+    src.mgr.next_input_byte = src.buffer;
+    src.mgr.bytes_in_buffer = static_cast<std::size_t>(src.in->gcount());
+    return TRUE;
+  }
+
+  static void skip_input_data(j_decompress_ptr info, long count) {
+    jpeg_source_mgr& mgr = *info->src;
+
+    if (count <= 0) {
+      return;
+    }
+
+    while (static_cast<std::size_t>(count) > mgr.bytes_in_buffer) {
+      count -= static_cast<long>(mgr.bytes_in_buffer);
+      fill_input_buffer(info);
+    }
+
+    mgr.next_input_byte += count;
+    mgr.bytes_in_buffer -= static_cast<std::size_t>(count);
+  }
+} // namespace.
+
+struct jpeg_decoder::pimpl {
+  pimpl(std::istream& s, image::decode_scale scale)
+      : in(s) {
+    valid = start(scale);
+  }
+
+  pimpl(const std::filesystem::path& filepath, image::decode_scale scale)
+      : file(filepath, std::ios::binary)
+      , in(file) {
+    valid = file.is_open() && start(scale);
+  }
+
+  ~pimpl() {
+    if (created) {
+      jpeg_destroy_decompress(&info);
+    }
+  }
+
+  bool start(image::decode_scale scale) {
+    info.err = jpeg_std_error(&error.mgr);
+    error.mgr.error_exit = &error_exit;
+    error.mgr.output_message = &output_message;
+
+    if (setjmp(error.jump)) {
+      return false;
+    }
+
+    jpeg_create_decompress(&info);
+    created = true;
+
+    source.in = &in;
+    source.mgr.init_source = &init_source;
+    source.mgr.fill_input_buffer = &fill_input_buffer;
+    source.mgr.skip_input_data = &skip_input_data;
+    source.mgr.resync_to_restart = &jpeg_resync_to_restart;
+    source.mgr.term_source = &term_source;
+    source.mgr.bytes_in_buffer = 0;
+    source.mgr.next_input_byte = nullptr;
+    info.src = &source.mgr;
+
+    if (jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK) {
+      return false;
+    }
+
+    // libjpeg has no conversion from cmyk to rgb.
+    cmyk = info.jpeg_color_space == JCS_CMYK || info.jpeg_color_space == JCS_YCCK;
+    info.out_color_space = cmyk ? JCS_CMYK : JCS_RGB;
+    info.scale_num = 1;
+    info.scale_denom = static_cast<unsigned int>(scale);
+
+    if (!jpeg_start_decompress(&info)) {
+      return false;
+    }
+
+    size = { info.output_width, info.output_height };
+    scanline.resize(size.width * static_cast<std::size_t>(info.output_components));
+    output.resize(cmyk ? size.width * 3 : 0);
+    return true;
+  }
+
+  /// Adobe files store inverted cmyk values, which is the case of nearly every cmyk jpeg.
+  void convert_cmyk() noexcept {
+    const bool inverted = info.saw_Adobe_marker;
+
+    for (std::size_t x = 0; x < size.width; x++) {
+      const std::uint8_t* px = scanline.data() + x * 4;
+      const std::uint32_t k = inverted ? px[3] : 255u - px[3];
+
+      for (std::size_t c = 0; c < 3; c++) {
+        output[x * 3 + c] = static_cast<std::uint8_t>(detail::mul_div255(inverted ? px[c] : 255u - px[c], k));
+      }
+    }
+  }
+
+  /// The pixels of the next row in rgb, nullptr after the last one or on error.
+  const std::uint8_t* next_row() {
+    if (!valid || row_index >= size.height) {
+      return nullptr;
+    }
+
+    if (setjmp(error.jump)) {
+      valid = false;
+      return nullptr;
+    }
+
+    JSAMPROW row = scanline.data();
+
+    if (jpeg_read_scanlines(&info, &row, 1) != 1) {
+      valid = false;
+      return nullptr;
+    }
+
+    row_index++;
+
+    if (!cmyk) {
+      return scanline.data();
+    }
+
+    convert_cmyk();
+    return output.data();
+  }
+
+  std::ifstream file;
+  std::istream& in;
+  bool valid = false;
+
+  jpeg_decompress_struct info = {};
+  error_manager error = {};
+  stream_source source = {};
+  bool created = false;
+  bool cmyk = false;
+
+  nano::size<std::size_t> size = { 0, 0 };
+  std::vector<std::uint8_t> scanline;
+
+  // Converted cmyk rows.
+  std::vector<std::uint8_t> output;
+  std::size_t row_index = 0;
+};
+
+jpeg_decoder::jpeg_decoder(const std::filesystem::path& filepath, image::decode_scale scale) {
+  m_pimpl = new pimpl(filepath, scale);
+}
+
+jpeg_decoder::jpeg_decoder(std::istream& stream, image::decode_scale scale) { m_pimpl = new pimpl(stream, scale); }
+
+jpeg_decoder::~jpeg_decoder() { delete m_pimpl; }
+
+bool jpeg_decoder::is_valid() const { return m_pimpl->valid; }
+
+nano::size<std::size_t> jpeg_decoder::get_size() const { return m_pimpl->size; }
+
+image::format jpeg_decoder::get_format() const { return image::format::rgb; }
+
+std::size_t jpeg_decoder::get_row_index() const { return m_pimpl->row_index; }
+
+bool jpeg_decoder::read_row(std::uint8_t* row, image::format fmt) {
+  const std::uint8_t* src = m_pimpl->next_row();
+
+  if (!src) {
+    return false;
+  }
+
+  if (fmt == image::format::rgb) {
+    std::memcpy(row, src, m_pimpl->size.width * 3);
+  }
+  else {
+    detail::convert_row(src, image::format::rgb, row, fmt, m_pimpl->size.width);
+  }
+
+  return true;
+}
+
+bool jpeg_decoder::read_rows(const std::function<bool(std::size_t, const image_view&)>& fct) {
+  const nano::size<std::size_t> row_size = { m_pimpl->size.width, 1 };
+
+  while (m_pimpl->row_index < m_pimpl->size.height) {
+    const std::size_t y = m_pimpl->row_index;
+    const std::uint8_t* src = m_pimpl->next_row();
+
+    if (!src || !fct(y, image_view(src, row_size, row_size.width * 3, image::format::rgb))) {
+      return false;
+    }
+  }
+
+  return m_pimpl->valid;
+}
+} // namespace nano.
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
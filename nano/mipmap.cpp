@@ -0,0 +1,183 @@
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+
+namespace nano::detail {
+
+namespace {
+  std::atomic<std::size_t> g_memory_limit{ 64 * 1024 * 1024 };
+  std::atomic<std::size_t> g_memory_used{ 0 };
+
+  static inline std::size_t level_bytes(const bitmap& bmp) noexcept { return bmp.bytes_per_row * bmp.size.height; }
+
+  /// Takes bytes from the shared budget, false when they don't fit.
+  static inline bool reserve_memory(std::size_t bytes) noexcept {
+    std::size_t used = g_memory_used.load(std::memory_order_relaxed);
+
+    do {
+      if (used + bytes > g_memory_limit.load(std::memory_order_relaxed)) {
+        return false;
+      }
+    } while (!g_memory_used.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+
+    return true;
+  }
+
+  static inline std::uint32_t average_pixels(
+      std::uint32_t a, std::uint32_t b, std::uint32_t c, std::uint32_t d) noexcept {
+    const std::uint32_t rb = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+    const std::uint32_t ag = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF)
+        + ((d >> 8) & 0x00FF00FF) + 0x00020002;
+    return ((rb >> 2) & 0x00FF00FF) | (((ag >> 2) & 0x00FF00FF) << 8);
+  }
+
+  static inline void scalar_downsample_row(const std::uint32_t* r0, const std::uint32_t* r1, std::uint32_t* dst,
+      std::size_t width, std::size_t done) noexcept {
+    for (std::size_t i = done; i < (width + 1) / 2; i++) {
+      const std::size_t x0 = i * 2;
+      const std::size_t x1 = std::min(x0 + 1, width - 1);
+      dst[i] = average_pixels(r0[x0], r0[x1], r1[x0], r1[x1]);
+    }
+  }
+
+#if NANO_GRAPHICS_SSE2
+  namespace sse2 {
+    static inline __m128i load(const void* p) noexcept { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+
+    /// Four destination pixels from eight pixels of each row, identical to average_pixels.
+    static std::size_t downsample_row(
+        const std::uint32_t* r0, const std::uint32_t* r1, std::uint32_t* dst, std::size_t width) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i two = _mm_set1_epi16(2);
+      std::size_t i = 0;
+
+      for (; (i + 4) * 2 <= width; i += 4) {
+        const __m128 a = _mm_castsi128_ps(load(r0 + i * 2));
+        const __m128 b = _mm_castsi128_ps(load(r0 + i * 2 + 4));
+        const __m128 c = _mm_castsi128_ps(load(r1 + i * 2));
+        const __m128 d = _mm_castsi128_ps(load(r1 + i * 2 + 4));
+
+        // Even and odd pixels of both rows.
+        const __m128i e0 = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i o0 = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m128i e1 = _mm_castps_si128(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i o1 = _mm_castps_si128(_mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(e0, zero), _mm_unpacklo_epi8(o0, zero));
+        lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_unpacklo_epi8(e1, zero), _mm_unpacklo_epi8(o1, zero)));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(e0, zero), _mm_unpackhi_epi8(o0, zero));
+        hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_unpackhi_epi8(e1, zero), _mm_unpackhi_epi8(o1, zero)));
+
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+      }
+
+      return i;
+    }
+  } // namespace sse2.
+#endif // NANO_GRAPHICS_SSE2
+
+  static inline nano::size<std::size_t> half_size(const nano::size<std::size_t>& size) noexcept {
+    return { (size.width + 1) / 2, (size.height + 1) / 2 };
+  }
+
+  /// The first level converts the rows of the base to premultiplied words, the next ones already are.
+  static bitmap* create_level(const bitmap& src, bool is_base) {
+    bitmap* level = bitmap::create(half_size(src.size), image::format::rgba);
+    level->premultiplied = true;
+
+    const pixel_layout layout = get_pixel_layout(image::format::rgba);
+    const std::size_t width = src.size.width;
+
+    parallel_rows(level->size.height, level->size.width, [&](std::size_t y0, std::size_t y1) {
+      std::vector<std::uint32_t> rows(is_base ? width * 2 : 0);
+
+      for (std::size_t y = y0; y < y1; y++) {
+        const std::size_t sy0 = y * 2;
+        const std::size_t sy1 = std::min(sy0 + 1, src.size.height - 1);
+        const std::uint32_t* r0 = reinterpret_cast<const std::uint32_t*>(src.row(sy0));
+        const std::uint32_t* r1 = reinterpret_cast<const std::uint32_t*>(src.row(sy1));
+
+        if (is_base) {
+          load_row(src, 0, sy0, width, rows.data(), layout);
+          load_row(src, 0, sy1, width, rows.data() + width, layout);
+          r0 = rows.data();
+          r1 = rows.data() + width;
+        }
+
+        downsample_row(r0, r1, reinterpret_cast<std::uint32_t*>(level->row(y)), width);
+      }
+    });
+
+    return level;
+  }
+} // namespace.
+
+void downsample_row(const std::uint32_t* r0, const std::uint32_t* r1, std::uint32_t* dst, std::size_t width) noexcept {
+  std::size_t done = 0;
+
+#if NANO_GRAPHICS_SSE2
+  if (get_simd_level() != simd_level::scalar) {
+    done = sse2::downsample_row(r0, r1, dst, width);
+  }
+#endif
+
+  scalar_downsample_row(r0, r1, dst, width, done);
+}
+
+mipmap_chain::~mipmap_chain() { clear(); }
+
+bitmap* mipmap_chain::get_level(const bitmap& base, const nano::size<float>& size) {
+  // Levels that are still at least size, the last one is the level to draw.
+  std::size_t count = 0;
+
+  for (nano::size<std::size_t> s = half_size(base.size);
+       static_cast<float>(s.width) >= size.width && static_cast<float>(s.height) >= size.height; s = half_size(s)) {
+    count++;
+
+    if (s.width == 1 && s.height == 1) {
+      break;
+    }
+  }
+
+  if (!count) {
+    return nullptr;
+  }
+
+  std::scoped_lock lock(m_mutex);
+
+  while (m_levels.size() < count) {
+    const bitmap& src = m_levels.empty() ? base : *m_levels.back();
+    const nano::size<std::size_t> s = half_size(src.size);
+
+    // Past the budget, draws use the smallest level already built.
+    if (!reserve_memory(s.width * s.height * sizeof(std::uint32_t))) {
+      break;
+    }
+
+    m_levels.push_back(create_level(src, m_levels.empty()));
+  }
+
+  return m_levels.empty() ? nullptr : bitmap::retain(m_levels[std::min(count, m_levels.size()) - 1]);
+}
+
+void mipmap_chain::clear() noexcept {
+  std::scoped_lock lock(m_mutex);
+
+  for (bitmap* level : m_levels) {
+    g_memory_used.fetch_sub(level_bytes(*level), std::memory_order_relaxed);
+    bitmap::release(level);
+  }
+
+  m_levels.clear();
+}
+} // namespace nano::detail.
+
+namespace nano {
+void image::set_mipmap_memory_limit(std::size_t bytes) {
+  detail::g_memory_limit.store(bytes, std::memory_order_relaxed);
+}
+
+std::size_t image::get_mipmap_memory_limit() { return detail::g_memory_limit.load(std::memory_order_relaxed); }
+} // namespace nano.
@@ -0,0 +1,422 @@
+#include <nano/graphics_path.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace nano {
+
+//
+// MARK: path
+//
+
+namespace detail {
+  namespace {
+    constexpr float k_pi = 3.14159265358979323846f;
+
+    /// Maximum distance in pixels between a flattened curve and the real one.
+    constexpr float k_flatten_tolerance = 0.1f;
+
+    /// Number of cached scales per path.
+    constexpr std::size_t k_cache_size = 4;
+
+    constexpr int k_max_segments = 1024;
+
+    static inline float length(const nano::point<float>& p) noexcept { return std::sqrt(p.x * p.x + p.y * p.y); }
+
+    static inline nano::point<float> second_difference(
+        const nano::point<float>& a, const nano::point<float>& b, const nano::point<float>& c) noexcept {
+      return { a.x - 2.0f * b.x + c.x, a.y - 2.0f * b.y + c.y };
+    }
+
+    static inline int to_segments(float n) noexcept {
+      return std::clamp(static_cast<int>(std::ceil(n)), 1, k_max_segments);
+    }
+  } // namespace.
+
+  path_data::path_data(const path_data& d)
+      : verbs(d.verbs)
+      , points(d.points)
+      , min(d.min)
+      , max(d.max) {}
+
+  std::shared_ptr<const polyline> path_data::flatten(float scale) const {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const std::shared_ptr<const polyline>& pl : cache) {
+        if (pl->scale == scale) {
+          return pl;
+        }
+      }
+    }
+
+    auto pl = std::make_shared<polyline>();
+    pl->scale = scale;
+
+    const float tolerance = k_flatten_tolerance / std::max(scale, 1e-6f);
+    nano::point<float> current = { 0, 0 };
+    nano::point<float> start = { 0, 0 };
+    std::size_t contour_start = 0;
+    bool open = false;
+    const nano::point<float>* pts = points.data();
+
+    auto end_contour = [&](bool closed) {
+      if (pl->points.size() - contour_start >= 2) {
+        pl->contours.push_back(static_cast<std::uint32_t>(pl->points.size()));
+        pl->closed.push_back(closed ? 1 : 0);
+      }
+      else {
+        pl->points.resize(contour_start);
+      }
+
+      contour_start = pl->points.size();
+      open = false;
+    };
+
+    // Drawing after a close_path starts a new contour at the last start point.
+    auto add_point = [&](const nano::point<float>& p) {
+      if (!open) {
+        pl->points.push_back(current);
+        open = true;
+      }
+
+      pl->points.push_back(p);
+    };
+
+    for (path_verb v : verbs) {
+      switch (v) {
+      case path_verb::move:
+        if (open) {
+          end_contour(false);
+        }
+
+        start = current = *pts++;
+        break;
+
+      case path_verb::line:
+        add_point(pts[0]);
+        current = *pts++;
+        break;
+
+      case path_verb::quad: {
+        const nano::point<float> p0 = current;
+        const nano::point<float> p1 = pts[0];
+        const nano::point<float> p2 = pts[1];
+        const int n = to_segments(std::sqrt(length(second_difference(p0, p1, p2)) / (4.0f * tolerance)));
+
+        for (int i = 1; i <= n; i++) {
+          const float t = static_cast<float>(i) / static_cast<float>(n);
+          const float u = 1.0f - t;
+          add_point(
+              { u * u * p0.x + 2.0f * u * t * p1.x + t * t * p2.x, u * u * p0.y + 2.0f * u * t * p1.y + t * t * p2.y });
+        }
+
+        current = p2;
+        pts += 2;
+      } break;
+
+      case path_verb::cubic: {
+        const nano::point<float> p0 = current;
+        const nano::point<float> p1 = pts[0];
+        const nano::point<float> p2 = pts[1];
+        const nano::point<float> p3 = pts[2];
+
+        // Wang's formula.
+        const float dd = std::max(length(second_difference(p0, p1, p2)), length(second_difference(p1, p2, p3)));
+        const int n = to_segments(std::sqrt(0.75f * dd / tolerance));
+
+        for (int i = 1; i <= n; i++) {
+          const float t = static_cast<float>(i) / static_cast<float>(n);
+          const float u = 1.0f - t;
+          const float a = u * u * u;
+          const float b = 3.0f * u * u * t;
+          const float c = 3.0f * u * t * t;
+          const float d = t * t * t;
+          add_point({ a * p0.x + b * p1.x + c * p2.x + d * p3.x, a * p0.y + b * p1.y + c * p2.y + d * p3.y });
+        }
+
+        current = p3;
+        pts += 3;
+      } break;
+
+      case path_verb::close:
+        if (open) {
+          end_contour(true);
+        }
+
+        current = start;
+        break;
+      }
+    }
+
+    if (open) {
+      end_contour(false);
+    }
+
+    if (!pl->points.empty()) {
+      nano::point<float> lo = pl->points[0];
+      nano::point<float> hi = pl->points[0];
+
+      for (const nano::point<float>& p : pl->points) {
+        lo = { std::min(lo.x, p.x), std::min(lo.y, p.y) };
+        hi = { std::max(hi.x, p.x), std::max(hi.y, p.y) };
+      }
+
+      pl->bounds = { lo.x, lo.y, hi.x - lo.x, hi.y - lo.y };
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.insert(cache.begin(), pl);
+
+    if (cache.size() > k_cache_size) {
+      cache.pop_back();
+    }
+
+    return pl;
+  }
+
+  std::shared_ptr<const polyline> path_data::stroke(const stroke_style& style) const {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const auto& s : strokes) {
+        if (s.first == style) {
+          return s.second;
+        }
+      }
+    }
+
+    auto outline = std::make_shared<polyline>();
+    outline->scale = 1;
+    stroke_polyline(*flatten(1), style, *outline);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    strokes.insert(strokes.begin(), { style, outline });
+
+    if (strokes.size() > k_cache_size) {
+      strokes.pop_back();
+    }
+
+    return outline;
+  }
+} // namespace detail.
+
+namespace {
+  // Copy on write, the caches of the shared geometry stay valid for the other copies.
+  static inline detail::path_data& get_mutable_data(path::pimpl& p) {
+    if (p.data.use_count() > 1) {
+      p.data = std::make_shared<detail::path_data>(*p.data);
+    }
+    else {
+      p.data->cache.clear();
+      p.data->strokes.clear();
+      p.data->native.reset();
+    }
+
+    return *p.data;
+  }
+
+  static inline void add_verb(path::pimpl& p, detail::path_verb v, std::initializer_list<nano::point<float>> pts) {
+    detail::path_data& d = get_mutable_data(p);
+
+    for (const nano::point<float>& pt : pts) {
+      if (d.points.empty()) {
+        d.min = d.max = pt;
+      }
+
+      d.min = { std::min(d.min.x, pt.x), std::min(d.min.y, pt.y) };
+      d.max = { std::max(d.max.x, pt.x), std::max(d.max.y, pt.y) };
+      d.points.push_back(pt);
+    }
+
+    d.verbs.push_back(v);
+  }
+
+  static inline bool has_open_contour(const detail::path_data& d) noexcept {
+    return !d.verbs.empty() && d.verbs.back() != detail::path_verb::close;
+  }
+} // namespace.
+
+path::path() {
+  m_pimpl = new pimpl;
+  m_pimpl->data = std::make_shared<detail::path_data>();
+}
+
+path::path(const path& p) {
+  m_pimpl = new pimpl;
+  m_pimpl->data = p.m_pimpl->data;
+}
+
+path::path(path&& p) {
+  m_pimpl = new pimpl;
+  m_pimpl->data = p.m_pimpl->data;
+  p.m_pimpl->data = std::make_shared<detail::path_data>();
+}
+
+path::~path() { delete m_pimpl; }
+
+path& path::operator=(const path& p) {
+  m_pimpl->data = p.m_pimpl->data;
+  return *this;
+}
+
+path& path::operator=(path&& p) {
+  std::swap(m_pimpl->data, p.m_pimpl->data);
+  return *this;
+}
+
+void path::move_to(const nano::point<float>& p) { add_verb(*m_pimpl, detail::path_verb::move, { p }); }
+
+void path::line_to(const nano::point<float>& p) { add_verb(*m_pimpl, detail::path_verb::line, { p }); }
+
+void path::quad_to(const nano::point<float>& ctrl, const nano::point<float>& end) {
+  add_verb(*m_pimpl, detail::path_verb::quad, { ctrl, end });
+}
+
+void path::cubic_to(const nano::point<float>& ctrl0, const nano::point<float>& ctrl1, const nano::point<float>& end) {
+  add_verb(*m_pimpl, detail::path_verb::cubic, { ctrl0, ctrl1, end });
+}
+
+void path::add_arc(const nano::point<float>& center, float radius, float start_angle, float end_angle, bool clockwise) {
+  constexpr float two_pi = 2.0f * detail::k_pi;
+  float sweep = end_angle - start_angle;
+
+  if (clockwise) {
+    while (sweep < 0) {
+      sweep += two_pi;
+    }
+  }
+  else {
+    while (sweep > 0) {
+      sweep -= two_pi;
+    }
+  }
+
+  const nano::point<float> start = { center.x + radius * std::cos(start_angle),
+    center.y + radius * std::sin(start_angle) };
+
+  if (has_open_contour(*m_pimpl->data)) {
+    line_to(start);
+  }
+  else {
+    move_to(start);
+  }
+
+  // One cubic per quarter turn at most.
+  const int n = std::max(static_cast<int>(std::ceil(std::abs(sweep) / (0.5f * detail::k_pi) - 1e-4f)), 1);
+  const float step = sweep / static_cast<float>(n);
+  const float k = radius * 4.0f / 3.0f * std::tan(step * 0.25f);
+  float a = start_angle;
+
+  for (int i = 0; i < n; i++) {
+    const float b = a + step;
+    const float ca = std::cos(a);
+    const float sa = std::sin(a);
+    const float cb = std::cos(b);
+    const float sb = std::sin(b);
+
+    cubic_to({ center.x + radius * ca - k * sa, center.y + radius * sa + k * ca },
+        { center.x + radius * cb + k * sb, center.y + radius * sb - k * cb },
+        { center.x + radius * cb, center.y + radius * sb });
+    a = b;
+  }
+}
+
+void path::add_rect(const nano::rect<float>& r) {
+  move_to({ r.x, r.y });
+  line_to({ r.x + r.width, r.y });
+  line_to({ r.x + r.width, r.y + r.height });
+  line_to({ r.x, r.y + r.height });
+  close_path();
+}
+
+void path::add_ellipse(const nano::rect<float>& r) {
+  constexpr float kappa = 0.5522847498f;
+  const float rx = r.width * 0.5f;
+  const float ry = r.height * 0.5f;
+  const float cx = r.x + rx;
+  const float cy = r.y + ry;
+  const float kx = rx * kappa;
+  const float ky = ry * kappa;
+
+  move_to({ cx + rx, cy });
+  cubic_to({ cx + rx, cy + ky }, { cx + kx, cy + ry }, { cx, cy + ry });
+  cubic_to({ cx - kx, cy + ry }, { cx - rx, cy + ky }, { cx - rx, cy });
+  cubic_to({ cx - rx, cy - ky }, { cx - kx, cy - ry }, { cx, cy - ry });
+  cubic_to({ cx + kx, cy - ry }, { cx + rx, cy - ky }, { cx + rx, cy });
+  close_path();
+}
+
+void path::add_rounded_rect(const nano::rect<float>& r, float radius) {
+  radius = std::min({ radius, r.width * 0.5f, r.height * 0.5f });
+
+  if (radius <= 0) {
+    add_rect(r);
+    return;
+  }
+
+  constexpr float kappa = 0.5522847498f;
+  const float k = radius * (1.0f - kappa);
+  const float x0 = r.x;
+  const float y0 = r.y;
+  const float x1 = r.x + r.width;
+  const float y1 = r.y + r.height;
+
+  move_to({ x0 + radius, y0 });
+  line_to({ x1 - radius, y0 });
+  cubic_to({ x1 - k, y0 }, { x1, y0 + k }, { x1, y0 + radius });
+  line_to({ x1, y1 - radius });
+  cubic_to({ x1, y1 - k }, { x1 - k, y1 }, { x1 - radius, y1 });
+  line_to({ x0 + radius, y1 });
+  cubic_to({ x0 + k, y1 }, { x0, y1 - k }, { x0, y1 - radius });
+  line_to({ x0, y0 + radius });
+  cubic_to({ x0, y0 + k }, { x0 + k, y0 }, { x0 + radius, y0 });
+  close_path();
+}
+
+void path::add_path(const path& p) {
+  if (p.empty()) {
+    return;
+  }
+
+  // Keep the source alive in case p is this path.
+  const std::shared_ptr<detail::path_data> src = p.m_pimpl->data;
+  detail::path_data& d = get_mutable_data(*m_pimpl);
+
+  if (d.points.empty()) {
+    d.min = src->min;
+    d.max = src->max;
+  }
+  else {
+    d.min = { std::min(d.min.x, src->min.x), std::min(d.min.y, src->min.y) };
+    d.max = { std::max(d.max.x, src->max.x), std::max(d.max.y, src->max.y) };
+  }
+
+  d.verbs.insert(d.verbs.end(), src->verbs.begin(), src->verbs.end());
+  d.points.insert(d.points.end(), src->points.begin(), src->points.end());
+}
+
+void path::close_path() {
+  if (has_open_contour(*m_pimpl->data)) {
+    add_verb(*m_pimpl, detail::path_verb::close, {});
+  }
+}
+
+void path::clear() {
+  if (m_pimpl->data.use_count() > 1) {
+    m_pimpl->data = std::make_shared<detail::path_data>();
+    return;
+  }
+
+  detail::path_data& d = get_mutable_data(*m_pimpl);
+  d.verbs.clear();
+  d.points.clear();
+  d.min = d.max = { 0, 0 };
+}
+
+bool path::empty() const noexcept { return m_pimpl->data->verbs.empty(); }
+
+nano::rect<float> path::get_bounding_box() const noexcept {
+  const detail::path_data& d = *m_pimpl->data;
+  return { d.min.x, d.min.y, d.max.x - d.min.x, d.max.y - d.min.y };
+}
+
+} // namespace nano.
@@ -0,0 +1,844 @@
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace nano::detail {
+
+namespace {
+  /// Pixels converted at a time through the stack buffers.
+  constexpr std::size_t k_chunk = 256;
+
+  /// Layout whose bytes are r, g, b, a in memory, the channel order of the float formats.
+  /// Every vector kernel assumes a little endian target.
+  constexpr pixel_layout k_memory_layout = { 0, 8, 16, 24 };
+
+  static inline bool has_alpha(image::format fmt) noexcept {
+    switch (fmt) {
+    case image::format::alpha:
+    case image::format::argb:
+    case image::format::bgra:
+    case image::format::rgba:
+    case image::format::abgr:
+    case image::format::float_alpha:
+    case image::format::float_argb:
+    case image::format::float_rgba:
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+  static inline bool has_color(image::format fmt) noexcept {
+    return fmt != image::format::alpha && fmt != image::format::float_alpha;
+  }
+
+  static inline bool is_float_format(image::format fmt) noexcept { return get_bits_per_component(fmt) == 32; }
+
+  static inline std::size_t bytes_per_pixel(image::format fmt) noexcept { return get_bits_per_pixel(fmt) / 8; }
+
+  /// Byte moves between two word layouts.
+  struct byte_map {
+    /// Source byte of each destination byte, -1 leaves it to fill.
+    int index[4];
+
+    /// Or'ed to every destination word.
+    std::uint32_t fill;
+
+    inline bool is_identity() const noexcept {
+      return index[0] == 0 && index[1] == 1 && index[2] == 2 && index[3] == 3 && !fill;
+    }
+  };
+
+  /// The alpha byte is moved when move_alpha is true, otherwise it's set to 0xFF.
+  static inline byte_map make_byte_map(const pixel_layout& src, const pixel_layout& dst, bool move_alpha) noexcept {
+    byte_map m = { { -1, -1, -1, -1 }, move_alpha ? 0u : 0xFFu << dst.a };
+    m.index[dst.r / 8] = static_cast<int>(src.r / 8);
+    m.index[dst.g / 8] = static_cast<int>(src.g / 8);
+    m.index[dst.b / 8] = static_cast<int>(src.b / 8);
+
+    if (move_alpha) {
+      m.index[dst.a / 8] = static_cast<int>(src.a / 8);
+    }
+
+    return m;
+  }
+
+  static inline std::uint32_t load_word(const std::uint8_t* p) noexcept {
+    std::uint32_t w;
+    std::memcpy(&w, p, sizeof(w));
+    return w;
+  }
+
+  static inline void store_word(std::uint8_t* p, std::uint32_t w) noexcept { std::memcpy(p, &w, sizeof(w)); }
+
+  static inline std::uint8_t float_to_u8(float f) noexcept {
+    // Written so that NaN gives 0 like the max/min of the vector kernels.
+    const float c = f > 0.0f ? (f < 1.0f ? f : 1.0f) : 0.0f;
+    return static_cast<std::uint8_t>(c * 255.0f + 0.5f);
+  }
+
+  static inline std::uint32_t premultiply_word(std::uint32_t w, std::uint32_t alpha_shift) noexcept {
+    const std::uint32_t a = (w >> alpha_shift) & 0xFF;
+    std::uint32_t out = a << alpha_shift;
+
+    for (std::uint32_t shift = 0; shift < 32; shift += 8) {
+      if (shift != alpha_shift) {
+        out |= mul_div255((w >> shift) & 0xFF, a) << shift;
+      }
+    }
+
+    return out;
+  }
+
+  /// Rounded c * 255 / a, the scale is computed in float so that the vector kernels can match it exactly.
+  static inline std::uint32_t unpremultiply_word(std::uint32_t w, std::uint32_t alpha_shift) noexcept {
+    const std::uint32_t a = (w >> alpha_shift) & 0xFF;
+    const float s = a ? 255.0f / static_cast<float>(a) : 0.0f;
+    std::uint32_t out = a << alpha_shift;
+
+    for (std::uint32_t shift = 0; shift < 32; shift += 8) {
+      if (shift != alpha_shift) {
+        const float v = std::min(static_cast<float>((w >> shift) & 0xFF) * s + 0.5f, 255.0f);
+        out |= static_cast<std::uint32_t>(v) << shift;
+      }
+    }
+
+    return out;
+  }
+
+  //
+  // Scalar kernels, they also finish the tails left by the vector ones.
+  //
+
+  static inline void scalar_swizzle(
+      const std::uint8_t* src, std::uint8_t* dst, std::size_t count, const byte_map& m) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      const std::uint32_t w = load_word(src + i * 4);
+      std::uint32_t out = m.fill;
+
+      for (std::uint32_t k = 0; k < 4; k++) {
+        if (m.index[k] >= 0) {
+          out |= ((w >> (m.index[k] * 8)) & 0xFF) << (k * 8);
+        }
+      }
+
+      store_word(dst + i * 4, out);
+    }
+  }
+
+  static inline void scalar_rgb_to_words(
+      const std::uint8_t* src, std::uint32_t* dst, std::size_t count, const pixel_layout& l) noexcept {
+    for (std::size_t i = 0; i < count; i++, src += 3) {
+      dst[i] = pack_pixel(l, src[0], src[1], src[2], 255);
+    }
+  }
+
+  static inline void scalar_words_to_rgb(
+      const std::uint32_t* src, std::uint8_t* dst, std::size_t count, const pixel_layout& l) noexcept {
+    for (std::size_t i = 0; i < count; i++, dst += 3) {
+      dst[0] = static_cast<std::uint8_t>(src[i] >> l.r);
+      dst[1] = static_cast<std::uint8_t>(src[i] >> l.g);
+      dst[2] = static_cast<std::uint8_t>(src[i] >> l.b);
+    }
+  }
+
+  static inline void scalar_expand_alpha(
+      const std::uint8_t* src, std::uint32_t* dst, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      dst[i] = std::uint32_t(src[i]) << alpha_shift;
+    }
+  }
+
+  static inline void scalar_extract_alpha(
+      const std::uint32_t* src, std::uint8_t* dst, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      dst[i] = static_cast<std::uint8_t>(src[i] >> alpha_shift);
+    }
+  }
+
+  static inline void scalar_premultiply(std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      px[i] = premultiply_word(px[i], alpha_shift);
+    }
+  }
+
+  static inline void scalar_unpremultiply(std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      px[i] = unpremultiply_word(px[i], alpha_shift);
+    }
+  }
+
+  static inline void scalar_u8_to_float(const std::uint8_t* src, float* dst, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      dst[i] = static_cast<float>(src[i]) / 255.0f;
+    }
+  }
+
+  static inline void scalar_float_to_u8(const float* src, std::uint8_t* dst, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      dst[i] = float_to_u8(src[i]);
+    }
+  }
+
+#if NANO_GRAPHICS_SSE2
+  namespace sse2 {
+    static inline __m128i load(const void* p) noexcept { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+
+    static inline void store(void* p, __m128i v) noexcept { _mm_storeu_si128(static_cast<__m128i*>(p), v); }
+
+    /// Rounded x * a / 255 on 16-bit lanes, identical to mul_div255.
+    static inline __m128i mul_div255(__m128i x16, __m128i a16) noexcept {
+      const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x16, a16), _mm_set1_epi16(128));
+      return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    static std::size_t expand_alpha(
+        const std::uint8_t* src, std::uint32_t* dst, std::size_t count, std::uint32_t alpha_shift) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(alpha_shift));
+      std::size_t i = 0;
+
+      for (; i + 16 <= count; i += 16) {
+        const __m128i b = load(src + i);
+        const __m128i lo = _mm_unpacklo_epi8(b, zero);
+        const __m128i hi = _mm_unpackhi_epi8(b, zero);
+        store(dst + i, _mm_sll_epi32(_mm_unpacklo_epi16(lo, zero), shift));
+        store(dst + i + 4, _mm_sll_epi32(_mm_unpackhi_epi16(lo, zero), shift));
+        store(dst + i + 8, _mm_sll_epi32(_mm_unpacklo_epi16(hi, zero), shift));
+        store(dst + i + 12, _mm_sll_epi32(_mm_unpackhi_epi16(hi, zero), shift));
+      }
+
+      return i;
+    }
+
+    static std::size_t extract_alpha(
+        const std::uint32_t* src, std::uint8_t* dst, std::size_t count, std::uint32_t alpha_shift) noexcept {
+      const __m128i ff = _mm_set1_epi32(0xFF);
+      const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(alpha_shift));
+      std::size_t i = 0;
+
+      for (; i + 16 <= count; i += 16) {
+        const __m128i a0 = _mm_and_si128(_mm_srl_epi32(load(src + i), shift), ff);
+        const __m128i a1 = _mm_and_si128(_mm_srl_epi32(load(src + i + 4), shift), ff);
+        const __m128i a2 = _mm_and_si128(_mm_srl_epi32(load(src + i + 8), shift), ff);
+        const __m128i a3 = _mm_and_si128(_mm_srl_epi32(load(src + i + 12), shift), ff);
+        store(dst + i, _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3)));
+      }
+
+      return i;
+    }
+
+    static std::size_t premultiply(std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i ff = _mm_set1_epi32(0xFF);
+      const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(alpha_shift));
+      const __m128i alpha_mask = _mm_sll_epi32(ff, shift);
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        const __m128i w = load(px + i);
+
+        // Alpha of each pixel broadcast to the four 16-bit lanes of its channels.
+        const __m128i a = _mm_and_si128(_mm_srl_epi32(w, shift), ff);
+        const __m128i a2 = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        const __m128i lo = mul_div255(_mm_unpacklo_epi8(w, zero), _mm_unpacklo_epi32(a2, a2));
+        const __m128i hi = mul_div255(_mm_unpackhi_epi8(w, zero), _mm_unpackhi_epi32(a2, a2));
+        const __m128i colors = _mm_packus_epi16(lo, hi);
+        store(px + i, _mm_or_si128(_mm_andnot_si128(alpha_mask, colors), _mm_and_si128(alpha_mask, w)));
+      }
+
+      return i;
+    }
+
+    /// The four channels of one pixel, as float lanes, scaled by s, rounded and clamped.
+    static inline __m128i unpremultiply_pixel(__m128i c32, __m128 s) noexcept {
+      const __m128 v = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c32), s), _mm_set1_ps(0.5f));
+      return _mm_cvttps_epi32(_mm_min_ps(v, _mm_set1_ps(255.0f)));
+    }
+
+    static std::size_t unpremultiply(std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i ff = _mm_set1_epi32(0xFF);
+      const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(alpha_shift));
+      const __m128i alpha_mask = _mm_sll_epi32(ff, shift);
+      const __m128 k255 = _mm_set1_ps(255.0f);
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        const __m128i w = load(px + i);
+        const __m128i a = _mm_and_si128(_mm_srl_epi32(w, shift), ff);
+        const __m128 s = _mm_and_ps(_mm_div_ps(k255, _mm_cvtepi32_ps(a)), _mm_castsi128_ps(_mm_cmpgt_epi32(a, zero)));
+
+        const __m128i lo = _mm_unpacklo_epi8(w, zero);
+        const __m128i hi = _mm_unpackhi_epi8(w, zero);
+        const __m128 s0 = _mm_shuffle_ps(s, s, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 s1 = _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 s2 = _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 s3 = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128i c0 = unpremultiply_pixel(_mm_unpacklo_epi16(lo, zero), s0);
+        const __m128i c1 = unpremultiply_pixel(_mm_unpackhi_epi16(lo, zero), s1);
+        const __m128i c2 = unpremultiply_pixel(_mm_unpacklo_epi16(hi, zero), s2);
+        const __m128i c3 = unpremultiply_pixel(_mm_unpackhi_epi16(hi, zero), s3);
+        const __m128i colors = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+        store(px + i, _mm_or_si128(_mm_andnot_si128(alpha_mask, colors), _mm_and_si128(alpha_mask, w)));
+      }
+
+      return i;
+    }
+
+    static std::size_t u8_to_float(const std::uint8_t* src, float* dst, std::size_t count) noexcept {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 k255 = _mm_set1_ps(255.0f);
+      std::size_t i = 0;
+
+      for (; i + 16 <= count; i += 16) {
+        const __m128i b = load(src + i);
+        const __m128i lo = _mm_unpacklo_epi8(b, zero);
+        const __m128i hi = _mm_unpackhi_epi8(b, zero);
+        _mm_storeu_ps(dst + i, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), k255));
+        _mm_storeu_ps(dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), k255));
+        _mm_storeu_ps(dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), k255));
+        _mm_storeu_ps(dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), k255));
+      }
+
+      return i;
+    }
+
+    static inline __m128i float_to_u32(const float* src) noexcept {
+      const __m128 c = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+      return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    }
+
+    static std::size_t float_to_u8(const float* src, std::uint8_t* dst, std::size_t count) noexcept {
+      std::size_t i = 0;
+
+      for (; i + 16 <= count; i += 16) {
+        const __m128i lo = _mm_packs_epi32(float_to_u32(src + i), float_to_u32(src + i + 4));
+        const __m128i hi = _mm_packs_epi32(float_to_u32(src + i + 8), float_to_u32(src + i + 12));
+        store(dst + i, _mm_packus_epi16(lo, hi));
+      }
+
+      return i;
+    }
+  } // namespace sse2.
+#endif // NANO_GRAPHICS_SSE2
+
+#if NANO_GRAPHICS_AVX2
+  namespace avx2 {
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i load(const void* p) noexcept {
+      return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static inline void store(void* p, __m256i v) noexcept {
+      _mm256_storeu_si256(static_cast<__m256i*>(p), v);
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i mul_div255(__m256i x16, __m256i a16) noexcept {
+      const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x16, a16), _mm256_set1_epi16(128));
+      return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    /// pshufb control moving the bytes of four pixels, 0x80 clears a byte.
+    static inline __m128i make_shuffle(const int (&index)[16]) noexcept {
+      alignas(16) std::int8_t ctrl[16];
+      for (int k = 0; k < 16; k++) {
+        ctrl[k] = static_cast<std::int8_t>(index[k] < 0 ? 0x80 : index[k]);
+      }
+      return _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t swizzle(
+        const std::uint8_t* src, std::uint8_t* dst, std::size_t count, const byte_map& m) noexcept {
+      int index[16];
+      for (int k = 0; k < 16; k++) {
+        const int c = m.index[k % 4];
+        index[k] = c < 0 ? -1 : (k / 4) * 4 + c;
+      }
+
+      const __m256i ctrl = _mm256_broadcastsi128_si256(make_shuffle(index));
+      const __m256i fill = _mm256_set1_epi32(static_cast<int>(m.fill));
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        store(dst + i * 4, _mm256_or_si256(_mm256_shuffle_epi8(load(src + i * 4), ctrl), fill));
+      }
+
+      return i;
+    }
+
+    // The 24-bit kernels read or write 16 bytes for every 12, they stop 2 pixels early
+    // so that they never touch memory past the row.
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t rgb_to_words(
+        const std::uint8_t* src, std::uint32_t* dst, std::size_t count, const pixel_layout& l) noexcept {
+      int index[16];
+      for (int p = 0; p < 4; p++) {
+        index[p * 4 + l.r / 8] = p * 3;
+        index[p * 4 + l.g / 8] = p * 3 + 1;
+        index[p * 4 + l.b / 8] = p * 3 + 2;
+        index[p * 4 + l.a / 8] = -1;
+      }
+
+      const __m128i ctrl = make_shuffle(index);
+      const __m128i fill = _mm_set1_epi32(static_cast<int>(0xFFu << l.a));
+      std::size_t i = 0;
+
+      for (; i + 6 <= count; i += 4) {
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_shuffle_epi8(b, ctrl), fill));
+      }
+
+      return i;
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t words_to_rgb(
+        const std::uint32_t* src, std::uint8_t* dst, std::size_t count, const pixel_layout& l) noexcept {
+      int index[16];
+      for (int p = 0; p < 4; p++) {
+        index[p * 3] = static_cast<int>(p * 4 + l.r / 8);
+        index[p * 3 + 1] = static_cast<int>(p * 4 + l.g / 8);
+        index[p * 3 + 2] = static_cast<int>(p * 4 + l.b / 8);
+        index[12 + p] = -1;
+      }
+
+      const __m128i ctrl = make_shuffle(index);
+      std::size_t i = 0;
+
+      for (; i + 6 <= count; i += 4) {
+        const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm_shuffle_epi8(w, ctrl));
+      }
+
+      return i;
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t premultiply(
+        std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i ff = _mm256_set1_epi32(0xFF);
+      const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(alpha_shift));
+      const __m256i alpha_mask = _mm256_sll_epi32(ff, shift);
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        const __m256i w = load(px + i);
+        const __m256i a = _mm256_and_si256(_mm256_srl_epi32(w, shift), ff);
+        const __m256i a2 = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        const __m256i lo = mul_div255(_mm256_unpacklo_epi8(w, zero), _mm256_unpacklo_epi32(a2, a2));
+        const __m256i hi = mul_div255(_mm256_unpackhi_epi8(w, zero), _mm256_unpackhi_epi32(a2, a2));
+        const __m256i colors = _mm256_packus_epi16(lo, hi);
+        store(px + i, _mm256_or_si256(_mm256_andnot_si256(alpha_mask, colors), _mm256_and_si256(alpha_mask, w)));
+      }
+
+      return i;
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t u8_to_float(
+        const std::uint8_t* src, float* dst, std::size_t count) noexcept {
+      const __m256 k255 = _mm256_set1_ps(255.0f);
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), k255));
+      }
+
+      return i;
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static inline __m256i float_to_u32(const float* src) noexcept {
+      const __m256 c = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+      return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+    }
+
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t float_to_u8(
+        const float* src, std::uint8_t* dst, std::size_t count) noexcept {
+      // The packs work within 128-bit lanes, the permutation puts the 4-byte groups back in order.
+      const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+      std::size_t i = 0;
+
+      for (; i + 32 <= count; i += 32) {
+        const __m256i ab = _mm256_packs_epi32(float_to_u32(src + i), float_to_u32(src + i + 8));
+        const __m256i cd = _mm256_packs_epi32(float_to_u32(src + i + 16), float_to_u32(src + i + 24));
+        store(dst + i, _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), order));
+      }
+
+      return i;
+    }
+  } // namespace avx2.
+#endif // NANO_GRAPHICS_AVX2
+
+  //
+  // Dispatch, each vector kernel returns how many elements it did and the scalar one does the rest.
+  //
+
+  static inline void swizzle(
+      const std::uint8_t* src, std::uint8_t* dst, std::size_t count, const byte_map& m) noexcept {
+    if (m.is_identity()) {
+      std::memcpy(dst, src, count * 4);
+      return;
+    }
+
+    // Without pshufb, moving bytes with SSE2 shifts isn't faster than the scalar loop.
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_AVX2
+    if (get_simd_level() == simd_level::avx2) {
+      done = avx2::swizzle(src, dst, count, m);
+    }
+#endif
+
+    scalar_swizzle(src + done * 4, dst + done * 4, count - done, m);
+  }
+
+  static inline void rgb_to_words(
+      const std::uint8_t* src, std::uint32_t* dst, std::size_t count, const pixel_layout& l) noexcept {
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_AVX2
+    if (get_simd_level() == simd_level::avx2) {
+      done = avx2::rgb_to_words(src, dst, count, l);
+    }
+#endif
+
+    scalar_rgb_to_words(src + done * 3, dst + done, count - done, l);
+  }
+
+  static inline void words_to_rgb(
+      const std::uint32_t* src, std::uint8_t* dst, std::size_t count, const pixel_layout& l) noexcept {
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_AVX2
+    if (get_simd_level() == simd_level::avx2) {
+      done = avx2::words_to_rgb(src, dst, count, l);
+    }
+#endif
+
+    scalar_words_to_rgb(src + done, dst + done * 3, count - done, l);
+  }
+
+  static inline void expand_alpha(
+      const std::uint8_t* src, std::uint32_t* dst, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_SSE2
+    if (get_simd_level() != simd_level::scalar) {
+      done = sse2::expand_alpha(src, dst, count, alpha_shift);
+    }
+#endif
+
+    scalar_expand_alpha(src + done, dst + done, count - done, alpha_shift);
+  }
+
+  static inline void extract_alpha(
+      const std::uint32_t* src, std::uint8_t* dst, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_SSE2
+    if (get_simd_level() != simd_level::scalar) {
+      done = sse2::extract_alpha(src, dst, count, alpha_shift);
+    }
+#endif
+
+    scalar_extract_alpha(src + done, dst + done, count - done, alpha_shift);
+  }
+
+  static inline void premultiply(std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    std::size_t done = 0;
+
+    switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+    case simd_level::avx2:
+      done = avx2::premultiply(px, count, alpha_shift);
+      break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+    case simd_level::sse2:
+      done = sse2::premultiply(px, count, alpha_shift);
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+    scalar_premultiply(px + done, count - done, alpha_shift);
+  }
+
+  static inline void unpremultiply(std::uint32_t* px, std::size_t count, std::uint32_t alpha_shift) noexcept {
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_SSE2
+    if (get_simd_level() != simd_level::scalar) {
+      done = sse2::unpremultiply(px, count, alpha_shift);
+    }
+#endif
+
+    scalar_unpremultiply(px + done, count - done, alpha_shift);
+  }
+
+  static inline void u8_to_float(const std::uint8_t* src, float* dst, std::size_t count) noexcept {
+    std::size_t done = 0;
+
+    switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+    case simd_level::avx2:
+      done = avx2::u8_to_float(src, dst, count);
+      break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+    case simd_level::sse2:
+      done = sse2::u8_to_float(src, dst, count);
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+    scalar_u8_to_float(src + done, dst + done, count - done);
+  }
+
+  static inline void float_to_u8(const float* src, std::uint8_t* dst, std::size_t count) noexcept {
+    std::size_t done = 0;
+
+    switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+    case simd_level::avx2:
+      done = avx2::float_to_u8(src, dst, count);
+      break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+    case simd_level::sse2:
+      done = sse2::float_to_u8(src, dst, count);
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+    scalar_float_to_u8(src + done, dst + done, count - done);
+  }
+
+  //
+  // Row stages.
+  //
+
+  /// Loads any 8-bit format into words of layout l, formats without alpha are opaque
+  /// and the alpha format has black colors.
+  static inline void load_words(const std::uint8_t* src, image::format fmt, std::uint32_t* dst, std::size_t count,
+      const pixel_layout& l) noexcept {
+    if (is_word_format(fmt)) {
+      const byte_map m = make_byte_map(get_pixel_layout(fmt), l, has_alpha(fmt));
+      swizzle(src, reinterpret_cast<std::uint8_t*>(dst), count, m);
+    }
+    else if (fmt == image::format::rgb) {
+      rgb_to_words(src, dst, count, l);
+    }
+    else {
+      expand_alpha(src, dst, count, l.a);
+    }
+  }
+
+  static inline void store_words(const std::uint32_t* src, std::uint8_t* dst, image::format fmt, std::size_t count,
+      const pixel_layout& l) noexcept {
+    if (is_word_format(fmt)) {
+      // The padding byte of the x formats is always 0xFF.
+      const byte_map m = make_byte_map(l, get_pixel_layout(fmt), has_alpha(fmt));
+      swizzle(reinterpret_cast<const std::uint8_t*>(src), dst, count, m);
+    }
+    else if (fmt == image::format::rgb) {
+      words_to_rgb(src, dst, count, l);
+    }
+    else {
+      extract_alpha(src, dst, count, l.a);
+    }
+  }
+
+  /// Loads any float format as r, g, b, a floats.
+  static inline void load_floats(const std::uint8_t* src, image::format fmt, float* dst, std::size_t count) noexcept {
+    float px[4];
+
+    switch (fmt) {
+    case image::format::float_rgba:
+      std::memcpy(dst, src, count * 4 * sizeof(float));
+      break;
+
+    case image::format::float_argb:
+      for (std::size_t i = 0; i < count; i++, src += 4 * sizeof(float), dst += 4) {
+        std::memcpy(px, src, sizeof(px));
+        dst[0] = px[1];
+        dst[1] = px[2];
+        dst[2] = px[3];
+        dst[3] = px[0];
+      }
+      break;
+
+    case image::format::float_rgb:
+      for (std::size_t i = 0; i < count; i++, src += 3 * sizeof(float), dst += 4) {
+        std::memcpy(dst, src, 3 * sizeof(float));
+        dst[3] = 1.0f;
+      }
+      break;
+
+    default:
+      for (std::size_t i = 0; i < count; i++, src += sizeof(float), dst += 4) {
+        dst[0] = dst[1] = dst[2] = 0.0f;
+        std::memcpy(dst + 3, src, sizeof(float));
+      }
+      break;
+    }
+  }
+
+  static inline void store_floats(const float* src, std::uint8_t* dst, image::format fmt, std::size_t count) noexcept {
+    switch (fmt) {
+    case image::format::float_rgba:
+      std::memcpy(dst, src, count * 4 * sizeof(float));
+      break;
+
+    case image::format::float_argb:
+      for (std::size_t i = 0; i < count; i++, src += 4, dst += 4 * sizeof(float)) {
+        const float px[4] = { src[3], src[0], src[1], src[2] };
+        std::memcpy(dst, px, sizeof(px));
+      }
+      break;
+
+    case image::format::float_rgb:
+      for (std::size_t i = 0; i < count; i++, src += 4, dst += 3 * sizeof(float)) {
+        std::memcpy(dst, src, 3 * sizeof(float));
+      }
+      break;
+
+    default:
+      for (std::size_t i = 0; i < count; i++, src += 4, dst += sizeof(float)) {
+        std::memcpy(dst, src + 3, sizeof(float));
+      }
+      break;
+    }
+  }
+
+  static inline void convert_float_alpha(float* px, std::size_t count, image::alpha_conversion op) noexcept {
+    for (std::size_t i = 0; i < count; i++, px += 4) {
+      const float a = px[3];
+      const float s = op == image::alpha_conversion::premultiply ? a : a > 0.0f ? 1.0f / a : 0.0f;
+      px[0] *= s;
+      px[1] *= s;
+      px[2] *= s;
+    }
+  }
+
+  /// Both formats have 8 bits per component, the pixels go through words of the destination
+  /// layout when it has one so that a plain swizzle is a single pass.
+  static void convert_u8_row(const std::uint8_t* src, image::format src_fmt, std::uint8_t* dst, image::format dst_fmt,
+      std::size_t count, image::alpha_conversion op) noexcept {
+    const pixel_layout l = is_word_format(dst_fmt) ? get_pixel_layout(dst_fmt)
+        : is_word_format(src_fmt)                  ? get_pixel_layout(src_fmt)
+                                                   : k_memory_layout;
+
+    if (op == image::alpha_conversion::none && is_word_format(src_fmt) && is_word_format(dst_fmt)) {
+      const bool move_alpha = has_alpha(src_fmt) && has_alpha(dst_fmt);
+      swizzle(src, dst, count, make_byte_map(get_pixel_layout(src_fmt), l, move_alpha));
+      return;
+    }
+
+    std::uint32_t words[k_chunk];
+    const std::size_t src_bpp = bytes_per_pixel(src_fmt);
+    const std::size_t dst_bpp = bytes_per_pixel(dst_fmt);
+
+    for (std::size_t i = 0; i < count; i += k_chunk) {
+      const std::size_t n = std::min(k_chunk, count - i);
+      load_words(src + i * src_bpp, src_fmt, words, n, l);
+
+      if (op == image::alpha_conversion::premultiply) {
+        premultiply(words, n, l.a);
+      }
+      else if (op == image::alpha_conversion::unpremultiply) {
+        unpremultiply(words, n, l.a);
+      }
+
+      store_words(words, dst + i * dst_bpp, dst_fmt, n, l);
+    }
+  }
+
+  /// One of the formats is float, the pixels go through r, g, b, a floats.
+  static void convert_float_row(const std::uint8_t* src, image::format src_fmt, std::uint8_t* dst,
+      image::format dst_fmt, std::size_t count, image::alpha_conversion op) noexcept {
+    float values[k_chunk * 4];
+    std::uint32_t words[k_chunk];
+    const std::size_t src_bpp = bytes_per_pixel(src_fmt);
+    const std::size_t dst_bpp = bytes_per_pixel(dst_fmt);
+
+    for (std::size_t i = 0; i < count; i += k_chunk) {
+      const std::size_t n = std::min(k_chunk, count - i);
+
+      if (is_float_format(src_fmt)) {
+        load_floats(src + i * src_bpp, src_fmt, values, n);
+      }
+      else {
+        load_words(src + i * src_bpp, src_fmt, words, n, k_memory_layout);
+        u8_to_float(reinterpret_cast<const std::uint8_t*>(words), values, n * 4);
+      }
+
+      if (op != image::alpha_conversion::none) {
+        convert_float_alpha(values, n, op);
+      }
+
+      if (is_float_format(dst_fmt)) {
+        store_floats(values, dst + i * dst_bpp, dst_fmt, n);
+      }
+      else {
+        float_to_u8(values, reinterpret_cast<std::uint8_t*>(words), n * 4);
+        store_words(words, dst + i * dst_bpp, dst_fmt, n, k_memory_layout);
+      }
+    }
+  }
+} // namespace.
+
+void convert_row(const std::uint8_t* src, image::format src_fmt, std::uint8_t* dst, image::format dst_fmt,
+    std::size_t count, image::alpha_conversion op) noexcept {
+  // Only pixels with both a color and an alpha can change premultiplication.
+  if (!has_alpha(src_fmt) || !has_color(src_fmt)) {
+    op = image::alpha_conversion::none;
+  }
+
+  if (src_fmt == dst_fmt && op == image::alpha_conversion::none) {
+    std::memcpy(dst, src, count * bytes_per_pixel(src_fmt));
+  }
+  else if (is_float_format(src_fmt) || is_float_format(dst_fmt)) {
+    convert_float_row(src, src_fmt, dst, dst_fmt, count, op);
+  }
+  else {
+    convert_u8_row(src, src_fmt, dst, dst_fmt, count, op);
+  }
+}
+
+} // namespace nano::detail.
+
+namespace nano {
+void image::convert_pixels(const nano::size<std::size_t>& size, const std::uint8_t* src, std::size_t src_bytes_per_row,
+    format src_fmt, std::uint8_t* dst, std::size_t dst_bytes_per_row, format dst_fmt, alpha_conversion op) {
+  if (!src || !dst || !size.width || !size.height) {
+    return;
+  }
+
+  // Bands of rows, each one is converted by a single thread.
+  detail::parallel_rows(size.height, size.width, [&](std::size_t y0, std::size_t y1) {
+    for (std::size_t y = y0; y < y1; y++) {
+      detail::convert_row(src + y * src_bytes_per_row, src_fmt, dst + y * dst_bytes_per_row, dst_fmt, size.width, op);
+    }
+  });
+}
+
+void image::convert_pixels(const image_view& src, const mutable_image_view& dst, alpha_conversion op) {
+  const nano::size<std::size_t> size
+      = { std::min(src.size.width, dst.size.width), std::min(src.size.height, dst.size.height) };
+  convert_pixels(size, src.data, src.bytes_per_row, src.fmt, dst.data, dst.bytes_per_row, dst.fmt, op);
+}
+
+std::size_t image::get_bytes_per_pixel(format fmt) noexcept { return detail::bytes_per_pixel(fmt); }
+} // namespace nano.
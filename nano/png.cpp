@@ -0,0 +1,1049 @@
+#include <nano/graphics_codec.h>
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+#include <zlib.h>
+
+namespace nano {
+namespace {
+  constexpr std::uint8_t k_signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+  /// Compressed bytes read at once by the decoder, the encoder writes an IDAT chunk each time it fills that much.
+  constexpr std::size_t k_buffer_size = 1 << 16;
+
+  /// Largest width, height and chunk length allowed by the specification.
+  constexpr std::uint32_t k_max_value = 0x7FFFFFFF;
+
+  /// Raw bytes of the bands of rows that the parallel encoder compresses on their own.
+  constexpr std::size_t k_band_bytes = 1 << 18;
+
+  /// Bands of each thread in a batch, some of them compress slower than others.
+  constexpr std::size_t k_bands_per_thread = 4;
+
+  /// Largest deflate dictionary.
+  constexpr std::size_t k_window_size = 1 << 15;
+
+  enum color_type : std::uint8_t { gray = 0, truecolor = 2, indexed = 3, gray_alpha = 4, truecolor_alpha = 6 };
+
+  enum filter_type : std::uint8_t { none = 0, sub, up, average, paeth };
+
+  struct adam7_pass {
+    std::size_t x0, y0, dx, dy;
+  };
+
+  constexpr adam7_pass k_adam7[7] = {
+    { 0, 0, 8, 8 },
+    { 4, 0, 8, 8 },
+    { 0, 4, 4, 8 },
+    { 2, 0, 4, 4 },
+    { 0, 2, 2, 4 },
+    { 1, 0, 2, 2 },
+    { 0, 1, 1, 2 },
+  };
+
+  static inline constexpr std::uint32_t make_chunk_type(const char (&s)[5]) noexcept {
+    return (std::uint32_t(std::uint8_t(s[0])) << 24) | (std::uint32_t(std::uint8_t(s[1])) << 16)
+        | (std::uint32_t(std::uint8_t(s[2])) << 8) | std::uint32_t(std::uint8_t(s[3]));
+  }
+
+  constexpr std::uint32_t k_ihdr = make_chunk_type("IHDR");
+  constexpr std::uint32_t k_plte = make_chunk_type("PLTE");
+  constexpr std::uint32_t k_trns = make_chunk_type("tRNS");
+  constexpr std::uint32_t k_idat = make_chunk_type("IDAT");
+  constexpr std::uint32_t k_iend = make_chunk_type("IEND");
+  constexpr std::uint32_t k_phys = make_chunk_type("pHYs");
+
+  /// pHYs units are pixels per meter.
+  constexpr double k_meters_per_inch = 0.0254;
+
+  /// Chunks whose type starts with an upper case letter can't be skipped.
+  static inline bool is_critical_chunk(std::uint32_t type) noexcept { return !(type & 0x20000000); }
+
+  static inline std::uint32_t read_u32(const std::uint8_t* p) noexcept {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+  }
+
+  static inline void write_u32(std::uint8_t* p, std::uint32_t v) noexcept {
+    p[0] = static_cast<std::uint8_t>(v >> 24);
+    p[1] = static_cast<std::uint8_t>(v >> 16);
+    p[2] = static_cast<std::uint8_t>(v >> 8);
+    p[3] = static_cast<std::uint8_t>(v);
+  }
+
+  static inline bool has_alpha(image::format fmt) noexcept {
+    switch (fmt) {
+    case image::format::alpha:
+    case image::format::argb:
+    case image::format::bgra:
+    case image::format::rgba:
+    case image::format::abgr:
+    case image::format::float_alpha:
+    case image::format::float_argb:
+    case image::format::float_rgba:
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+  static inline std::uint8_t paeth_predictor(std::uint8_t a, std::uint8_t b, std::uint8_t c) noexcept {
+    const int p = int(a) + int(b) - int(c);
+    const int pa = std::abs(p - int(a));
+    const int pb = std::abs(p - int(b));
+    const int pc = std::abs(p - int(c));
+
+    if (pa <= pb && pa <= pc) {
+      return a;
+    }
+
+    return pb <= pc ? b : c;
+  }
+
+  /// Value added to byte i of a row by the filter, prev is the previous unfiltered row.
+  static inline std::uint8_t predict(
+      std::uint8_t type, const std::uint8_t* row, const std::uint8_t* prev, std::size_t i, std::size_t bpp) noexcept {
+    const std::uint8_t left = i >= bpp ? row[i - bpp] : 0;
+
+    switch (type) {
+    case sub:
+      return left;
+
+    case up:
+      return prev[i];
+
+    case average:
+      return static_cast<std::uint8_t>((left + prev[i]) >> 1);
+
+    case paeth:
+      return paeth_predictor(left, prev[i], i >= bpp ? prev[i - bpp] : 0);
+
+    default:
+      return 0;
+    }
+  }
+
+  /// Reverses the filter of size bytes in place, false for an unknown filter type.
+  static inline bool unfilter_row(
+      std::uint8_t type, std::uint8_t* row, const std::uint8_t* prev, std::size_t size, std::size_t bpp) noexcept {
+    if (type > paeth) {
+      return false;
+    }
+
+    if (type != none) {
+      for (std::size_t i = 0; i < size; i++) {
+        row[i] = static_cast<std::uint8_t>(row[i] + predict(type, row, prev, i, bpp));
+      }
+    }
+
+    return true;
+  }
+
+  static inline void filter_row(std::uint8_t type, const std::uint8_t* row, const std::uint8_t* prev,
+      std::uint8_t* dst, std::size_t size, std::size_t bpp) noexcept {
+    for (std::size_t i = 0; i < size; i++) {
+      dst[i] = static_cast<std::uint8_t>(row[i] - predict(type, row, prev, i, bpp));
+    }
+  }
+
+  /// Sum of the filtered bytes taken as signed values, the heuristic suggested by the specification.
+  static inline std::size_t filtered_cost(const std::uint8_t* data, std::size_t size) noexcept {
+    std::size_t cost = 0;
+
+    for (std::size_t i = 0; i < size; i++) {
+      cost += static_cast<std::size_t>(std::abs(static_cast<int>(static_cast<std::int8_t>(data[i]))));
+    }
+
+    return cost;
+  }
+
+  /// Filters size bytes of row into dst, which starts with the filter type byte. The adaptive filter
+  /// keeps the cheapest of the five, scratch holds each candidate and has the size of dst.
+  static inline void apply_filter(png_filter f, const std::uint8_t* row, const std::uint8_t* prev, std::uint8_t* dst,
+      std::uint8_t* scratch, std::size_t size, std::size_t bpp) noexcept {
+    if (f != png_filter::adaptive) {
+      dst[0] = static_cast<std::uint8_t>(f);
+      filter_row(dst[0], row, prev, dst + 1, size, bpp);
+      return;
+    }
+
+    std::size_t best_cost = std::numeric_limits<std::size_t>::max();
+
+    for (std::uint8_t type = none; type <= paeth; type++) {
+      scratch[0] = type;
+      filter_row(type, row, prev, scratch + 1, size, bpp);
+
+      if (const std::size_t cost = filtered_cost(scratch + 1, size); cost < best_cost) {
+        best_cost = cost;
+        std::memcpy(dst, scratch, size + 1);
+      }
+    }
+  }
+
+  /// The two bytes starting a zlib stream, the same ones as deflateInit() for the level.
+  static inline std::uint16_t zlib_header(int level) noexcept {
+    const std::uint32_t flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    const std::uint32_t header = (0x78 << 8) | (flags << 6);
+    return static_cast<std::uint16_t>(header + 31 - header % 31);
+  }
+
+  /// Rows compressed on their own by the parallel encoder.
+  struct png_band {
+    std::vector<std::uint8_t> filtered;
+    std::vector<std::uint8_t> compressed;
+    uLong adler = 0;
+    bool valid = false;
+  };
+
+  /// Compresses the filtered rows of a band to raw deflate data, the band can be appended to the
+  /// ones before it: every band but the last one ends with a sync flush, which leaves the stream
+  /// on a byte boundary. The dictionary is the end of the data of the previous band.
+  static bool deflate_band(png_band& b, const std::uint8_t* dictionary, std::size_t dictionary_size, int level,
+      bool last) {
+    z_stream zs = {};
+
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+
+    if (dictionary_size) {
+      deflateSetDictionary(&zs, dictionary, static_cast<uInt>(dictionary_size));
+    }
+
+    // The bound doesn't count the empty block of the sync flush.
+    b.compressed.resize(deflateBound(&zs, static_cast<uLong>(b.filtered.size())) + 16);
+    zs.next_in = b.filtered.data();
+    zs.avail_in = static_cast<uInt>(b.filtered.size());
+    zs.next_out = b.compressed.data();
+    zs.avail_out = static_cast<uInt>(b.compressed.size());
+
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    int result = deflate(&zs, flush);
+
+    while (result == Z_OK && !zs.avail_out) {
+      const std::size_t used = b.compressed.size();
+      b.compressed.resize(used * 2);
+      zs.next_out = b.compressed.data() + used;
+      zs.avail_out = static_cast<uInt>(used);
+      result = deflate(&zs, flush);
+    }
+
+    b.compressed.resize(b.compressed.size() - zs.avail_out);
+    deflateEnd(&zs);
+    return result == (last ? Z_STREAM_END : Z_OK) && !zs.avail_in;
+  }
+} // namespace.
+
+//
+// MARK: png_decoder
+//
+
+struct png_decoder::pimpl {
+  pimpl(std::istream& s)
+      : in(s) {
+    valid = read_header();
+    size = valid ? size : nano::size<std::size_t>{ 0, 0 };
+  }
+
+  pimpl(const std::filesystem::path& filepath)
+      : file(filepath, std::ios::binary)
+      , in(file) {
+    valid = file.is_open() && read_header();
+    size = valid ? size : nano::size<std::size_t>{ 0, 0 };
+  }
+
+  ~pimpl() {
+    if (inflating) {
+      inflateEnd(&zs);
+    }
+  }
+
+  bool read(void* data, std::size_t size) {
+    in.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+    return !in.fail();
+  }
+
+  /// Starts a chunk, its crc is accumulated in chunk_crc until check_crc().
+  bool read_chunk_header(std::uint32_t& length, std::uint32_t& type) {
+    std::uint8_t header[8];
+
+    if (!read(header, sizeof(header))) {
+      return false;
+    }
+
+    length = read_u32(header);
+    type = read_u32(header + 4);
+    chunk_crc = crc32(crc32(0, Z_NULL, 0), header + 4, 4);
+    return length <= k_max_value;
+  }
+
+  bool read_chunk_data(std::uint8_t* data, std::size_t size) {
+    if (!read(data, size)) {
+      return false;
+    }
+
+    chunk_crc = crc32(chunk_crc, data, static_cast<uInt>(size));
+    return true;
+  }
+
+  bool skip_chunk_data(std::size_t size) {
+    for (std::size_t n = 0; size; size -= n) {
+      n = std::min(size, input.size());
+
+      if (!read_chunk_data(input.data(), n)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool check_crc() {
+    std::uint8_t crc[4];
+    return read(crc, sizeof(crc)) && read_u32(crc) == chunk_crc;
+  }
+
+  /// Reads everything up to the data of the first IDAT chunk.
+  bool read_header() {
+    std::uint8_t signature[sizeof(k_signature)];
+    std::uint8_t ihdr[13];
+    std::uint32_t length = 0;
+    std::uint32_t type = 0;
+
+    if (!read(signature, sizeof(signature)) || std::memcmp(signature, k_signature, sizeof(k_signature))
+        || !read_chunk_header(length, type) || type != k_ihdr || length != sizeof(ihdr)
+        || !read_chunk_data(ihdr, sizeof(ihdr)) || !check_crc()) {
+      return false;
+    }
+
+    size = { read_u32(ihdr), read_u32(ihdr + 4) };
+    depth = ihdr[8];
+    color = ihdr[9];
+    interlaced = ihdr[12] == 1;
+
+    switch (color) {
+    case gray:
+    case indexed:
+      channels = 1;
+      break;
+
+    case truecolor:
+      channels = 3;
+      break;
+
+    case gray_alpha:
+      channels = 2;
+      break;
+
+    case truecolor_alpha:
+      channels = 4;
+      break;
+
+    default:
+      return false;
+    }
+
+    const bool valid_depth = depth == 8 || depth == 16 || (color == gray && (depth == 1 || depth == 2 || depth == 4))
+        || (color == indexed && (depth == 1 || depth == 2 || depth == 4));
+
+    if (!size.width || !size.height || size.width > k_max_value || size.height > k_max_value || !valid_depth
+        || (color == indexed && depth == 16) || ihdr[10] || ihdr[11] || ihdr[12] > 1) {
+      return false;
+    }
+
+    input.resize(k_buffer_size);
+    palette_alpha.fill(255);
+    bool transparent = color == gray_alpha || color == truecolor_alpha;
+
+    for (;;) {
+      if (!read_chunk_header(length, type)) {
+        return false;
+      }
+
+      if (type == k_idat) {
+        chunk_left = length;
+        break;
+      }
+
+      if (type == k_plte && length <= 256 * 3 && length % 3 == 0) {
+        palette_size = length / 3;
+
+        if (!read_chunk_data(palette.data(), length)) {
+          return false;
+        }
+      }
+      else if (type == k_trns && color == indexed && length <= 256) {
+        transparent = true;
+
+        if (!read_chunk_data(palette_alpha.data(), length)) {
+          return false;
+        }
+      }
+      else if (type == k_trns && (color == gray || color == truecolor) && length == channels * 2) {
+        std::uint8_t key_data[6];
+        transparent = true;
+        has_key = true;
+
+        if (!read_chunk_data(key_data, length)) {
+          return false;
+        }
+
+        for (std::size_t c = 0; c < channels; c++) {
+          key[c] = static_cast<std::uint16_t>((key_data[c * 2] << 8) | key_data[c * 2 + 1]);
+        }
+      }
+      else if (is_critical_chunk(type)) {
+        return false;
+      }
+      else if (!skip_chunk_data(length)) {
+        return false;
+      }
+
+      if (!check_crc()) {
+        return false;
+      }
+    }
+
+    if (color == indexed && !palette_size) {
+      return false;
+    }
+
+    fmt = transparent ? image::format::abgr : image::format::rgb;
+    pixel_bytes = transparent ? 4 : 3;
+    filter_bytes = std::max<std::size_t>(1, channels * depth / 8);
+
+    const std::size_t row_size = 1 + get_raw_bytes(size.width);
+    current.resize(row_size);
+    previous.resize(row_size);
+    output.resize(size.width * pixel_bytes * (interlaced ? size.height : 1));
+
+    inflating = inflateInit(&zs) == Z_OK;
+    return inflating;
+  }
+
+  inline std::size_t get_raw_bytes(std::size_t width) const noexcept { return (width * channels * depth + 7) / 8; }
+
+  /// Moves the next compressed bytes of the IDAT chunks to the input buffer.
+  bool fill_input() {
+    while (!chunk_left) {
+      std::uint32_t type = 0;
+
+      if (!check_crc() || !read_chunk_header(chunk_left, type) || type != k_idat) {
+        return false;
+      }
+    }
+
+    const std::size_t n = std::min<std::size_t>(chunk_left, input.size());
+
+    if (!read_chunk_data(input.data(), n)) {
+      return false;
+    }
+
+    chunk_left -= static_cast<std::uint32_t>(n);
+    zs.next_in = input.data();
+    zs.avail_in = static_cast<uInt>(n);
+    return true;
+  }
+
+  bool inflate_bytes(std::uint8_t* data, std::size_t n) {
+    zs.next_out = data;
+    zs.avail_out = static_cast<uInt>(n);
+
+    while (zs.avail_out) {
+      if (!zs.avail_in && !fill_input()) {
+        return false;
+      }
+
+      const int result = inflate(&zs, Z_NO_FLUSH);
+
+      if (result == Z_STREAM_END) {
+        return !zs.avail_out;
+      }
+
+      if (result != Z_OK && result != Z_BUF_ERROR) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /// Inflates and unfilters the next row of width pixels, it ends up in previous.
+  bool decode_raw_row(std::size_t width) {
+    const std::size_t n = get_raw_bytes(width);
+
+    if (!inflate_bytes(current.data(), n + 1) || !unfilter_row(current[0], current.data() + 1, previous.data() + 1, n,
+            filter_bytes)) {
+      return false;
+    }
+
+    std::swap(current, previous);
+    return true;
+  }
+
+  /// Sample i of a raw row, a whole byte or less for the small depths.
+  inline std::uint32_t get_sample(const std::uint8_t* raw, std::size_t i) const noexcept {
+    switch (depth) {
+    case 8:
+      return raw[i];
+
+    case 16:
+      return (std::uint32_t(raw[i * 2]) << 8) | raw[i * 2 + 1];
+
+    default: {
+      const std::size_t bit = i * depth;
+      return (std::uint32_t(raw[bit >> 3]) >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+    }
+    }
+  }
+
+  inline std::uint8_t to_byte(std::uint32_t sample) const noexcept {
+    switch (depth) {
+    case 8:
+      return static_cast<std::uint8_t>(sample);
+
+    case 16:
+      return static_cast<std::uint8_t>((sample * 255 + 32767) / 65535);
+
+    default:
+      return static_cast<std::uint8_t>(sample * 255 / ((1u << depth) - 1));
+    }
+  }
+
+  /// Converts width pixels of a raw row to fmt.
+  void expand_row(const std::uint8_t* raw, std::size_t width, std::uint8_t* dst) const noexcept {
+    for (std::size_t i = 0; i < width; i++, dst += pixel_bytes) {
+      std::uint32_t samples[4] = { 0, 0, 0, 0 };
+      std::uint8_t a = 255;
+
+      for (std::size_t c = 0; c < channels; c++) {
+        samples[c] = get_sample(raw, i * channels + c);
+      }
+
+      switch (color) {
+      case gray:
+        a = has_key && samples[0] == key[0] ? 0 : 255;
+        dst[0] = dst[1] = dst[2] = to_byte(samples[0]);
+        break;
+
+      case truecolor:
+        a = has_key && samples[0] == key[0] && samples[1] == key[1] && samples[2] == key[2] ? 0 : 255;
+        dst[0] = to_byte(samples[0]);
+        dst[1] = to_byte(samples[1]);
+        dst[2] = to_byte(samples[2]);
+        break;
+
+      case indexed:
+        // Indices past the palette are an error, they are read as black.
+        if (samples[0] < palette_size) {
+          std::memcpy(dst, palette.data() + samples[0] * 3, 3);
+        }
+        else {
+          dst[0] = dst[1] = dst[2] = 0;
+        }
+
+        a = palette_alpha[samples[0]];
+        break;
+
+      case gray_alpha:
+        dst[0] = dst[1] = dst[2] = to_byte(samples[0]);
+        a = to_byte(samples[1]);
+        break;
+
+      default:
+        dst[0] = to_byte(samples[0]);
+        dst[1] = to_byte(samples[1]);
+        dst[2] = to_byte(samples[2]);
+        a = to_byte(samples[3]);
+        break;
+      }
+
+      if (pixel_bytes == 4) {
+        dst[3] = a;
+      }
+    }
+  }
+
+  /// Decodes the seven passes of an interlaced file into output.
+  bool decode_interlaced() {
+    std::vector<std::uint8_t> pass_row(size.width * pixel_bytes);
+
+    for (const adam7_pass& pass : k_adam7) {
+      const std::size_t width = size.width > pass.x0 ? (size.width - pass.x0 + pass.dx - 1) / pass.dx : 0;
+      const std::size_t height = size.height > pass.y0 ? (size.height - pass.y0 + pass.dy - 1) / pass.dy : 0;
+
+      if (!width || !height) {
+        continue;
+      }
+
+      std::fill(previous.begin(), previous.end(), std::uint8_t(0));
+
+      for (std::size_t y = 0; y < height; y++) {
+        if (!decode_raw_row(width)) {
+          return false;
+        }
+
+        expand_row(previous.data() + 1, width, pass_row.data());
+        std::uint8_t* dst = output.data() + ((pass.y0 + y * pass.dy) * size.width + pass.x0) * pixel_bytes;
+
+        for (std::size_t x = 0; x < width; x++) {
+          std::memcpy(dst + x * pass.dx * pixel_bytes, pass_row.data() + x * pixel_bytes, pixel_bytes);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /// The pixels of the next row in fmt, nullptr after the last one or on error.
+  const std::uint8_t* next_row() {
+    if (!valid || row_index >= size.height) {
+      return nullptr;
+    }
+
+    if (interlaced) {
+      if (!row_index && !decode_interlaced()) {
+        valid = false;
+        return nullptr;
+      }
+
+      return output.data() + row_index++ * size.width * pixel_bytes;
+    }
+
+    if (!decode_raw_row(size.width)) {
+      valid = false;
+      return nullptr;
+    }
+
+    expand_row(previous.data() + 1, size.width, output.data());
+    row_index++;
+    return output.data();
+  }
+
+  std::ifstream file;
+  std::istream& in;
+  bool valid = false;
+
+  nano::size<std::size_t> size = { 0, 0 };
+  image::format fmt = image::format::rgb;
+  std::size_t depth = 0;
+  std::uint8_t color = 0;
+  std::size_t channels = 0;
+  bool interlaced = false;
+
+  std::array<std::uint8_t, 256 * 3> palette = {};
+  std::array<std::uint8_t, 256> palette_alpha = {};
+  std::size_t palette_size = 0;
+
+  // Color of the transparent pixels, from the tRNS chunk of gray and truecolor files.
+  bool has_key = false;
+  std::uint16_t key[3] = { 0, 0, 0 };
+
+  z_stream zs = {};
+  bool inflating = false;
+  std::vector<std::uint8_t> input;
+  std::uint32_t chunk_left = 0;
+  uLong chunk_crc = 0;
+
+  // Bytes of a pixel for the filters, at least 1, and of a pixel in fmt.
+  std::size_t filter_bytes = 0;
+  std::size_t pixel_bytes = 0;
+
+  // Rows starting with their filter type byte.
+  std::vector<std::uint8_t> current;
+  std::vector<std::uint8_t> previous;
+
+  // One row in fmt, or the whole image when interlaced.
+  std::vector<std::uint8_t> output;
+  std::size_t row_index = 0;
+};
+
+png_decoder::png_decoder(const std::filesystem::path& filepath) { m_pimpl = new pimpl(filepath); }
+
+png_decoder::png_decoder(std::istream& stream) { m_pimpl = new pimpl(stream); }
+
+png_decoder::~png_decoder() { delete m_pimpl; }
+
+bool png_decoder::is_valid() const { return m_pimpl->valid; }
+
+nano::size<std::size_t> png_decoder::get_size() const { return m_pimpl->size; }
+
+image::format png_decoder::get_format() const { return m_pimpl->fmt; }
+
+std::size_t png_decoder::get_row_index() const { return m_pimpl->row_index; }
+
+bool png_decoder::read_row(std::uint8_t* row, image::format fmt) {
+  const std::uint8_t* src = m_pimpl->next_row();
+
+  if (!src) {
+    return false;
+  }
+
+  if (fmt == m_pimpl->fmt) {
+    std::memcpy(row, src, m_pimpl->size.width * m_pimpl->pixel_bytes);
+  }
+  else {
+    detail::convert_row(src, m_pimpl->fmt, row, fmt, m_pimpl->size.width);
+  }
+
+  return true;
+}
+
+bool png_decoder::read_rows(const std::function<bool(std::size_t, const image_view&)>& fct) {
+  const nano::size<std::size_t> row_size = { m_pimpl->size.width, 1 };
+
+  while (m_pimpl->row_index < m_pimpl->size.height) {
+    const std::size_t y = m_pimpl->row_index;
+    const std::uint8_t* src = m_pimpl->next_row();
+
+    if (!src || !fct(y, image_view(src, row_size, row_size.width * m_pimpl->pixel_bytes, m_pimpl->fmt))) {
+      return false;
+    }
+  }
+
+  return m_pimpl->valid;
+}
+
+//
+// MARK: png_encoder
+//
+
+struct png_encoder::pimpl {
+  pimpl(std::ostream& s, const nano::size<std::size_t>& sz, image::format f, const png_options& opts)
+      : out(s)
+      , size(sz)
+      , src_fmt(f)
+      , options(opts) {
+    valid = init();
+  }
+
+  pimpl(const std::filesystem::path& filepath, const nano::size<std::size_t>& sz, image::format f,
+      const png_options& opts)
+      : file(filepath, std::ios::binary)
+      , out(file)
+      , size(sz)
+      , src_fmt(f)
+      , options(opts) {
+    valid = file.is_open() && init();
+  }
+
+  ~pimpl() {
+    if (deflating) {
+      deflateEnd(&zs);
+    }
+  }
+
+  bool write(const void* data, std::size_t n) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+    return !out.fail();
+  }
+
+  bool write_chunk(std::uint32_t type, const std::uint8_t* data, std::size_t length) {
+    std::uint8_t header[8];
+    std::uint8_t crc[4];
+    write_u32(header, static_cast<std::uint32_t>(length));
+    write_u32(header + 4, type);
+
+    uLong c = crc32(crc32(0, Z_NULL, 0), header + 4, 4);
+
+    if (length) {
+      c = crc32(c, data, static_cast<uInt>(length));
+    }
+
+    write_u32(crc, static_cast<std::uint32_t>(c));
+    return write(header, sizeof(header)) && (!length || write(data, length)) && write(crc, sizeof(crc));
+  }
+
+  bool init() {
+    if (!size.width || !size.height || size.width > k_max_value || size.height > k_max_value) {
+      return false;
+    }
+
+    fmt = has_alpha(src_fmt) ? image::format::abgr : image::format::rgb;
+    pixel_bytes = fmt == image::format::abgr ? 4 : 3;
+
+    const std::size_t row_size = size.width * pixel_bytes;
+    row.resize(row_size);
+    previous.resize(row_size);
+    filtered.resize(row_size + 1);
+    candidate.resize(row_size + 1);
+    level = std::clamp(options.compression_level, 0, 9);
+
+    // A single band is encoded on the calling thread. The bands don't depend on the number of threads,
+    // neither does the file.
+    const std::size_t thread_count = detail::thread_pool::shared().get_worker_count() + 1;
+    band_rows = std::max<std::size_t>(1, k_band_bytes / row_size);
+    parallel = options.parallel && size.height > band_rows;
+
+    if (parallel) {
+      batch.resize(std::min(size.height, band_rows * k_bands_per_thread * thread_count) * row_size);
+      adler = adler32(0, Z_NULL, 0);
+    }
+    else {
+      if (deflateInit(&zs, level) != Z_OK) {
+        return false;
+      }
+
+      deflating = true;
+      output.resize(k_buffer_size);
+      zs.next_out = output.data();
+      zs.avail_out = static_cast<uInt>(output.size());
+    }
+
+    std::uint8_t ihdr[13];
+    write_u32(ihdr, static_cast<std::uint32_t>(size.width));
+    write_u32(ihdr + 4, static_cast<std::uint32_t>(size.height));
+    ihdr[8] = 8;
+    ihdr[9] = pixel_bytes == 4 ? truecolor_alpha : truecolor;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+    if (!write(k_signature, sizeof(k_signature)) || !write_chunk(k_ihdr, ihdr, sizeof(ihdr))) {
+      return false;
+    }
+
+    if (options.dpi.width <= 0 || options.dpi.height <= 0) {
+      return true;
+    }
+
+    std::uint8_t phys[9];
+    write_u32(phys, static_cast<std::uint32_t>(std::lround(options.dpi.width / k_meters_per_inch)));
+    write_u32(phys + 4, static_cast<std::uint32_t>(std::lround(options.dpi.height / k_meters_per_inch)));
+    phys[8] = 1;
+    return write_chunk(k_phys, phys, sizeof(phys));
+  }
+
+  /// Writes the compressed bytes waiting in output as an IDAT chunk.
+  bool flush_output() {
+    const std::size_t n = output.size() - zs.avail_out;
+
+    if (n && !write_chunk(k_idat, output.data(), n)) {
+      return false;
+    }
+
+    zs.next_out = output.data();
+    zs.avail_out = static_cast<uInt>(output.size());
+    return true;
+  }
+
+  bool deflate_bytes(const std::uint8_t* data, std::size_t n, int flush) {
+    zs.next_in = const_cast<std::uint8_t*>(data);
+    zs.avail_in = static_cast<uInt>(n);
+
+    for (;;) {
+      const int result = deflate(&zs, flush);
+
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+
+      if (!zs.avail_out) {
+        if (!flush_output()) {
+          return false;
+        }
+      }
+      else if (!zs.avail_in && (flush == Z_NO_FLUSH || result == Z_STREAM_END)) {
+        return true;
+      }
+    }
+  }
+
+  /// Filters and compresses the rows of the batch by bands on the thread pool, then writes the bands in order.
+  /// The zlib stream is the concatenation of the bands, between a header and the combined checksum.
+  bool compress_batch(bool last) {
+    const std::size_t n = row.size();
+    const std::size_t count = (batch_rows + band_rows - 1) / band_rows;
+    const bool first = row_index == batch_rows;
+    detail::thread_pool& pool = detail::thread_pool::shared();
+
+    if (bands.size() < count) {
+      bands.resize(count);
+    }
+
+    pool.parallel_for(count, 0, [&](std::size_t i) {
+      png_band& b = bands[i];
+      const std::size_t y0 = i * band_rows;
+      const std::size_t y1 = std::min(batch_rows, y0 + band_rows);
+      std::vector<std::uint8_t> scratch(n + 1);
+      b.filtered.resize((y1 - y0) * (n + 1));
+
+      for (std::size_t y = y0; y < y1; y++) {
+        const std::uint8_t* r = batch.data() + y * n;
+        apply_filter(options.filter, r, y ? r - n : previous.data(), b.filtered.data() + (y - y0) * (n + 1),
+            scratch.data(), n, pixel_bytes);
+      }
+    });
+
+    // The dictionaries are the filtered rows of the previous bands, they are all ready.
+    pool.parallel_for(count, 0, [&](std::size_t i) {
+      png_band& b = bands[i];
+      const std::vector<std::uint8_t>& prev = i ? bands[i - 1].filtered : dictionary;
+      const std::size_t dictionary_size = std::min(prev.size(), k_window_size);
+
+      b.adler = adler32(adler32(0, Z_NULL, 0), b.filtered.data(), static_cast<uInt>(b.filtered.size()));
+      b.valid = deflate_band(
+          b, prev.data() + prev.size() - dictionary_size, dictionary_size, level, last && i == count - 1);
+    });
+
+    for (std::size_t i = 0; i < count; i++) {
+      png_band& b = bands[i];
+
+      if (!b.valid) {
+        return false;
+      }
+
+      if (first && !i) {
+        const std::uint16_t header = zlib_header(level);
+        b.compressed.insert(b.compressed.begin(),
+            { static_cast<std::uint8_t>(header >> 8), static_cast<std::uint8_t>(header & 0xFF) });
+      }
+
+      adler = adler32_combine(adler, b.adler, static_cast<z_off_t>(b.filtered.size()));
+
+      if (last && i == count - 1) {
+        b.compressed.resize(b.compressed.size() + 4);
+        write_u32(b.compressed.data() + b.compressed.size() - 4, static_cast<std::uint32_t>(adler));
+      }
+
+      if (!write_chunk(k_idat, b.compressed.data(), b.compressed.size())) {
+        return false;
+      }
+    }
+
+    const std::vector<std::uint8_t>& tail = bands[count - 1].filtered;
+    dictionary.assign(tail.end() - static_cast<std::ptrdiff_t>(std::min(tail.size(), k_window_size)), tail.end());
+    std::memcpy(previous.data(), batch.data() + (batch_rows - 1) * n, n);
+    batch_rows = 0;
+    return true;
+  }
+
+  bool write_row(const std::uint8_t* src) {
+    if (!valid || row_index >= size.height) {
+      return false;
+    }
+
+    std::uint8_t* dst = parallel ? batch.data() + batch_rows * row.size() : row.data();
+
+    if (src_fmt == fmt) {
+      std::memcpy(dst, src, row.size());
+    }
+    else {
+      detail::convert_row(src, src_fmt, dst, fmt, size.width);
+    }
+
+    const bool last = ++row_index == size.height;
+
+    if (parallel) {
+      if (++batch_rows * row.size() == batch.size() || last) {
+        valid = compress_batch(last);
+      }
+    }
+    else {
+      apply_filter(options.filter, row.data(), previous.data(), filtered.data(), candidate.data(), row.size(),
+          pixel_bytes);
+      valid = deflate_bytes(filtered.data(), filtered.size(), last ? Z_FINISH : Z_NO_FLUSH);
+      std::swap(row, previous);
+    }
+
+    return last ? finish() : valid;
+  }
+
+  bool finish() {
+    if (!valid || row_index < size.height) {
+      return false;
+    }
+
+    if (!finished) {
+      finished = true;
+      valid = (parallel || flush_output()) && write_chunk(k_iend, nullptr, 0) && out.flush();
+    }
+
+    return valid;
+  }
+
+  std::ofstream file;
+  std::ostream& out;
+  bool valid = false;
+  bool finished = false;
+
+  nano::size<std::size_t> size;
+  image::format src_fmt;
+  png_options options;
+
+  // Pixels written to the file, rgba or rgb bytes.
+  image::format fmt = image::format::rgb;
+  std::size_t pixel_bytes = 0;
+
+  z_stream zs = {};
+  int level = 0;
+  bool deflating = false;
+
+  std::vector<std::uint8_t> row;
+  std::vector<std::uint8_t> previous;
+
+  // Filtered rows starting with their filter type byte.
+  std::vector<std::uint8_t> filtered;
+  std::vector<std::uint8_t> candidate;
+
+  std::vector<std::uint8_t> output;
+  std::size_t row_index = 0;
+
+  // Parallel encoding: converted rows waiting for a batch of bands, the bands of the last batch,
+  // the end of the filtered data already compressed and its checksum.
+  bool parallel = false;
+  std::size_t band_rows = 0;
+  std::vector<std::uint8_t> batch;
+  std::size_t batch_rows = 0;
+  std::vector<png_band> bands;
+  std::vector<std::uint8_t> dictionary;
+  uLong adler = 0;
+};
+
+png_encoder::png_encoder(const std::filesystem::path& filepath, const nano::size<std::size_t>& size,
+    image::format fmt, const png_options& options) {
+  m_pimpl = new pimpl(filepath, size, fmt, options);
+}
+
+png_encoder::png_encoder(
+    std::ostream& stream, const nano::size<std::size_t>& size, image::format fmt, const png_options& options) {
+  m_pimpl = new pimpl(stream, size, fmt, options);
+}
+
+png_encoder::~png_encoder() {
+  m_pimpl->finish();
+  delete m_pimpl;
+}
+
+bool png_encoder::is_valid() const { return m_pimpl->valid; }
+
+nano::size<std::size_t> png_encoder::get_size() const { return m_pimpl->size; }
+
+std::size_t png_encoder::get_row_index() const { return m_pimpl->row_index; }
+
+bool png_encoder::write_row(const std::uint8_t* row) { return m_pimpl->write_row(row); }
+
+bool png_encoder::write_rows(const std::function<void(std::size_t, const mutable_image_view&)>& fct) {
+  const nano::size<std::size_t> row_size = { m_pimpl->size.width, 1 };
+  const std::size_t bytes_per_row = row_size.width * image::get_bytes_per_pixel(m_pimpl->src_fmt);
+  std::vector<std::uint8_t> buffer(bytes_per_row);
+
+  while (m_pimpl->valid && m_pimpl->row_index < m_pimpl->size.height) {
+    fct(m_pimpl->row_index, mutable_image_view(buffer.data(), row_size, bytes_per_row, m_pimpl->src_fmt));
+
+    if (!m_pimpl->write_row(buffer.data())) {
+      return false;
+    }
+  }
+
+  return m_pimpl->valid;
+}
+
+bool png_encoder::finish() { return m_pimpl->finish(); }
+} // namespace nano.
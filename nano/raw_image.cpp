@@ -0,0 +1,202 @@
+#include <nano/graphics_codec.h>
+#include <nano/graphics_raster.h>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nano {
+namespace {
+  constexpr char k_magic[8] = { 'N', 'A', 'N', 'O', 'I', 'M', 'G', '\0' };
+
+  /// Also tells the byte order, the header and the pixels are in the one of the machine that wrote the file.
+  constexpr std::uint32_t k_version = 1;
+
+  /// Alignment of the rows in the file, the mapping itself is page aligned.
+  constexpr std::size_t k_row_alignment = 64;
+
+  /// Bit of raw_header::flags set when the pixels are premultiplied.
+  constexpr std::uint32_t k_premultiplied_flag = 1;
+
+  struct raw_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint64_t width;
+    std::uint64_t height;
+    std::uint64_t bytes_per_row;
+    std::uint64_t data_offset;
+    std::uint32_t flags;
+    std::uint8_t reserved[12];
+  };
+
+  static_assert(sizeof(raw_header) == k_row_alignment, "The first row must be aligned");
+
+  static inline bool is_valid_format(std::uint32_t fmt) noexcept {
+    return fmt <= static_cast<std::uint32_t>(image::format::float_rgba);
+  }
+
+  /// Writes the rows one at a time after the header, used to save images and to convert files.
+  class raw_writer {
+  public:
+    raw_writer(const std::filesystem::path& filepath, const nano::size<std::size_t>& size, image::format fmt,
+        bool premultiplied)
+        : m_file(filepath, std::ios::binary | std::ios::trunc)
+        , m_row_bytes((size.width * detail::get_bits_per_pixel(fmt) + 7) / 8)
+        , m_height(size.height) {
+
+      raw_header header = {};
+      std::memcpy(header.magic, k_magic, sizeof(k_magic));
+      header.version = k_version;
+      header.format = static_cast<std::uint32_t>(fmt);
+      header.width = size.width;
+      header.height = size.height;
+      header.bytes_per_row = (m_row_bytes + k_row_alignment - 1) / k_row_alignment * k_row_alignment;
+      header.data_offset = sizeof(raw_header);
+      header.flags = premultiplied ? k_premultiplied_flag : 0;
+
+      m_padding = static_cast<std::size_t>(header.bytes_per_row) - m_row_bytes;
+      m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    inline bool is_valid() const { return m_file.good(); }
+
+    bool write_row(const std::uint8_t* row) {
+      constexpr char zeros[k_row_alignment] = {};
+      m_file.write(reinterpret_cast<const char*>(row), static_cast<std::streamsize>(m_row_bytes));
+      m_file.write(zeros, static_cast<std::streamsize>(m_padding));
+      m_rows++;
+      return m_file.good();
+    }
+
+    bool finish() {
+      m_file.flush();
+      return m_file.good() && m_rows == m_height;
+    }
+
+  private:
+    std::ofstream m_file;
+    std::size_t m_row_bytes;
+    std::size_t m_padding = 0;
+    std::size_t m_height;
+    std::size_t m_rows = 0;
+  };
+
+  template <class Decoder>
+  static bool convert_rows(Decoder& decoder, const std::filesystem::path& dst) {
+    if (!decoder.is_valid()) {
+      return false;
+    }
+
+    raw_writer writer(dst, decoder.get_size(), decoder.get_format(), false);
+    return writer.is_valid()
+        && decoder.read_rows([&](std::size_t, const image_view& row) { return writer.write_row(row.data); })
+        && writer.finish();
+  }
+} // namespace.
+
+namespace detail {
+  std::unique_ptr<mapped_file> mapped_file::map(const std::filesystem::path& filepath) {
+    const int fd = ::open(filepath.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+      return nullptr;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+      ::close(fd);
+      return nullptr;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(info.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+      return nullptr;
+    }
+
+    return std::unique_ptr<mapped_file>(new mapped_file(static_cast<std::uint8_t*>(data), size));
+  }
+
+  mapped_file::~mapped_file() { ::munmap(m_data, m_size); }
+
+  bitmap* map_raw_image(const std::filesystem::path& filepath) {
+    std::unique_ptr<mapped_file> file = mapped_file::map(filepath);
+
+    if (!file || file->size() < sizeof(raw_header)) {
+      return nullptr;
+    }
+
+    raw_header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, k_magic, sizeof(k_magic)) != 0 || header.version != k_version
+        || !is_valid_format(header.format) || !header.width || !header.height) {
+      return nullptr;
+    }
+
+    const image::format fmt = static_cast<image::format>(header.format);
+    constexpr std::uint64_t max_size = std::numeric_limits<std::uint32_t>::max();
+
+    // Every row must be in the file and the pixels aligned like the ones of save_raw_image().
+    if (header.width > max_size || header.height > max_size || header.data_offset % k_row_alignment
+        || header.bytes_per_row % k_row_alignment
+        || header.bytes_per_row < (header.width * detail::get_bits_per_pixel(fmt) + 7) / 8
+        || header.data_offset > file->size()
+        || (file->size() - header.data_offset) / header.bytes_per_row < header.height) {
+      return nullptr;
+    }
+
+    bitmap* bmp = new bitmap;
+    bmp->size = { static_cast<std::size_t>(header.width), static_cast<std::size_t>(header.height) };
+    bmp->fmt = fmt;
+    bmp->bits_per_component = get_bits_per_component(fmt);
+    bmp->bits_per_pixel = get_bits_per_pixel(fmt);
+    bmp->bytes_per_row = static_cast<std::size_t>(header.bytes_per_row);
+    bmp->premultiplied = header.flags & k_premultiplied_flag;
+    bmp->data = file->data() + header.data_offset;
+    bmp->mapping = std::move(file);
+    return bmp;
+  }
+
+  bool save_raw_image(const std::filesystem::path& filepath, const image_view& v, bool premultiplied) {
+    if (!v.data || !v.size.width || !v.size.height) {
+      return false;
+    }
+
+    raw_writer writer(filepath, v.size, v.fmt, premultiplied);
+
+    for (std::size_t y = 0; y < v.size.height && writer.is_valid(); y++) {
+      writer.write_row(v.data + y * v.bytes_per_row);
+    }
+
+    return writer.finish();
+  }
+} // namespace detail.
+
+bool convert_to_raw_image(const std::filesystem::path& src, image::type src_type, const std::filesystem::path& dst) {
+  if (src_type == image::type::png) {
+    png_decoder decoder(src);
+    return convert_rows(decoder, dst);
+  }
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  if (src_type == image::type::jpeg) {
+    jpeg_decoder decoder(src);
+    return convert_rows(decoder, dst);
+  }
+#endif // NANO_GRAPHICS_SOFTWARE_RENDERER
+
+  image img(src.string(), src_type);
+  return img.is_valid() && img.save(dst, image::type::raw);
+}
+} // namespace nano.
@@ -0,0 +1,322 @@
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace nano::detail {
+
+namespace {
+  constexpr float k_pi = 3.14159265358979f;
+
+  //
+  // Filters, x is in source pixels from the center of the destination one.
+  //
+
+  static inline float box_weight(float x) noexcept { return x > -0.5f && x <= 0.5f ? 1.0f : 0.0f; }
+
+  static inline float triangle_weight(float x) noexcept {
+    x = std::abs(x);
+    return x < 1.0f ? 1.0f - x : 0.0f;
+  }
+
+  /// Catmull-Rom, the cubic with a = -0.5.
+  static inline float cubic_weight(float x) noexcept {
+    x = std::abs(x);
+
+    if (x < 1.0f) {
+      return (1.5f * x - 2.5f) * x * x + 1.0f;
+    }
+
+    return x < 2.0f ? ((-0.5f * x + 2.5f) * x - 4.0f) * x + 2.0f : 0.0f;
+  }
+
+  static inline float sinc(float x) noexcept {
+    if (x == 0.0f) {
+      return 1.0f;
+    }
+
+    x *= k_pi;
+    return std::sin(x) / x;
+  }
+
+  static inline float lanczos3_weight(float x) noexcept { return std::abs(x) < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f; }
+
+  struct filter_kernel {
+    float support;
+    float (*weight)(float x) noexcept;
+  };
+
+  static inline filter_kernel get_filter_kernel(image::filter f) noexcept {
+    switch (f) {
+    case image::filter::box:
+      return { 0.5f, &box_weight };
+    case image::filter::bilinear:
+      return { 1.0f, &triangle_weight };
+    case image::filter::bicubic:
+      return { 2.0f, &cubic_weight };
+    case image::filter::lanczos3:
+      return { 3.0f, &lanczos3_weight };
+    }
+
+    return { 2.0f, &cubic_weight };
+  }
+
+  /// Contributions of the source pixels to each destination pixel along one axis.
+  /// Every destination pixel has the same number of taps, starting at first[i] inside the source,
+  /// the unused ones have a zero weight.
+  struct weight_table {
+    weight_table(std::size_t src_size, std::size_t dst_size, image::filter f) {
+      const filter_kernel kernel = get_filter_kernel(f);
+      const float ratio = static_cast<float>(src_size) / static_cast<float>(dst_size);
+
+      // Downscaling stretches the filter over the source pixels, which averages them.
+      const float scale = std::max(ratio, 1.0f);
+      const float support = kernel.support * scale;
+
+      taps = std::min(src_size, static_cast<std::size_t>(std::ceil(support)) * 2 + 1);
+      first.resize(dst_size);
+      weights.assign(dst_size * taps, 0.0f);
+
+      for (std::size_t i = 0; i < dst_size; i++) {
+        const float center = (static_cast<float>(i) + 0.5f) * ratio;
+        const std::size_t lo = static_cast<std::size_t>(std::max(center - support + 0.5f, 0.0f));
+        const std::size_t hi = std::min(src_size, static_cast<std::size_t>(std::max(center + support + 0.5f, 0.0f)));
+
+        // Keeps the taps inside the source, the window is moved left near the end.
+        const std::size_t start = std::min(lo, src_size - taps);
+        float* w = weights.data() + i * taps;
+        float total = 0;
+
+        for (std::size_t j = lo; j < std::min(hi, start + taps); j++) {
+          w[j - start] = kernel.weight((static_cast<float>(j) - center + 0.5f) / scale);
+          total += w[j - start];
+        }
+
+        if (total == 0.0f) {
+          // Rounding can leave the box without a pixel, the nearest one is used.
+          const std::size_t nearest = std::min(static_cast<std::size_t>(center), src_size - 1);
+          w[std::clamp(nearest, start, start + taps - 1) - start] = 1.0f;
+        }
+        else {
+          for (std::size_t k = 0; k < taps; k++) {
+            w[k] /= total;
+          }
+        }
+
+        first[i] = start;
+      }
+    }
+
+    std::size_t taps = 0;
+    std::vector<std::size_t> first;
+    std::vector<float> weights;
+  };
+
+  //
+  // Scalar kernels on premultiplied float rgba pixels.
+  //
+
+  static inline void scalar_convolve_row(
+      const float* src, float* dst, std::size_t count, const weight_table& t, std::size_t done) noexcept {
+    for (std::size_t i = done; i < count; i++) {
+      const float* px = src + t.first[i] * 4;
+      const float* w = t.weights.data() + i * t.taps;
+      float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+      for (std::size_t k = 0; k < t.taps; k++) {
+        for (std::size_t c = 0; c < 4; c++) {
+          acc[c] = acc[c] + px[k * 4 + c] * w[k];
+        }
+      }
+
+      std::copy(acc, acc + 4, dst + i * 4);
+    }
+  }
+
+  static inline void scalar_accumulate(float* acc, const float* src, float w, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; i++) {
+      acc[i] = acc[i] + src[i] * w;
+    }
+  }
+
+  /// The filters with negative lobes can overshoot, colors are kept in [0, alpha].
+  static inline void scalar_clamp_premultiplied(float* px, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; i++, px += 4) {
+      const float a = std::min(std::max(px[3], 0.0f), 1.0f);
+
+      for (std::size_t c = 0; c < 4; c++) {
+        px[c] = std::min(std::max(px[c], 0.0f), a);
+      }
+    }
+  }
+
+#if NANO_GRAPHICS_SSE2
+  namespace sse2 {
+    /// One pixel per register, the taps are summed in the same order as the scalar kernel.
+    static std::size_t convolve_row(const float* src, float* dst, std::size_t count, const weight_table& t) noexcept {
+      for (std::size_t i = 0; i < count; i++) {
+        const float* px = src + t.first[i] * 4;
+        const float* w = t.weights.data() + i * t.taps;
+        __m128 acc = _mm_setzero_ps();
+
+        for (std::size_t k = 0; k < t.taps; k++) {
+          acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(px + k * 4), _mm_set1_ps(w[k])));
+        }
+
+        _mm_storeu_ps(dst + i * 4, acc);
+      }
+
+      return count;
+    }
+
+    static std::size_t accumulate(float* acc, const float* src, float w, std::size_t count) noexcept {
+      const __m128 weight = _mm_set1_ps(w);
+      std::size_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), weight)));
+      }
+
+      return i;
+    }
+
+    static std::size_t clamp_premultiplied(float* px, std::size_t count) noexcept {
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 one = _mm_set1_ps(1.0f);
+
+      for (std::size_t i = 0; i < count; i++) {
+        const __m128 p = _mm_loadu_ps(px + i * 4);
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)), zero), one);
+        _mm_storeu_ps(px + i * 4, _mm_min_ps(_mm_max_ps(p, zero), a));
+      }
+
+      return count;
+    }
+  } // namespace sse2.
+#endif // NANO_GRAPHICS_SSE2
+
+#if NANO_GRAPHICS_AVX2
+  namespace avx2 {
+    NANO_GRAPHICS_AVX2_TARGET static std::size_t accumulate(
+        float* acc, const float* src, float w, std::size_t count) noexcept {
+      const __m256 weight = _mm256_set1_ps(w);
+      std::size_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(
+            acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), weight)));
+      }
+
+      return i;
+    }
+  } // namespace avx2.
+#endif // NANO_GRAPHICS_AVX2
+
+  //
+  // Dispatch, each vector kernel returns how many elements it did and the scalar one does the rest.
+  //
+
+  static inline void convolve_row(const float* src, float* dst, std::size_t count, const weight_table& t) noexcept {
+    std::size_t done = 0;
+
+    // A pixel fills an SSE register, wider vectors would have to mix the taps of two pixels.
+#if NANO_GRAPHICS_SSE2
+    if (get_simd_level() != simd_level::scalar) {
+      done = sse2::convolve_row(src, dst, count, t);
+    }
+#endif
+
+    scalar_convolve_row(src, dst, count, t, done);
+  }
+
+  static inline void accumulate(float* acc, const float* src, float w, std::size_t count) noexcept {
+    std::size_t done = 0;
+
+    switch (get_simd_level()) {
+#if NANO_GRAPHICS_AVX2
+    case simd_level::avx2:
+      done = avx2::accumulate(acc, src, w, count);
+      break;
+#endif
+
+#if NANO_GRAPHICS_SSE2
+    case simd_level::sse2:
+      done = sse2::accumulate(acc, src, w, count);
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+    scalar_accumulate(acc + done, src + done, w, count - done);
+  }
+
+  static inline void clamp_premultiplied(float* px, std::size_t count) noexcept {
+    std::size_t done = 0;
+
+#if NANO_GRAPHICS_SSE2
+    if (get_simd_level() != simd_level::scalar) {
+      done = sse2::clamp_premultiplied(px, count);
+    }
+#endif
+
+    scalar_clamp_premultiplied(px + done * 4, count - done);
+  }
+} // namespace.
+
+void resize_pixels(const image_view& src, const mutable_image_view& dst, image::filter f, bool premultiplied) {
+  if (!src || !dst || !src.size.width || !src.size.height || !dst.size.width || !dst.size.height) {
+    return;
+  }
+
+  const weight_table horizontal(src.size.width, dst.size.width, f);
+  const weight_table vertical(src.size.height, dst.size.height, f);
+
+  // Filtering is done on premultiplied colors, so that transparent pixels don't bleed their color.
+  const image::alpha_conversion load_op
+      = premultiplied ? image::alpha_conversion::none : image::alpha_conversion::premultiply;
+  const image::alpha_conversion store_op
+      = premultiplied ? image::alpha_conversion::none : image::alpha_conversion::unpremultiply;
+
+  // First pass, every source row is resampled horizontally into dst.size.width x src.size.height pixels.
+  const std::size_t row_floats = dst.size.width * 4;
+  std::vector<float> columns(row_floats * src.size.height);
+
+  parallel_rows(src.size.height, src.size.width + dst.size.width, [&](std::size_t y0, std::size_t y1) {
+    std::vector<float> line(src.size.width * 4);
+
+    for (std::size_t y = y0; y < y1; y++) {
+      convert_row(src.row(y), src.fmt, reinterpret_cast<std::uint8_t*>(line.data()), image::format::float_rgba,
+          src.size.width, load_op);
+      convolve_row(line.data(), columns.data() + y * row_floats, dst.size.width, horizontal);
+    }
+  });
+
+  // Second pass, the rows of the first one are blended into each destination row.
+  parallel_rows(dst.size.height, dst.size.width * vertical.taps, [&](std::size_t y0, std::size_t y1) {
+    std::vector<float> line(row_floats);
+
+    for (std::size_t y = y0; y < y1; y++) {
+      const float* w = vertical.weights.data() + y * vertical.taps;
+      std::fill(line.begin(), line.end(), 0.0f);
+
+      for (std::size_t k = 0; k < vertical.taps; k++) {
+        if (w[k] != 0.0f) {
+          accumulate(line.data(), columns.data() + (vertical.first[y] + k) * row_floats, w[k], row_floats);
+        }
+      }
+
+      clamp_premultiplied(line.data(), dst.size.width);
+      convert_row(reinterpret_cast<const std::uint8_t*>(line.data()), image::format::float_rgba, dst.row(y),
+          dst.fmt, dst.size.width, store_op);
+    }
+  });
+}
+} // namespace nano::detail.
+
+namespace nano {
+void image::resize_pixels(const image_view& src, const mutable_image_view& dst, filter f) {
+  detail::resize_pixels(src, dst, f, false);
+}
+} // namespace nano.
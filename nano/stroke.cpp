@@ -0,0 +1,327 @@
+#include <nano/graphics_path.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace nano::detail {
+
+//
+// MARK: stroker
+//
+
+namespace {
+  constexpr float k_pi = 3.14159265358979323846f;
+
+  /// Maximum distance in pixels between a round join or cap and the real arc.
+  constexpr float k_arc_tolerance = 0.1f;
+
+  using vec = nano::point<float>;
+
+  static inline float cross(const vec& a, const vec& b) noexcept { return a.x * b.y - a.y * b.x; }
+
+  static inline float dot(const vec& a, const vec& b) noexcept { return a.x * b.x + a.y * b.y; }
+
+  static inline float length(const vec& v) noexcept { return std::sqrt(dot(v, v)); }
+
+  static inline vec rotate(const vec& v, float c, float s) noexcept { return { v.x * c - v.y * s, v.x * s + v.y * c }; }
+
+  /// Left normal of the unit direction d, scaled by the half width.
+  static inline vec normal(const vec& d, float hw) noexcept { return { -d.y * hw, d.x * hw }; }
+
+  static inline int get_arc_segments(float radius, float sweep) noexcept {
+    if (radius <= k_arc_tolerance) {
+      return 1;
+    }
+
+    const float step = 2.0f * std::acos(1.0f - k_arc_tolerance / radius);
+    return std::clamp(static_cast<int>(std::ceil(std::abs(sweep) / step)), 1, 1024);
+  }
+
+  static inline float signed_area(const vec* pts, std::size_t count) noexcept {
+    float area = 0;
+    for (std::size_t i = 0; i < count; i++) {
+      area += cross(pts[i], pts[(i + 1) % count]);
+    }
+
+    return area;
+  }
+
+  // Every outline is a single polygon per side of a contour, overlapping pieces would be
+  // counted twice by the coverage accumulation on the pixels they share.
+  class outline_builder {
+  public:
+    outline_builder(polyline& dst, const stroke_style& style)
+        : m_dst(dst)
+        , m_style(style)
+        , m_hw(style.width * 0.5f) {}
+
+    /// Contour without zero length segments.
+    void stroke(const std::vector<vec>& pts, bool closed) {
+      if (pts.size() == 1) {
+        dot_cap(pts[0]);
+        return;
+      }
+
+      m_directions.resize(pts.size());
+      m_lengths.resize(pts.size());
+
+      if (closed) {
+        const std::size_t first = begin();
+        left_side(pts, true);
+        const std::size_t second = end_loop();
+
+        m_reversed.assign(pts.rbegin(), pts.rend());
+        left_side(m_reversed, true);
+        end_loop();
+
+        // The loops wind in opposite directions, the outer one sets the direction of the stroke.
+        const float a0 = signed_area(m_dst.points.data() + first, second - first);
+        const float a1 = signed_area(m_dst.points.data() + second, m_dst.points.size() - second);
+        finish(first, a0 + a1);
+        return;
+      }
+
+      const std::size_t first = begin();
+      left_side(pts, false);
+      cap(pts.back(), m_directions[pts.size() - 2]);
+
+      m_reversed.assign(pts.rbegin(), pts.rend());
+      left_side(m_reversed, false);
+      cap(m_reversed.back(), m_directions[pts.size() - 2]);
+
+      m_dst.contours.push_back(static_cast<std::uint32_t>(m_dst.points.size()));
+      m_dst.closed.push_back(1);
+      finish(first, signed_area(m_dst.points.data() + first, m_dst.points.size() - first));
+    }
+
+  private:
+    /// Offset of the left side of pts in order, the directions and lengths are
+    /// computed for the segments of pts.
+    void left_side(const std::vector<vec>& pts, bool closed) {
+      const std::size_t n = pts.size();
+      const std::size_t segments = closed ? n : n - 1;
+
+      for (std::size_t i = 0; i < segments; i++) {
+        const vec d = pts[(i + 1) % n] - pts[i];
+        m_lengths[i] = length(d);
+        m_directions[i] = d * (1.0f / m_lengths[i]);
+      }
+
+      if (closed) {
+        for (std::size_t i = 0; i < n; i++) {
+          const std::size_t prev = (i + n - 1) % n;
+          join(pts[i], m_directions[prev], m_directions[i], std::min(m_lengths[prev], m_lengths[i]));
+        }
+
+        return;
+      }
+
+      add(pts[0] + normal(m_directions[0], m_hw));
+
+      for (std::size_t i = 1; i < n - 1; i++) {
+        join(pts[i], m_directions[i - 1], m_directions[i], std::min(m_lengths[i - 1], m_lengths[i]));
+      }
+
+      add(pts[n - 1] + normal(m_directions[n - 2], m_hw));
+    }
+
+    /// Left side at p from the unit direction d0 to d1, max_length is the length
+    /// of the shortest of the two segments.
+    void join(const vec& p, const vec& d0, const vec& d1, float max_length) {
+      const vec n0 = normal(d0, m_hw);
+      const vec n1 = normal(d1, m_hw);
+      const float c = cross(d0, d1);
+      const float d = dot(d0, d1);
+
+      if (std::abs(c) < 1e-6f && d > 0) {
+        add(p + n0);
+        return;
+      }
+
+      // n1 is n0 rotated by the turn angle. A reversal is taken as a right turn,
+      // atan2 would give +pi and the outer side would go back through the stroke.
+      const bool reversal = std::abs(c) < 1e-6f && d < 0;
+      const float angle = reversal ? -k_pi : std::atan2(c, d);
+      const float cos_half = std::cos(angle * 0.5f);
+      const vec mid = n0 + n1;
+      const float mid_length = length(mid);
+
+      // Turning left, the left side is the inner one. Both offsets meet at a single
+      // point as long as it is on both segments, otherwise the outline goes through p.
+      if (c > 0 && !reversal) {
+        if (mid_length > 0 && m_hw * std::tan(angle * 0.5f) <= max_length) {
+          add(p + mid * (m_hw / (cos_half * mid_length)));
+        }
+        else {
+          add(p + n0);
+          add(p);
+          add(p + n1);
+        }
+
+        return;
+      }
+
+      add(p + n0);
+
+      switch (m_style.join) {
+      case line_join::round:
+        arc(p, n0, angle);
+        break;
+
+      case line_join::miter:
+        // Ratio of the miter length to the line width, 1 / sin(half the angle between the segments).
+        if (cos_half > 1e-4f && mid_length > 0 && 1.0f / cos_half <= m_style.miter_limit) {
+          add(p + mid * (m_hw / (cos_half * mid_length)));
+        }
+        break;
+
+      case line_join::bevel:
+        break;
+      }
+
+      add(p + n1);
+    }
+
+    /// Cap at the end point p of a segment going in the direction d,
+    /// from its left side to its right side.
+    void cap(const vec& p, const vec& d) {
+      const vec n = normal(d, m_hw);
+
+      switch (m_style.cap) {
+      case line_cap::butt:
+        break;
+
+      case line_cap::round:
+        arc(p, n, -k_pi);
+        break;
+
+      case line_cap::square:
+        add(p + n + d * m_hw);
+        add(p - n + d * m_hw);
+        break;
+      }
+    }
+
+    /// Disc or square of a contour with a single point.
+    void dot_cap(const vec& p) {
+      const std::size_t first = begin();
+
+      if (m_style.cap == line_cap::round) {
+        add(p + vec{ m_hw, 0 });
+        arc(p, { m_hw, 0 }, 2.0f * k_pi);
+      }
+      else if (m_style.cap == line_cap::square) {
+        add({ p.x - m_hw, p.y - m_hw });
+        add({ p.x + m_hw, p.y - m_hw });
+        add({ p.x + m_hw, p.y + m_hw });
+        add({ p.x - m_hw, p.y + m_hw });
+      }
+
+      if (m_dst.points.size() > first) {
+        m_dst.contours.push_back(static_cast<std::uint32_t>(m_dst.points.size()));
+        m_dst.closed.push_back(1);
+        finish(first, signed_area(m_dst.points.data() + first, m_dst.points.size() - first));
+      }
+    }
+
+    /// Points strictly between p + v and p + v rotated by angle.
+    void arc(const vec& p, const vec& v, float angle) {
+      const int n = get_arc_segments(m_hw, angle);
+      const float step = angle / static_cast<float>(n);
+      const float c = std::cos(step);
+      const float s = std::sin(step);
+      vec r = v;
+
+      for (int i = 1; i < n; i++) {
+        r = rotate(r, c, s);
+        add(p + r);
+      }
+    }
+
+    inline std::size_t begin() const noexcept { return m_dst.points.size(); }
+
+    inline void add(const vec& p) { m_dst.points.push_back(p); }
+
+    inline std::size_t end_loop() {
+      m_dst.contours.push_back(static_cast<std::uint32_t>(m_dst.points.size()));
+      m_dst.closed.push_back(1);
+      return m_dst.points.size();
+    }
+
+    // Every stroke winds the same way so that they add up with the non-zero rule.
+    void finish(std::size_t first, float area) {
+      if (area >= 0) {
+        return;
+      }
+
+      std::size_t start = first;
+      for (std::size_t i = 0; i < m_dst.contours.size(); i++) {
+        const std::size_t end = m_dst.contours[i];
+        if (end > first) {
+          std::reverse(m_dst.points.begin() + static_cast<std::ptrdiff_t>(start),
+              m_dst.points.begin() + static_cast<std::ptrdiff_t>(end));
+        }
+
+        start = std::max<std::size_t>(end, first);
+      }
+    }
+
+    polyline& m_dst;
+    const stroke_style& m_style;
+    float m_hw;
+    std::vector<vec> m_directions;
+    std::vector<float> m_lengths;
+    std::vector<vec> m_reversed;
+  };
+
+  // Calls fct with every contour of src without its zero length segments, which have no direction.
+  template <typename Fct>
+  static inline void stroke_contours(const polyline& src, polyline& dst, Fct&& fct) {
+    std::vector<vec> pts;
+    std::size_t begin = 0;
+
+    for (std::size_t c = 0; c < src.contours.size(); c++) {
+      const std::size_t end = src.contours[c];
+      const bool closed = src.closed[c];
+
+      pts.clear();
+      for (std::size_t i = begin; i < end; i++) {
+        const vec& p = src.points[i];
+        if (pts.empty() || std::abs(p.x - pts.back().x) + std::abs(p.y - pts.back().y) > 1e-5f) {
+          pts.push_back(p);
+        }
+      }
+
+      begin = end;
+
+      if (closed && pts.size() > 2 && std::abs(pts[0].x - pts.back().x) + std::abs(pts[0].y - pts.back().y) <= 1e-5f) {
+        pts.pop_back();
+      }
+
+      fct(pts, closed && pts.size() > 1);
+    }
+
+    if (!dst.points.empty()) {
+      vec lo = dst.points[0];
+      vec hi = dst.points[0];
+
+      for (const vec& p : dst.points) {
+        lo = { std::min(lo.x, p.x), std::min(lo.y, p.y) };
+        hi = { std::max(hi.x, p.x), std::max(hi.y, p.y) };
+      }
+
+      dst.bounds = { lo.x, lo.y, hi.x - lo.x, hi.y - lo.y };
+    }
+  }
+} // namespace.
+
+void stroke_polyline(const polyline& src, const stroke_style& style, polyline& dst) {
+  if (style.width <= 0) {
+    return;
+  }
+
+  outline_builder builder(dst, style);
+  stroke_contours(src, dst, [&](const std::vector<vec>& pts, bool closed) { builder.stroke(pts, closed); });
+}
+
+} // namespace nano::detail.
@@ -0,0 +1,292 @@
+#include <nano/graphics_atlas.h>
+#include <nano/graphics_raster.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace nano {
+namespace {
+  /// Bottom-left skyline of a page: the top of the packed images, as segments from left to right.
+  class skyline {
+  public:
+    explicit skyline(const nano::size<std::size_t>& size)
+        : m_size(size)
+        , m_nodes{ { 0, 0, size.width } } {}
+
+    /// Position of a width x height rect where its top is the lowest, false when it doesn't fit.
+    bool insert(std::size_t width, std::size_t height, std::size_t& x, std::size_t& y) {
+      std::size_t best = m_nodes.size();
+      std::size_t best_bottom = 0;
+      std::size_t best_y = 0;
+
+      for (std::size_t i = 0; i < m_nodes.size(); i++) {
+        std::size_t node_y = 0;
+
+        if (fit(i, width, height, node_y)
+            && (best == m_nodes.size() || node_y + height < best_bottom
+                || (node_y + height == best_bottom && m_nodes[i].width < m_nodes[best].width))) {
+          best = i;
+          best_bottom = node_y + height;
+          best_y = node_y;
+        }
+      }
+
+      if (best == m_nodes.size()) {
+        return false;
+      }
+
+      x = m_nodes[best].x;
+      y = best_y;
+      m_nodes.insert(m_nodes.begin() + static_cast<std::ptrdiff_t>(best), { x, best_bottom, width });
+
+      // The nodes under the new one are shortened or removed.
+      for (std::size_t i = best + 1; i < m_nodes.size();) {
+        const std::size_t end = m_nodes[i - 1].x + m_nodes[i - 1].width;
+
+        if (m_nodes[i].x >= end) {
+          break;
+        }
+
+        const std::size_t shrink = end - m_nodes[i].x;
+
+        if (m_nodes[i].width > shrink) {
+          m_nodes[i].x += shrink;
+          m_nodes[i].width -= shrink;
+          break;
+        }
+
+        m_nodes.erase(m_nodes.begin() + static_cast<std::ptrdiff_t>(i));
+      }
+
+      merge();
+      return true;
+    }
+
+  private:
+    struct node {
+      std::size_t x, y, width;
+    };
+
+    /// Lowest y of a width x height rect whose left side is at node i.
+    bool fit(std::size_t i, std::size_t width, std::size_t height, std::size_t& y) const {
+      if (m_nodes[i].x + width > m_size.width) {
+        return false;
+      }
+
+      y = 0;
+      for (std::size_t left = width; left; i++) {
+        y = std::max(y, m_nodes[i].y);
+
+        if (y + height > m_size.height) {
+          return false;
+        }
+
+        left -= std::min(left, m_nodes[i].width);
+      }
+
+      return true;
+    }
+
+    void merge() {
+      for (std::size_t i = 1; i < m_nodes.size();) {
+        if (m_nodes[i - 1].y == m_nodes[i].y) {
+          m_nodes[i - 1].width += m_nodes[i].width;
+          m_nodes.erase(m_nodes.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        else {
+          i++;
+        }
+      }
+    }
+
+    nano::size<std::size_t> m_size;
+    std::vector<node> m_nodes;
+  };
+} // namespace.
+
+struct texture_atlas::pimpl {
+  struct page {
+    image img;
+    skyline packer;
+  };
+
+  /// rect is the image without its padding.
+  struct slot {
+    bool used = false;
+    std::size_t page = 0;
+    nano::rect<std::size_t> rect = { 0, 0, 0, 0 };
+  };
+
+  pimpl(const nano::size<std::size_t>& size, image::format f, std::size_t pad)
+      : page_size(size)
+      , fmt(f)
+      , padding(pad) {}
+
+  inline std::size_t get_padded_area(const nano::rect<std::size_t>& r) const noexcept {
+    return (r.width + 2 * padding) * (r.height + 2 * padding);
+  }
+
+  /// Position of the padded rect in the first page of ps with room, a page is added when none has.
+  void allocate(std::vector<page>& ps, const nano::size<std::size_t>& size, slot& s) {
+    const std::size_t width = size.width + 2 * padding;
+    const std::size_t height = size.height + 2 * padding;
+    std::size_t x = 0;
+    std::size_t y = 0;
+
+    for (std::size_t i = 0; i < ps.size(); i++) {
+      if (ps[i].packer.insert(width, height, x, y)) {
+        s.page = i;
+        s.rect = { x + padding, y + padding, size.width, size.height };
+        return;
+      }
+    }
+
+    const std::size_t bytes_per_row = page_size.width * image::get_bytes_per_pixel(fmt);
+    ps.push_back({ image(page_size, detail::get_bits_per_component(fmt), detail::get_bits_per_pixel(fmt),
+                       bytes_per_row, fmt),
+        skyline(page_size) });
+    ps.back().packer.insert(width, height, x, y);
+    s.page = ps.size() - 1;
+    s.rect = { x + padding, y + padding, size.width, size.height };
+  }
+
+  /// Copies the pixels at the rect of s and repeats its edges in the padding.
+  void place(std::vector<page>& ps, const slot& s, const image_view& v) {
+    const mutable_image_view dst = ps[s.page].img.mutable_view();
+    const nano::rect<std::size_t>& r = s.rect;
+    const std::size_t bpp = image::get_bytes_per_pixel(fmt);
+    image::convert_pixels(v, dst.sub_view(r));
+
+    for (std::size_t y = r.y; y < r.y + r.height; y++) {
+      std::uint8_t* row = dst.row(y);
+
+      for (std::size_t k = 1; k <= padding; k++) {
+        std::memcpy(row + (r.x - k) * bpp, row + r.x * bpp, bpp);
+        std::memcpy(row + (r.x + r.width - 1 + k) * bpp, row + (r.x + r.width - 1) * bpp, bpp);
+      }
+    }
+
+    const std::size_t x0 = (r.x - padding) * bpp;
+    const std::size_t row_size = (r.width + 2 * padding) * bpp;
+
+    for (std::size_t k = 1; k <= padding; k++) {
+      std::memcpy(dst.row(r.y - k) + x0, dst.row(r.y) + x0, row_size);
+      std::memcpy(dst.row(r.y + r.height - 1 + k) + x0, dst.row(r.y + r.height - 1) + x0, row_size);
+    }
+  }
+
+  nano::size<std::size_t> page_size;
+  image::format fmt;
+  std::size_t padding;
+
+  std::vector<page> pages;
+  std::vector<slot> slots;
+  std::vector<handle> free_slots;
+  std::size_t used_area = 0;
+};
+
+texture_atlas::texture_atlas(const nano::size<std::size_t>& page_size, image::format fmt, std::size_t padding) {
+  m_pimpl = new pimpl(page_size, fmt, padding);
+}
+
+texture_atlas::~texture_atlas() { delete m_pimpl; }
+
+texture_atlas::handle texture_atlas::insert(const image_view& v) {
+  const nano::size<std::size_t> page_size = m_pimpl->page_size;
+  const std::size_t padding = m_pimpl->padding;
+
+  if (!v || !v.size.width || !v.size.height || v.size.width + 2 * padding > page_size.width
+      || v.size.height + 2 * padding > page_size.height) {
+    return invalid_handle;
+  }
+
+  handle h = static_cast<handle>(m_pimpl->slots.size());
+
+  if (!m_pimpl->free_slots.empty()) {
+    h = m_pimpl->free_slots.back();
+    m_pimpl->free_slots.pop_back();
+  }
+  else {
+    m_pimpl->slots.emplace_back();
+  }
+
+  pimpl::slot& s = m_pimpl->slots[h];
+  s.used = true;
+  m_pimpl->allocate(m_pimpl->pages, v.size, s);
+  m_pimpl->place(m_pimpl->pages, s, v);
+  m_pimpl->used_area += m_pimpl->get_padded_area(s.rect);
+  return h;
+}
+
+void texture_atlas::erase(handle h) {
+  if (!contains(h)) {
+    return;
+  }
+
+  pimpl::slot& s = m_pimpl->slots[h];
+  s.used = false;
+  m_pimpl->used_area -= m_pimpl->get_padded_area(s.rect);
+  m_pimpl->free_slots.push_back(h);
+}
+
+void texture_atlas::repack() {
+  std::vector<handle> order;
+
+  for (handle h = 0; h < m_pimpl->slots.size(); h++) {
+    if (m_pimpl->slots[h].used) {
+      order.push_back(h);
+    }
+  }
+
+  // Tall images first leave a flatter skyline.
+  std::sort(order.begin(), order.end(), [&](handle a, handle b) {
+    const nano::rect<std::size_t>& ra = m_pimpl->slots[a].rect;
+    const nano::rect<std::size_t>& rb = m_pimpl->slots[b].rect;
+    return ra.height != rb.height ? ra.height > rb.height : ra.width > rb.width;
+  });
+
+  std::vector<pimpl::page> pages;
+
+  for (handle h : order) {
+    pimpl::slot& s = m_pimpl->slots[h];
+    const image_view src = m_pimpl->pages[s.page].img.view().sub_view(s.rect);
+    m_pimpl->allocate(pages, s.rect.size, s);
+    m_pimpl->place(pages, s, src);
+  }
+
+  m_pimpl->pages = std::move(pages);
+}
+
+bool texture_atlas::contains(handle h) const { return h < m_pimpl->slots.size() && m_pimpl->slots[h].used; }
+
+texture_atlas::entry texture_atlas::get_entry(handle h) const {
+  if (!contains(h)) {
+    return entry();
+  }
+
+  const pimpl::slot& s = m_pimpl->slots[h];
+  return { s.page, nano::rect<float>(s.rect) };
+}
+
+std::size_t texture_atlas::get_page_count() const { return m_pimpl->pages.size(); }
+
+nano::size<std::size_t> texture_atlas::get_page_size() const { return m_pimpl->page_size; }
+
+const image& texture_atlas::get_page(std::size_t index) const { return m_pimpl->pages[index].img; }
+
+void texture_atlas::draw(graphic_context& g, handle h, const nano::rect<float>& r) const {
+  if (contains(h)) {
+    const entry e = get_entry(h);
+    g.draw_sub_image(m_pimpl->pages[e.page].img, r, e.rect);
+  }
+}
+
+std::size_t texture_atlas::get_image_count() const {
+  return m_pimpl->slots.size() - m_pimpl->free_slots.size();
+}
+
+float texture_atlas::get_occupancy() const {
+  const std::size_t area = m_pimpl->pages.size() * m_pimpl->page_size.width * m_pimpl->page_size.height;
+  return area ? static_cast<float>(m_pimpl->used_area) / static_cast<float>(area) : 0.0f;
+}
+} // namespace nano.
@@ -1,6 +1,18 @@
 #include <nano/test.h>
 #include <nano/graphics.h>
+#include <nano/graphics_atlas.h>
+#include <nano/graphics_cache.h>
+#include <nano/graphics_codec.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <sstream>
 #include <thread>
+#include <tuple>
 
 namespace {
 TEST_CASE("nano.graphics", Color, "Color") {
@@ -34,49 +46,19 @@ TEST_CASE("nano.graphics", Color, "Color") {
   //  {1200,1600}
   std::cout << img.get_size() << std::endl;
 
-  std::vector<std::uint8_t> buffer;
-  img.copy_data(buffer);
+  const nano::image_view pixels = img.view();
 
-  std::vector<float> fbuffer;
-  fbuffer.resize(img.get_size().width * img.get_size().height * 4);
-  std::size_t fbuffer_index = 0;
+  const std::size_t rgba_bytes_per_row = img.width() * 4;
+  std::vector<std::uint8_t> buffer(rgba_bytes_per_row * img.height());
+  nano::image::convert_pixels(pixels.size, pixels.data, pixels.bytes_per_row, pixels.fmt, buffer.data(),
+      rgba_bytes_per_row, nano::image::format::rgba);
 
-  for (std::size_t j = 0; j < img.get_size().height; j++) {
-    nano::color* cs = reinterpret_cast<nano::color*>(buffer.data() + j * img.get_bytes_per_row());
+  std::vector<float> fbuffer(img.get_size().width * img.get_size().height * 4);
+  nano::image::convert_pixels(pixels.size, pixels.data, pixels.bytes_per_row, pixels.fmt,
+      reinterpret_cast<std::uint8_t*>(fbuffer.data()), img.get_size().width * sizeof(float) * 4,
+      nano::image::format::float_rgba);
 
-    for (std::size_t i = 0; i < img.get_size().width; i++) {
-      // from buffer
-      // r -> a
-      // g -> b
-      // b -> g
-      // a -> r
-
-      nano::color c = cs[i].abgr();
-      fbuffer[fbuffer_index++] = c.f_red();
-      fbuffer[fbuffer_index++] = c.f_green();
-      fbuffer[fbuffer_index++] = c.f_blue();
-      fbuffer[fbuffer_index++] = c.f_alpha();
-
-      cs[i] = cs[i].abgr();
-
-      //      cs[i].red<nano::color::format::abgr>(0);
-      //      cs[i].green<nano::color::format::abgr>(0);
-
-      //      cs[i] = cs[i].abgr();
-      //      cs[i].blue(0);
-      ////      cs[i].red(0);
-      ////      cs[i].alpha(0);
-      //
-      //      cs[i] = cs[i].abgr();
-    }
-  }
-
-  nano::image img2(img.get_size(), //
-      img.get_bits_per_component(), //
-      img.get_bits_per_pixel(), //
-      img.get_bytes_per_row(),
-      nano::image::format::rgba, //
-      buffer.data());
+  nano::image img2(img.get_size(), 8, 32, rgba_bytes_per_row, nano::image::format::rgba, buffer.data());
 
   img2.save("/Users/alexandrearsenault/Desktop/vvv3.png", nano::image::type::png);
 
@@ -118,6 +100,1423 @@ TEST_CASE("nano.graphics", Color, "Color") {
   //  create_bitmap_context(const nano::size<std::size_t>& size, std::size_t bitsPerComponent,
   //                 std::size_t bytesPerRow, image::format fmt,   std::uint8_t* buffer)
 }
+
+TEST_CASE("nano.graphics", DisplayList, "DisplayList") {
+  nano::graphic_context src = nano::graphic_context::create_bitmap_context({ 16, 16 }, nano::image::format::rgba);
+  src.set_fill_color(0x00FF00FF);
+  src.fill_rect({ 0, 0, 16, 16 });
+  nano::image img = src.create_image();
+
+  nano::display_list dl;
+  EXPECT_TRUE(dl.empty());
+
+  dl.set_fill_color(0x202020FF);
+  dl.fill_rect({ 0, 0, 128, 128 });
+  dl.save_state();
+  dl.translate({ 10, 20 });
+  dl.set_fill_color(0xFF0000FF);
+  dl.fill_ellipse({ 0, 0, 40, 30 });
+  dl.set_stroke_color(0x0000FFFF);
+  dl.stroke_rect({ 50, 50, 30, 20 }, 3);
+  dl.draw_image(img, nano::rect<float>{ 60, 0, 16, 16 });
+  dl.restore_state();
+  dl.set_fill_color(0xFFFFFF80);
+  dl.fill_rounded_rect({ 300, 300, 40, 40 }, 5);
+  EXPECT_EQ(dl.size(), 12);
+
+  auto render = [&](bool culled) {
+    nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 128, 128 }, nano::image::format::rgba);
+    if (culled) {
+      dl.replay(gc, { 0, 0, 128, 128 });
+    }
+    else {
+      dl.replay(gc);
+    }
+    return gc.create_image();
+  };
+
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 128, 128 }, nano::image::format::rgba);
+  gc.set_fill_color(0x202020FF);
+  gc.fill_rect({ 0, 0, 128, 128 });
+  gc.save_state();
+  gc.translate({ 10, 20 });
+  gc.set_fill_color(0xFF0000FF);
+  gc.fill_ellipse({ 0, 0, 40, 30 });
+  gc.set_stroke_color(0x0000FFFF);
+  gc.stroke_rect({ 50, 50, 30, 20 }, 3);
+  gc.draw_image(img, nano::rect<float>{ 60, 0, 16, 16 });
+  gc.restore_state();
+  nano::image expected = gc.create_image();
+
+  const std::size_t bytes = expected.get_bytes_per_row() * 128;
+  EXPECT_EQ(std::memcmp(expected.data(), render(false).data(), bytes), 0);
+  EXPECT_EQ(std::memcmp(expected.data(), render(true).data(), bytes), 0);
+
+  // Nesting deeper than the states kept inline by a culled replay.
+  dl.clear();
+  for (int i = 0; i < 40; i++) {
+    dl.save_state();
+    dl.translate({ 3, 2 });
+    dl.set_stroke_color(0xFF00FFFF);
+    dl.stroke_rect({ 0, 0, 4, 4 }, 1);
+  }
+
+  for (int i = 0; i < 40; i++) {
+    dl.restore_state();
+    dl.fill_rect({ static_cast<float>(i * 3), 0, 2, 2 });
+  }
+
+  EXPECT_EQ(std::memcmp(render(false).data(), render(true).data(), bytes), 0);
+
+  dl.clear();
+  EXPECT_TRUE(dl.empty());
+}
+
+TEST_CASE("nano.graphics", Path, "Path") {
+  nano::path p;
+  EXPECT_TRUE(p.empty());
+
+  p.add_rect({ 10, 20, 30, 40 });
+  p.move_to({ 0, 0 });
+  p.cubic_to({ 50, 0 }, { 50, 100 }, { 5, 100 });
+  EXPECT_FALSE(p.empty());
+  EXPECT_EQ(p.get_bounding_box(), nano::rect<float>(0, 0, 50, 100));
+
+  // Copies share the geometry until one of them is modified.
+  nano::path q = p;
+  EXPECT_EQ(q.get_native_path(), p.get_native_path());
+  q.line_to({ -10, 0 });
+  EXPECT_NE(q.get_native_path(), p.get_native_path());
+  EXPECT_EQ(q.get_bounding_box(), nano::rect<float>(-10, 0, 60, 100));
+  EXPECT_EQ(p.get_bounding_box(), nano::rect<float>(0, 0, 50, 100));
+
+  q.clear();
+  EXPECT_TRUE(q.empty());
+  EXPECT_FALSE(p.empty());
+}
+
+TEST_CASE("nano.graphics", PixelFormats, "PixelFormats") {
+  using fmt = nano::image::format;
+  const nano::size<std::size_t> size = { 37, 3 };
+  const std::size_t count = size.width * size.height;
+
+  std::vector<nano::color> src(count);
+  for (std::size_t i = 0; i < count; i++) {
+    src[i] = nano::color(static_cast<std::uint8_t>(i * 7), static_cast<std::uint8_t>(i * 13),
+        static_cast<std::uint8_t>(i * 29), static_cast<std::uint8_t>(i % 3 ? i * 5 : 255));
+  }
+
+  const std::uint8_t* src_data = reinterpret_cast<const std::uint8_t*>(src.data());
+  const fmt formats[] = { fmt::alpha, fmt::argb, fmt::bgra, fmt::rgb, fmt::rgba, fmt::abgr, fmt::rgbx, fmt::xbgr,
+    fmt::xrgb, fmt::bgrx, fmt::float_alpha, fmt::float_argb, fmt::float_rgb, fmt::float_rgba };
+
+  // Round trip through every format, the ones without alpha are opaque and the alpha ones are black.
+  for (fmt f : formats) {
+    // Large enough for the 16 bytes of the float_rgba pixels.
+    const std::size_t bpr = size.width * 16;
+    std::vector<std::uint8_t> buffer(bpr * size.height);
+    std::vector<nano::color> back(count);
+
+    nano::image::convert_pixels(size, src_data, size.width * 4, fmt::rgba, buffer.data(), bpr, f);
+    nano::image::convert_pixels(
+        size, buffer.data(), bpr, f, reinterpret_cast<std::uint8_t*>(back.data()), size.width * 4, fmt::rgba);
+
+    const bool has_color = f != fmt::alpha && f != fmt::float_alpha;
+    const bool has_alpha = f == fmt::alpha || f == fmt::argb || f == fmt::bgra || f == fmt::rgba || f == fmt::abgr
+        || f == fmt::float_alpha || f == fmt::float_argb || f == fmt::float_rgba;
+
+    bool same = true;
+    for (std::size_t i = 0; i < count; i++) {
+      const nano::color c = src[i];
+      const nano::color expected = has_color ? nano::color(c.red(), c.green(), c.blue(), has_alpha ? c.alpha() : 255)
+                                             : nano::color(0, 0, 0, c.alpha());
+      same = same && back[i] == expected;
+    }
+
+    EXPECT_TRUE(same);
+  }
+
+  // Byte order of the swizzles and values of the floats.
+  std::vector<std::uint8_t> abgr(count * 4);
+  std::vector<float> floats(count * 4);
+  nano::image::convert_pixels(size, src_data, size.width * 4, fmt::rgba, abgr.data(), size.width * 4, fmt::abgr);
+  nano::image::convert_pixels(size, src_data, size.width * 4, fmt::rgba,
+      reinterpret_cast<std::uint8_t*>(floats.data()), size.width * 16, fmt::float_rgba);
+
+  bool same = true;
+  for (std::size_t i = 0; i < count; i++) {
+    const nano::color c = src[i];
+    same = same && abgr[i * 4] == c.red() && abgr[i * 4 + 1] == c.green() && abgr[i * 4 + 2] == c.blue()
+        && abgr[i * 4 + 3] == c.alpha();
+    same = same && floats[i * 4] == c.red() / 255.0f && floats[i * 4 + 3] == c.alpha() / 255.0f;
+  }
+
+  EXPECT_TRUE(same);
+
+  // Rounded c * a / 255, unpremultiplying gives back the opaque pixels.
+  std::vector<nano::color> premultiplied(count);
+  std::vector<nano::color> unpremultiplied(count);
+  nano::image::convert_pixels(size, src_data, size.width * 4, fmt::rgba,
+      reinterpret_cast<std::uint8_t*>(premultiplied.data()), size.width * 4, fmt::bgra,
+      nano::image::alpha_conversion::premultiply);
+  nano::image::convert_pixels(size, reinterpret_cast<const std::uint8_t*>(premultiplied.data()), size.width * 4,
+      fmt::bgra, reinterpret_cast<std::uint8_t*>(unpremultiplied.data()), size.width * 4, fmt::rgba,
+      nano::image::alpha_conversion::unpremultiply);
+
+  same = true;
+  for (std::size_t i = 0; i < count; i++) {
+    const nano::color c = src[i];
+    const std::uint32_t px = premultiplied[i].rgba();
+    same = same && ((px >> 8) & 0xFF) == (c.red() * c.alpha() + 127u) / 255 && (px & 0xFF) == c.alpha();
+    same = same && (c.alpha() != 255 || unpremultiplied[i] == c);
+  }
+
+  EXPECT_TRUE(same);
+
+  // Large enough to be converted on several threads.
+  const nano::size<std::size_t> large = { 1024, 512 };
+  std::vector<std::uint32_t> pixels(large.width * large.height);
+  for (std::size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = static_cast<std::uint32_t>(i * 2654435761u);
+  }
+
+  nano::image img(large, 8, 32, large.width * 4, fmt::rgba, reinterpret_cast<const std::uint8_t*>(pixels.data()));
+  nano::image converted = img.convert(fmt::bgra);
+  EXPECT_TRUE(converted.get_format() == fmt::bgra);
+
+  nano::image restored = converted.convert(fmt::rgba);
+  EXPECT_EQ(std::memcmp(restored.data(), pixels.data(), pixels.size() * 4), 0);
+}
+
+TEST_CASE("nano.graphics", ImagePixels, "ImagePixels") {
+  std::vector<std::uint32_t> pixels(16 * 8, 0x336699FF);
+  nano::image img({ 16, 8 }, 8, 32, 16 * 4, nano::image::format::rgba,
+      reinterpret_cast<const std::uint8_t*>(pixels.data()));
+
+  // The buffer is copied once, reading the pixels again doesn't copy them.
+  pixels[0] = 0;
+  const nano::image_view v = img.view();
+  EXPECT_TRUE(v && v.data == img.data() && img.view().data == v.data);
+  EXPECT_TRUE(v.size == img.get_size() && v.bytes_per_row == 64 && v.fmt == nano::image::format::rgba);
+  EXPECT_EQ(reinterpret_cast<const std::uint32_t*>(v.row(0))[0], 0x336699FFu);
+
+  {
+    // Copies share the pixels until one of them writes to them.
+    nano::image copy = img.make_copy();
+    EXPECT_TRUE(copy.view().data == v.data);
+
+    nano::mutable_image_view cm = copy.mutable_view();
+    EXPECT_TRUE(cm && cm.data != v.data && copy.view().data == cm.data);
+    reinterpret_cast<std::uint32_t*>(cm.row(0))[0] = 0;
+    EXPECT_EQ(reinterpret_cast<const std::uint32_t*>(img.view().row(0))[0], 0x336699FFu);
+  }
+
+  // The last owner writes in place.
+  nano::mutable_image_view m = img.mutable_view();
+  EXPECT_TRUE(m.data == v.data);
+  reinterpret_cast<std::uint32_t*>(m.row(3))[5] = 0xFF0000FF;
+
+  const nano::image_view cm = m;
+  EXPECT_EQ(reinterpret_cast<const std::uint32_t*>(cm.row(3))[5], 0xFF0000FFu);
+  EXPECT_EQ(reinterpret_cast<const std::uint32_t*>(img.view().row(3))[5], 0xFF0000FFu);
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  // A tiled context holds the image until its draws are rendered, they don't see later writes.
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 16, 8 }, nano::image::format::rgba);
+  gc.set_tiled_rendering(true);
+  gc.draw_image(img, nano::rect<float>(0, 0, 16, 8));
+
+  m = img.mutable_view();
+  EXPECT_TRUE(m.data != v.data);
+  reinterpret_cast<std::uint32_t*>(m.row(3))[5] = 0x00FF00FF;
+
+  gc.flush();
+  EXPECT_TRUE(img.mutable_view().data == m.data);
+
+  nano::image result = gc.create_image();
+  EXPECT_EQ(reinterpret_cast<const nano::color*>(result.view().row(3))[5], nano::color(0xFF0000FF));
+#endif
+}
+
+TEST_CASE("nano.graphics", ImageViews, "ImageViews") {
+  // An 8x4 sheet of 2x2 opaque sprites.
+  std::vector<nano::color> pixels(8 * 4);
+  for (std::size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = nano::color(static_cast<std::uint8_t>(i * 8), static_cast<std::uint8_t>(255 - i), 40, 255);
+  }
+
+  const nano::image_view sheet(reinterpret_cast<const std::uint8_t*>(pixels.data()), { 8, 4 }, 8 * 4);
+  EXPECT_EQ(sheet.bytes_per_pixel(), 4);
+
+  // Sub-views point inside the same buffer.
+  const nano::image_view sprite = sheet.sub_view({ 2, 2, 2, 2 });
+  EXPECT_TRUE(sprite.data == sheet.row(2) + 2 * 4 && sprite.bytes_per_row == sheet.bytes_per_row);
+  EXPECT_TRUE(sprite.size == nano::size<std::size_t>(2, 2));
+  EXPECT_TRUE(sheet.sub_view({ 6, 3, 4, 4 }).size == nano::size<std::size_t>(2, 1));
+  EXPECT_FALSE(sheet.sub_view({ 8, 0, 1, 1 }));
+
+  // Conversions between strided views.
+  std::vector<std::uint8_t> bgra(2 * 2 * 4);
+  std::vector<nano::color> back(2 * 2);
+  nano::image::convert_pixels(sprite, nano::mutable_image_view(bgra.data(), { 2, 2 }, 8, nano::image::format::bgra));
+  nano::image::convert_pixels(nano::image_view(bgra.data(), { 2, 2 }, 8, nano::image::format::bgra),
+      nano::mutable_image_view(reinterpret_cast<std::uint8_t*>(back.data()), { 2, 2 }, 8));
+  EXPECT_EQ(back[0], pixels[2 * 8 + 2]);
+  EXPECT_EQ(back[3], pixels[3 * 8 + 3]);
+
+  // The image copies the view, its sub-images share the pixels of the image.
+  const nano::image img(sheet);
+  const nano::image sub = img.get_sub_image({ 2, 2, 2, 2 });
+  EXPECT_TRUE(img.view().data != sheet.data && sub.get_size() == sprite.size);
+  EXPECT_EQ(reinterpret_cast<const nano::color*>(sub.view().row(1))[1], pixels[3 * 8 + 3]);
+
+  // Drawing a sprite from the view or from the image gives the same pixels.
+  const auto draw = [&](bool from_view, bool tiled) {
+    nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 8, 8 }, nano::image::format::rgba);
+    gc.set_tiled_rendering(tiled);
+
+    if (from_view) {
+      gc.draw_sub_image(sheet, { 1, 1, 4, 4 }, { 2, 2, 2, 2 });
+      gc.draw_image(sprite, { 5, 5, 2, 2 });
+    }
+    else {
+      gc.draw_sub_image(img, { 1, 1, 4, 4 }, { 2, 2, 2, 2 });
+      gc.draw_image(sub, { 5, 5, 2, 2 });
+    }
+
+    return gc.create_image().get_data();
+  };
+
+  const std::vector<std::uint8_t> expected = draw(false, false);
+  EXPECT_TRUE(draw(true, false) == expected);
+  EXPECT_TRUE(draw(true, true) == expected);
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  EXPECT_TRUE(sub.view().data == img.view().row(2) + 2 * 4);
+
+  // A sub-image that writes detaches from its parent, only its own pixels are copied.
+  nano::image owner = img;
+  nano::image part = owner.get_sub_image({ 0, 0, 4, 4 });
+  const std::uint8_t* shared = part.view().data;
+  nano::mutable_image_view pm = part.mutable_view();
+  EXPECT_TRUE(pm.data != shared && pm.bytes_per_row == 4 * 4);
+  reinterpret_cast<nano::color*>(pm.row(0))[0] = nano::color(0, 0, 0, 255);
+  EXPECT_EQ(reinterpret_cast<const nano::color*>(owner.view().row(0))[0], pixels[0]);
+
+  // The parent still shares its pixels with img.
+  EXPECT_TRUE(owner.mutable_view().data != img.view().data);
+#endif
+}
+
+TEST_CASE("nano.graphics", Resize, "Resize") {
+  using filter = nano::image::filter;
+  const filter filters[] = { filter::box, filter::bilinear, filter::bicubic, filter::lanczos3 };
+  const auto as_bytes = [](const nano::color* c) { return reinterpret_cast<const std::uint8_t*>(c); };
+
+  // A flat translucent color stays the same with every filter, the weights add up to one.
+  const nano::color flat_color(200, 100, 50, 128);
+  const std::vector<nano::color> flat(1024 * 512, flat_color);
+  const nano::image_view flat_view(as_bytes(flat.data()), { 1024, 512 }, 1024 * 4);
+  std::vector<nano::color> small(13 * 7);
+  std::vector<nano::color> large(2048 * 600);
+
+  for (filter f : filters) {
+    nano::image::resize_pixels(
+        flat_view, nano::mutable_image_view(reinterpret_cast<std::uint8_t*>(small.data()), { 13, 7 }, 13 * 4), f);
+    nano::image::resize_pixels(
+        flat_view, nano::mutable_image_view(reinterpret_cast<std::uint8_t*>(large.data()), { 2048, 600 }, 2048 * 4), f);
+
+    int diff = 0;
+    for (const std::vector<nano::color>* pixels : { &small, &large }) {
+      for (nano::color c : *pixels) {
+        for (std::size_t k = 0; k < 4; k++) {
+          diff = std::max(diff, std::abs(static_cast<int>(c[k]) - static_cast<int>(flat_color[k])));
+        }
+      }
+    }
+
+    EXPECT_TRUE(diff <= 1);
+  }
+
+  // The same size is an exact copy with the interpolating filters.
+  std::vector<nano::color> noise(16 * 8);
+  for (std::size_t i = 0; i < noise.size(); i++) {
+    noise[i] = nano::color(static_cast<std::uint8_t>(i * 37), static_cast<std::uint8_t>(i * 11), 90, 255);
+  }
+
+  const nano::image img({ 16, 8 }, 8, 32, 16 * 4, nano::image::format::rgba, as_bytes(noise.data()));
+  EXPECT_TRUE(img.resize({ 16, 8 }, filter::bilinear).get_data() == img.get_data());
+  EXPECT_TRUE(img.resize({ 16, 8 }, filter::bicubic).get_data() == img.get_data());
+
+  // Box halving averages 2x2 blocks.
+  const nano::color quad[] = { { 10, 0, 0, 255 }, { 20, 0, 0, 255 }, { 30, 0, 0, 255 }, { 40, 0, 0, 255 } };
+  nano::color half;
+  const nano::mutable_image_view half_view(reinterpret_cast<std::uint8_t*>(&half), { 1, 1 }, 4);
+  nano::image::resize_pixels(nano::image_view(as_bytes(quad), { 2, 2 }, 8), half_view, filter::box);
+  EXPECT_EQ(half, nano::color(25, 0, 0, 255));
+
+  // Transparent pixels don't bleed their color.
+  const nano::color pair[] = { { 255, 0, 0, 255 }, { 0, 255, 0, 0 } };
+  nano::image::resize_pixels(nano::image_view(as_bytes(pair), { 2, 1 }, 8), half_view, filter::box);
+  EXPECT_EQ(half, nano::color(255, 0, 0, 128));
+
+  // Formats and sizes are kept by image::resize.
+  const nano::image bgra = img.convert(nano::image::format::bgra).resize({ 5, 3 }, filter::lanczos3);
+  EXPECT_TRUE(bgra.get_size() == nano::size<std::size_t>(5, 3) && bgra.get_format() == nano::image::format::bgra);
+}
+
+TEST_CASE("nano.graphics", Png, "Png") {
+  using fmt = nano::image::format;
+  const nano::png_filter filters[] = { nano::png_filter::none, nano::png_filter::sub, nano::png_filter::up,
+    nano::png_filter::average, nano::png_filter::paeth, nano::png_filter::adaptive };
+
+  // rgba words are a, b, g, r bytes, the decoder gives r, g, b, a bytes back as format::abgr.
+  const nano::size<std::size_t> size = { 37, 11 };
+  std::vector<nano::color> pixels(size.width * size.height);
+  for (std::size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = nano::color(static_cast<std::uint8_t>(i * 7), static_cast<std::uint8_t>(i / 3), 200,
+        static_cast<std::uint8_t>(255 - i % 5));
+  }
+
+  for (nano::png_filter f : filters) {
+    std::stringstream stream;
+    nano::png_encoder encoder(stream, size, fmt::rgba, { 9, f });
+
+    for (std::size_t y = 0; y < size.height; y++) {
+      EXPECT_TRUE(encoder.write_row(reinterpret_cast<const std::uint8_t*>(pixels.data() + y * size.width)));
+    }
+
+    EXPECT_TRUE(encoder.finish());
+
+    nano::png_decoder decoder(stream);
+    EXPECT_TRUE(decoder.is_valid() && decoder.get_size() == size && decoder.get_format() == fmt::abgr);
+
+    std::vector<nano::color> decoded(pixels.size());
+    for (std::size_t y = 0; y < size.height; y++) {
+      EXPECT_TRUE(decoder.read_row(reinterpret_cast<std::uint8_t*>(decoded.data() + y * size.width), fmt::rgba));
+    }
+
+    EXPECT_FALSE(decoder.read_row(reinterpret_cast<std::uint8_t*>(decoded.data())));
+    EXPECT_TRUE(decoded == pixels);
+  }
+
+  // Opaque rows are written as rgb and streamed back with the callbacks.
+  std::stringstream stream;
+  nano::png_encoder encoder(stream, { 300, 200 }, fmt::rgb, { 1, nano::png_filter::paeth });
+  EXPECT_TRUE(encoder.write_rows([](std::size_t y, const nano::mutable_image_view& row) {
+    for (std::size_t x = 0; x < row.size.width * 3; x++) {
+      row.data[x] = static_cast<std::uint8_t>(x ^ y);
+    }
+  }));
+
+  const std::string file = stream.str();
+  std::istringstream input(file);
+  nano::png_decoder decoder(input);
+  EXPECT_TRUE(decoder.get_format() == fmt::rgb);
+
+  bool same = true;
+  EXPECT_TRUE(decoder.read_rows([&](std::size_t y, const nano::image_view& row) {
+    for (std::size_t x = 0; x < row.size.width * 3; x++) {
+      same = same && row.data[x] == static_cast<std::uint8_t>(x ^ y);
+    }
+
+    return true;
+  }));
+  EXPECT_TRUE(same && decoder.get_row_index() == 200);
+
+  // The parallel encoder splits the rows in bands that are compressed on their own.
+  nano::png_options parallel_options;
+  parallel_options.parallel = true;
+
+  const nano::size<std::size_t> large_size = { 4096, 300 };
+  std::stringstream parallel_stream;
+  nano::png_encoder parallel_encoder(parallel_stream, large_size, fmt::rgba, parallel_options);
+  EXPECT_TRUE(parallel_encoder.write_rows([](std::size_t y, const nano::mutable_image_view& row) {
+    for (std::size_t x = 0; x < row.size.width * 4; x++) {
+      row.data[x] = static_cast<std::uint8_t>((x * y) >> 4);
+    }
+  }));
+
+  nano::png_decoder parallel_decoder(parallel_stream);
+  same = true;
+  EXPECT_TRUE(parallel_decoder.read_rows([&](std::size_t y, const nano::image_view& row) {
+    for (std::size_t x = 0; x < row.size.width * 4; x += 4) {
+      // rgba words are a, b, g, r bytes, the decoder gives r, g, b, a.
+      for (std::size_t k = 0; k < 4; k++) {
+        same = same && row.data[x + k] == static_cast<std::uint8_t>(((x + 3 - k) * y) >> 4);
+      }
+    }
+
+    return true;
+  }));
+  EXPECT_TRUE(same && parallel_decoder.get_size() == large_size);
+
+  // Truncated data makes the decoder invalid before the last row.
+  std::istringstream truncated(file.substr(0, file.size() / 2));
+  nano::png_decoder partial(truncated);
+  std::vector<std::uint8_t> row(300 * 3);
+  std::size_t rows = 0;
+  while (partial.read_row(row.data())) {
+    rows++;
+  }
+
+  EXPECT_TRUE(rows < 200 && !partial.is_valid());
+
+  // Interlaced 3x2 gray with 2 bits per sample.
+  const std::uint8_t interlaced[] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49,
+    0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x01, 0x85, 0xA8, 0x11,
+    0xF1, 0x00, 0x00, 0x00, 0x10, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0x63, 0x60, 0x60, 0x68, 0x60, 0x70, 0x60, 0x78,
+    0x02, 0x00, 0x04, 0x2C, 0x01, 0xA5, 0x5F, 0x2D, 0x12, 0xDE, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE,
+    0x42, 0x60, 0x82 };
+
+  std::istringstream gray_input(std::string(reinterpret_cast<const char*>(interlaced), sizeof(interlaced)));
+  nano::png_decoder gray(gray_input);
+  EXPECT_TRUE(gray.get_size() == nano::size<std::size_t>(3, 2) && gray.get_format() == fmt::rgb);
+
+  std::uint8_t gray_rows[2][9];
+  EXPECT_TRUE(gray.read_row(gray_rows[0]) && gray.read_row(gray_rows[1]));
+  EXPECT_TRUE(gray_rows[0][0] == 0 && gray_rows[0][3] == 85 && gray_rows[0][6] == 170);
+  EXPECT_TRUE(gray_rows[1][0] == 255 && gray_rows[1][4] == 170 && gray_rows[1][8] == 85);
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+  // image::save and the file constructor go through the same codec.
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "nano_graphics_png_test.png";
+  nano::image img(size, 8, 32, size.width * 4, fmt::rgba, reinterpret_cast<const std::uint8_t*>(pixels.data()));
+  EXPECT_TRUE(img.save(path, nano::image::type::png));
+
+  const nano::image loaded(path.string(), nano::image::type::png);
+  EXPECT_TRUE(loaded.get_size() == size && loaded.convert(fmt::rgba).get_data() == img.get_data());
+  std::filesystem::remove(path);
+#endif
+}
+
+TEST_CASE("nano.graphics", RawImage, "RawImage") {
+  using fmt = nano::image::format;
+  using type = nano::image::type;
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "nano_graphics_raw_test.nanoimg";
+  const std::filesystem::path png_path = std::filesystem::temp_directory_path() / "nano_graphics_raw_test.png";
+
+  // Rows of 5 rgba pixels are padded to 64 bytes in the file.
+  const nano::size<std::size_t> size = { 5, 3 };
+  std::vector<std::uint32_t> pixels(size.width * size.height);
+  for (std::size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = static_cast<std::uint32_t>(i * 0x01020304u) | 0xFF;
+  }
+
+  const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(pixels.data());
+  nano::image img(size, 8, 32, size.width * 4, fmt::rgba, bytes);
+  EXPECT_TRUE(img.save(path, type::raw));
+
+  // The view points to the mapped rows, which are the saved ones.
+  nano::image loaded(path.string(), type::raw);
+  const nano::image_view v = loaded.view();
+  EXPECT_TRUE(loaded.get_size() == size && v.fmt == fmt::rgba && v.bytes_per_row == 64);
+  EXPECT_TRUE(reinterpret_cast<std::uintptr_t>(v.data) % 64 == 0);
+
+  bool same = true;
+  for (std::size_t y = 0; y < size.height; y++) {
+    same = same && std::memcmp(v.row(y), bytes + y * size.width * 4, size.width * 4) == 0;
+  }
+  EXPECT_TRUE(same);
+
+  // The mapping is private, writing to the pixels leaves the file as it was.
+  loaded.mutable_view().data[0] ^= 0xFF;
+  EXPECT_TRUE(nano::image(path.string(), type::raw).view().data[0] == bytes[0]);
+
+  // Missing rows make the file invalid.
+  std::filesystem::resize_file(path, 64 * 3);
+  EXPECT_FALSE(nano::image(path.string(), type::raw).is_valid());
+
+  // A converted png keeps the format of the decoder.
+  {
+    nano::png_encoder encoder(png_path, size, fmt::rgba);
+    for (std::size_t y = 0; y < size.height; y++) {
+      encoder.write_row(bytes + y * size.width * 4);
+    }
+  }
+
+  EXPECT_TRUE(nano::convert_to_raw_image(png_path, type::png, path));
+  const nano::image converted(path.string(), type::raw);
+  EXPECT_TRUE(converted.get_format() == fmt::abgr && converted.convert(fmt::rgba).get_data() == img.get_data());
+  EXPECT_TRUE(nano::image(path.string(), type::raw, nano::image::decode_scale::half).get_size()
+      == nano::size<std::size_t>(3, 2));
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(png_path);
+}
+
+TEST_CASE("nano.graphics", Probe, "Probe") {
+  using type = nano::image::type;
+  const std::filesystem::path dir = std::filesystem::temp_directory_path();
+  const std::filesystem::path png_path = dir / "nano_graphics_probe_test.png";
+  const std::filesystem::path jfif_path = dir / "nano_graphics_probe_test_jfif.jpg";
+  const std::filesystem::path exif_path = dir / "nano_graphics_probe_test_exif.jpg";
+  const std::filesystem::path raw_path = dir / "nano_graphics_probe_test.nanoimg";
+  const nano::size<std::size_t> size = { 20, 10 };
+  const auto near = [](double a, double b) { return std::abs(a - b) < 0.01; };
+
+  {
+    nano::png_options options;
+    options.dpi = { 144.0, 72.0 };
+    nano::png_encoder encoder(png_path, size, nano::image::format::rgb, options);
+    encoder.write_rows([](std::size_t, const nano::mutable_image_view& row) {
+      std::fill_n(row.data, row.bytes_per_row, std::uint8_t(0));
+    });
+  }
+
+  // Only the headers are needed, the frame of both jpeg files is 8 bits 20x10 ycbcr.
+  const std::uint8_t frame[] = { 0xFF, 0xC0, 0x00, 0x11, 0x08, 0x00, 0x0A, 0x00, 0x14, 0x03, 0x01, 0x22, 0x00, 0x02,
+    0x11, 0x01, 0x03, 0x11, 0x01, 0xFF, 0xD9 };
+
+  // 300 dpi.
+  const std::uint8_t jfif[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0, 1, 1, 1, 0x01, 0x2C, 0x01,
+    0x2C, 0, 0 };
+
+  // Big endian IFD0 of 72 pixels per centimeter.
+  const std::uint8_t exif[] = { 0xFF, 0xD8, 0xFF, 0xE1, 0x00, 0x4A, 'E', 'x', 'i', 'f', 0x00, 0x00, 'M', 'M', 0x00,
+    0x2A, 0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0x01, 0x1A, 0x00, 0x05, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x32,
+    0x01, 0x1B, 0x00, 0x05, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3A, 0x01, 0x28, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x90, 0x00, 0x00, 0x00, 0x02 };
+
+  for (const auto& [path, bytes, count] :
+      { std::make_tuple(jfif_path, jfif, sizeof(jfif)), std::make_tuple(exif_path, exif, sizeof(exif)) }) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(count));
+    file.write(reinterpret_cast<const char*>(frame), sizeof(frame));
+  }
+
+  const nano::image::file_info png = nano::image::probe(png_path);
+  EXPECT_TRUE(png && png.file_type == type::png && png.size == size && png.channels == 3);
+  EXPECT_TRUE(png.bits_per_component == 8 && near(png.dpi.width, 144) && near(png.dpi.height, 72));
+  EXPECT_TRUE(near(nano::image::get_dpi(png_path.string()).width, 144));
+
+  const nano::image::file_info jpeg = nano::image::probe(jfif_path);
+  EXPECT_TRUE(jpeg && jpeg.file_type == type::jpeg && jpeg.size == size && jpeg.channels == 3);
+  EXPECT_TRUE(jpeg.bits_per_component == 8 && near(jpeg.dpi.width, 300) && near(jpeg.dpi.height, 300));
+
+  const nano::image::file_info jpeg_exif = nano::image::probe(exif_path);
+  EXPECT_TRUE(jpeg_exif && jpeg_exif.size == size && near(jpeg_exif.dpi.width, 72 * 2.54));
+  EXPECT_TRUE(near(jpeg_exif.dpi.height, 72 * 2.54));
+
+  const std::vector<std::uint8_t> alpha(size.width * size.height, 255);
+  nano::image(size, 8, 8, size.width, nano::image::format::alpha, alpha.data()).save(raw_path, type::raw);
+
+  // The batch keeps the order, missing files are invalid.
+  const std::vector<nano::image::file_info> infos
+      = nano::image::probe({ raw_path, dir / "nano_graphics_probe_missing.png", png_path, jfif_path });
+  EXPECT_TRUE(infos.size() == 4 && infos[0] && infos[0].file_type == type::raw && infos[0].channels == 1);
+  EXPECT_TRUE(infos[0].size == size && !infos[1] && infos[2].file_type == type::png && infos[3].size == size);
+
+  for (const std::filesystem::path& path : { png_path, jfif_path, exif_path, raw_path }) {
+    std::filesystem::remove(path);
+  }
+}
+
+TEST_CASE("nano.graphics", LoadAsync, "LoadAsync") {
+  using type = nano::image::type;
+  using priority = nano::image::load_priority;
+  using status = nano::async_image::status;
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "nano_graphics_load_async_test.png";
+  const nano::size<std::size_t> size = { 8, 4 };
+
+  {
+    nano::png_encoder encoder(path, size, nano::image::format::rgb);
+    encoder.write_rows([](std::size_t, const nano::mutable_image_view& row) {
+      std::fill_n(row.data, row.size.width * 3, std::uint8_t(90));
+    });
+  }
+
+  // on_loaded returns before the load is done.
+  std::atomic<int> callbacks = 0;
+  nano::async_image request = nano::image::load_async(
+      path.string(), type::png, priority::normal, [&](const nano::image& img) { callbacks += img.get_size() == size; });
+  EXPECT_TRUE(request.get().get_size() == size && request.get_status() == status::done && callbacks == 1);
+  EXPECT_FALSE(request.cancel());
+  EXPECT_FALSE(nano::image::load_async("nano_graphics_missing.png", type::png).get().is_valid());
+
+  // There are at most 4 decode threads, they all wait in a blocker or start one before the loads pushed next.
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::vector<nano::async_image> blockers;
+
+  for (int i = 0; i < 4; i++) {
+    blockers.push_back(nano::image::load_async(
+        path.string(), type::png, priority::normal, [released](const nano::image&) { released.wait(); }));
+  }
+
+  nano::async_image cancelled
+      = nano::image::load_async(path.string(), type::png, priority::low, [&](const nano::image&) { callbacks++; });
+  std::vector<nano::async_image> prefetched = nano::image::prefetch({ path.string(), path.string() }, type::png);
+  prefetched[0].set_priority(priority::high);
+
+  EXPECT_TRUE(cancelled.get_status() == status::pending && !cancelled.wait_for(std::chrono::milliseconds(1)));
+  EXPECT_TRUE(cancelled.cancel() && cancelled.is_ready() && !cancelled.get().is_valid());
+  EXPECT_TRUE(prefetched.size() == 2 && prefetched[1].get_status() == status::pending);
+
+  release.set_value();
+  bool loaded = true;
+  for (const nano::async_image& r : blockers) {
+    loaded = loaded && r.get().get_size() == size;
+  }
+
+  for (const nano::async_image& r : prefetched) {
+    loaded = loaded && r.get().get_size() == size;
+  }
+
+  EXPECT_TRUE(loaded && callbacks == 1 && cancelled.get_status() == status::cancelled);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("nano.graphics", ImageCache, "ImageCache") {
+  using type = nano::image::type;
+  const std::filesystem::path dir = std::filesystem::temp_directory_path();
+  const std::filesystem::path small_path = dir / "nano_graphics_cache_test_small.png";
+  const std::filesystem::path large_path = dir / "nano_graphics_cache_test_large.png";
+
+  const auto write_png = [](const std::filesystem::path& path, const nano::size<std::size_t>& size) {
+    nano::png_encoder encoder(path, size, nano::image::format::rgb);
+    encoder.write_rows([](std::size_t y, const nano::mutable_image_view& row) {
+      std::fill_n(row.data, row.size.width * 3, static_cast<std::uint8_t>(y * 40));
+    });
+  };
+
+  write_png(small_path, { 8, 4 });
+  write_png(large_path, { 16, 4 });
+
+  nano::image_cache cache(1 << 20);
+  const nano::image small = cache.get(small_path, type::png);
+  const std::size_t small_bytes = small.get_bytes_per_row() * small.height();
+  EXPECT_TRUE(small.get_size() == nano::size<std::size_t>(8, 4) && cache.get(small_path, type::png).is_valid());
+
+  const nano::image large = cache.get(large_path, type::png);
+  const std::size_t large_bytes = large.get_bytes_per_row() * large.height();
+  nano::image_cache::stats stats = cache.get_stats();
+  EXPECT_TRUE(stats.hits == 1 && stats.misses == 2 && stats.count == 2 && stats.bytes == small_bytes + large_bytes);
+
+  // The small image was used last, the large one goes first.
+  cache.get(small_path, type::png);
+  cache.set_byte_budget(small_bytes);
+  stats = cache.get_stats();
+  EXPECT_TRUE(stats.evictions == 1 && stats.count == 1 && stats.bytes == small_bytes && stats.hits == 2);
+
+  // A file of another size is loaded again, missing files aren't cached.
+  write_png(small_path, { 16, 4 });
+  cache.set_byte_budget(1 << 20);
+  EXPECT_TRUE(cache.get(small_path, type::png).get_size() == nano::size<std::size_t>(16, 4));
+  EXPECT_FALSE(cache.get(dir / "nano_graphics_cache_missing.png", type::png).is_valid());
+  stats = cache.get_stats();
+  EXPECT_TRUE(stats.misses == 4 && stats.count == 1 && stats.bytes == large_bytes);
+
+  // Concurrent requests share one load.
+  cache.clear();
+  std::vector<std::thread> threads;
+  std::atomic<int> loaded = 0;
+
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&]() { loaded += cache.get(large_path, type::png).get_size().width == 16; });
+  }
+
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  stats = cache.get_stats();
+  EXPECT_TRUE(loaded == 4 && stats.misses == 5 && stats.hits == 5 && stats.count == 1);
+
+  cache.erase(large_path);
+  EXPECT_TRUE(cache.get_stats().count == 0 && cache.get_stats().bytes == 0);
+
+  // A load cancelled by one caller before it started is loaded again by the next one.
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::vector<nano::async_image> blockers;
+
+  for (int i = 0; i < 4; i++) {
+    blockers.push_back(nano::image::load_async(
+        small_path.string(), type::png, nano::image::load_priority::high, [released](const nano::image&) {
+          released.wait();
+        }));
+  }
+
+  EXPECT_TRUE(cache.get_async(large_path, type::png).cancel());
+  release.set_value();
+
+  for (const nano::async_image& b : blockers) {
+    b.get();
+  }
+
+  EXPECT_TRUE(cache.get(large_path, type::png).get_size().width == 16);
+  stats = cache.get_stats();
+  EXPECT_TRUE(stats.count == 1 && stats.bytes == large_bytes && stats.misses == 7);
+
+  std::filesystem::remove(small_path);
+  std::filesystem::remove(large_path);
+}
+
+TEST_CASE("nano.graphics", TextureAtlas, "TextureAtlas") {
+  using fmt = nano::image::format;
+  using handle = nano::texture_atlas::handle;
+  nano::texture_atlas atlas({ 64, 64 }, fmt::rgba, 1);
+
+  // Every sprite has its own color, with a different alpha at its first pixel.
+  std::vector<std::vector<std::uint32_t>> sprites;
+  std::vector<nano::size<std::size_t>> sizes;
+  std::vector<handle> handles;
+
+  for (std::uint32_t i = 0; i < 40; i++) {
+    const nano::size<std::size_t> size = { 3 + i % 7 * 2, 4 + i % 5 * 3 };
+    std::vector<std::uint32_t> pixels(size.width * size.height, 0x10203000u + i * 0x01050700u + 0xFF);
+    pixels[0] = (pixels[0] & 0xFFFFFF00u) | 0x80;
+
+    handles.push_back(atlas.insert(nano::image_view(
+        reinterpret_cast<const std::uint8_t*>(pixels.data()), size, size.width * 4, fmt::rgba)));
+    sprites.push_back(std::move(pixels));
+    sizes.push_back(size);
+  }
+
+  const auto check = [&]() {
+    bool ok = true;
+
+    for (std::size_t i = 0; i < handles.size(); i++) {
+      if (!atlas.contains(handles[i])) {
+        continue;
+      }
+
+      const nano::texture_atlas::entry e = atlas.get_entry(handles[i]);
+      const nano::image_view page = atlas.get_page(e.page).view();
+      const nano::size<std::size_t> size = sizes[i];
+      const std::size_t x = static_cast<std::size_t>(e.rect.x);
+      const std::size_t y = static_cast<std::size_t>(e.rect.y);
+      ok = ok && e.rect.width == size.width && e.rect.height == size.height;
+
+      for (std::size_t r = 0; r < size.height; r++) {
+        ok = ok && std::memcmp(page.row(y + r) + x * 4, sprites[i].data() + r * size.width, size.width * 4) == 0;
+      }
+
+      // The padding repeats the edges, the corner takes the first pixel.
+      const std::uint32_t* above = reinterpret_cast<const std::uint32_t*>(page.row(y - 1));
+      ok = ok && above[x - 1] == sprites[i][0] && above[x + size.width] == sprites[i][size.width - 1];
+    }
+
+    return ok;
+  };
+
+  EXPECT_TRUE(std::find(handles.begin(), handles.end(), nano::texture_atlas::invalid_handle) == handles.end());
+  EXPECT_TRUE(atlas.get_image_count() == 40 && atlas.get_page_count() > 1 && check());
+
+  const std::vector<std::uint32_t> too_large(70 * 2, 0);
+  EXPECT_TRUE(atlas.insert(nano::image_view(reinterpret_cast<const std::uint8_t*>(too_large.data()), { 70, 2 }, 280,
+                  fmt::rgba))
+      == nano::texture_atlas::invalid_handle);
+
+  // Half of the sprites go away, repacking them needs fewer pages and keeps the handles.
+  const std::size_t page_count = atlas.get_page_count();
+  const float occupancy = atlas.get_occupancy();
+
+  for (std::size_t i = 0; i < handles.size(); i += 2) {
+    atlas.erase(handles[i]);
+  }
+
+  atlas.repack();
+  EXPECT_TRUE(atlas.get_image_count() == 20 && atlas.get_page_count() < page_count && check());
+  EXPECT_TRUE(atlas.get_occupancy() > occupancy / 2 && !atlas.contains(handles[0]) && atlas.contains(handles[1]));
+}
+
+#if NANO_GRAPHICS_SOFTWARE_RENDERER
+TEST_CASE("nano.graphics", SoftwarePath, "SoftwarePath") {
+  // Both sides are flattened within a tenth of a pixel, which is at most 26 out of 255 on an edge.
+  auto max_difference = [](const nano::image& a, const nano::image& b) {
+    int diff = 0;
+    for (std::size_t i = 0; i < a.get_bytes_per_row() * a.height(); i++) {
+      diff = std::max(diff, std::abs(static_cast<int>(a.data()[i]) - static_cast<int>(b.data()[i])));
+    }
+    return diff;
+  };
+
+  nano::graphic_context expected = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  expected.set_fill_color(0xFF0000FF);
+  expected.fill_ellipse({ 4.5f, 6, 50, 40 });
+  expected.fill_rect({ 44, 50, 16, 12 });
+
+  nano::path p;
+  p.add_ellipse({ 4.5f, 6, 50, 40 });
+  p.add_rect({ 44, 50, 16, 12 });
+
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  gc.set_fill_color(0xFF0000FF);
+  gc.fill_path(p);
+  EXPECT_TRUE(max_difference(expected.create_image(), gc.create_image()) <= 26);
+
+  // A unit path drawn in a rect.
+  nano::path unit;
+  unit.add_ellipse({ 0, 0, 1, 1 });
+
+  nano::graphic_context scaled = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  scaled.set_fill_color(0xFF0000FF);
+  scaled.fill_path(unit, { 4.5f, 6, 50, 40 });
+  scaled.fill_rect({ 44, 50, 16, 12 });
+  EXPECT_TRUE(max_difference(expected.create_image(), scaled.create_image()) <= 26);
+
+  // Semicircle with a stroked outline.
+  nano::path arc;
+  arc.add_arc({ 32, 32 }, 20, 0, 3.14159265f, true);
+  arc.close_path();
+
+  nano::graphic_context stroked = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  stroked.set_fill_color(0x00FF00FF);
+  stroked.fill_path(arc);
+  stroked.set_stroke_color(0x0000FFFF);
+  stroked.set_line_width(2);
+  stroked.stroke_path(arc);
+
+  nano::image img = stroked.create_image();
+  const nano::color* px = reinterpret_cast<const nano::color*>(img.data());
+  EXPECT_EQ(px[42 * 64 + 32], nano::color(0x00FF00FF));
+  EXPECT_EQ(px[51 * 64 + 32], nano::color(0x0000FFFF));
+  EXPECT_EQ(px[20 * 64 + 32], nano::color(0));
+}
+
+TEST_CASE("nano.graphics", Stroke, "Stroke") {
+  nano::path corner;
+  corner.move_to({ 10, 40 });
+  corner.line_to({ 40, 40 });
+  corner.line_to({ 40, 10 });
+
+  auto stroke = [&](nano::line_join join, float miter_limit) {
+    nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+    gc.set_stroke_color(0xFF0000FF);
+    gc.set_line_style(10, join, nano::line_cap::butt);
+    gc.set_miter_limit(miter_limit);
+    gc.stroke_path(corner);
+    return gc.create_image();
+  };
+
+  auto red = [](const nano::image& img, int x, int y) { return img.data()[(y * 64 + x) * 4]; };
+
+  // The outer corner is at 45, 45.
+  const nano::image miter = stroke(nano::line_join::miter, 10);
+  EXPECT_EQ(red(miter, 44, 44), 255);
+  EXPECT_EQ(red(miter, 30, 40), 255);
+  EXPECT_EQ(red(miter, 30, 30), 0);
+  EXPECT_EQ(red(stroke(nano::line_join::miter, 1.2f), 43, 43), 0);
+  EXPECT_EQ(red(stroke(nano::line_join::bevel, 10), 43, 43), 0);
+
+  const nano::image round = stroke(nano::line_join::round, 10);
+  EXPECT_EQ(red(round, 42, 42), 255);
+  EXPECT_EQ(red(round, 44, 44), 0);
+
+  // A round join at a reversal wraps around the turning point.
+  nano::path back;
+  back.move_to({ 10, 32 });
+  back.line_to({ 40, 32 });
+  back.line_to({ 10, 32 });
+  nano::graphic_context reversal = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  reversal.set_stroke_color(0xFF0000FF);
+  reversal.set_line_style(10, nano::line_join::round, nano::line_cap::butt);
+  reversal.stroke_path(back);
+  const nano::image reversed = reversal.create_image();
+  EXPECT_EQ(red(reversed, 42, 32), 255);
+  EXPECT_EQ(red(reversed, 38, 32), 255);
+  EXPECT_EQ(red(reversed, 47, 32), 0);
+
+  // Strokes of copies share the cached outline.
+  nano::path copy = corner;
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  gc.set_stroke_color(0xFF0000FF);
+  gc.set_line_width(10);
+  gc.stroke_path(copy);
+  EXPECT_EQ(std::memcmp(miter.data(), gc.create_image().data(), miter.get_bytes_per_row() * 64), 0);
+
+  // A stroked circle against the difference of two circles.
+  nano::path circle;
+  circle.add_ellipse({ 12, 12.5f, 40, 40 });
+
+  nano::graphic_context expected = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  expected.set_stroke_color(0x0000FFFF);
+  expected.set_line_width(6);
+  expected.stroke_ellipse({ 12, 12.5f, 40, 40 });
+
+  nano::graphic_context result = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  result.set_stroke_color(0x0000FFFF);
+  result.set_line_width(6);
+  result.stroke_path(circle);
+
+  // Both are flattened within a tenth of a pixel.
+  const nano::image a = expected.create_image();
+  const nano::image b = result.create_image();
+  int diff = 0;
+  for (std::size_t i = 0; i < a.get_bytes_per_row() * 64; i++) {
+    diff = std::max(diff, std::abs(static_cast<int>(a.data()[i]) - static_cast<int>(b.data()[i])));
+  }
+  EXPECT_TRUE(diff <= 52);
+
+  // Hairlines.
+  nano::path diagonal;
+  diagonal.move_to({ 2, 2 });
+  diagonal.line_to({ 60, 40 });
+  result.set_line_width(1);
+  result.stroke_path(diagonal);
+  const nano::image hairline = result.create_image();
+  EXPECT_TRUE(reinterpret_cast<const nano::color*>(hairline.data())[21 * 64 + 31].alpha() > 0);
+}
+
+TEST_CASE("nano.graphics", Damage, "Damage") {
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 200, 100 }, nano::image::format::rgba);
+  gc.set_fill_color(0x000000FF);
+  gc.fill_rect({ 0, 0, 200, 100 });
+  EXPECT_EQ(gc.get_damage_bounds(), nano::rect<std::size_t>(0, 0, 200, 100));
+  gc.create_image();
+  EXPECT_TRUE(gc.get_damage().empty());
+
+  gc.set_fill_color(0xFF0000FF);
+  gc.fill_ellipse({ 10.5f, 10, 20, 20 });
+  gc.fill_rect({ 150, 60, 30, 30 });
+  gc.fill_rect({ 300, 0, 10, 10 });
+  EXPECT_EQ(gc.get_damage().size(), 2);
+  EXPECT_EQ(gc.get_damage_bounds(), nano::rect<std::size_t>(10, 10, 170, 80));
+  gc.reset_damage();
+
+  // Partial redraw of a single region.
+  auto draw = [](nano::graphic_context& g, const nano::color& c) {
+    g.set_fill_color(c);
+    g.fill_rect({ 0, 0, 200, 100 });
+  };
+
+  gc.save_state();
+  gc.translate({ 40, 0 });
+  gc.add_damage({ 0, 0, 20, 20 });
+  gc.restore_state();
+
+  gc.save_state();
+  gc.clip_to_damage();
+  draw(gc, 0x00FF00FF);
+  gc.restore_state();
+
+  EXPECT_EQ(gc.get_damage_bounds(), nano::rect<std::size_t>(40, 0, 20, 20));
+  nano::image img = gc.create_image();
+  const nano::color* px = reinterpret_cast<const nano::color*>(img.data());
+  EXPECT_EQ(px[5 * 200 + 45], nano::color(0x00FF00FF));
+  EXPECT_EQ(px[5 * 200 + 35], nano::color(0x000000FF));
+  EXPECT_EQ(px[70 * 200 + 160], nano::color(0xFF0000FF));
+}
+
+TEST_CASE("nano.graphics", Clip, "Clip") {
+  auto draw = [](nano::graphic_context& gc) {
+    gc.set_fill_color(0x000000FF);
+    gc.fill_rect({ 0, 0, 300, 200 });
+
+    nano::path circle;
+    circle.add_ellipse({ 20, 20, 100, 100 });
+
+    gc.save_state();
+    gc.clip_to_path(circle);
+    gc.set_fill_color(0xFF0000FF);
+    gc.fill_rect({ 0, 0, 300, 200 });
+
+    // Rects intersect the scissor and keep the mask.
+    gc.save_state();
+    gc.clip_to_rect({ 70, 0, 100, 200 });
+    gc.set_fill_color(0x0000FFFF);
+    gc.fill_ellipse({ 0, 0, 300, 200 });
+    gc.restore_state();
+    gc.restore_state();
+
+    // Even-odd ring intersected with the alpha of an image.
+    nano::path ring;
+    ring.add_ellipse({ 150, 50, 100, 100 });
+    ring.add_ellipse({ 175, 75, 50, 50 });
+
+    std::vector<std::uint8_t> pixels(4 * 4 * 4, 0);
+    for (std::size_t i = 0; i < 8; i++) {
+      pixels[i * 4 + 0] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = pixels[i * 4 + 3] = 255;
+    }
+    const nano::image half({ 4, 4 }, 8, 32, 16, nano::image::format::rgba, pixels.data());
+
+    gc.save_state();
+    gc.clip_to_path_even_odd(ring);
+    gc.clip_to_mask(half, { 150, 50, 100, 100 });
+    gc.begin_transparent_layer(1);
+    gc.set_fill_color(0x00FF00FF);
+    gc.fill_rect({ 0, 0, 300, 200 });
+    gc.end_transparent_layer();
+    gc.restore_state();
+
+    gc.set_fill_color(0xFFFFFFFF);
+    gc.fill_rect({ 290, 190, 10, 10 });
+  };
+
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 300, 200 }, nano::image::format::rgba);
+
+  // The bounds of a mask are the scissor, rects only shrink it.
+  nano::path circle;
+  circle.add_ellipse({ 20, 20, 100, 100 });
+  gc.save_state();
+  gc.clip_to_path(circle);
+  EXPECT_EQ(gc.get_clipping_rect(), nano::rect<float>(20, 20, 100, 100));
+  gc.clip_to_rect({ 70, 0, 100, 200 });
+  EXPECT_EQ(gc.get_clipping_rect(), nano::rect<float>(70, 20, 50, 100));
+  gc.restore_state();
+  EXPECT_EQ(gc.get_clipping_rect(), nano::rect<float>(0, 0, 300, 200));
+
+  // Fractional rects partially cover their edge pixels, from clip_to_rect() or from a path.
+  for (int from_path = 0; from_path < 2; from_path++) {
+    nano::graphic_context half_px = nano::graphic_context::create_bitmap_context({ 40, 20 }, nano::image::format::rgba);
+    half_px.translate({ 0.25f, 0 });
+
+    if (from_path) {
+      half_px.begin_path();
+      half_px.add_rect({ 10.25f, 5, 20, 10 });
+      half_px.clip();
+    }
+    else {
+      half_px.clip_to_rect({ 10.25f, 5, 20, 10 });
+    }
+
+    half_px.set_fill_color(0xFF0000FF);
+    half_px.fill_rect({ -1, 0, 40, 20 });
+    const nano::image clipped = half_px.create_image();
+    const nano::color* row = reinterpret_cast<const nano::color*>(clipped.data()) + 10 * 40;
+    EXPECT_TRUE(std::abs(static_cast<int>(row[10].red()) - 128) <= 2);
+    EXPECT_EQ(row[11].red(), 255);
+    EXPECT_TRUE(std::abs(static_cast<int>(row[30].red()) - 128) <= 2);
+    EXPECT_EQ(row[31].red(), 0);
+    EXPECT_EQ(reinterpret_cast<const nano::color*>(clipped.data())[4 * 40 + 20].red(), 0);
+  }
+
+  draw(gc);
+  nano::image img = gc.create_image();
+  const nano::color* px = reinterpret_cast<const nano::color*>(img.data());
+
+  EXPECT_EQ(px[70 * 300 + 40], nano::color(0xFF0000FF));
+  EXPECT_EQ(px[70 * 300 + 90], nano::color(0x0000FFFF));
+  EXPECT_EQ(px[22 * 300 + 22], nano::color(0x000000FF));
+  const nano::color edge = px[70 * 300 + 20];
+  EXPECT_TRUE(edge.red() > 0 && edge.red() < 255);
+
+  // Ring in the top half of the mask only.
+  // The mask is sampled bilinearly, which can lose a unit of coverage.
+  EXPECT_TRUE(px[60 * 300 + 200].green() >= 250 && px[60 * 300 + 200].red() == 0);
+  EXPECT_EQ(px[95 * 300 + 200], nano::color(0x000000FF));
+  EXPECT_EQ(px[140 * 300 + 200], nano::color(0x000000FF));
+  EXPECT_EQ(px[195 * 300 + 295], nano::color(0xFFFFFFFF));
+
+  nano::graphic_context tiled = nano::graphic_context::create_bitmap_context({ 300, 200 }, nano::image::format::rgba);
+  tiled.set_tiled_rendering(true);
+  draw(tiled);
+  nano::image result = tiled.create_image();
+  EXPECT_EQ(std::memcmp(img.data(), result.data(), img.get_bytes_per_row() * 200), 0);
+}
+
+TEST_CASE("nano.graphics", Layers, "Layers") {
+  // Small layers reused from the pool, nested ones and one drawn outside of its clip.
+  auto draw = [](nano::graphic_context& gc) {
+    gc.set_fill_color(0x000000FF);
+    gc.fill_rect({ 0, 0, 200, 100 });
+
+    for (int i = 0; i < 4; i++) {
+      const float x = static_cast<float>(i * 50);
+      gc.save_state();
+      gc.clip_to_rect({ x + 10, 10, 30, 30 });
+      gc.begin_transparent_layer(0.5f);
+      gc.set_fill_color(0xFF0000FF);
+      gc.fill_rect({ 0, 0, 200, 100 });
+
+      gc.begin_transparent_layer(1);
+      gc.set_fill_color(0x0000FFFF);
+      gc.fill_ellipse({ x + 20, 20, 40, 40 });
+      gc.end_transparent_layer();
+
+      gc.end_transparent_layer();
+      gc.restore_state();
+    }
+
+    gc.begin_transparent_layer(0.5f);
+    gc.set_fill_color(0x00FF00FF);
+    gc.fill_rect({ 0, 60, 20, 20 });
+    gc.fill_rect({ 300, 60, 20, 20 });
+    gc.end_transparent_layer();
+  };
+
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 200, 100 }, nano::image::format::rgba);
+  draw(gc);
+  nano::image img = gc.create_image();
+  const nano::color* px = reinterpret_cast<const nano::color*>(img.data());
+
+  for (int i = 0; i < 4; i++) {
+    const nano::color red = px[12 * 200 + i * 50 + 12];
+    EXPECT_TRUE(red.red() >= 127 && red.red() <= 128 && red.green() == 0 && red.blue() == 0);
+
+    const nano::color blue = px[35 * 200 + i * 50 + 35];
+    EXPECT_TRUE(blue.blue() >= 127 && blue.blue() <= 128 && blue.red() == 0);
+
+    EXPECT_EQ(px[45 * 200 + i * 50 + 35], nano::color(0x000000FF));
+  }
+
+  EXPECT_TRUE(px[70 * 200 + 10].green() >= 127 && px[70 * 200 + 10].green() <= 128);
+  EXPECT_EQ(px[70 * 200 + 30], nano::color(0x000000FF));
+
+  nano::graphic_context tiled = nano::graphic_context::create_bitmap_context({ 200, 100 }, nano::image::format::rgba);
+  tiled.set_tiled_rendering(true);
+  draw(tiled);
+  tiled.flush();
+  draw(tiled);
+  nano::image result = tiled.create_image();
+
+  // Drawn twice over an opaque background, the second pass reuses the flushed layers.
+  EXPECT_EQ(std::memcmp(img.data(), result.data(), img.get_bytes_per_row() * 100), 0);
+
+  // Extra restores can't pop the state of a layer, whose buffer only covers its clip.
+  nano::graphic_context unbalanced
+      = nano::graphic_context::create_bitmap_context({ 200, 100 }, nano::image::format::rgba);
+  unbalanced.save_state();
+  unbalanced.clip_to_rect({ 10, 10, 20, 20 });
+  unbalanced.begin_transparent_layer(1);
+  unbalanced.restore_state();
+  unbalanced.restore_state();
+  unbalanced.draw_image(img, { 0.5f, 0.5f, 150, 150 });
+  unbalanced.set_fill_color(0x00FF00FF);
+  unbalanced.fill_rect({ 0, 0, 200, 100 });
+  EXPECT_EQ(unbalanced.get_clipping_rect(), nano::rect<float>(10, 10, 20, 20));
+  unbalanced.end_transparent_layer();
+  unbalanced.restore_state();
+  EXPECT_EQ(unbalanced.get_clipping_rect(), nano::rect<float>(0, 0, 200, 100));
+
+  const nano::image layered = unbalanced.create_image();
+  const nano::color* out = reinterpret_cast<const nano::color*>(layered.data());
+  EXPECT_EQ(out[20 * 200 + 20], nano::color(0x00FF00FF));
+  EXPECT_EQ(out[50 * 200 + 50].alpha(), 0);
+}
+
+TEST_CASE("nano.graphics", BlendModes, "BlendModes") {
+  auto draw = [](nano::graphic_context& gc) {
+    gc.set_fill_color(nano::color(200, 100, 50, 255));
+    gc.fill_rect({ 0, 0, 160, 60 });
+
+    const std::pair<nano::blend_mode, nano::color> modes[] = {
+      { nano::blend_mode::multiply, nano::color(128, 128, 128, 255) },
+      { nano::blend_mode::screen, nano::color(128, 128, 128, 255) },
+      { nano::blend_mode::plus_lighter, nano::color(100, 100, 100, 255) },
+      { nano::blend_mode::copy, nano::color(0, 0, 0, 0) },
+      { nano::blend_mode::clear, nano::color(255, 255, 255, 255) },
+      { nano::blend_mode::destination_out, nano::color(0, 0, 0, 128) },
+      { nano::blend_mode::source_atop, nano::color(0, 0, 255, 255) },
+      { nano::blend_mode::overlay, nano::color(128, 128, 128, 255) },
+    };
+
+    for (std::size_t i = 0; i < 8; i++) {
+      gc.save_state();
+      gc.set_blend_mode(modes[i].first);
+      gc.set_fill_color(modes[i].second);
+      gc.fill_rect({ static_cast<float>(i * 20), 0, 20, 20 });
+      gc.fill_ellipse({ static_cast<float>(i * 20) + 0.5f, 20.5f, 19, 19 });
+      gc.restore_state();
+    }
+
+    // The layer is drawn normally and multiplied when it ends.
+    gc.save_state();
+    gc.set_blend_mode(nano::blend_mode::multiply);
+    gc.begin_transparent_layer(1);
+    gc.set_fill_color(nano::color(128, 128, 128, 255));
+    gc.fill_rect({ 0, 40, 20, 20 });
+    gc.end_transparent_layer();
+    gc.restore_state();
+  };
+
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 160, 60 }, nano::image::format::rgba);
+  draw(gc);
+  nano::image img = gc.create_image();
+  const nano::color* px = reinterpret_cast<const nano::color*>(img.data());
+
+  EXPECT_EQ(px[10 * 160 + 10], nano::color(100, 50, 25, 255));
+  EXPECT_EQ(px[10 * 160 + 30], nano::color(228, 178, 153, 255));
+  EXPECT_EQ(px[10 * 160 + 50], nano::color(255, 200, 150, 255));
+  EXPECT_EQ(px[10 * 160 + 70], nano::color(0, 0, 0, 0));
+  EXPECT_EQ(px[10 * 160 + 90], nano::color(0, 0, 0, 0));
+  EXPECT_EQ(px[10 * 160 + 110], nano::color(100, 50, 25, 127));
+  EXPECT_EQ(px[10 * 160 + 130], nano::color(0, 0, 255, 255));
+  EXPECT_EQ(px[50 * 160 + 10], nano::color(100, 50, 25, 255));
+
+  // Copy only replaces the covered part of the ellipse.
+  EXPECT_EQ(px[30 * 160 + 70], nano::color(0, 0, 0, 0));
+  EXPECT_EQ(px[21 * 160 + 61], nano::color(200, 100, 50, 255));
+  const nano::color edge = px[30 * 160 + 60];
+  EXPECT_TRUE(edge.alpha() > 0 && edge.alpha() < 255);
+
+  nano::graphic_context tiled = nano::graphic_context::create_bitmap_context({ 160, 60 }, nano::image::format::rgba);
+  tiled.set_tiled_rendering(true);
+  draw(tiled);
+  nano::image result = tiled.create_image();
+  EXPECT_EQ(std::memcmp(img.data(), result.data(), img.get_bytes_per_row() * 60), 0);
+}
+
+TEST_CASE("nano.graphics", SoftwareContext, "SoftwareContext") {
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+  gc.set_fill_color(0xFF0000FF);
+  gc.fill_rect({ 0, 0, 64, 64 });
+
+  gc.set_fill_color(0x0000FF80);
+  gc.fill_rect({ 8, 8, 16, 16 });
+
+  gc.set_fill_color(0x00FF00FF);
+  gc.fill_ellipse({ 32, 32, 32, 32 });
+
+  gc.save_state();
+  gc.clip_to_rect({ 0, 32, 8, 8 });
+  gc.set_fill_color(0xFFFFFFFF);
+  gc.fill_rect({ 0, 0, 64, 64 });
+  gc.restore_state();
+
+  nano::image img = gc.create_image();
+  EXPECT_TRUE(img.is_valid());
+  EXPECT_EQ(img.get_size(), nano::size<std::size_t>(64, 64));
+
+  // rgba pixels are stored as nano::color words.
+  const nano::color* px = reinterpret_cast<const nano::color*>(img.data());
+  EXPECT_EQ(px[0], nano::color(0xFF0000FF));
+  EXPECT_EQ(px[10 * 64 + 10], nano::color(127, 0, 128, 255));
+  EXPECT_EQ(px[48 * 64 + 48], nano::color(0x00FF00FF));
+  EXPECT_EQ(px[36 * 64 + 4], nano::color(0xFFFFFFFF));
+  EXPECT_EQ(px[36 * 64 + 8], nano::color(0xFF0000FF));
+
+  // Anti-aliased edge of the ellipse.
+  const nano::color edge = px[48 * 64 + 32];
+  EXPECT_TRUE(edge.green() > 0 && edge.green() < 255);
+}
+
+TEST_CASE("nano.graphics", TiledRendering, "TiledRendering") {
+  auto draw = [](nano::graphic_context& gc) {
+    gc.set_fill_color(0x202020FF);
+    gc.fill_rect({ 0, 0, 600, 300 });
+
+    for (int i = 0; i < 20; i++) {
+      const float x = static_cast<float>(i * 29 % 500);
+      gc.set_fill_color(nano::color(static_cast<std::uint8_t>(i * 40), 128, 200, 160));
+      gc.fill_ellipse({ x + 0.3f, 10.5f + i * 7, 90.25f, 70.75f });
+      gc.set_stroke_color(0xFFFFFF80);
+      gc.stroke_line({ x, 0 }, { x + 70, 290 });
+    }
+
+    gc.save_state();
+    gc.clip_to_rect({ 100.5f, 50, 300, 200 });
+    gc.begin_transparent_layer(0.5f);
+    gc.set_fill_color(0x00FF00FF);
+    gc.fill_rounded_rect({ 50, 20, 500, 250 }, 30);
+    gc.end_transparent_layer();
+    gc.restore_state();
+  };
+
+  nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 600, 300 }, nano::image::format::rgba);
+  draw(gc);
+  nano::image expected = gc.create_image();
+
+  nano::graphic_context tiled = nano::graphic_context::create_bitmap_context({ 600, 300 }, nano::image::format::rgba);
+  tiled.set_tiled_rendering(true);
+  EXPECT_TRUE(tiled.is_tiled_rendering());
+  draw(tiled);
+  nano::image result = tiled.create_image();
+
+  EXPECT_EQ(std::memcmp(expected.data(), result.data(), expected.get_bytes_per_row() * 300), 0);
+}
+
+TEST_CASE("nano.graphics", Mipmaps, "Mipmaps") {
+  // One white column every four, a 4x shrink sampling two black columns aliases to black.
+  std::vector<nano::color> stripes(256 * 256, nano::color(0, 0, 0, 255));
+  for (std::size_t i = 0; i < stripes.size(); i += 4) {
+    stripes[i] = nano::color(255, 255, 255, 255);
+  }
+
+  nano::image img(
+      { 256, 256 }, 8, 32, 256 * 4, nano::image::format::rgba, reinterpret_cast<const std::uint8_t*>(stripes.data()));
+
+  const auto draw = [](const nano::image& src) {
+    nano::graphic_context gc = nano::graphic_context::create_bitmap_context({ 64, 64 }, nano::image::format::rgba);
+    gc.draw_image(src, nano::rect<float>(0, 0, 64, 64));
+    return reinterpret_cast<const nano::color*>(gc.create_image().view().row(20))[30];
+  };
+
+  EXPECT_EQ(draw(img).red(), 0);
+
+  // The 64x64 level averages the columns.
+  img.set_mipmapped(true);
+  EXPECT_TRUE(img.is_mipmapped() && nano::image(img).is_mipmapped());
+  EXPECT_EQ(draw(img), nano::color(64, 64, 64, 255));
+
+  // Writing to the pixels drops the levels.
+  nano::mutable_image_view m = img.mutable_view();
+  std::fill_n(reinterpret_cast<nano::color*>(m.data), 256 * 256, nano::color(255, 0, 0, 255));
+  EXPECT_EQ(draw(img), nano::color(255, 0, 0, 255));
+
+  // No level fits in the budget.
+  const std::size_t limit = nano::image::get_mipmap_memory_limit();
+  nano::image::set_mipmap_memory_limit(0);
+  nano::image fresh(
+      { 256, 256 }, 8, 32, 256 * 4, nano::image::format::rgba, reinterpret_cast<const std::uint8_t*>(stripes.data()));
+  fresh.set_mipmapped(true);
+  EXPECT_EQ(draw(fresh).red(), 0);
+  nano::image::set_mipmap_memory_limit(limit);
+}
+
+TEST_CASE("nano.graphics", Jpeg, "Jpeg") {
+  using scale = nano::image::decode_scale;
+
+  // 16x8 with a red left half and a blue right half.
+  const std::uint8_t data[] = {
+    0xFF, 0xD8, 0xFF, 0xDB, 0x00, 0x43, 0x00, 0x08, 0x06, 0x06, 0x07, 0x06, 0x05, 0x08, 0x07, 0x07, 0x07, 0x09,
+    0x09, 0x08, 0x0A, 0x0C, 0x14, 0x0D, 0x0C, 0x0B, 0x0B, 0x0C, 0x19, 0x12, 0x13, 0x0F, 0x14, 0x1D, 0x1A, 0x1F,
+    0x1E, 0x1D, 0x1A, 0x1C, 0x1C, 0x20, 0x24, 0x2E, 0x27, 0x20, 0x22, 0x2C, 0x23, 0x1C, 0x1C, 0x28, 0x37, 0x29,
+    0x2C, 0x30, 0x31, 0x34, 0x34, 0x34, 0x1F, 0x27, 0x39, 0x3D, 0x38, 0x32, 0x3C, 0x2E, 0x33, 0x34, 0x32, 0xFF,
+    0xDB, 0x00, 0x43, 0x01, 0x09, 0x09, 0x09, 0x0C, 0x0B, 0x0C, 0x18, 0x0D, 0x0D, 0x18, 0x32, 0x21, 0x1C, 0x21,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0xFF, 0xC0, 0x00, 0x11,
+    0x08, 0x00, 0x08, 0x00, 0x10, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xFF, 0xC4, 0x00,
+    0x15, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x06, 0xFF, 0xC4, 0x00, 0x14, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xC4, 0x00, 0x14, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xFF, 0xC4, 0x00, 0x18, 0x11, 0x00, 0x02, 0x03,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x43, 0x82, 0xC2,
+    0xFF, 0xDA, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3F, 0x00, 0x9B, 0x4D, 0x01, 0x84,
+    0x99, 0xEB, 0xA1, 0xE6, 0xF8, 0x6D, 0x93, 0xFF, 0xD9
+  };
+
+  const std::string file(reinterpret_cast<const char*>(data), sizeof(data));
+
+  for (scale s : { scale::full, scale::half, scale::quarter, scale::eighth }) {
+    const std::size_t d = static_cast<std::size_t>(s);
+    std::istringstream input(file);
+    nano::jpeg_decoder decoder(input, s);
+    EXPECT_TRUE(decoder.is_valid() && decoder.get_size() == nano::size<std::size_t>(16 / d, 8 / d));
+
+    bool colors = true;
+    EXPECT_TRUE(decoder.read_rows([&](std::size_t, const nano::image_view& row) {
+      const std::uint8_t* left = row.data;
+      const std::uint8_t* right = row.data + (row.size.width - 1) * 3;
+      colors = colors && left[0] > 180 && left[2] < 60 && right[0] < 60 && right[2] > 180;
+      return true;
+    }));
+
+    EXPECT_TRUE(colors && decoder.get_row_index() == 8 / d);
+  }
+
+  std::istringstream truncated(file.substr(0, file.size() / 2));
+  nano::jpeg_decoder partial(truncated);
+  std::vector<std::uint8_t> row(16 * 4);
+  while (partial.read_row(row.data(), nano::image::format::rgba)) {
+  }
+
+  EXPECT_FALSE(partial.is_valid());
+
+  // The reduced decode is also an image constructor.
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "nano_graphics_jpeg_test.jpg";
+  std::ofstream(path, std::ios::binary).write(file.data(), static_cast<std::streamsize>(file.size()));
+
+  const nano::image img(path.string(), nano::image::type::jpeg, scale::quarter);
+  EXPECT_TRUE(img.get_size() == nano::size<std::size_t>(4, 2) && img.get_format() == nano::image::format::rgb);
+  EXPECT_TRUE(nano::image(path.string(), nano::image::type::jpeg).get_size() == nano::size<std::size_t>(16, 8));
+  std::filesystem::remove(path);
+}
+#endif
 } // namespace.
 
 NANO_TEST_MAIN()